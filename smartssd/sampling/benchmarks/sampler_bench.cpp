@@ -0,0 +1,827 @@
+/**
+ * Benchmarks of the sampling stages and of whole epochs of every sampler,
+ * swept over fanouts, batch sizes and chunk sizes. The results go to a JSON
+ * file, one entry per benchmark and configuration:
+ *   {"config": {...},
+ *    "results": [{"benchmark": ..., "chunk_size": ..., "fanouts": [...],
+ *                 "batch_size": ..., "seconds": ...,
+ *                 "metrics": {...}, "phases": {...}}, ...]}
+ * seconds is the median over the repeats, metrics and phases are those of
+ * the median run. Times are in seconds, rates are per second of wall time.
+ *
+ * The graph is either preprocessed data (--data) or a synthetic graph (see
+ * GraphGenerator) that is generated into --work-dir for every chunk size.
+ * With --weighted the samplers draw by edge weight from the weighted files,
+ * with --layer-budgets the streaming epochs sample layer-wise, and with
+ * --fused-epochs k they sample k epochs per pass over the edge file. The
+ * synthetic streaming chunks are padded only to a page with --variable-chunks,
+ * and --max-degree above what a chunk holds makes nodes that span chunks.
+ * Built with -DHOST_EMULATION=ON the devices are emulated and the kernels run
+ * on the CPU, so the benchmarks run on any machine with ordinary files; the
+ * samplers read with O_DIRECT, so the files must not be on tmpfs.
+ */
+#include "BatchDeduplicator.hpp"
+#include "FrontierPartitioner.hpp"
+#include "InMemorySampler.hpp"
+#include "RandomReadSampler.hpp"
+#include "ReadPlanner.hpp"
+#include "StreamingSampler.hpp"
+#include "utils/alias_table.hpp"
+#include "utils/array_file.hpp"
+#include "utils/artifact_writer.hpp"
+#include "utils/graph_generator.hpp"
+#include "utils/metrics.hpp"
+#include "utils/philox.hpp"
+#include "utils/timer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const char *ALL_BENCHMARKS =
+    "frontier_partition,frontier_prep,dedup,read_plan,streaming_pass,"
+    "streaming_epoch,random_read_epoch,in_memory_epoch";
+
+struct Options {
+  std::string data_dir;
+  std::string work_dir = "sampler_bench_data";
+  std::string xclbin_dir = ".";
+  std::string output = "sampler_bench.json";
+  std::string metrics_file;
+  uint64_t n_nodes = 1 << 20;
+  std::string model = "log_normal";
+  double avg_degree = 16;
+  uint64_t seed = 42;
+  std::vector<std::vector<uint>> fanouts = {{10, 5}, {15, 10, 5}};
+  std::vector<size_t> batch_sizes = {512, 2048};
+  std::vector<size_t> chunk_sizes = {4 << 20, 16 << 20};
+  size_t n_devices = 1;
+  size_t repeat = 3;
+  size_t epochs = 1;
+  std::vector<std::string> benchmarks;
+  bool replace = true;
+  bool weighted = false;
+  // nodes kept per batch and layer, empty for node-wise sampling
+  std::vector<uint> layer_budgets;
+  // epochs sampled per pass over the edge file
+  size_t fused_epochs = 1;
+  bool variable_chunks = false;
+  // degree cap of the synthetic graph, 0 for what one chunk holds
+  uint64_t max_degree = 0;
+};
+
+/**
+ * The graph of one chunk size, as the samplers read it
+ */
+struct Dataset {
+  std::string dir;
+  size_t chunk_size_byte;
+  ArrayFile offsets;
+  std::vector<uint> chunk_offsets;
+  std::vector<uint> train_nodes;
+
+  uint64_t getNumNodes() const { return this->offsets.size() - 1; }
+
+  uint64_t getNumEdges() const {
+    return this->offsets[this->offsets.size() - 1];
+  }
+
+  std::string path(const char *file) const { return this->dir + "/" + file; }
+
+  // the files of the sampled edges, the alias tables when weighted
+  std::string streamingEdges(bool weighted) const {
+    return path(weighted ? "weighted_streaming_edges.bin"
+                         : "streaming_edges.bin");
+  }
+
+  std::string chunkInfo(bool weighted) const {
+    return path(weighted ? "weighted_chunk_info.bin" : "chunk_info.bin");
+  }
+
+  std::string randomReadEdges(bool weighted) const {
+    return path(weighted ? "weighted_edges.bin" : "random_read_edges.bin");
+  }
+};
+
+struct Result {
+  float seconds = 0;
+  std::vector<std::pair<std::string, double>> metrics;
+  std::vector<std::pair<std::string, double>> phases;
+};
+
+template <typename T> std::vector<T> parseList(const std::string &text) {
+  std::vector<T> values;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      values.push_back(static_cast<T>(std::stoull(item)));
+    }
+  }
+  return values;
+}
+
+std::vector<std::string> parseNames(const std::string &text) {
+  std::vector<std::string> names;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      names.push_back(item);
+    }
+  }
+  return names;
+}
+
+/**
+ * Fanout lists are separated by ';', "10,5;15,10,5"
+ */
+std::vector<std::vector<uint>> parseFanouts(const std::string &text) {
+  std::vector<std::vector<uint>> fanouts;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ';')) {
+    std::vector<uint> layers = parseList<uint>(item);
+    if (!layers.empty()) {
+      fanouts.push_back(layers);
+    }
+  }
+  return fanouts;
+}
+
+std::string quote(const std::string &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+template <typename T> std::string toJson(const std::vector<T> &values) {
+  std::stringstream json;
+  json << "[";
+  for (size_t i = 0; i < values.size(); i++) {
+    json << (i ? ", " : "") << values[i];
+  }
+  json << "]";
+  return json.str();
+}
+
+std::string toJson(const std::vector<std::pair<std::string, double>> &values) {
+  std::stringstream json;
+  json.precision(10);
+  json << "{";
+  for (size_t i = 0; i < values.size(); i++) {
+    json << (i ? ", " : "") << quote(values[i].first) << ": "
+         << values[i].second;
+  }
+  json << "}";
+  return json.str();
+}
+
+bool exists(const std::string &path) {
+  struct stat statbuf;
+  return stat(path.c_str(), &statbuf) == 0;
+}
+
+/**
+ * Write the synthetic graph with a chunk size into dir, a tenth of its nodes
+ * training nodes
+ */
+void generateGraph(const Options &options, const std::string &dir,
+                   size_t chunk_size_byte) {
+  if (!exists(dir) && mkdir(dir.c_str(), 0755) != 0) {
+    std::cerr << "ERR: cannot create " << dir << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  GraphGenerator generator(GraphGenerator::parseModel(options.model),
+                           options.n_nodes, options.avg_degree, options.seed);
+  generator.setMaxDegree(
+      options.max_degree > 0
+          ? options.max_degree
+          : (chunk_size_byte / sizeof(int) - 4) /
+                (options.weighted ? AliasTable::ENTRY_INTS : 1));
+  ArtifactWriter writer(dir, chunk_size_byte, 4, false, false,
+                        options.weighted, options.variable_chunks);
+  generator.write(writer, 0.1);
+  std::cerr << "generated " << writer.getNumNodes() << " nodes, "
+            << writer.getNumEdges() << " edges, " << writer.getNumChunks()
+            << " chunks of " << chunk_size_byte << " bytes in " << dir
+            << std::endl;
+}
+
+std::vector<uint> loadUintArray(const std::string &path) {
+  ArrayFile file(path, 4);
+  Span<const uint> values = file.view<uint>();
+  if (values.size() != file.size()) {
+    std::cerr << "ERR: " << path << " does not hold 4 byte values" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return std::vector<uint>(values.begin(), values.end());
+}
+
+void loadDataset(Dataset &dataset, bool weighted) {
+  dataset.offsets = ArrayFile(dataset.path("offsets.bin"), 0);
+  if (dataset.offsets.size() < 2) {
+    std::cerr << "ERR: no graph in " << dataset.dir << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  dataset.chunk_offsets = loadUintArray(dataset.chunkInfo(weighted));
+  dataset.train_nodes = loadUintArray(dataset.path("train.bin"));
+}
+
+/**
+ * The uniformly random nodes an epoch would see as the second layer frontier,
+ * n_train * fanout of them, about 5% of them -1 for missing neighbors
+ */
+std::vector<uint> randomFrontier(const Dataset &dataset, uint fanout,
+                                 bool with_missing, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<uint> node_distribution(
+      0, dataset.getNumNodes() - 1);
+  std::vector<uint> frontier(dataset.train_nodes.size() * fanout);
+  for (uint &node : frontier) {
+    node = with_missing && rng() % 20 == 0 ? static_cast<uint>(-1)
+                                           : node_distribution(rng);
+  }
+  return frontier;
+}
+
+/**
+ * The training nodes in a fixed random order
+ */
+std::vector<uint> shuffledTrainNodes(const Dataset &dataset, uint64_t seed) {
+  std::vector<uint> nodes = dataset.train_nodes;
+  std::shuffle(nodes.begin(), nodes.end(), std::mt19937_64(seed));
+  return nodes;
+}
+
+std::vector<uint> allNodes(const Dataset &dataset) {
+  std::vector<uint> nodes(dataset.getNumNodes());
+  for (size_t i = 0; i < nodes.size(); i++) {
+    nodes[i] = i;
+  }
+  return nodes;
+}
+
+std::vector<uint> deviceIds(const Options &options) {
+  std::vector<uint> ids;
+  for (size_t i = 0; i < options.n_devices; i++) {
+    ids.push_back(i);
+  }
+  return ids;
+}
+
+Result benchFrontierPartition(const Dataset &dataset,
+                              const std::vector<uint> &fanouts) {
+  std::vector<uint> frontier = randomFrontier(dataset, fanouts[0], false, 1);
+  FrontierPartitioner partitioner(dataset.chunk_offsets);
+  Timer timer;
+  timer.start();
+  partitioner.partition(frontier.data(), frontier.size());
+  timer.stop();
+
+  Result result;
+  result.seconds = timer.getDuration() / 1000;
+  result.metrics = {{"nodes", frontier.size()},
+                    {"chunks", partitioner.getNumChunks()},
+                    {"nodes_per_s", frontier.size() / result.seconds}};
+  return result;
+}
+
+Result benchFrontierPrep(const Dataset &dataset,
+                         const std::vector<uint> &fanouts) {
+  std::vector<uint> frontier = randomFrontier(dataset, fanouts[0], true, 2);
+  size_t n_samples = frontier.size();
+  Result result;
+  float filter_time = 0, sort_time = 0, unique_time = 0;
+  Timer timer;
+  timer.start();
+  {
+    EasyTimer phase(filter_time);
+    frontier.erase(
+        std::remove(frontier.begin(), frontier.end(), static_cast<uint>(-1)),
+        frontier.end());
+  }
+  {
+    EasyTimer phase(sort_time);
+    std::sort(frontier.begin(), frontier.end());
+  }
+  {
+    EasyTimer phase(unique_time);
+    frontier.erase(std::unique(frontier.begin(), frontier.end()),
+                   frontier.end());
+  }
+  timer.stop();
+
+  result.seconds = timer.getDuration() / 1000;
+  result.metrics = {{"samples", n_samples},
+                    {"distinct", frontier.size()},
+                    {"samples_per_s", n_samples / result.seconds}};
+  result.phases = {{"filter", filter_time / 1000},
+                   {"sort", sort_time / 1000},
+                   {"unique", unique_time / 1000}};
+  return result;
+}
+
+Result benchDedup(const Dataset &dataset, const std::vector<uint> &fanouts,
+                  size_t batch_size) {
+  uint fanout = fanouts[0];
+  std::vector<uint> samples = randomFrontier(dataset, fanout, true, 3);
+  std::vector<uint> source_size;
+  for (size_t begin = 0; begin < dataset.train_nodes.size();
+       begin += batch_size) {
+    source_size.push_back(
+        std::min(batch_size, dataset.train_nodes.size() - begin));
+  }
+  BatchDeduplicator deduplicator;
+  std::vector<uint> deduplicated, deduplicated_size;
+  size_t n_samples = samples.size();
+  Timer timer;
+  timer.start();
+  deduplicator.deduplicate(samples, source_size, fanout, deduplicated,
+                           deduplicated_size);
+  timer.stop();
+
+  Result result;
+  result.seconds = timer.getDuration() / 1000;
+  result.metrics = {{"samples", n_samples},
+                    {"batches", source_size.size()},
+                    {"distinct", deduplicated.size()},
+                    {"samples_per_s", n_samples / result.seconds}};
+  return result;
+}
+
+Result benchReadPlan(const Options &options, const Dataset &dataset,
+                     const std::vector<uint> &fanouts, size_t batch_size) {
+  uint fanout = fanouts[0];
+  std::vector<uint> targets = shuffledTrainNodes(dataset, 4);
+  size_t max_samples = batch_size * fanout;
+  std::vector<uint> sector_offsets(max_samples), buffer_offsets(max_samples);
+  std::vector<uint> coins(max_samples);
+  std::vector<UringReader::ReadRequest> requests;
+  ReadPlanner planner;
+  planner.setReplace(options.replace);
+  planner.setWeighted(options.weighted);
+  Philox draws(options.seed, 0, 0);
+  size_t n_samples = 0, n_sectors = 0, n_reads = 0;
+  Timer timer;
+  timer.start();
+  for (size_t begin = 0; begin < targets.size(); begin += batch_size) {
+    size_t n = std::min(batch_size, targets.size() - begin);
+    ssize_t re = planner.plan(targets.data() + begin, n, fanout,
+                              dataset.offsets, max_samples, draws,
+                              sector_offsets.data(), buffer_offsets.data(),
+                              requests, nullptr, nullptr, coins.data());
+    if (re < 0) {
+      std::cerr << "ERR: the read plan does not fit " << max_samples
+                << " sectors" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    n_samples += planner.getNumSamples();
+    n_sectors += planner.getNumReadSectors();
+    n_reads += requests.size();
+  }
+  timer.stop();
+
+  Result result;
+  result.seconds = timer.getDuration() / 1000;
+  result.metrics = {{"samples", n_samples},
+                    {"sectors", n_sectors},
+                    {"reads", n_reads},
+                    {"samples_per_s", n_samples / result.seconds},
+                    {"planned_iops", n_reads / result.seconds},
+                    {"planned_gb_per_s", n_sectors * 512.0 / result.seconds /
+                                             1e9}};
+  return result;
+}
+
+StreamingSampler *newStreamingSampler(const Options &options,
+                                      const Dataset &dataset,
+                                      const std::vector<uint> &fanouts) {
+  StreamingSampler *sampler = new StreamingSampler(
+      deviceIds(options),
+      options.xclbin_dir + "/parallel_streaming_sampler.xclbin",
+      "parallel_streaming_sampler", dataset.streamingEdges(options.weighted),
+      dataset.chunkInfo(options.weighted), dataset.path("train.bin"), fanouts,
+      dataset.chunk_size_byte / sizeof(int));
+  sampler->setSeed(options.seed);
+  sampler->setReplace(options.replace);
+  sampler->setWeighted(options.weighted);
+  sampler->setLayerBudgets(options.layer_budgets);
+  sampler->setFusedEpochs(options.fused_epochs);
+  return sampler;
+}
+
+Result benchStreamingPass(const Options &options, const Dataset &dataset,
+                          const std::vector<uint> &fanouts) {
+  std::unique_ptr<StreamingSampler> sampler(
+      newStreamingSampler(options, dataset, fanouts));
+  std::vector<uint> frontier = allNodes(dataset);
+  std::vector<uint> sampled;
+  Timer timer;
+  timer.start();
+  sampler->sampleLayer(Span<const uint>(frontier.data(), frontier.size()),
+                       fanouts[0], sampled, Philox(options.seed, 0, 0));
+  timer.stop();
+
+  Result result;
+  result.seconds = timer.getDuration() / 1000;
+  size_t bytes_read = sampler->getEdgeBytesRead();
+  result.metrics = {
+      {"edges", dataset.getNumEdges()},
+      {"bytes_read", bytes_read},
+      {"sampled", sampled.size()},
+      {"edges_per_s", dataset.getNumEdges() / result.seconds},
+      {"gb_per_s", bytes_read / result.seconds / 1e9}};
+  result.phases = {{"kernel", sampler->getFpgaTime() / 1000},
+                   {"transfer", sampler->getTransferTime() / 1000}};
+  return result;
+}
+
+/**
+ * Time `epochs` epochs of newEpochStart and serving every batch. The first
+ * epoch, and the epochs fused with it, is sampled while we wait, the later
+ * ones in the background while the previous ones are served.
+ */
+Result benchStreamingEpoch(const Options &options, const Dataset &dataset,
+                           const std::vector<uint> &fanouts,
+                           size_t batch_size) {
+  std::unique_ptr<StreamingSampler> sampler(
+      newStreamingSampler(options, dataset, fanouts));
+  sampler->setBatchSize(batch_size);
+  SampleWorkspace workspace;
+  size_t n_batches = 0, n_sampled = 0, bytes_read = 0;
+  float first_epoch_time = 0, wait_time = 0, serve_time = 0;
+  float kernel_time = 0, transfer_time = 0;
+  Timer timer;
+  timer.start();
+  for (size_t epoch = 0; epoch < options.epochs; epoch++) {
+    {
+      EasyTimer phase(epoch == 0 ? first_epoch_time : wait_time);
+      sampler->newEpochStart();
+    }
+    if (epoch == 0) {
+      // the epochs after it are sampled from now on, the first call sampled
+      // the fused ones with it
+      kernel_time = sampler->getFpgaTime();
+      transfer_time = sampler->getTransferTime();
+      bytes_read = sampler->getEdgeBytesRead();
+    }
+    EasyTimer phase(serve_time);
+    size_t epoch_batches = sampler->getNumBatches();
+    for (size_t batch = 0; batch < epoch_batches; batch++) {
+      sampler->sample(Span<const uint>(), workspace);
+      n_sampled += workspace.values.size();
+    }
+    n_batches += epoch_batches;
+  }
+  timer.stop();
+
+  Result result;
+  result.seconds = timer.getDuration() / 1000;
+  result.metrics = {{"epochs", options.epochs},
+                    {"batches", n_batches},
+                    {"sampled", n_sampled},
+                    {"first_epoch_bytes_read", bytes_read},
+                    {"bytes_read_per_epoch",
+                     (double)bytes_read / options.fused_epochs},
+                    {"sampled_per_s", n_sampled / result.seconds},
+                    {"first_epoch_gb_per_s",
+                     bytes_read / (first_epoch_time / 1000) / 1e9}};
+  result.phases = {{"first_epoch", first_epoch_time / 1000},
+                   {"first_epoch_kernel", kernel_time / 1000},
+                   {"first_epoch_transfer", transfer_time / 1000},
+                   {"wait", wait_time / 1000},
+                   {"serve", serve_time / 1000}};
+  return result;
+}
+
+/**
+ * Time `epochs` epochs of minibatches of the shuffled training nodes
+ */
+Result benchSamplerEpoch(SamplerBase &sampler, const Options &options,
+                         const Dataset &dataset, size_t batch_size) {
+  std::vector<uint> targets = shuffledTrainNodes(dataset, 5);
+  SampleWorkspace workspace;
+  size_t n_batches = 0, n_sampled = 0;
+  Timer timer;
+  timer.start();
+  for (size_t epoch = 0; epoch < options.epochs; epoch++) {
+    for (size_t begin = 0; begin < targets.size(); begin += batch_size) {
+      size_t n = std::min(batch_size, targets.size() - begin);
+      sampler.sample(Span<const uint>(targets.data() + begin, n), workspace);
+      n_sampled += workspace.values.size();
+      n_batches++;
+    }
+  }
+  timer.stop();
+
+  Result result;
+  result.seconds = timer.getDuration() / 1000;
+  result.metrics = {{"epochs", options.epochs},
+                    {"batches", n_batches},
+                    {"sampled", n_sampled},
+                    {"sampled_per_s", n_sampled / result.seconds}};
+  return result;
+}
+
+Result benchRandomReadEpoch(const Options &options, const Dataset &dataset,
+                            const std::vector<uint> &fanouts,
+                            size_t batch_size) {
+  std::string kernel_name = options.weighted ? "weighted_random_read_sampler"
+                                             : "random_read_sampler";
+  RandomReadSampler sampler(
+      deviceIds(options), options.xclbin_dir + "/" + kernel_name + ".xclbin",
+      kernel_name, dataset.randomReadEdges(options.weighted),
+      dataset.path("offsets.bin"), fanouts);
+  sampler.setSeed(options.seed);
+  sampler.setReplace(options.replace);
+  sampler.setWeighted(options.weighted);
+  Result result = benchSamplerEpoch(sampler, options, dataset, batch_size);
+  size_t n_reads = sampler.getReadsIssued();
+  size_t n_sectors = sampler.getSectorsRead();
+  result.metrics.push_back({"reads", n_reads});
+  result.metrics.push_back({"sectors", n_sectors});
+  result.metrics.push_back({"iops", n_reads / result.seconds});
+  result.metrics.push_back(
+      {"gb_per_s", n_sectors * 512.0 / result.seconds / 1e9});
+  float kernel_time = sampler.getFpgaTime() / 1000;
+  float transfer_time = sampler.getTransferTime() / 1000;
+  result.phases = {{"kernel", kernel_time},
+                   {"transfer", transfer_time},
+                   {"host", result.seconds - kernel_time - transfer_time}};
+  return result;
+}
+
+Result benchInMemoryEpoch(const Options &options, const Dataset &dataset,
+                          const std::vector<uint> &fanouts,
+                          size_t batch_size) {
+  InMemorySampler sampler(dataset.randomReadEdges(options.weighted),
+                          dataset.path("offsets.bin"), fanouts, 0);
+  sampler.setSeed(options.seed);
+  sampler.setReplace(options.replace);
+  sampler.setWeighted(options.weighted);
+  return benchSamplerEpoch(sampler, options, dataset, batch_size);
+}
+
+/**
+ * Whether a minibatch fits the raw sample buffer of the random read sampler
+ */
+bool fitsRandomRead(const std::vector<uint> &fanouts, size_t batch_size) {
+  // the largest layer samples every node of the previous ones
+  size_t n_samples = batch_size;
+  for (uint fanout : fanouts) {
+    n_samples *= fanout;
+  }
+  return n_samples <= 1024 * 20 * 15 * 10;
+}
+
+Result runBenchmark(const std::string &name, const Options &options,
+                    const Dataset &dataset, const std::vector<uint> &fanouts,
+                    size_t batch_size) {
+  if (name == "frontier_partition") {
+    return benchFrontierPartition(dataset, fanouts);
+  } else if (name == "frontier_prep") {
+    return benchFrontierPrep(dataset, fanouts);
+  } else if (name == "dedup") {
+    return benchDedup(dataset, fanouts, batch_size);
+  } else if (name == "read_plan") {
+    return benchReadPlan(options, dataset, fanouts, batch_size);
+  } else if (name == "streaming_pass") {
+    return benchStreamingPass(options, dataset, fanouts);
+  } else if (name == "streaming_epoch") {
+    return benchStreamingEpoch(options, dataset, fanouts, batch_size);
+  } else if (name == "random_read_epoch") {
+    return benchRandomReadEpoch(options, dataset, fanouts, batch_size);
+  } else if (name == "in_memory_epoch") {
+    return benchInMemoryEpoch(options, dataset, fanouts, batch_size);
+  }
+  std::cerr << "ERR: unknown benchmark " << name << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Run a benchmark options.repeat times and keep the median run
+ */
+Result runRepeated(const std::string &name, const Options &options,
+                   const Dataset &dataset, const std::vector<uint> &fanouts,
+                   size_t batch_size) {
+  std::vector<Result> runs;
+  for (size_t i = 0; i < std::max<size_t>(options.repeat, 1); i++) {
+    runs.push_back(runBenchmark(name, options, dataset, fanouts, batch_size));
+  }
+  std::sort(runs.begin(), runs.end(), [](const Result &a, const Result &b) {
+    return a.seconds < b.seconds;
+  });
+  return runs[runs.size() / 2];
+}
+
+void printUsage(const char *name) {
+  std::cerr
+      << "Benchmark the samplers: " << name
+      << " [--data <preprocessed_dir> | --work-dir <dir> [--nodes <n>]"
+      << " [--model rmat|power_law|log_normal] [--avg-degree <d>] [--seed <s>]"
+      << " [--max-degree <d>] [--variable-chunks]]"
+      << " [--fanouts <f,f;f,f,f>] [--batch-sizes <b,b>]"
+      << " [--chunk-sizes <bytes,bytes>] [--devices <n>]"
+      << " [--xclbin-dir <dir>] [--repeat <n>] [--epochs <n>] [--no-replace]"
+      << " [--weighted] [--layer-budgets <b,b>] [--fused-epochs <k>]"
+      << " [--benchmarks <name,name>] [--output <file|->]"
+      << " [--metrics <file.json|file.prom>]" << std::endl
+      << "benchmarks: " << ALL_BENCHMARKS << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  options.benchmarks = parseNames(ALL_BENCHMARKS);
+  bool chunk_sizes_given = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--data" && has_value) {
+      options.data_dir = argv[++i];
+    } else if (arg == "--work-dir" && has_value) {
+      options.work_dir = argv[++i];
+    } else if (arg == "--nodes" && has_value) {
+      options.n_nodes = std::stoull(argv[++i]);
+    } else if (arg == "--model" && has_value) {
+      options.model = argv[++i];
+    } else if (arg == "--avg-degree" && has_value) {
+      options.avg_degree = std::stod(argv[++i]);
+    } else if (arg == "--seed" && has_value) {
+      options.seed = std::stoull(argv[++i]);
+    } else if (arg == "--max-degree" && has_value) {
+      options.max_degree = std::stoull(argv[++i]);
+    } else if (arg == "--variable-chunks") {
+      options.variable_chunks = true;
+    } else if (arg == "--fanouts" && has_value) {
+      options.fanouts = parseFanouts(argv[++i]);
+    } else if (arg == "--batch-sizes" && has_value) {
+      options.batch_sizes = parseList<size_t>(argv[++i]);
+    } else if (arg == "--chunk-sizes" && has_value) {
+      options.chunk_sizes = parseList<size_t>(argv[++i]);
+      chunk_sizes_given = true;
+    } else if (arg == "--devices" && has_value) {
+      options.n_devices = std::stoull(argv[++i]);
+    } else if (arg == "--xclbin-dir" && has_value) {
+      options.xclbin_dir = argv[++i];
+    } else if (arg == "--repeat" && has_value) {
+      options.repeat = std::stoull(argv[++i]);
+    } else if (arg == "--epochs" && has_value) {
+      options.epochs = std::stoull(argv[++i]);
+    } else if (arg == "--benchmarks" && has_value) {
+      options.benchmarks = parseNames(argv[++i]);
+    } else if (arg == "--output" && has_value) {
+      options.output = argv[++i];
+    } else if (arg == "--no-replace") {
+      options.replace = false;
+    } else if (arg == "--weighted") {
+      options.weighted = true;
+    } else if (arg == "--layer-budgets" && has_value) {
+      options.layer_budgets = parseList<uint>(argv[++i]);
+    } else if (arg == "--fused-epochs" && has_value) {
+      options.fused_epochs = std::stoull(argv[++i]);
+    } else if (arg == "--metrics" && has_value) {
+      options.metrics_file = argv[++i];
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  // preprocessed data has one chunk size, which has to be given
+  bool bad_chunk_sizes =
+      options.chunk_sizes.empty() ||
+      (!options.data_dir.empty() &&
+       (!chunk_sizes_given || options.chunk_sizes.size() != 1));
+  for (size_t chunk_size : options.chunk_sizes) {
+    bad_chunk_sizes |= chunk_size == 0 || chunk_size % 512 != 0;
+  }
+  // one budget per layer of every fanout list
+  bool bad_budgets = false;
+  for (const std::vector<uint> &fanouts : options.fanouts) {
+    bad_budgets |= !options.layer_budgets.empty() &&
+                   options.layer_budgets.size() != fanouts.size();
+  }
+  for (uint budget : options.layer_budgets) {
+    bad_budgets |= budget == 0;
+  }
+  if (bad_chunk_sizes || bad_budgets || options.fanouts.empty() ||
+      options.batch_sizes.empty() || options.n_devices == 0 ||
+      options.n_nodes == 0 || options.epochs == 0 ||
+      options.fused_epochs == 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::stringstream results;
+  bool first_result = true;
+  uint64_t n_nodes = 0, n_edges = 0;
+  for (size_t chunk_size : options.chunk_sizes) {
+    Dataset dataset;
+    dataset.chunk_size_byte = chunk_size;
+    if (!options.data_dir.empty()) {
+      dataset.dir = options.data_dir;
+    } else {
+      if (!exists(options.work_dir) &&
+          mkdir(options.work_dir.c_str(), 0755) != 0) {
+        std::cerr << "ERR: cannot create " << options.work_dir << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      dataset.dir = options.work_dir + "/chunk_" + std::to_string(chunk_size);
+      generateGraph(options, dataset.dir, chunk_size);
+    }
+    loadDataset(dataset, options.weighted);
+    n_nodes = dataset.getNumNodes();
+    n_edges = dataset.getNumEdges();
+
+    for (const std::vector<uint> &fanouts : options.fanouts) {
+      for (size_t batch_size : options.batch_sizes) {
+        for (const std::string &name : options.benchmarks) {
+          if (name == "random_read_epoch" &&
+              !fitsRandomRead(fanouts, batch_size)) {
+            std::cerr << "skip " << name << ": batch size " << batch_size
+                      << " does not fit the random read buffers" << std::endl;
+            continue;
+          }
+          std::cerr << name << " chunk_size=" << chunk_size
+                    << " fanouts=" << toJson(fanouts)
+                    << " batch_size=" << batch_size << std::endl;
+          Result result =
+              runRepeated(name, options, dataset, fanouts, batch_size);
+          results << (first_result ? "" : ",\n") << "    {\"benchmark\": "
+                  << quote(name) << ", \"chunk_size\": " << chunk_size
+                  << ", \"fanouts\": " << toJson(fanouts)
+                  << ", \"batch_size\": " << batch_size
+                  << ", \"seconds\": " << result.seconds
+                  << ",\n     \"metrics\": " << toJson(result.metrics)
+                  << ",\n     \"phases\": " << toJson(result.phases) << "}";
+          first_result = false;
+        }
+      }
+    }
+  }
+
+  std::stringstream json;
+  json << "{\n  \"config\": {\"data\": "
+       << quote(options.data_dir.empty() ? "synthetic" : options.data_dir)
+       << ", \"nodes\": " << n_nodes << ", \"edges\": " << n_edges;
+  if (options.data_dir.empty()) {
+    json << ", \"model\": " << quote(options.model)
+         << ", \"avg_degree\": " << options.avg_degree
+         << ", \"seed\": " << options.seed
+         << ", \"max_degree\": " << options.max_degree
+         << ", \"variable_chunks\": "
+         << (options.variable_chunks ? "true" : "false");
+  }
+  json << ", \"devices\": " << options.n_devices
+       << ", \"replace\": " << (options.replace ? "true" : "false")
+       << ", \"weighted\": " << (options.weighted ? "true" : "false")
+       << ", \"layer_budgets\": " << toJson(options.layer_budgets)
+       << ", \"fused_epochs\": " << options.fused_epochs
+       << ", \"repeat\": " << options.repeat
+       << ", \"epochs\": " << options.epochs << ", \"emulated\": "
+#ifdef HOST_EMULATION
+       << "true"
+#else
+       << "false"
+#endif
+       << "},\n  \"results\": [\n"
+       << results.str() << "\n  ]\n}\n";
+
+  if (options.output == "-") {
+    std::cout << json.str();
+  } else {
+    std::ofstream output(options.output);
+    output << json.str();
+    if (!output) {
+      std::cerr << "ERR: cannot write " << options.output << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cerr << "results written to " << options.output << std::endl;
+  }
+  // the sampler metrics summed over every benchmark run
+  if (!options.metrics_file.empty()) {
+    if (metrics::writeSnapshot(options.metrics_file) != 0) {
+      std::cerr << "ERR: cannot write " << options.metrics_file << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cerr << "metrics written to " << options.metrics_file << std::endl;
+  }
+  return 0;
+}
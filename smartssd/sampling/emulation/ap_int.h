@@ -0,0 +1,66 @@
+/**
+ * Host emulation of the HLS arbitrary precision integers, as far as the
+ * kernels use them: up to 64 bits, wrapping at their width.
+ */
+#ifndef EMULATION_AP_INT_H
+#define EMULATION_AP_INT_H
+
+#include <cstdint>
+
+template <int W> class ap_uint {
+private:
+  uint64_t value;
+
+  static uint64_t wrap(uint64_t value) {
+    return W >= 64 ? value : value & ((uint64_t(1) << W) - 1);
+  }
+
+public:
+  ap_uint() : value(0) {}
+
+  ap_uint(uint64_t value) : value(wrap(value)) {}
+
+  operator uint64_t() const { return this->value; }
+
+  /**
+   * Bit i
+   */
+  bool operator[](int i) const { return (this->value >> i) & 1; }
+
+  ap_uint &operator>>=(int shift) {
+    this->value >>= shift;
+    return *this;
+  }
+
+  ap_uint &operator<<=(int shift) {
+    this->value = wrap(this->value << shift);
+    return *this;
+  }
+
+  ap_uint &operator^=(uint64_t other) {
+    this->value = wrap(this->value ^ other);
+    return *this;
+  }
+
+  ap_uint &operator&=(uint64_t other) {
+    this->value &= other;
+    return *this;
+  }
+
+  ap_uint &operator|=(uint64_t other) {
+    this->value = wrap(this->value | other);
+    return *this;
+  }
+
+  ap_uint &operator+=(uint64_t other) {
+    this->value = wrap(this->value + other);
+    return *this;
+  }
+
+  ap_uint &operator-=(uint64_t other) {
+    this->value = wrap(this->value - other);
+    return *this;
+  }
+};
+
+#endif // EMULATION_AP_INT_H
@@ -0,0 +1,70 @@
+/**
+ * Host emulation of xrt::bo: page aligned host memory, so that it can be the
+ * target of O_DIRECT reads like a P2P buffer. Device and host share the
+ * memory, so syncing does nothing.
+ */
+#ifndef EMULATION_XRT_BO_H
+#define EMULATION_XRT_BO_H
+
+#include "xrt_device.h"
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+namespace xrt {
+
+class bo {
+private:
+  std::shared_ptr<char> memory;
+  size_t offset = 0;
+  size_t size_byte = 0;
+
+  void allocate(size_t size_byte) {
+    // the size of aligned_alloc has to be a multiple of the alignment
+    size_t alloc_size_byte = (size_byte + 4095) / 4096 * 4096;
+    char *ptr = static_cast<char *>(
+        aligned_alloc(4096, alloc_size_byte > 0 ? alloc_size_byte : 4096));
+    if (ptr == nullptr) {
+      std::cerr << "ERR: cannot allocate a buffer of " << size_byte
+                << " bytes" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    this->memory = std::shared_ptr<char>(ptr, free);
+    this->size_byte = size_byte;
+  }
+
+public:
+  enum class flags { normal, cacheable, device_only, host_only, p2p, svm };
+
+  bo() {}
+
+  bo(const device &device, size_t size_byte, flags flags, int group) {
+    allocate(size_byte);
+  }
+
+  bo(const device &device, size_t size_byte, int group) {
+    allocate(size_byte);
+  }
+
+  /**
+   * A sub buffer of size_byte bytes at offset of the parent
+   */
+  bo(const bo &parent, size_t size_byte, size_t offset)
+      : memory(parent.memory), offset(parent.offset + offset),
+        size_byte(size_byte) {}
+
+  template <typename T> T map() {
+    return reinterpret_cast<T>(this->memory.get() + this->offset);
+  }
+
+  size_t size() const { return this->size_byte; }
+
+  void sync(xclBOSyncDirection direction) {}
+
+  void sync(xclBOSyncDirection direction, size_t size_byte, size_t offset) {}
+};
+
+} // namespace xrt
+
+#endif // EMULATION_XRT_BO_H
@@ -0,0 +1,78 @@
+/**
+ * Host emulation of the part of the XRT native API the samplers use, for
+ * builds with HOST_EMULATION. A device is the host itself: loading an xclbin
+ * only records its name, buffers are host memory and kernels run their host
+ * implementation from host_kernels.cpp on a thread of their own.
+ */
+#ifndef EMULATION_XRT_DEVICE_H
+#define EMULATION_XRT_DEVICE_H
+
+#include <ostream>
+#include <string>
+
+enum xclBOSyncDirection {
+  XCL_BO_SYNC_BO_TO_DEVICE,
+  XCL_BO_SYNC_BO_FROM_DEVICE
+};
+
+namespace xrt {
+
+class uuid {
+private:
+  std::string xclbin;
+
+public:
+  uuid() {}
+
+  explicit uuid(std::string xclbin) : xclbin(xclbin) {}
+
+  std::string to_string() const { return this->xclbin; }
+};
+
+namespace info {
+namespace device {
+struct name {};
+struct bdf {};
+} // namespace device
+} // namespace info
+
+class device {
+private:
+  unsigned int id = 0;
+
+public:
+  device() {}
+
+  explicit device(unsigned int id) : id(id) {}
+
+  /**
+   * The xclbin is not read, the kernels are the host implementations
+   */
+  uuid load_xclbin(const std::string &xclbin_file) {
+    return uuid(xclbin_file);
+  }
+
+  unsigned int getId() const { return this->id; }
+
+  template <typename Param> std::string get_info() const;
+};
+
+template <> inline std::string device::get_info<info::device::name>() const {
+  return "host_emulation_" + std::to_string(this->id);
+}
+
+template <> inline std::string device::get_info<info::device::bdf>() const {
+  return "0000:00:00." + std::to_string(this->id);
+}
+
+inline std::ostream &operator<<(std::ostream &out, const uuid &uuid) {
+  return out << uuid.to_string();
+}
+
+inline std::ostream &operator<<(std::ostream &out, const device &device) {
+  return out << device.get_info<info::device::name>();
+}
+
+} // namespace xrt
+
+#endif // EMULATION_XRT_DEVICE_H
@@ -0,0 +1,112 @@
+/**
+ * Host emulation of xrt::kernel and xrt::run. A kernel is looked up by name
+ * among the host kernels registered with registerHostKernel, and every call
+ * runs it asynchronously like a device would.
+ */
+#ifndef EMULATION_XRT_KERNEL_H
+#define EMULATION_XRT_KERNEL_H
+
+#include "xrt_bo.h"
+#include "xrt_device.h"
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace xrt {
+
+/**
+ * An argument of a host kernel, a buffer or a scalar
+ */
+struct kernel_arg {
+  void *buffer = nullptr;
+  uint64_t scalar = 0;
+};
+
+using host_kernel = std::function<void(const std::vector<kernel_arg> &)>;
+
+inline std::map<std::string, host_kernel> &hostKernelRegistry() {
+  static std::map<std::string, host_kernel> registry;
+  return registry;
+}
+
+/**
+ * Make `kernel` the host implementation of the kernel called name
+ */
+inline bool registerHostKernel(const std::string &name, host_kernel kernel) {
+  hostKernelRegistry()[name] = kernel;
+  return true;
+}
+
+inline kernel_arg toKernelArg(bo &buffer) {
+  kernel_arg arg;
+  arg.buffer = buffer.map<void *>();
+  return arg;
+}
+
+inline kernel_arg toKernelArg(const bo &buffer) {
+  return toKernelArg(const_cast<bo &>(buffer));
+}
+
+template <typename T> kernel_arg toKernelArg(T value) {
+  kernel_arg arg;
+  arg.scalar = static_cast<uint64_t>(value);
+  return arg;
+}
+
+class run {
+private:
+  std::shared_future<void> done;
+
+public:
+  run() {}
+
+  explicit run(std::shared_future<void> done) : done(done) {}
+
+  void wait() {
+    if (this->done.valid()) {
+      this->done.wait();
+    }
+  }
+};
+
+class kernel {
+private:
+  std::string name;
+  host_kernel implementation;
+
+public:
+  kernel() {}
+
+  kernel(const device &device, const uuid &xclbin_id,
+         const std::string &name)
+      : name(name) {
+    auto it = hostKernelRegistry().find(name);
+    if (it == hostKernelRegistry().end()) {
+      std::cerr << "ERR: there is no host kernel " << name << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    this->implementation = it->second;
+  }
+
+  /**
+   * All arguments are in one memory bank
+   */
+  int group_id(int argument) const { return 0; }
+
+  template <typename... Args> run operator()(Args &&...args) {
+    std::vector<kernel_arg> kernel_args = {toKernelArg(args)...};
+    host_kernel implementation = this->implementation;
+    return run(std::async(std::launch::async, [implementation,
+                                               kernel_args]() {
+                 implementation(kernel_args);
+               }).share());
+  }
+};
+
+} // namespace xrt
+
+#endif // EMULATION_XRT_KERNEL_H
@@ -0,0 +1,39 @@
+/**
+ * Host emulation of hls::stream, an unbounded FIFO
+ */
+#ifndef EMULATION_HLS_STREAM_H
+#define EMULATION_HLS_STREAM_H
+
+#include <deque>
+
+namespace hls {
+
+template <typename T> class stream {
+private:
+  std::deque<T> fifo;
+
+public:
+  void write(const T &value) { this->fifo.push_back(value); }
+
+  T read() {
+    T value = this->fifo.front();
+    this->fifo.pop_front();
+    return value;
+  }
+
+  bool empty() const { return this->fifo.empty(); }
+
+  stream &operator<<(const T &value) {
+    write(value);
+    return *this;
+  }
+
+  stream &operator>>(T &value) {
+    value = read();
+    return *this;
+  }
+};
+
+} // namespace hls
+
+#endif // EMULATION_HLS_STREAM_H
@@ -0,0 +1,76 @@
+/**
+ * Registers the kernels of kernels/, compiled for the host, as the host
+ * kernels of the emulated devices.
+ */
+#include "experimental/xrt_kernel.h"
+
+extern "C" {
+void parallel_streaming_sampler(unsigned int *in, unsigned int *out,
+                                unsigned int *target, unsigned int n_target,
+                                unsigned int n_sample,
+                                unsigned int external_seed,
+                                unsigned int distinct, unsigned int weighted);
+
+void random_read_sampler(unsigned int *in, unsigned int *out,
+                         unsigned int *offsets, unsigned int *buffer_offsets,
+                         unsigned int n_total);
+
+void weighted_random_read_sampler(unsigned int *in, unsigned int *out,
+                                  unsigned int *offsets,
+                                  unsigned int *buffer_offsets,
+                                  unsigned int *coins, unsigned int n_total);
+
+void seqkernel(unsigned int *chunk, unsigned int *sample_result,
+               unsigned int *target_nodes, unsigned int n_target,
+               unsigned int fanout);
+}
+
+static unsigned int *bufferArg(const std::vector<xrt::kernel_arg> &args,
+                               size_t i) {
+  return static_cast<unsigned int *>(args[i].buffer);
+}
+
+static unsigned int scalarArg(const std::vector<xrt::kernel_arg> &args,
+                              size_t i) {
+  return static_cast<unsigned int>(args[i].scalar);
+}
+
+static void runParallelStreamingSampler(
+    const std::vector<xrt::kernel_arg> &args) {
+  parallel_streaming_sampler(bufferArg(args, 0), bufferArg(args, 1),
+                             bufferArg(args, 2), scalarArg(args, 3),
+                             scalarArg(args, 4), scalarArg(args, 5),
+                             // hosts from before the distinct and weighted
+                             // arguments
+                             args.size() > 6 ? scalarArg(args, 6) : 0,
+                             args.size() > 7 ? scalarArg(args, 7) : 0);
+}
+
+static void runRandomReadSampler(const std::vector<xrt::kernel_arg> &args) {
+  random_read_sampler(bufferArg(args, 0), bufferArg(args, 1),
+                      bufferArg(args, 2), bufferArg(args, 3),
+                      scalarArg(args, 4));
+}
+
+static void
+runWeightedRandomReadSampler(const std::vector<xrt::kernel_arg> &args) {
+  weighted_random_read_sampler(bufferArg(args, 0), bufferArg(args, 1),
+                               bufferArg(args, 2), bufferArg(args, 3),
+                               bufferArg(args, 4), scalarArg(args, 5));
+}
+
+static void runSeqkernel(const std::vector<xrt::kernel_arg> &args) {
+  seqkernel(bufferArg(args, 0), bufferArg(args, 1), bufferArg(args, 2),
+            scalarArg(args, 3), scalarArg(args, 4));
+}
+
+static const bool registered =
+    xrt::registerHostKernel("parallel_streaming_sampler",
+                            runParallelStreamingSampler) &&
+    xrt::registerHostKernel("random_read_sampler", runRandomReadSampler) &&
+    // the name the random read xclbin was built with before
+    xrt::registerHostKernel("simple_random_read_sampler",
+                            runRandomReadSampler) &&
+    xrt::registerHostKernel("weighted_random_read_sampler",
+                            runWeightedRandomReadSampler) &&
+    xrt::registerHostKernel("seqkernel", runSeqkernel);
@@ -18,12 +18,86 @@
 
 extern "C" {
 
-inline unsigned int lfsr_random(unsigned int *lfsr) {
-  unsigned lsb = *lfsr & 1; // Get LSB (i.e., the output bit)
-  *lfsr >>= 1;             // Shift register
-  if (lsb)                // Apply toggle mask
-    *lfsr ^= 0xB400u;
-  return *lfsr;
+// at most this many distinct samples per node, larger fanouts are drawn with
+// replacement; StreamingSampler::MAX_DISTINCT_FANOUT refuses them on the host
+const unsigned int MAX_DISTINCT_SAMPLE = 256;
+
+// xorshift32, full period over the 2^32 - 1 non zero states
+inline unsigned int xorshift_random(unsigned int *state) {
+  unsigned int x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+// uniform in [0, range) by multiply and shift, without the bias of modulo
+inline unsigned int random_below(unsigned int *state, unsigned int range) {
+  return static_cast<unsigned int>(
+      (static_cast<unsigned long long>(xorshift_random(state)) * range) >> 32);
+}
+
+// a non zero generator state for every lane, spread out from the seed
+inline unsigned int lane_state(unsigned int seed, unsigned int lane) {
+  unsigned int x = seed + 0x9E3779B9u * (lane + 1);
+  x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+  x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+  x ^= x >> 16;
+  return x ? x : 1;
+}
+
+/**
+ * Sample n_sample of the degree > n_sample neighbors starting at in[offset_l]
+ * into out. With distinct set, the neighbors are picked without replacement
+ * by Floyd's algorithm: draw k picks from the first degree - n_sample + k + 1
+ * neighbors and takes the last of them if the pick was taken before.
+ */
+inline void sample_neighbors(const unsigned int *in, unsigned int *out,
+                             unsigned int offset_l, unsigned int degree,
+                             unsigned int n_sample, unsigned int distinct,
+                             unsigned int *state) {
+  if (!distinct || n_sample > MAX_DISTINCT_SAMPLE) {
+    for (unsigned int k = 0; k < n_sample; k++) {
+#pragma HLS PIPELINE
+      out[k] = in[offset_l + random_below(state, degree)];
+    }
+    return;
+  }
+  unsigned int picked[MAX_DISTINCT_SAMPLE];
+  for (unsigned int k = 0; k < n_sample; k++) {
+    unsigned int last = degree - n_sample + k;
+    unsigned int pick = random_below(state, last + 1);
+    for (unsigned int m = 0; m < k; m++) {
+#pragma HLS PIPELINE
+      if (picked[m] == pick) {
+        pick = last;
+      }
+    }
+    picked[k] = pick;
+    out[k] = in[offset_l + pick];
+  }
+}
+
+/**
+ * Sample n_sample neighbors of a weighted node into out, from its degree
+ * alias entries of 4 words starting at in[offset_l] (see
+ * utils/alias_table.hpp): a uniform column and a coin that picks its
+ * neighbor or its alias. A node without neighbors gets -1.
+ */
+inline void sample_alias(const unsigned int *in, unsigned int *out,
+                         unsigned int offset_l, unsigned int degree,
+                         unsigned int n_sample, unsigned int *state) {
+  for (unsigned int k = 0; k < n_sample; k++) {
+#pragma HLS PIPELINE
+    if (degree == 0) {
+      out[k] = static_cast<unsigned int>(-1);
+    } else {
+      unsigned int entry = offset_l + 4 * random_below(state, degree);
+      unsigned int coin = xorshift_random(state);
+      out[k] = coin < in[entry + 1] ? in[entry] : in[entry + 2];
+    }
+  }
 }
 
 /*
@@ -35,24 +109,27 @@ inline unsigned int lfsr_random(unsigned int *lfsr) {
    */
 void parallel_streaming_sampler(unsigned int *in, unsigned int *out,
                          unsigned int *target, unsigned int n_target,
-                         unsigned int n_sample, unsigned int external_seed = 0xACE1u) {
+                         unsigned int n_sample, unsigned int external_seed = 0xACE1u,
+                         unsigned int distinct = 0, unsigned int weighted = 0) {
 #pragma HLS INTERFACE m_axi port = in offset = slave bundle = gmem
 #pragma HLS INTERFACE m_axi port = out offset = slave bundle = gmem
 #pragma HLS INTERFACE m_axi port = target offset = slave bundle = gmem
 #pragma HLS INTERFACE s_axilite port = n_target
 #pragma HLS INTERFACE s_axilite port = n_sample
 #pragma HLS INTERFACE s_axilite port = external_seed
+#pragma HLS INTERFACE s_axilite port = distinct
+#pragma HLS INTERFACE s_axilite port = weighted
 #pragma HLS ARRAY_PARTITION variable = in complete
 #pragma HLS ARRAY_PARTITION variable = out complete
 #pragma HLS ARRAY_PARTITION variable = target complete
 
   const int UNROLL_FACTOR = 16;
 
-  unsigned int lfsr[UNROLL_FACTOR];
-#pragma HLS ARRAY_PARTITION variable = lfsr complete
+  unsigned int state[UNROLL_FACTOR];
+#pragma HLS ARRAY_PARTITION variable = state complete
 
   for (unsigned int i = 0; i < UNROLL_FACTOR; i++) {
-    lfsr[i] = external_seed * (i+1);
+    state[i] = lane_state(external_seed, i);
   }
 
   // Auto-pipeline is going to apply pipeline to this loop
@@ -71,9 +148,14 @@ void parallel_streaming_sampler(unsigned int *in, unsigned int *out,
       unsigned int offset_l = in[target_node_index + 2];
       unsigned int offset_r = in[target_node_index + 3];
       unsigned int degree = offset_r - offset_l;
+      // a weighted chunk holds an alias entry of 4 words per neighbor
+      if (weighted) {
+        sample_alias(in, out + i * UNROLL_FACTOR * n_sample + j * n_sample,
+                     offset_l, degree / 4, n_sample, &state[j]);
+      }
       // if current target node has less than n_sample neighbors, fill the
       // output with all its neighbors
-      if (degree <= n_sample) {
+      else if (degree <= n_sample) {
         for (unsigned int k = 0; k < degree; k++) {
 #pragma HLS PIPELINE
           out[i * UNROLL_FACTOR * n_sample + j * n_sample + k] =
@@ -88,11 +170,8 @@ void parallel_streaming_sampler(unsigned int *in, unsigned int *out,
       // if current target node has more than n_sample neighbors, randomly
       // sample n_sample neighbors
       else {
-        for (unsigned int k = 0; k < n_sample; k++) {
-#pragma HLS PIPELINE
-          out[i * UNROLL_FACTOR * n_sample + j * n_sample + k] =
-              in[offset_l + (lfsr_random(&lfsr[j]) % degree)];
-        }
+        sample_neighbors(in, out + i * UNROLL_FACTOR * n_sample + j * n_sample,
+                         offset_l, degree, n_sample, distinct, &state[j]);
       }
     }
   }
@@ -108,9 +187,13 @@ void parallel_streaming_sampler(unsigned int *in, unsigned int *out,
     unsigned int offset_l = in[target_node_index + 2];
     unsigned int offset_r = in[target_node_index + 3];
     unsigned int degree = offset_r - offset_l;
+    if (weighted) {
+      sample_alias(in, out + i * n_sample, offset_l, degree / 4, n_sample,
+                   &state[0]);
+    }
     // if current target node has less than n_sample neighbors, fill the output
     // with all its neighbors
-    if (degree <= n_sample) {
+    else if (degree <= n_sample) {
       for (unsigned int k = 0; k < degree; k++) {
 #pragma HLS PIPELINE
         out[i * n_sample + k] = in[offset_l + k];
@@ -123,10 +206,8 @@ void parallel_streaming_sampler(unsigned int *in, unsigned int *out,
     // if current target node has more than n_sample neighbors, randomly sample
     // n_sample neighbors
     else {
-      for (unsigned int k = 0; k < n_sample; k++) {
-#pragma HLS PIPELINE
-        out[i * n_sample + k] = in[offset_l + (lfsr_random(&lfsr[0]) % degree)];
-      }
+      sample_neighbors(in, out + i * n_sample, offset_l, degree, n_sample,
+                       distinct, &state[0]);
     }
   }
 }
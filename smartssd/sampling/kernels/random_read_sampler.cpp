@@ -1,6 +1,8 @@
 /**
  * This sampler will take already sampled target and copy only the neighbors to
- * the output
+ * the output. The host reads every sector only once, so the neighbor of
+ * position pos is word offsets[pos] of the buffer sector
+ * (pos - buffer_offsets[pos]).
  */
 
 #include <ap_int.h>
@@ -8,14 +10,17 @@
 
 extern "C" {
 void random_read_sampler(unsigned int *in, unsigned int *out,
-                         unsigned int *offsets, unsigned int n_total) {
+                         unsigned int *offsets, unsigned int *buffer_offsets,
+                         unsigned int n_total) {
 #pragma HLS INTERFACE m_axi port = in offset = slave bundle = gmem
 #pragma HLS INTERFACE m_axi port = out offset = slave bundle = gmem
 #pragma HLS INTERFACE m_axi port = offsets offset = slave bundle = gmem
+#pragma HLS INTERFACE m_axi port = buffer_offsets offset = slave bundle = gmem
 #pragma HLS INTERFACE s_axilite port = n_total
 #pragma HLS ARRAY_PARTITION variable = in complete
 #pragma HLS ARRAY_PARTITION variable = out complete
 #pragma HLS ARRAY_PARTITION variable = offsets complete
+#pragma HLS ARRAY_PARTITION variable = buffer_offsets complete
 
   const int UNROLL_FACTOR = 64;
   for (unsigned int i = 0; i < n_total / UNROLL_FACTOR; i++) {
@@ -28,7 +33,7 @@ void random_read_sampler(unsigned int *in, unsigned int *out,
       if (offsets[pos] == -1) {
         out[pos] = static_cast<unsigned int>(-1);
       } else {
-        out[pos] = in[offsets[pos] + 128 * pos];
+        out[pos] = in[offsets[pos] + 128 * (pos - buffer_offsets[pos])];
       }
     }
   }
@@ -39,7 +44,7 @@ void random_read_sampler(unsigned int *in, unsigned int *out,
     if (offsets[i] == -1) {
       out[i] = static_cast<unsigned int>(-1);
     } else {
-      out[i] = in[offsets[i] + 128 * i];
+      out[i] = in[offsets[i] + 128 * (i - buffer_offsets[i])];
     }
   }
 }
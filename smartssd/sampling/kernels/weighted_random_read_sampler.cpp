@@ -0,0 +1,57 @@
+/**
+ * The weighted random read sampler. The host reads the sectors of the alias
+ * entries it picked (4 words each, see utils/alias_table.hpp) and gives a
+ * coin per position: the entry of position pos starts at word offsets[pos]
+ * of the buffer sector (pos - buffer_offsets[pos]), and the coin picks its
+ * neighbor or its alias, so a weighted draw is one read like a uniform one.
+ */
+
+#include <ap_int.h>
+#include <hls_stream.h>
+
+extern "C" {
+void weighted_random_read_sampler(unsigned int *in, unsigned int *out,
+                                  unsigned int *offsets,
+                                  unsigned int *buffer_offsets,
+                                  unsigned int *coins, unsigned int n_total) {
+#pragma HLS INTERFACE m_axi port = in offset = slave bundle = gmem
+#pragma HLS INTERFACE m_axi port = out offset = slave bundle = gmem
+#pragma HLS INTERFACE m_axi port = offsets offset = slave bundle = gmem
+#pragma HLS INTERFACE m_axi port = buffer_offsets offset = slave bundle = gmem
+#pragma HLS INTERFACE m_axi port = coins offset = slave bundle = gmem
+#pragma HLS INTERFACE s_axilite port = n_total
+#pragma HLS ARRAY_PARTITION variable = in complete
+#pragma HLS ARRAY_PARTITION variable = out complete
+#pragma HLS ARRAY_PARTITION variable = offsets complete
+#pragma HLS ARRAY_PARTITION variable = buffer_offsets complete
+#pragma HLS ARRAY_PARTITION variable = coins complete
+
+  const int UNROLL_FACTOR = 64;
+  for (unsigned int i = 0; i < n_total / UNROLL_FACTOR; i++) {
+    for (unsigned int j = 0; j < UNROLL_FACTOR; j++) {
+#pragma HLS PIPELINE
+#pragma HLS UNROLL factor = UNROLL_FACTOR
+
+      unsigned int pos = i * UNROLL_FACTOR + j;
+
+      if (offsets[pos] == static_cast<unsigned int>(-1)) {
+        out[pos] = static_cast<unsigned int>(-1);
+      } else {
+        unsigned int entry = offsets[pos] + 128 * (pos - buffer_offsets[pos]);
+        out[pos] = coins[pos] < in[entry + 1] ? in[entry] : in[entry + 2];
+      }
+    }
+  }
+
+  // handle the last few target nodes
+  for (unsigned int i = n_total / UNROLL_FACTOR * UNROLL_FACTOR; i < n_total;
+       i++) {
+    if (offsets[i] == static_cast<unsigned int>(-1)) {
+      out[i] = static_cast<unsigned int>(-1);
+    } else {
+      unsigned int entry = offsets[i] + 128 * (i - buffer_offsets[i]);
+      out[i] = coins[i] < in[entry + 1] ? in[entry] : in[entry + 2];
+    }
+  }
+}
+}
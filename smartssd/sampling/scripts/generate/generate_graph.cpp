@@ -0,0 +1,146 @@
+/**
+ * Generate a synthetic graph straight into every file the samplers read, the
+ * same files preprocess writes:
+ *   streaming_edges.bin, chunk_info.bin, chunk_index.bin,
+ *   random_read_edges.bin, offsets.bin, train.bin and, with --sequential-read,
+ *   sequential_read_edges.bin
+ * and with --weighted the alias tables of random edge weights,
+ *   weighted_streaming_edges.bin, weighted_chunk_info.bin,
+ *   weighted_chunk_index.bin, weighted_edges.bin
+ * The graph is R-MAT, Chung-Lu power law or log-normal (see GraphGenerator),
+ * generated by all threads and written as it is generated, so it can be far
+ * larger than memory. The same seed gives the same graph for any number of
+ * threads. The degrees are capped to what a streaming chunk holds unless
+ * --max-degree is given, nodes above it are split over chunks.
+ */
+#include "utils/alias_table.hpp"
+#include "utils/artifact_writer.hpp"
+#include "utils/graph_generator.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <omp.h>
+#include <string>
+
+void printUsage(const char *name) {
+  std::cerr
+      << "Generate a graph for the samplers: " << name
+      << " <output_dir> (--nodes <n> | --scale <log2 n>)"
+      << " [--model rmat|power_law|log_normal] [--avg-degree <d>]"
+      << " [--rmat <a,b,c>] [--exponent <e>] [--sigma <s>] [--scramble]"
+      << " [--train-fraction <f>] [--seed <s>] [--chunk-size <bytes>]"
+      << " [--max-degree <d>] [--variable-chunks] [--offset-width 4|8]"
+      << " [--sequential-read] [--raw-arrays] [--weighted] [--threads <n>]"
+      << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  std::string output_dir = argv[1];
+  std::string model_name = "rmat";
+  uint64_t n_nodes = 0;
+  double avg_degree = 16;
+  double rmat_a = 0.57, rmat_b = 0.19, rmat_c = 0.19;
+  double exponent = 2.5;
+  double sigma = 1;
+  bool scramble = false;
+  double train_fraction = 0.01;
+  uint64_t seed = 1;
+  size_t chunk_size_byte = (size_t)512 * 1024 * 1024;
+  uint64_t max_degree = 0;
+  bool variable_chunks = false;
+  size_t offset_width = 0;
+  bool sequential_read = false;
+  bool raw_arrays = false;
+  bool weighted = false;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--nodes" && has_value) {
+      n_nodes = std::stoull(argv[++i]);
+    } else if (arg == "--scale" && has_value) {
+      n_nodes = uint64_t(1) << std::stoi(argv[++i]);
+    } else if (arg == "--model" && has_value) {
+      model_name = argv[++i];
+    } else if (arg == "--avg-degree" && has_value) {
+      avg_degree = std::stod(argv[++i]);
+    } else if (arg == "--rmat" && has_value) {
+      if (sscanf(argv[++i], "%lf,%lf,%lf", &rmat_a, &rmat_b, &rmat_c) != 3) {
+        printUsage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--exponent" && has_value) {
+      exponent = std::stod(argv[++i]);
+    } else if (arg == "--sigma" && has_value) {
+      sigma = std::stod(argv[++i]);
+    } else if (arg == "--scramble") {
+      scramble = true;
+    } else if (arg == "--train-fraction" && has_value) {
+      train_fraction = std::stod(argv[++i]);
+    } else if (arg == "--seed" && has_value) {
+      seed = std::stoull(argv[++i]);
+    } else if (arg == "--chunk-size" && has_value) {
+      chunk_size_byte = std::stoull(argv[++i]);
+    } else if (arg == "--max-degree" && has_value) {
+      max_degree = std::stoull(argv[++i]);
+    } else if (arg == "--variable-chunks") {
+      variable_chunks = true;
+    } else if (arg == "--offset-width" && has_value) {
+      offset_width = std::stoull(argv[++i]);
+    } else if (arg == "--sequential-read") {
+      sequential_read = true;
+    } else if (arg == "--raw-arrays") {
+      raw_arrays = true;
+    } else if (arg == "--weighted") {
+      weighted = true;
+    } else if (arg == "--threads" && has_value) {
+      omp_set_num_threads(std::stoi(argv[++i]));
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (n_nodes == 0 || chunk_size_byte % 512 != 0 ||
+      chunk_size_byte < 1024 ||
+      (offset_width != 0 && offset_width != 4 && offset_width != 8)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  GraphGenerator generator(GraphGenerator::parseModel(model_name), n_nodes,
+                           avg_degree, seed);
+  generator.setRmatProbabilities(rmat_a, rmat_b, rmat_c);
+  generator.setExponent(exponent);
+  generator.setSigma(sigma);
+  generator.setScramble(scramble);
+  // by default a node fits in a chunk next to the chunk header, a weighted
+  // one takes an alias entry per edge
+  generator.setMaxDegree(max_degree > 0
+                             ? max_degree
+                             : (chunk_size_byte / 4 - 4) /
+                                   (weighted ? AliasTable::ENTRY_INTS : 1));
+
+  // 4 byte offsets unless the graph may get close to 2^32 edges
+  if (offset_width == 0) {
+    offset_width = n_nodes * avg_degree * 1.1 > UINT32_MAX ? 8 : 4;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  ArtifactWriter writer(output_dir, chunk_size_byte, offset_width,
+                        sequential_read, raw_arrays, weighted,
+                        variable_chunks);
+  generator.write(writer, train_fraction, true);
+  auto end = std::chrono::steady_clock::now();
+
+  std::cout << writer.getNumNodes() << " nodes, " << writer.getNumEdges()
+            << " edges, " << writer.getNumChunks() << " chunks, "
+            << offset_width << " byte offsets, in "
+            << std::chrono::duration<double>(end - begin).count() << " s"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include "utils/array_file.hpp"
+#include "utils/edge_codec.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  if (argc != 4 && argc != 5) {
+    std::cerr << "Compress a streaming edge file: " << argv[0]
+              << " <streaming_edge_file> <chunk_size_byte> <output_file>"
+              << " [<chunk_index_file>]" << std::endl;
+    return 1;
+  }
+  size_t chunk_size_byte = std::stoull(argv[2]);
+  if (chunk_size_byte == 0 || chunk_size_byte % 4 != 0) {
+    std::cerr << "The chunk size has to be a multiple of 4 bytes" << std::endl;
+    return 1;
+  }
+
+  FILE *input_file = fopen(argv[1], "rb");
+  if (!input_file) {
+    std::cerr << "Failed to open input file" << std::endl;
+    return 1;
+  }
+  fseek(input_file, 0, SEEK_END);
+  size_t input_size_byte = ftell(input_file);
+  fseek(input_file, 0, SEEK_SET);
+  // the chunks are at the positions of the chunk index, or chunk_size_byte
+  // apart; either way chunk_size_byte bounds them
+  std::vector<uint64_t> input_pos;
+  if (argc == 5) {
+    ArrayFile chunk_index(argv[4], 8);
+    Span<const uint64_t> positions = chunk_index.view<uint64_t>();
+    input_pos.assign(positions.begin(), positions.end());
+  } else {
+    for (size_t pos = 0; pos < input_size_byte; pos += chunk_size_byte) {
+      input_pos.push_back(pos);
+    }
+    input_pos.push_back(input_size_byte);
+  }
+  if (input_pos.size() < 2 || input_pos.back() > input_size_byte) {
+    std::cerr << "The chunk index does not fit the streaming edge file"
+              << std::endl;
+    return 1;
+  }
+  size_t n_chunks = input_pos.size() - 1;
+
+  FILE *output_file = fopen(argv[3], "wb");
+  if (!output_file) {
+    std::cerr << "Failed to open output file" << std::endl;
+    return 1;
+  }
+  // the header is written last, once the chunk positions are known
+  size_t header_size_byte = EdgeCodec::fileHeaderSize(n_chunks);
+  std::vector<char> header(header_size_byte, 0);
+  fwrite(header.data(), 1, header_size_byte, output_file);
+
+  std::vector<uint64_t> chunk_pos = {header_size_byte};
+  std::vector<uint32_t> raw_chunk(chunk_size_byte / 4);
+  std::vector<uint8_t> compressed;
+  size_t raw_bytes = 0;
+  for (size_t chunk = 0; chunk < n_chunks; chunk++) {
+    size_t read_size_byte = input_pos[chunk + 1] - input_pos[chunk];
+    if (read_size_byte > chunk_size_byte) {
+      std::cerr << "Chunk " << chunk << " has " << read_size_byte
+                << " bytes, more than the chunk size" << std::endl;
+      return 1;
+    }
+    if (fseek(input_file, input_pos[chunk], SEEK_SET) != 0 ||
+        fread(raw_chunk.data(), 1, read_size_byte, input_file) !=
+            read_size_byte) {
+      std::cerr << "Failed to read chunk " << chunk << std::endl;
+      return 1;
+    }
+    uint32_t n_nodes = raw_chunk[0];
+    const uint32_t *offsets = raw_chunk.data() + 2;
+    if (((size_t)n_nodes + 3) * 4 > read_size_byte ||
+        (size_t)offsets[n_nodes] * 4 > read_size_byte) {
+      std::cerr << "Chunk " << chunk << " has no valid header" << std::endl;
+      return 1;
+    }
+    // sampling does not depend on the order of a neighbor list, and sorted
+    // lists have the smallest deltas
+    for (uint32_t i = 0; i < n_nodes; i++) {
+      std::sort(raw_chunk.begin() + offsets[i],
+                raw_chunk.begin() + offsets[i + 1]);
+    }
+    compressed.clear();
+    EdgeCodec::encodeChunk(raw_chunk.data(), compressed);
+    // every chunk starts on a page so that it can be read with O_DIRECT
+    compressed.resize((compressed.size() + EdgeCodec::PAGE_SIZE - 1) /
+                          EdgeCodec::PAGE_SIZE * EdgeCodec::PAGE_SIZE,
+                      0);
+    fwrite(compressed.data(), 1, compressed.size(), output_file);
+    chunk_pos.push_back(chunk_pos.back() + compressed.size());
+    raw_bytes += (size_t)offsets[n_nodes] * 4;
+  }
+
+  uint32_t magic = EdgeCodec::FILE_MAGIC;
+  uint32_t n_chunks_u32 = n_chunks;
+  uint64_t raw_chunk_size_byte = chunk_size_byte;
+  memcpy(header.data(), &magic, 4);
+  memcpy(header.data() + 4, &n_chunks_u32, 4);
+  memcpy(header.data() + 8, &raw_chunk_size_byte, 8);
+  memcpy(header.data() + 16, chunk_pos.data(), chunk_pos.size() * 8);
+  fseek(output_file, 0, SEEK_SET);
+  fwrite(header.data(), 1, header_size_byte, output_file);
+  fclose(output_file);
+  fclose(input_file);
+
+  std::cout << n_chunks << " chunks, " << raw_bytes << " bytes of chunks -> "
+            << chunk_pos.back() << " bytes, "
+            << (double)raw_bytes / chunk_pos.back() << "x" << std::endl;
+}
@@ -0,0 +1,442 @@
+/**
+ * Turn a graph into every file the samplers read, in one pass over the input:
+ *   streaming_edges.bin        chunks of [n_nodes][start_node][offsets][edges]
+ *   chunk_info.bin             the end node (exclusive) of every chunk, int32
+ *   chunk_index.bin            the file offset of every chunk and the end
+ *   random_read_edges.bin      all the edges, padded to 512 bytes
+ *   offsets.bin                the first edge of every node and the end
+ *   train.bin                  the training nodes, uint32
+ *   sequential_read_edges.bin  chunks of [n_nodes][start_node][degree][edges]
+ *                              ..., only with --sequential-read
+ * and, with --weights, the alias tables of the edge weights:
+ *   weighted_streaming_edges.bin, weighted_chunk_info.bin,
+ *   weighted_chunk_index.bin, weighted_edges.bin
+ * and, with --reorder, the maps between the original and the written ids:
+ *   old_to_new.bin, new_to_old.bin
+ * chunk_info.bin, the chunk indexes, offsets.bin and train.bin start with the
+ * ArrayFile header that gives their element width and count, unless
+ * --raw-arrays is given. The files are written by ArtifactWriter: streaming
+ * chunks are --chunk-size apart, or with --variable-chunks padded only to a
+ * page, and nodes with more edges than a chunk holds are split over chunks.
+ *
+ * The input is either a text adjacency list with one node per line,
+ * "src degree dst ...", as the Yahoo dump has it, or a binary CSR of uint32
+ * degrees and uint32 edges, and optionally float32 edge weights in the order
+ * of the edges. Both are mapped, and text is parsed by all threads while the
+ * previous batch is written, so the graph does not have to fit in memory:
+ * only one chunk and two batches of parsed lines are held at a time.
+ *
+ * --reorder degree|rcm|gorder renumbers the nodes of a CSR input for id
+ * locality (see NodeOrder) and writes every file in the new ids. This needs
+ * the order, its inverse and for rcm and gorder the reversed edges in memory.
+ */
+#include "utils/artifact_writer.hpp"
+#include "utils/node_order.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <omp.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// text is parsed in pieces of about this size, one piece per thread at a time
+static const size_t PIECE_SIZE_BYTE = 64 << 20;
+
+/**
+ * Map a whole file read only for a sequential pass, exit if that fails
+ */
+const char *mapFile(std::string file_path, size_t &file_size_byte) {
+  int fd = open(file_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Failed to open " << file_path << ": " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) == -1 || statbuf.st_size == 0) {
+    std::cerr << file_path << " is empty or cannot be read" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  file_size_byte = statbuf.st_size;
+  void *ptr = mmap(NULL, file_size_byte, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    std::cerr << "Failed to map " << file_path << ": " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  madvise(ptr, file_size_byte, MADV_SEQUENTIAL);
+  return static_cast<const char *>(ptr);
+}
+
+/**
+ * Consecutive nodes with their degrees and their edges back to back
+ */
+struct NodeBlock {
+  uint64_t first_node = 0;
+  std::vector<uint32_t> degrees;
+  std::vector<uint32_t> edges;
+  std::string error;
+};
+
+/**
+ * Parse the lines "src degree dst ..." in [begin, end) into block, with no
+ * edges for the nodes missing between two lines
+ */
+void parsePiece(const char *begin, const char *end, NodeBlock &block) {
+  block.degrees.clear();
+  block.edges.clear();
+  block.error.clear();
+  const char *p = begin;
+  auto next_number = [&](uint64_t &value) {
+    while (p < end && (*p < '0' || *p > '9')) {
+      p++;
+    }
+    if (p == end) {
+      return false;
+    }
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      value = value * 10 + (*p - '0');
+      p++;
+    }
+    return true;
+  };
+
+  uint64_t src, degree, dst;
+  bool first = true;
+  while (next_number(src)) {
+    if (!next_number(degree)) {
+      block.error = "line of node " + std::to_string(src) + " has no degree";
+      return;
+    }
+    if (first) {
+      block.first_node = src;
+      first = false;
+    }
+    uint64_t next_node = block.first_node + block.degrees.size();
+    if (src < next_node) {
+      block.error = "node " + std::to_string(src) + " comes after node " +
+                    std::to_string(next_node - 1);
+      return;
+    }
+    block.degrees.resize(src - block.first_node, 0);
+    block.degrees.push_back(degree);
+    for (uint64_t i = 0; i < degree; i++) {
+      if (!next_number(dst) || dst > UINT32_MAX) {
+        block.error = "node " + std::to_string(src) + " has a bad edge list";
+        return;
+      }
+      block.edges.push_back(dst);
+    }
+  }
+}
+
+void preprocessAdjacencyText(std::string input_path, ArtifactWriter &writer) {
+  size_t input_size_byte;
+  const char *input = mapFile(input_path, input_size_byte);
+
+  // pieces start at a line
+  std::vector<size_t> piece_begin = {0};
+  while (piece_begin.back() < input_size_byte) {
+    size_t pos = std::min(piece_begin.back() + PIECE_SIZE_BYTE,
+                          input_size_byte);
+    const char *newline = static_cast<const char *>(
+        memchr(input + pos, '\n', input_size_byte - pos));
+    piece_begin.push_back(newline ? newline - input + 1 : input_size_byte);
+  }
+  size_t n_pieces = piece_begin.size() - 1;
+
+  // one batch is parsed by all threads while the batch before is written
+  size_t batch_size = omp_get_max_threads();
+  std::vector<std::vector<NodeBlock>> batches(
+      2, std::vector<NodeBlock>(batch_size));
+  std::future<void> pending_write;
+  for (size_t b = 0; b * batch_size < n_pieces; b++) {
+    std::vector<NodeBlock> &batch = batches[b % 2];
+    size_t first_piece = b * batch_size;
+    size_t n_batch_pieces = std::min(batch_size, n_pieces - first_piece);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < n_batch_pieces; i++) {
+      parsePiece(input + piece_begin[first_piece + i],
+                 input + piece_begin[first_piece + i + 1], batch[i]);
+    }
+    for (size_t i = 0; i < n_batch_pieces; i++) {
+      if (!batch[i].error.empty()) {
+        std::cerr << "Failed to parse " << input_path << ": " << batch[i].error
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (pending_write.valid()) {
+      pending_write.wait();
+    }
+    std::vector<NodeBlock> *blocks = &batch;
+    pending_write =
+        std::async(std::launch::async, [&writer, blocks, n_batch_pieces]() {
+          for (size_t i = 0; i < n_batch_pieces; i++) {
+            NodeBlock &block = (*blocks)[i];
+            if (!block.degrees.empty()) {
+              writer.addNodes(block.first_node, block.degrees.data(),
+                              block.degrees.size(), block.edges.data());
+            }
+          }
+        });
+    std::cout << "\rParsed " << piece_begin[first_piece + n_batch_pieces]
+              << " / " << input_size_byte << " bytes";
+    std::cout.flush();
+  }
+  if (pending_write.valid()) {
+    pending_write.wait();
+  }
+  std::cout << std::endl;
+  munmap(const_cast<char *>(input), input_size_byte);
+}
+
+void preprocessCsr(std::string degree_path, std::string edge_path,
+                   std::string weight_path, std::string reorder,
+                   ArtifactWriter &writer, std::vector<uint32_t> &new_to_old) {
+  size_t degrees_size_byte, edges_size_byte, weights_size_byte = 0;
+  const uint32_t *degrees = reinterpret_cast<const uint32_t *>(
+      mapFile(degree_path, degrees_size_byte));
+  const uint32_t *edges =
+      reinterpret_cast<const uint32_t *>(mapFile(edge_path, edges_size_byte));
+  const float *weights = nullptr;
+  if (!weight_path.empty()) {
+    weights = reinterpret_cast<const float *>(
+        mapFile(weight_path, weights_size_byte));
+    if (weights_size_byte != edges_size_byte) {
+      std::cerr << weight_path << " does not hold a weight for every edge"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  size_t n_nodes = degrees_size_byte / 4;
+
+  if (reorder.empty()) {
+    // hand the nodes over in blocks of about 16M edges
+    uint64_t edge_pos = 0;
+    for (size_t begin = 0; begin < n_nodes;) {
+      size_t end = begin;
+      uint64_t n_block_edges = 0;
+      while (end < n_nodes && (n_block_edges < (16 << 20) || end == begin)) {
+        n_block_edges += degrees[end++];
+      }
+      if ((edge_pos + n_block_edges) * 4 > edges_size_byte) {
+        std::cerr << "The degrees add up to more edges than " << edge_path
+                  << " holds" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      writer.addNodes(begin, degrees + begin, end - begin, edges + edge_pos,
+                      weights ? weights + edge_pos : nullptr);
+      edge_pos += n_block_edges;
+      begin = end;
+    }
+  } else {
+    std::vector<uint64_t> offsets(n_nodes + 1, 0);
+    for (size_t v = 0; v < n_nodes; v++) {
+      offsets[v + 1] = offsets[v] + degrees[v];
+    }
+    if (offsets[n_nodes] * 4 > edges_size_byte) {
+      std::cerr << "The degrees add up to more edges than " << edge_path
+                << " holds" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    // the nodes are gathered in the new order, not read in file order
+    madvise(const_cast<uint32_t *>(edges), edges_size_byte, MADV_RANDOM);
+    auto begin_time = std::chrono::steady_clock::now();
+    new_to_old = NodeOrder::compute(NodeOrder::parseMethod(reorder), n_nodes,
+                                    offsets.data(), edges);
+    std::vector<uint32_t> old_to_new = NodeOrder::invert(new_to_old);
+    std::cout << "Reordered by " << reorder << " in "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - begin_time)
+                     .count()
+              << " s" << std::endl;
+
+    // the same blocks of about 16M edges, of the nodes in their new order
+    // and with their neighbors renamed
+    std::vector<uint32_t> block_degrees, block_edges;
+    std::vector<float> block_weights;
+    for (size_t begin = 0; begin < n_nodes;) {
+      block_degrees.clear();
+      block_edges.clear();
+      block_weights.clear();
+      size_t end = begin;
+      while (end < n_nodes &&
+             (block_edges.size() < (16 << 20) || end == begin)) {
+        uint32_t old = new_to_old[end++];
+        block_degrees.push_back(degrees[old]);
+        for (uint64_t e = offsets[old]; e < offsets[old + 1]; e++) {
+          block_edges.push_back(old_to_new[edges[e]]);
+        }
+        if (weights) {
+          block_weights.insert(block_weights.end(), weights + offsets[old],
+                               weights + offsets[old + 1]);
+        }
+      }
+      writer.addNodes(begin, block_degrees.data(), end - begin,
+                      block_edges.data(),
+                      weights ? block_weights.data() : nullptr);
+      begin = end;
+    }
+  }
+  munmap(const_cast<uint32_t *>(degrees), degrees_size_byte);
+  munmap(const_cast<uint32_t *>(edges), edges_size_byte);
+  if (weights) {
+    munmap(const_cast<float *>(weights), weights_size_byte);
+  }
+}
+
+/**
+ * Write the training nodes, either the ids in a text file, one per line, or
+ * the first `n_first` nodes, renamed by old_to_new if it is not empty
+ */
+void writeTrainNodes(ArtifactWriter &writer, std::string train_path,
+                     uint64_t n_first,
+                     const std::vector<uint32_t> &old_to_new) {
+  std::vector<uint32_t> train_nodes;
+  if (!train_path.empty()) {
+    std::ifstream train_file(train_path);
+    if (!train_file) {
+      std::cerr << "Failed to open " << train_path << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::string line;
+    while (std::getline(train_file, line)) {
+      // header lines are skipped
+      if (!line.empty() && line[0] >= '0' && line[0] <= '9') {
+        train_nodes.push_back(std::stoul(line));
+      }
+    }
+  } else {
+    for (uint64_t i = 0; i < n_first; i++) {
+      train_nodes.push_back(i);
+    }
+  }
+  if (!old_to_new.empty()) {
+    for (uint32_t &node : train_nodes) {
+      if (node >= old_to_new.size()) {
+        std::cerr << "Training node " << node << " is not in the graph"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      node = old_to_new[node];
+    }
+  }
+  writer.writeTrainNodes(train_nodes);
+}
+
+void printUsage(const char *name) {
+  std::cerr
+      << "Preprocess a graph for the samplers: " << name
+      << " <output_dir> (--adj <text_file> | --csr <degree_file> <edge_file>"
+      << " [--weights <weight_file>] [--reorder degree|rcm|gorder])"
+      << " [--chunk-size <bytes>] [--offset-width 4|8]"
+      << " [--train-file <text_file> | --train-first <n>]"
+      << " [--variable-chunks] [--sequential-read] [--raw-arrays]"
+      << " [--threads <n>]" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  std::string output_dir = argv[1];
+  std::string adj_path, degree_path, edge_path, weight_path, train_path;
+  std::string reorder;
+  size_t chunk_size_byte = (size_t)512 * 1024 * 1024;
+  size_t offset_width = 0;
+  uint64_t train_first = 0;
+  bool sequential_read = false;
+  bool raw_arrays = false;
+  bool variable_chunks = false;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--adj" && has_value) {
+      adj_path = argv[++i];
+    } else if (arg == "--csr" && i + 2 < argc) {
+      degree_path = argv[++i];
+      edge_path = argv[++i];
+    } else if (arg == "--weights" && has_value) {
+      weight_path = argv[++i];
+    } else if (arg == "--reorder" && has_value) {
+      reorder = argv[++i];
+    } else if (arg == "--chunk-size" && has_value) {
+      chunk_size_byte = std::stoull(argv[++i]);
+    } else if (arg == "--offset-width" && has_value) {
+      offset_width = std::stoull(argv[++i]);
+    } else if (arg == "--train-file" && has_value) {
+      train_path = argv[++i];
+    } else if (arg == "--train-first" && has_value) {
+      train_first = std::stoull(argv[++i]);
+    } else if (arg == "--sequential-read") {
+      sequential_read = true;
+    } else if (arg == "--raw-arrays") {
+      raw_arrays = true;
+    } else if (arg == "--variable-chunks") {
+      variable_chunks = true;
+    } else if (arg == "--threads" && has_value) {
+      omp_set_num_threads(std::stoi(argv[++i]));
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  // the text format has no weights, and is not held in memory to reorder
+  if (adj_path.empty() == degree_path.empty() || chunk_size_byte % 512 != 0 ||
+      ((!weight_path.empty() || !reorder.empty()) && degree_path.empty()) ||
+      (offset_width != 0 && offset_width != 4 && offset_width != 8)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  // 4 byte offsets unless the input can hold 2^32 edges
+  if (offset_width == 0) {
+    struct stat statbuf;
+    uint64_t max_edges = 0;
+    if (stat(adj_path.empty() ? edge_path.c_str() : adj_path.c_str(),
+             &statbuf) == 0) {
+      // a text edge is at least a digit and a separator
+      max_edges = statbuf.st_size / (adj_path.empty() ? 4 : 2);
+    }
+    offset_width = max_edges > UINT32_MAX ? 8 : 4;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  ArtifactWriter writer(output_dir, chunk_size_byte, offset_width,
+                        sequential_read, raw_arrays, !weight_path.empty(),
+                        variable_chunks);
+  std::vector<uint32_t> new_to_old;
+  if (!adj_path.empty()) {
+    preprocessAdjacencyText(adj_path, writer);
+  } else {
+    preprocessCsr(degree_path, edge_path, weight_path, reorder, writer,
+                  new_to_old);
+  }
+  writer.finish();
+  writeTrainNodes(writer, train_path, train_first,
+                  NodeOrder::invert(new_to_old));
+  if (!new_to_old.empty()) {
+    writer.writeNodeMaps(new_to_old);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  std::cout << writer.getNumNodes() << " nodes, " << writer.getNumEdges()
+            << " edges, " << writer.getNumChunks() << " chunks, "
+            << offset_width << " byte offsets, in "
+            << std::chrono::duration<double>(end - begin).count() << " s"
+            << std::endl;
+}
@@ -0,0 +1,85 @@
+#include "BatchDeduplicator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <omp.h>
+
+static const uint EMPTY = static_cast<uint>(-1);
+
+BatchDeduplicator::BatchDeduplicator(size_t max_hash_batch_size)
+    : max_hash_batch_size(max_hash_batch_size) {}
+
+size_t BatchDeduplicator::hashBatch(uint *batch, size_t n,
+                                    std::vector<uint> &table) {
+  // at most half full, so probe sequences stay short
+  size_t bits = 4;
+  while (((size_t)1 << bits) < 2 * n) {
+    bits++;
+  }
+  size_t mask = ((size_t)1 << bits) - 1;
+  table.assign(mask + 1, EMPTY);
+
+  size_t n_distinct = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint value = batch[i];
+    if (value == EMPTY) {
+      continue;
+    }
+    size_t h = (uint32_t)(value * 0x9E3779B1u) >> (32 - bits);
+    while (table[h] != EMPTY && table[h] != value) {
+      h = (h + 1) & mask;
+    }
+    if (table[h] == EMPTY) {
+      table[h] = value;
+      // n_distinct <= i, so this never overwrites an unread sample
+      batch[n_distinct++] = value;
+    }
+  }
+  return n_distinct;
+}
+
+size_t BatchDeduplicator::sortBatch(uint *batch, size_t n) {
+  uint *last = std::remove(batch, batch + n, EMPTY);
+  std::sort(batch, last);
+  return std::unique(batch, last) - batch;
+}
+
+void BatchDeduplicator::deduplicate(std::vector<uint> &samples,
+                                    const std::vector<uint> &source_size,
+                                    uint fanout, std::vector<uint> &result,
+                                    std::vector<uint> &result_size) {
+  size_t n_batches = source_size.size();
+  this->input_pos.assign(n_batches + 1, 0);
+  for (size_t b = 0; b < n_batches; b++) {
+    this->input_pos[b + 1] =
+        this->input_pos[b] + (size_t)source_size[b] * fanout;
+  }
+  result_size.assign(n_batches, 0);
+  this->hash_table.resize(omp_get_max_threads());
+
+  // compact every batch at the front of its own range
+#pragma omp parallel
+  {
+    std::vector<uint> &table = this->hash_table[omp_get_thread_num()];
+#pragma omp for schedule(dynamic)
+    for (size_t b = 0; b < n_batches; b++) {
+      uint *batch = samples.data() + this->input_pos[b];
+      size_t n = this->input_pos[b + 1] - this->input_pos[b];
+      result_size[b] = n <= this->max_hash_batch_size
+                           ? hashBatch(batch, n, table)
+                           : sortBatch(batch, n);
+    }
+  }
+
+  // exclusive scan of the batch sizes gives where every batch goes
+  this->output_pos.assign(n_batches + 1, 0);
+  for (size_t b = 0; b < n_batches; b++) {
+    this->output_pos[b + 1] = this->output_pos[b] + result_size[b];
+  }
+  result.resize(this->output_pos[n_batches]);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t b = 0; b < n_batches; b++) {
+    std::copy(samples.begin() + this->input_pos[b],
+              samples.begin() + this->input_pos[b] + result_size[b],
+              result.begin() + this->output_pos[b]);
+  }
+}
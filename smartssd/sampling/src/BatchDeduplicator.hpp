@@ -0,0 +1,54 @@
+/**
+ * This file defines the dedup stage of the streaming sampler. A sampled layer
+ * holds fanout samples for every source node of every minibatch; each
+ * minibatch needs its distinct sampled nodes without the -1 padding. Batches
+ * are compacted in place in parallel, then moved into one result.
+ */
+#ifndef BATCH_DEDUPLICATOR_HPP
+#define BATCH_DEDUPLICATOR_HPP
+
+#include <cstddef>
+#include <sys/types.h>
+#include <vector>
+
+class BatchDeduplicator {
+private:
+  // batches with more samples than this are sorted instead of hashed
+  size_t max_hash_batch_size;
+
+  // one open addressing table per thread
+  std::vector<std::vector<uint>> hash_table;
+  std::vector<size_t> input_pos;
+  std::vector<size_t> output_pos;
+
+  /**
+   * Move the distinct values of batch[0, n) other than -1 to its front with
+   * a hash table, and return how many there are
+   */
+  size_t hashBatch(uint *batch, size_t n, std::vector<uint> &table);
+
+  /**
+   * Same as hashBatch, with sort and unique for large batches
+   */
+  size_t sortBatch(uint *batch, size_t n);
+
+public:
+  /**
+   * @param max_hash_batch_size: Batches up to this many samples are
+   * deduplicated with a hash table
+   */
+  BatchDeduplicator(size_t max_hash_batch_size = 1 << 16);
+
+  /**
+   * Deduplicate the samples of every batch. Batch b holds
+   * source_size[b] * fanout consecutive samples of `samples`, which is used as
+   * scratch space. The distinct samples of every batch, without -1, are
+   * written to `result` batch after batch, and their number to
+   * `result_size`. The order inside a batch is not specified.
+   */
+  void deduplicate(std::vector<uint> &samples,
+                   const std::vector<uint> &source_size, uint fanout,
+                   std::vector<uint> &result, std::vector<uint> &result_size);
+};
+
+#endif // BATCH_DEDUPLICATOR_HPP
@@ -0,0 +1,104 @@
+#include "FrontierPartitioner.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <omp.h>
+
+FrontierPartitioner::FrontierPartitioner(std::vector<uint> chunk_offsets)
+    : chunk_offsets(chunk_offsets), chunk_begin(chunk_offsets.size() + 1, 0) {}
+
+void FrontierPartitioner::partition(const uint *nodes, size_t n_nodes) {
+  size_t n_chunks = this->chunk_offsets.size();
+  this->frontier.resize(n_nodes);
+  this->idx.resize(n_nodes);
+  this->node_chunk.resize(n_nodes);
+  this->chunk_begin.assign(n_chunks + 1, 0);
+
+  int n_threads = 1;
+  std::atomic<bool> out_of_range(false);
+
+#pragma omp parallel
+  {
+    // thread_count[t * n_chunks + c] is the number of nodes of chunk c in the
+    // block of thread t, and later where that thread writes them
+#pragma omp single
+    {
+      n_threads = omp_get_num_threads();
+      this->thread_count.assign(n_threads * n_chunks, 0);
+    }
+    int tid = omp_get_thread_num();
+    size_t block = (n_nodes + n_threads - 1) / n_threads;
+    size_t begin = std::min(n_nodes, tid * block);
+    size_t end = std::min(n_nodes, begin + block);
+    size_t *count = this->thread_count.data() + tid * n_chunks;
+
+    // chunk of every node, counted per thread
+    for (size_t i = begin; i < end; i++) {
+      size_t chunk = std::upper_bound(this->chunk_offsets.begin(),
+                                      this->chunk_offsets.end(), nodes[i]) -
+                     this->chunk_offsets.begin();
+      if (chunk == n_chunks) {
+        out_of_range = true;
+        continue;
+      }
+      this->node_chunk[i] = chunk;
+      count[chunk]++;
+    }
+#pragma omp barrier
+
+    // exclusive scan over (chunk, thread), so every thread writes its nodes
+    // of a chunk after the nodes of that chunk from the threads before it
+#pragma omp single
+    {
+      size_t pos = 0;
+      for (size_t c = 0; c < n_chunks; c++) {
+        this->chunk_begin[c] = pos;
+        for (int t = 0; t < n_threads; t++) {
+          size_t n = this->thread_count[t * n_chunks + c];
+          this->thread_count[t * n_chunks + c] = pos;
+          pos += n;
+        }
+      }
+      this->chunk_begin[n_chunks] = pos;
+    }
+
+    if (!out_of_range) {
+      for (size_t i = begin; i < end; i++) {
+        size_t pos = count[this->node_chunk[i]]++;
+        this->frontier[pos] = nodes[i];
+        this->idx[pos] = i;
+      }
+    }
+  }
+
+  if (out_of_range) {
+    std::cerr << "ERR: frontier has a node after the last chunk, which ends at "
+              << (n_chunks == 0 ? 0 : this->chunk_offsets.back()) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+size_t FrontierPartitioner::getNumChunks() const {
+  return this->chunk_offsets.size();
+}
+
+size_t FrontierPartitioner::size() const { return this->frontier.size(); }
+
+Span<const uint> FrontierPartitioner::getChunk(size_t chunk) const {
+  return Span<const uint>(this->frontier.data() + this->chunk_begin[chunk],
+                          this->chunk_begin[chunk + 1] -
+                              this->chunk_begin[chunk]);
+}
+
+const std::vector<size_t> &FrontierPartitioner::getChunkBegin() const {
+  return this->chunk_begin;
+}
+
+const std::vector<uint> &FrontierPartitioner::getFrontier() const {
+  return this->frontier;
+}
+
+const std::vector<uint> &FrontierPartitioner::getIndex() const {
+  return this->idx;
+}
@@ -0,0 +1,74 @@
+/**
+ * This file defines the partitioner that groups a frontier by the edge chunk
+ * holding each node, which is the order the streaming sampler reads chunks in.
+ * The nodes only have to be grouped, not sorted, so this is a parallel
+ * counting sort keyed by chunk id instead of a comparison sort.
+ */
+#ifndef FRONTIER_PARTITIONER_HPP
+#define FRONTIER_PARTITIONER_HPP
+
+#include "utils/span.hpp"
+#include <cstddef>
+#include <sys/types.h>
+#include <vector>
+
+class FrontierPartitioner {
+private:
+  // exclusive end node of every chunk
+  std::vector<uint> chunk_offsets;
+
+  // the last partition
+  std::vector<uint> frontier;
+  std::vector<uint> idx;
+  std::vector<size_t> chunk_begin;
+
+  // workspace, kept across calls
+  std::vector<uint> node_chunk;
+  std::vector<size_t> thread_count;
+
+public:
+  FrontierPartitioner() {}
+
+  /**
+   * @param chunk_offsets: The exclusive end node of every chunk
+   */
+  FrontierPartitioner(std::vector<uint> chunk_offsets);
+
+  /**
+   * Group n_nodes nodes by chunk. Nodes of the same chunk keep their order.
+   */
+  void partition(const uint *nodes, size_t n_nodes);
+
+  /**
+   * Number of chunks, including the ones without nodes
+   */
+  size_t getNumChunks() const;
+
+  /**
+   * Number of nodes of the last partition
+   */
+  size_t size() const;
+
+  /**
+   * The nodes of the last partition that belong to chunk `chunk`
+   */
+  Span<const uint> getChunk(size_t chunk) const;
+
+  /**
+   * Position of each chunk's nodes in the grouped frontier, getNumChunks() + 1
+   * entries
+   */
+  const std::vector<size_t> &getChunkBegin() const;
+
+  /**
+   * The grouped frontier
+   */
+  const std::vector<uint> &getFrontier() const;
+
+  /**
+   * idx[j] is the position in the input of grouped node j
+   */
+  const std::vector<uint> &getIndex() const;
+};
+
+#endif // FRONTIER_PARTITIONER_HPP
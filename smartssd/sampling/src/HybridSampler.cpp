@@ -0,0 +1,248 @@
+#include "HybridSampler.hpp"
+#include "utils/alias_table.hpp"
+#include "utils/timer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+HybridSampler::HybridSampler(
+    std::shared_ptr<RandomReadSampler> random_read_sampler,
+    std::shared_ptr<StreamingSampler> streaming_sampler,
+    std::vector<uint> fanouts, double bandwidth, double iops)
+    : SamplerBase(fanouts), random_read_sampler(random_read_sampler),
+      streaming_sampler(streaming_sampler) {
+  // a chunk costs at least a kernel launch and a few syncs
+  setDeviceModel(bandwidth, iops, 1.0);
+}
+
+void HybridSampler::setDeviceModel(double bandwidth, double iops,
+                                   double chunk_overhead) {
+  this->byte_time = 1000.0 / bandwidth;
+  this->sector_time = 1000.0 / iops;
+  this->chunk_time = chunk_overhead;
+}
+
+double HybridSampler::getBandwidth() { return 1000.0 / this->byte_time; }
+
+double HybridSampler::getIops() { return 1000.0 / this->sector_time; }
+
+const std::vector<HybridSampler::Engine> &HybridSampler::getLastEngines() {
+  return this->last_engines;
+}
+
+void HybridSampler::setFanouts(std::vector<uint> fanouts) {
+  // any layer may go to the streaming kernel
+  StreamingSampler::checkDistinctFanouts(fanouts, getReplace());
+  SamplerBase::setFanouts(fanouts);
+}
+
+void HybridSampler::setReplace(bool replace) {
+  StreamingSampler::checkDistinctFanouts(getFanouts(), replace);
+  SamplerBase::setReplace(replace);
+  this->random_read_sampler->setReplace(replace);
+  this->streaming_sampler->setReplace(replace);
+}
+
+void HybridSampler::setWeighted(bool weighted) {
+  SamplerBase::setWeighted(weighted);
+  this->random_read_sampler->setWeighted(weighted);
+  this->streaming_sampler->setWeighted(weighted);
+}
+
+double HybridSampler::estimateSectors(Span<const uint> frontier,
+                                      uint n_neighbors) {
+  const ArrayFile &offsets = this->random_read_sampler->getOffsets();
+  size_t stride =
+      std::max<size_t>(1, frontier.size() / this->max_estimate_nodes);
+  // 128 edges or 32 alias entries per sector
+  uint64_t per_sector = getWeighted() ? AliasTable::ENTRIES_PER_SECTOR : 128;
+  size_t n_seen = 0;
+  double n_sectors = 0;
+  for (size_t i = 0; i < frontier.size(); i += stride, n_seen++) {
+    uint64_t first_edge = offsets[frontier[i]];
+    uint64_t degree = offsets[frontier[i] + 1] - first_edge;
+    if (degree == 0) {
+      continue;
+    }
+    double span = (first_edge + degree - 1) / per_sector -
+                  first_edge / per_sector + 1;
+    if (degree < n_neighbors && !getWeighted()) {
+      n_sectors += span;
+    } else if (getReplace() || getWeighted()) {
+      // distinct sectors hit by n_neighbors uniform draws, weighted ones are
+      // taken as uniform
+      n_sectors += span * (1 - std::pow(1 - 1 / span, n_neighbors));
+    } else {
+      // distinct neighbors miss a sector of degree / span edges less often
+      n_sectors += span * (1 - std::pow(1 - (double)n_neighbors / degree,
+                                        degree / span));
+    }
+  }
+  return n_seen == 0 ? 0 : n_sectors * frontier.size() / n_seen;
+}
+
+double HybridSampler::estimateStreamingBytes(Span<const uint> frontier,
+                                             double &n_chunks) {
+  const ArrayFile &offsets = this->random_read_sampler->getOffsets();
+  const std::vector<uint> &chunk_offsets =
+      this->streaming_sampler->getChunkOffsets();
+  double density = this->streaming_sampler->getSelectiveReadDensity();
+  double edge_size_byte = getWeighted() ? sizeof(AliasEntry) : 4;
+
+  // pages each chunk would read selectively
+  this->chunk_bytes.assign(chunk_offsets.size(), 0);
+  size_t stride =
+      std::max<size_t>(1, frontier.size() / this->max_estimate_nodes);
+  size_t n_seen = 0;
+  for (size_t i = 0; i < frontier.size(); i += stride, n_seen++) {
+    size_t chunk = std::upper_bound(chunk_offsets.begin(), chunk_offsets.end(),
+                                    frontier[i]) -
+                   chunk_offsets.begin();
+    if (chunk == chunk_offsets.size()) {
+      continue;
+    }
+    uint64_t degree = offsets[frontier[i] + 1] - offsets[frontier[i]];
+    // a neighbor list usually straddles one more page than it fills
+    this->chunk_bytes[chunk] +=
+        (std::ceil(degree * edge_size_byte / 4096) + 1) * 4096;
+  }
+
+  double scale = n_seen == 0 ? 0 : (double)frontier.size() / n_seen;
+  double n_bytes = 0;
+  n_chunks = 0;
+  for (size_t c = 0; c < this->chunk_bytes.size(); c++) {
+    double bytes = this->chunk_bytes[c] * scale;
+    if (bytes == 0) {
+      continue;
+    }
+    // chunks of an index or compressed chunks differ in size
+    double chunk_size_byte = this->streaming_sampler->getChunkStoredSize(c);
+    if (this->streaming_sampler->isCompressed()) {
+      // compressed chunks are read whole
+      n_bytes += chunk_size_byte;
+    } else {
+      n_bytes += bytes > density * chunk_size_byte ? chunk_size_byte : bytes;
+    }
+    n_chunks++;
+  }
+  return n_bytes;
+}
+
+HybridSampler::Engine HybridSampler::chooseEngine(Span<const uint> frontier,
+                                                  uint n_neighbors,
+                                                  double &random_read_cost,
+                                                  double &streaming_cost) {
+  double n_bytes = estimateStreamingBytes(frontier, this->estimated_chunks);
+  random_read_cost =
+      estimateSectors(frontier, n_neighbors) * this->sector_time;
+  // cached sectors are not read
+  SectorCache *cache = this->random_read_sampler->getSectorCache();
+  if (cache != nullptr) {
+    random_read_cost *= 1 - cache->getHitRate();
+  }
+  streaming_cost =
+      n_bytes * this->byte_time + this->estimated_chunks * this->chunk_time;
+  return random_read_cost <= streaming_cost ? Engine::RandomRead
+                                            : Engine::Streaming;
+}
+
+void HybridSampler::updateModel(Engine engine, float time, double n_units,
+                                double n_chunks) {
+  double w = this->model_update_weight;
+  if (n_units <= 0) {
+    return;
+  }
+  if (engine == Engine::RandomRead) {
+    this->sector_time = (1 - w) * this->sector_time + w * time / n_units;
+  } else {
+    double transfer_time = time - n_chunks * this->chunk_time;
+    if (transfer_time > 0) {
+      this->byte_time =
+          (1 - w) * this->byte_time + w * transfer_time / n_units;
+    }
+  }
+}
+
+void HybridSampler::calibrate(Span<const uint> frontier, uint n_neighbors) {
+  frontier = toReordered(frontier);
+  double w = this->model_update_weight;
+  // take the measurements as they are
+  this->model_update_weight = 1;
+  std::vector<uint> result;
+  Philox draws(getSeed(), beginCall(), 0);
+
+  Timer timer;
+  size_t n_sectors = this->random_read_sampler->getSectorsRead();
+  timer.start();
+  this->random_read_sampler->sampleLayer(frontier, n_neighbors, result, draws);
+  timer.stop();
+  n_sectors = this->random_read_sampler->getSectorsRead() - n_sectors;
+  updateModel(Engine::RandomRead, timer.getDuration(), n_sectors, 0);
+
+  double n_chunks;
+  estimateStreamingBytes(frontier, n_chunks);
+  size_t n_bytes = this->streaming_sampler->getEdgeBytesRead();
+  timer.start();
+  this->streaming_sampler->sampleLayer(frontier, n_neighbors, result, draws);
+  timer.stop();
+  n_bytes = this->streaming_sampler->getEdgeBytesRead() - n_bytes;
+  updateModel(Engine::Streaming, timer.getDuration(), n_bytes, n_chunks);
+
+  this->model_update_weight = w;
+}
+
+void HybridSampler::sample(Span<const uint> frontier,
+                           SampleWorkspace &workspace) {
+  frontier = toReordered(frontier);
+  workspace.clear();
+  this->last_engines.clear();
+  uint32_t call = beginCall();
+  const std::vector<uint> &fanouts = this->getFanouts();
+  for (size_t i = 0; i < fanouts.size(); i++) {
+    Span<const uint> layer_frontier =
+        i == 0 ? frontier
+               : Span<const uint>(this->layer_frontier.data(),
+                                  this->layer_frontier.size());
+    double random_read_cost, streaming_cost;
+    Engine engine = chooseEngine(layer_frontier, fanouts[i], random_read_cost,
+                                 streaming_cost);
+    this->last_engines.push_back(engine);
+    Philox draws(getSeed(), call, i);
+
+    size_t layer_begin = workspace.values.size();
+    Timer timer;
+    if (engine == Engine::RandomRead) {
+      size_t n_sectors = this->random_read_sampler->getSectorsRead();
+      timer.start();
+      this->random_read_sampler->sampleLayer(layer_frontier, fanouts[i],
+                                             workspace.values, draws);
+      timer.stop();
+      n_sectors = this->random_read_sampler->getSectorsRead() - n_sectors;
+      updateModel(engine, timer.getDuration(), n_sectors, 0);
+    } else {
+      size_t n_bytes = this->streaming_sampler->getEdgeBytesRead();
+      timer.start();
+      this->streaming_sampler->sampleLayer(layer_frontier, fanouts[i],
+                                           workspace.values, draws);
+      timer.stop();
+      n_bytes = this->streaming_sampler->getEdgeBytesRead() - n_bytes;
+      updateModel(engine, timer.getDuration(), n_bytes,
+                  this->estimated_chunks);
+    }
+    workspace.endLayer();
+
+    // the sampled result is the frontier for the next layer, copied because
+    // the workspace may move when the next layer is appended
+    if (i < fanouts.size() - 1) {
+      this->layer_frontier.assign(workspace.values.begin() + layer_begin,
+                                  workspace.values.end());
+    }
+  }
+  toOriginal(workspace.values.data(), workspace.values.size());
+}
+
+std::vector<std::vector<uint>>
+HybridSampler::getSample(std::vector<uint> frontier) {
+  sample(Span<const uint>(frontier.data(), frontier.size()), this->workspace);
+  return toVectors(this->workspace);
+}
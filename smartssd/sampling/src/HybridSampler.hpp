@@ -0,0 +1,143 @@
+/**
+ * This file defines a sampler that picks, for every layer, whether the layer
+ * is sampled by random reads or by streaming the chunks that hold the
+ * frontier. Small frontiers touch few sectors and are cheaper to read
+ * randomly; large ones touch every chunk and are cheaper to stream.
+ */
+#ifndef HYBRID_SAMPLER_HPP
+#define HYBRID_SAMPLER_HPP
+#include "RandomReadSampler.hpp"
+#include "SamplerBase.hpp"
+#include "StreamingSampler.hpp"
+#include <memory>
+#include <vector>
+
+class HybridSampler : public SamplerBase {
+public:
+  enum class Engine { RandomRead, Streaming };
+
+private:
+  std::shared_ptr<RandomReadSampler> random_read_sampler;
+  std::shared_ptr<StreamingSampler> streaming_sampler;
+
+  // device model, all times in ms
+  double sector_time;
+  double byte_time;
+  double chunk_time;
+  // weight of a new measurement in the device model
+  double model_update_weight = 0.25;
+  // the estimates look at up to this many frontier nodes
+  size_t max_estimate_nodes = 1 << 16;
+
+  // chunks touched by the layer chooseEngine looked at last
+  double estimated_chunks = 0;
+
+  std::vector<Engine> last_engines;
+  std::vector<uint> layer_frontier;
+  std::vector<double> chunk_bytes;
+
+  /**
+   * Expected number of 512 byte sectors random reads need for the layer
+   */
+  double estimateSectors(Span<const uint> frontier, uint n_neighbors);
+
+  /**
+   * Expected number of bytes streaming reads for the layer, and the number
+   * of chunks it touches
+   */
+  double estimateStreamingBytes(Span<const uint> frontier,
+                                double &n_chunks);
+
+  /**
+   * Fold the measured time of a layer into the device model
+   */
+  void updateModel(Engine engine, float time, double n_units,
+                   double n_chunks);
+
+public:
+  /**
+   * @brief Construct a new Hybrid Sampler object over two samplers of the
+   * same graph. The streaming sampler is used through sampleLayer, so its
+   * epoch pipeline must not be running. The two samplers have to be on
+   * different devices unless one xclbin holds both kernels.
+   * @param random_read_sampler: The random read sampler of the graph
+   * @param streaming_sampler: The streaming sampler of the graph
+   * @param fanouts: The number of neighbors of each sample layer
+   * @param bandwidth: Sequential read bandwidth of the device in bytes/s
+   * @param iops: Random 512 byte reads per second of the device
+   */
+  HybridSampler(std::shared_ptr<RandomReadSampler> random_read_sampler,
+                std::shared_ptr<StreamingSampler> streaming_sampler,
+                std::vector<uint> fanouts, double bandwidth = 3.0e9,
+                double iops = 8.0e5);
+
+  /**
+   * Set the device model
+   * @param bandwidth: Sequential read bandwidth in bytes/s
+   * @param iops: Random 512 byte reads per second
+   * @param chunk_overhead: Fixed time of one streamed chunk in ms
+   */
+  void setDeviceModel(double bandwidth, double iops, double chunk_overhead);
+
+  /**
+   * Get the modeled sequential read bandwidth in bytes/s
+   */
+  double getBandwidth();
+
+  /**
+   * Get the modeled random 512 byte reads per second
+   */
+  double getIops();
+
+  /**
+   * Measure the device by sampling one layer of `frontier`, in original ids
+   * like the frontier of sample, with each engine; the result is given by
+   * getBandwidth and getIops. The model is also updated after every layer
+   * that is sampled.
+   */
+  void calibrate(Span<const uint> frontier, uint n_neighbors);
+
+  /**
+   * The engine the cost model picks for a layer, with the modeled costs in
+   * ms
+   */
+  Engine chooseEngine(Span<const uint> frontier, uint n_neighbors,
+                      double &random_read_cost, double &streaming_cost);
+
+  /**
+   * The engine used by each layer of the last sample
+   */
+  const std::vector<Engine> &getLastEngines();
+
+  /**
+   * Set the fanouts, exit if one is above
+   * StreamingSampler::MAX_DISTINCT_FANOUT while sampling without replacement
+   */
+  void setFanouts(std::vector<uint> fanouts) override;
+
+  /**
+   * Set the sampling mode of both engines as well, exit if a fanout is above
+   * StreamingSampler::MAX_DISTINCT_FANOUT without replacement
+   */
+  void setReplace(bool replace) override;
+
+  /**
+   * Sample by edge weight with both engines, which must have been built on
+   * the weighted files and kernels
+   */
+  void setWeighted(bool weighted) override;
+
+  /**
+   * Overwrite the abstract function getSample. Same layers as
+   * RandomReadSampler::getSample.
+   */
+  std::vector<std::vector<uint>> getSample(std::vector<uint> frontier) override;
+
+  /**
+   * Sample the layers of the frontier into the workspace, each with the
+   * engine the cost model picks
+   */
+  void sample(Span<const uint> frontier, SampleWorkspace &workspace) override;
+};
+
+#endif // HYBRID_SAMPLER_HPP
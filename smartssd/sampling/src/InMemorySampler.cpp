@@ -0,0 +1,199 @@
+#include "InMemorySampler.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+InMemorySampler::InMemorySampler(std::string edge_file_path,
+                                 std::string offsets_file_path,
+                                 std::vector<uint> fanouts,
+                                 size_t offset_width)
+    : SamplerBase(fanouts) {
+  METRICS_TIME(SETUP_SECONDS);
+  this->edges = reinterpret_cast<const uint *>(
+      mapFile(edge_file_path, this->edges_size_byte));
+  this->offsets = ArrayFile(offsets_file_path, offset_width);
+  if (this->offsets.size() < 2) {
+    std::cerr << "ERR: " << offsets_file_path << " has no nodes" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  this->n_nodes = this->offsets.size() - 1;
+  // neighbors are picked at random, read ahead would only waste memory
+  madvise(const_cast<uint *>(this->edges), this->edges_size_byte,
+          MADV_RANDOM);
+  this->visited =
+      std::vector<std::atomic<uint64_t>>((this->n_nodes + 63) / 64);
+}
+
+InMemorySampler::~InMemorySampler() {
+  munmap(const_cast<uint *>(this->edges), this->edges_size_byte);
+}
+
+const char *InMemorySampler::mapFile(std::string file_path,
+                                     size_t &file_size_byte) {
+  int fd = open(file_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "ERR: open " << file_path << " failed: " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) == -1 || statbuf.st_size == 0) {
+    std::cerr << "ERR: " << file_path << " is empty or cannot be read"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  file_size_byte = statbuf.st_size;
+  void *ptr = mmap(NULL, file_size_byte, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    std::cerr << "ERR: mmap " << file_path << " failed: " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  return reinterpret_cast<const char *>(ptr);
+}
+
+inline uint64_t InMemorySampler::getOffset(size_t node_id) {
+  return this->offsets[node_id];
+}
+
+size_t InMemorySampler::getNumNodes() { return this->n_nodes; }
+
+void InMemorySampler::setWeighted(bool weighted) {
+  uint64_t n_edges = getOffset(this->n_nodes);
+  if (weighted && this->edges_size_byte < n_edges * sizeof(AliasEntry)) {
+    std::cerr << "ERR: the edge file holds " << this->edges_size_byte
+              << " bytes, too few for the alias tables of " << n_edges
+              << " edges" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  SamplerBase::setWeighted(weighted);
+}
+
+void InMemorySampler::sampleOneLayer(Span<const uint> frontier,
+                                     uint n_neighbors, const Philox &draws,
+                                     std::vector<uint> &result) {
+  this->thread_result.resize(omp_get_max_threads());
+  this->thread_picks.resize(omp_get_max_threads());
+  this->thread_coins.resize(omp_get_max_threads());
+  bool replace = getReplace();
+  bool weighted = getWeighted();
+  const AliasEntry *entries = reinterpret_cast<const AliasEntry *>(this->edges);
+#pragma omp parallel
+  {
+    int tid = omp_get_thread_num();
+    // grown only, up to the largest fanout
+    std::vector<uint32_t> &picks = this->thread_picks[tid];
+    std::vector<uint32_t> &coins = this->thread_coins[tid];
+    if (picks.size() < n_neighbors) {
+      picks.resize(n_neighbors);
+    }
+    if (weighted && coins.size() < n_neighbors) {
+      coins.resize(n_neighbors);
+    }
+    std::vector<uint> &thread_result = this->thread_result[tid];
+    thread_result.clear();
+    // the first thread to set the bit of a node keeps it, so the layer is
+    // deduplicated while it is sampled
+    auto visit = [&](uint node) {
+      uint64_t bit = uint64_t(1) << (node % 64);
+      if (!(this->visited[node / 64].fetch_or(bit, std::memory_order_relaxed) &
+            bit)) {
+        thread_result.push_back(node);
+      }
+    };
+    // degrees are skewed, so hand out the frontier in small pieces
+#pragma omp for schedule(dynamic, 64)
+    for (size_t i = 0; i < frontier.size(); i++) {
+      uint64_t first_edge = getOffset(frontier[i]);
+      uint64_t degree = getOffset(frontier[i] + 1) - first_edge;
+      if (weighted) {
+        if (degree == 0) {
+          continue;
+        }
+        draws.drawAlias(frontier[i], degree, n_neighbors, picks.data(),
+                        coins.data());
+        for (size_t j = 0; j < n_neighbors; j++) {
+          visit(AliasTable::pick(entries[first_edge + picks[j]], coins[j]));
+        }
+      } else if (degree < n_neighbors) {
+        for (size_t j = 0; j < degree; j++) {
+          visit(this->edges[first_edge + j]);
+        }
+      } else {
+        if (replace) {
+          draws.drawBelow(frontier[i], degree, n_neighbors, picks.data());
+        } else {
+          draws.drawDistinct(frontier[i], degree, n_neighbors, picks.data());
+        }
+        for (size_t j = 0; j < n_neighbors; j++) {
+          visit(this->edges[first_edge + picks[j]]);
+        }
+      }
+    }
+  }
+
+  size_t layer_begin = result.size();
+  for (auto &r : this->thread_result) {
+    result.insert(result.end(), r.begin(), r.end());
+  }
+
+  // every word with a bit set belongs to a node of the result
+#pragma omp parallel for
+  for (size_t i = layer_begin; i < result.size(); i++) {
+    this->visited[result[i] / 64].store(0, std::memory_order_relaxed);
+  }
+  std::sort(result.begin() + layer_begin, result.end());
+}
+
+void InMemorySampler::sample(Span<const uint> frontier,
+                             SampleWorkspace &workspace) {
+  frontier = toReordered(frontier);
+  workspace.clear();
+  uint32_t call = beginCall();
+  const std::vector<uint> &fanouts = this->getFanouts();
+  for (size_t i = 0; i < fanouts.size(); i++) {
+    Span<const uint> layer_frontier =
+        i == 0 ? frontier
+               : Span<const uint>(this->layer_frontier.data(),
+                                  this->layer_frontier.size());
+    for (uint node : layer_frontier) {
+      if (node >= this->n_nodes) {
+        std::cerr << "ERR: node " << node << " is not in the graph of "
+                  << this->n_nodes << " nodes" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    size_t layer_begin = workspace.values.size();
+    METRICS_SET_LAYER(LAYER_FRONTIER_SIZE, i, layer_frontier.size());
+    METRICS_ADD(SAMPLES, layer_frontier.size() * fanouts[i]);
+    {
+      METRICS_TIME(LAYER_SECONDS);
+      sampleOneLayer(layer_frontier, fanouts[i], Philox(getSeed(), call, i),
+                     workspace.values);
+    }
+    workspace.endLayer();
+    METRICS_SET_LAYER(LAYER_SAMPLED_SIZE, i,
+                      workspace.values.size() - layer_begin);
+    // the sampled result is the frontier for the next layer, copied because
+    // the workspace may move when the next layer is appended
+    if (i < fanouts.size() - 1) {
+      this->layer_frontier.assign(workspace.values.begin() + layer_begin,
+                                  workspace.values.end());
+    }
+  }
+  toOriginal(workspace.values.data(), workspace.values.size());
+}
+
+std::vector<std::vector<uint>>
+InMemorySampler::getSample(std::vector<uint> frontier) {
+  sample(Span<const uint>(frontier.data(), frontier.size()), this->workspace);
+  return toVectors(this->workspace);
+}
@@ -0,0 +1,95 @@
+/**
+ * This file defines a sampler that samples from the random read artifacts
+ * mapped into host memory, without a SmartSSD. It is the fast path for graphs
+ * that fit in DRAM and the CPU baseline of the FPGA samplers.
+ */
+#ifndef IN_MEMORY_SAMPLER_HPP
+#define IN_MEMORY_SAMPLER_HPP
+#include "SamplerBase.hpp"
+#include "utils/alias_table.hpp"
+#include "utils/array_file.hpp"
+#include "utils/philox.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class InMemorySampler : public SamplerBase {
+private:
+  const uint *edges;
+  size_t edges_size_byte;
+  ArrayFile offsets;
+  size_t n_nodes;
+
+  // one bit per node, set for the nodes already in the current layer
+  std::vector<std::atomic<uint64_t>> visited;
+
+  // kept across calls so that sampling does not allocate once they have
+  // grown
+  std::vector<std::vector<uint>> thread_result;
+  std::vector<uint> layer_frontier;
+  // the neighbor picks and alias coins of one node, per thread
+  std::vector<std::vector<uint32_t>> thread_picks;
+  std::vector<std::vector<uint32_t>> thread_coins;
+
+  /**
+   * Map a whole file read only, exit if that fails
+   */
+  const char *mapFile(std::string file_path, size_t &file_size_byte);
+
+  /**
+   * Offset of the first edge of a node
+   */
+  inline uint64_t getOffset(size_t node_id);
+
+  /**
+   * Sample one layer and append the sorted distinct sampled nodes to
+   * `result`
+   */
+  void sampleOneLayer(Span<const uint> frontier, uint n_neighbors,
+                      const Philox &draws, std::vector<uint> &result);
+
+public:
+  /**
+   * @brief Construct a new In Memory Sampler object
+   * this will map the edge_file and the offsets_file
+   * @param edge_file_path: The edge file path
+   * @param offsets_file_path: The offsets information of edge file
+   * @param fanouts: The number of neighbors of each sample layer
+   * @param offset_width: Bytes of one offset of an offsets file without
+   * header, 4 for papers, 8 for yahoo, 0 to guess
+   */
+  InMemorySampler(std::string edge_file_path, std::string offsets_file_path,
+                  std::vector<uint> fanouts, size_t offset_width = 4);
+
+  ~InMemorySampler();
+
+  InMemorySampler(const InMemorySampler &) = delete;
+  InMemorySampler &operator=(const InMemorySampler &) = delete;
+
+  /**
+   * Get the number of nodes in the graph
+   */
+  size_t getNumNodes();
+
+  /**
+   * Sample by edge weight, the edge file must be weighted_edges.bin; exit if
+   * it is too small to hold an alias entry per edge
+   */
+  void setWeighted(bool weighted) override;
+
+  /**
+   * Overwrite the abstract function getSample. Same result as
+   * RandomReadSampler::getSample: for each layer, the sorted distinct
+   * sampled neighbors, which are also the frontier of the next layer.
+   */
+  std::vector<std::vector<uint>> getSample(std::vector<uint> frontier) override;
+
+  /**
+   * Sample the layers of the frontier into the workspace, the same layers as
+   * getSample
+   */
+  void sample(Span<const uint> frontier, SampleWorkspace &workspace) override;
+};
+
+#endif // IN_MEMORY_SAMPLER_HPP
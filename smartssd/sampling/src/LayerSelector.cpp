@@ -0,0 +1,55 @@
+#include "LayerSelector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+void LayerSelector::select(std::vector<uint> &nodes,
+                           std::vector<uint> &batch_size, uint budget,
+                           const std::vector<float> &importance,
+                           const Philox &draws) {
+  size_t n_batches = batch_size.size();
+  this->input_pos.assign(n_batches + 1, 0);
+  for (size_t b = 0; b < n_batches; b++) {
+    this->input_pos[b + 1] = this->input_pos[b] + batch_size[b];
+  }
+  this->keys.resize(omp_get_max_threads());
+
+  // select the kept nodes of every batch at the front of its own range
+#pragma omp parallel
+  {
+    std::vector<std::pair<double, uint>> &keys =
+        this->keys[omp_get_thread_num()];
+#pragma omp for schedule(dynamic)
+    for (size_t b = 0; b < n_batches; b++) {
+      size_t n = batch_size[b];
+      if (n <= budget) {
+        continue;
+      }
+      uint *batch = nodes.data() + this->input_pos[b];
+      keys.resize(n);
+      for (size_t i = 0; i < n; i++) {
+        // u in (0, 1), so the log is finite
+        double u = (draws.draw(batch[i], b) + 0.5) / 4294967296.0;
+        keys[i] = std::make_pair(-std::log(u) / importance[batch[i]], batch[i]);
+      }
+      std::nth_element(keys.begin(), keys.begin() + budget, keys.end());
+      for (size_t i = 0; i < budget; i++) {
+        batch[i] = keys[i].second;
+      }
+      batch_size[b] = budget;
+    }
+  }
+
+  // close the gaps in batch order, a batch only moves to the front so it
+  // never overwrites one that is still to be moved
+  size_t out = 0;
+  for (size_t b = 0; b < n_batches; b++) {
+    if (out != this->input_pos[b]) {
+      std::copy(nodes.begin() + this->input_pos[b],
+                nodes.begin() + this->input_pos[b] + batch_size[b],
+                nodes.begin() + out);
+    }
+    out += batch_size[b];
+  }
+  nodes.resize(out);
+}
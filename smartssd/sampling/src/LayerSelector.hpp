@@ -0,0 +1,39 @@
+/**
+ * This file defines the budget stage of layer-wise sampling (FastGCN,
+ * LADIES). After a layer is deduplicated every minibatch holds the distinct
+ * candidates drawn from the neighbors of its frontier; layer-wise sampling
+ * keeps a fixed number of them per batch, picked by node importance, so the
+ * frontier of the next layer stops growing with the fanouts.
+ */
+#ifndef LAYER_SELECTOR_HPP
+#define LAYER_SELECTOR_HPP
+
+#include "utils/philox.hpp"
+#include <cstddef>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+
+class LayerSelector {
+private:
+  // the (key, node) pairs of a batch, one workspace per thread
+  std::vector<std::vector<std::pair<double, uint>>> keys;
+  std::vector<size_t> input_pos;
+
+public:
+  /**
+   * Keep `budget` nodes of every batch that has more, drawn without
+   * replacement with probability proportional to their importance
+   * (Efraimidis-Spirakis: the budget smallest keys -ln(u) / importance).
+   * Batch b holds batch_size[b] consecutive distinct nodes of `nodes`; the
+   * kept nodes are moved to the front of `nodes` batch after batch and
+   * batch_size is updated. The key of node v in batch b is made from draw b
+   * of v, so the selection is the same for the same draws.
+   * @param importance: The importance of every node, indexed by node, above 0
+   */
+  void select(std::vector<uint> &nodes, std::vector<uint> &batch_size,
+              uint budget, const std::vector<float> &importance,
+              const Philox &draws);
+};
+
+#endif // LAYER_SELECTOR_HPP
@@ -1,11 +1,15 @@
 #include "RandomReadSampler.hpp"
+#include "utils/alias_table.hpp"
+#include "utils/metrics.hpp"
 #include "utils/timer.hpp"
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
-#include <fstream>
+#include <iostream>
 #include <omp.h>
-#include <random>
 #include <sys/stat.h>
+#include <thread>
 
 int RandomReadSampler::openEdgeFile(std::string edge_file_path) {
   this->edge_file_handler = -1;
@@ -23,13 +27,8 @@ int RandomReadSampler::openEdgeFile(std::string edge_file_path) {
 }
 
 int RandomReadSampler::loadOffsets(std::string offsets_file_path) {
-  std::ifstream offsets_file(offsets_file_path);
-  // off64_t buffer;  // for yahoo
-  uint32_t buffer; // for papers
-  while (offsets_file.read(reinterpret_cast<char *>(&buffer), sizeof(buffer))) {
-    this->offsets.push_back(buffer);
-  }
-  offsets_file.close();
+  // 4 byte offsets for papers, 8 byte ones for yahoo
+  this->offsets = ArrayFile(offsets_file_path, 0);
   return 0;
 }
 
@@ -45,11 +44,13 @@ RandomReadSampler::RandomReadSampler(std::vector<uint> xrt_device_id,
                                      std::vector<uint> fanouts)
     : SmartSSDBase(xrt_device_id, xclbin_file, kernel_name),
       SamplerBase(fanouts) {
-  EasyTimer timer("RandomReadSampler Constructor");
+  METRICS_TIME(SETUP_SECONDS);
   openEdgeFile(edge_file_path);
   loadOffsets(offsets_file_path);
   this->max_batch_sample_size = 1024 * 20 * 15 * 10 + 10;
   allocateBufferObject();
+  setupReadEngine();
+  this->slice_result.resize(this->getXrtDevice().size());
 }
 
 float RandomReadSampler::getTransferTime() { return this->transfer_time; }
@@ -62,6 +63,15 @@ size_t RandomReadSampler::getMaxBatchSampleSize() {
 
 void RandomReadSampler::setMaxBatchSampleSize(size_t max_batch_sample_size) {
   this->max_batch_sample_size = max_batch_sample_size;
+  // the read engines go first, they have the raw sample buffers registered
+  this->uring_reader.clear();
+  allocateBufferObject();
+  setupReadEngine();
+  if (getWeighted()) {
+    this->bo_coins.clear();
+    this->bo_coins_map.clear();
+    setWeighted(true);
+  }
 }
 
 void RandomReadSampler::allocateBufferObject() {
@@ -71,8 +81,17 @@ void RandomReadSampler::allocateBufferObject() {
   size_t buffer_offsets_size_byte = this->max_batch_sample_size * sizeof(int);
   size_t sample_result_size_byte = this->max_batch_sample_size * sizeof(int);
 
+  this->bo_raw_sample.clear();
+  this->bo_sample_result.clear();
+  this->bo_offsets.clear();
+  this->bo_buffer_offsets.clear();
+  this->bo_raw_sample_map.clear();
+  this->bo_offsets_map.clear();
+  this->bo_buffer_offsets_map.clear();
+  this->bo_sample_result_map.clear();
+
   // Allocate Memory for Each SmartSSD device
-  xrt::bo::flags flags = xrt::bo::flags::p2p;
+  xrt::bo::flags flags = this->getP2PFlags();
   for (size_t i = 0; i < this->getXrtDevice().size(); i++) {
     auto device = this->getXrtDevice()[i];
     auto krnl = this->getXrtKernel()[i];
@@ -101,158 +120,266 @@ void RandomReadSampler::allocateBufferObject() {
   }
 }
 
-std::vector<uint> RandomReadSampler::sampleOneLayer(std::vector<uint> frontier,
-                                                    uint n_neighbors) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::vector<uint> result; //(n_neighbors * frontier.size());
+void RandomReadSampler::setWeighted(bool weighted) {
+  SamplerBase::setWeighted(weighted);
+  if (!weighted || !this->bo_coins.empty()) {
+    return;
+  }
+  size_t coins_size_byte = this->max_batch_sample_size * sizeof(int);
+  for (size_t i = 0; i < this->getXrtDevice().size(); i++) {
+    this->bo_coins.push_back(xrt::bo(this->getXrtDevice()[i], coins_size_byte,
+                                     this->getP2PFlags(),
+                                     this->getXrtKernel()[i].group_id(4)));
+    this->bo_coins_map.push_back(this->bo_coins[i].map<uint *>());
+  }
+}
+
+void RandomReadSampler::setupReadEngine() {
+  // one read engine per device, only the worker of that device uses it
+  this->uring_reader.clear();
+  this->read_requests.clear();
+  this->read_planner.clear();
+  for (size_t i = 0; i < this->bo_raw_sample_map.size(); i++) {
+    this->uring_reader.push_back(std::unique_ptr<UringReader>(
+        new UringReader(this->edge_file_handler, this->read_queue_depth)));
+    // the sectors are read straight into the raw sample buffer
+    this->uring_reader[i]->setBuffer(this->bo_raw_sample_map[i],
+                                     this->max_batch_sample_size * 512);
+    this->read_requests.push_back(std::vector<UringReader::ReadRequest>());
+    this->read_planner.push_back(ReadPlanner());
+  }
+}
+
+void RandomReadSampler::sampleSliceOnDevice(size_t device, const uint *frontier,
+                                            size_t n_frontier, uint n_neighbors,
+                                            const Philox &draws,
+                                            std::vector<uint> &result,
+                                            float &transfer_time,
+                                            float &fpga_time) {
+  size_t n_used_sectors = 0;
   {
     EasyTimer timer(transfer_time);
-    // std::cout << "size of frontier: " << frontier.size() << std::endl;
-#pragma omp parallel for
-    for (size_t i = 0; i < frontier.size(); i++) {
-      // std::cout << "frontier: " << frontier[i] << std::endl;
-      size_t degree = get_degree(frontier[i]);
-      // std::cout << "degree: " << degree << " n_neighbors: " << n_neighbors
-      //           << std::endl;
-      if (degree < n_neighbors) {
-        // #pragma omp parallel for
-        size_t pre_read_buffer_offset = -1;
-        uint32_t cur_buffer_offset = 0;
-        for (size_t j = 0; j < degree; j++) {
-          // 4 byte for each integer
-          size_t this_read_offset = (this->offsets[frontier[i]] + j) * 4;
-
-          if (this_read_offset / 512 * 512 == pre_read_buffer_offset) {
-            // no need to read again
-            bo_offsets_map[0][i * n_neighbors + j] =
-                (this_read_offset % 512) / 4;
-            bo_buffer_offsets_map[0][i * n_neighbors + j] = ++cur_buffer_offset;
-            continue;
-          }
-          cur_buffer_offset = 0;
-          pre_read_buffer_offset = this_read_offset / 512 * 512;
-          bo_buffer_offsets_map[0][i * n_neighbors + j] = 0;
-
-          // std::cout << "A this_read_offset: " << (this->offsets[frontier[i]]
-          // + j)
-          //           << " " << this_read_offset << " "
-          //           << this_read_offset / 512 * 512 << " "
-          //           << this_read_offset % 512 / 4 << std::endl;
-          // bo_raw_sample_map is 4 byte for each integer
-          auto re = pread(this->edge_file_handler,
-                          (void *)(this->bo_raw_sample_map[0] +
-                                   (i * n_neighbors + j) * 128),
-                          512, this_read_offset / 512 * 512);
-          if (re <= 0) {
-            std::cerr << "ERR: pread failed: "
-                      << " error: " << strerror(errno) << std::endl;
-            exit(EXIT_FAILURE);
-          }
-          // 4 byte for each integer
-          bo_offsets_map[0][i * n_neighbors + j] = (this_read_offset % 512) / 4;
-        }
-        for (size_t j = degree; j < n_neighbors; j++) {
-          bo_offsets_map[0][i * n_neighbors + j] = -1;
-        }
-      } else {
-        std::uniform_int_distribution<> dis(0, get_degree(frontier[i]) - 1);
-        size_t pre_read_buffer_offset = -1;
-        uint32_t cur_buffer_offset = 0;
-        for (size_t j = 0; j < n_neighbors; j++) {
-          size_t this_read_offset =
-              uint64_t(dis(gen) + this->offsets[frontier[i]]) * 4;
-
-          if (this_read_offset / 512 * 512 == pre_read_buffer_offset) {
-            // no need to read again
-            bo_offsets_map[0][i * n_neighbors + j] =
-                (this_read_offset % 512) / 4;
-            bo_buffer_offsets_map[0][i * n_neighbors + j] = ++cur_buffer_offset;
-            continue;
-          }
-          cur_buffer_offset = 0;
-          pre_read_buffer_offset = this_read_offset / 512 * 512;
-          bo_buffer_offsets_map[0][i * n_neighbors + j] = 0;
-          // bo_raw_sample_map is 4 byte for each integer
-          // std::cout << "B this_read_offset: " << this_read_offset << " "
-          //           << this_read_offset << " " << this_read_offset / 512 *
-          //           512
-          //           << " " << this_read_offset % 512 / 4 << std::endl;
-          auto re = pread(this->edge_file_handler,
-                          (void *)(this->bo_raw_sample_map[0] +
-                                   (i * n_neighbors + j) * 128),
-                          512, this_read_offset / 512 * 512);
-          if (re <= 0) {
-            std::cerr << "ERR: pread failed: "
-                      << " error: " << strerror(errno) << std::endl;
-            exit(EXIT_FAILURE);
-          }
-          // 4 byte for each integer
-          bo_offsets_map[0][i * n_neighbors + j] = (this_read_offset % 512) / 4;
-        }
-      }
+    // plan the reads of the whole slice first, so that every sector is read
+    // once and close sectors are read together
+    std::vector<UringReader::ReadRequest> &requests =
+        this->read_requests[device];
+    ReadPlanner &planner = this->read_planner[device];
+    bool weighted = getWeighted();
+    planner.setReplace(getReplace());
+    planner.setWeighted(weighted);
+    ssize_t re_plan = planner.plan(
+        frontier, n_frontier, n_neighbors, this->offsets,
+        this->max_batch_sample_size, draws, bo_offsets_map[device],
+        bo_buffer_offsets_map[device], requests, this->sector_cache.get(),
+        reinterpret_cast<char *>(this->bo_raw_sample_map[device]),
+        weighted ? bo_coins_map[device] : nullptr);
+    if (re_plan < 0) {
+      std::cerr << "ERR: raw sample buffer too small for " << n_frontier
+                << " nodes with " << n_neighbors << " neighbors" << std::endl;
+      exit(EXIT_FAILURE);
     }
+    n_used_sectors = re_plan;
+    this->sectors_read += planner.getNumReadSectors();
+    this->reads_issued += requests.size();
+    METRICS_ADD(SECTORS_READ, planner.getNumReadSectors());
+    METRICS_ADD(BYTES_READ, planner.getNumReadSectors() * 512);
+    METRICS_ADD(READS_ISSUED, requests.size());
+    METRICS_ADD(SECTORS_DEDUPED,
+                planner.getNumSamples() - planner.getNumSectors());
+    METRICS_ADD(SECTORS_CACHED, planner.getNumCachedSectors());
+    METRICS_ADD(SAMPLES, n_frontier * n_neighbors);
 
-    bo_offsets[0].sync(XCL_BO_SYNC_BO_TO_DEVICE);
-    bo_buffer_offsets[0].sync(XCL_BO_SYNC_BO_TO_DEVICE);
+    // submit the reads of the whole slice at once, so the SSD sees a deep
+    // queue instead of one read per thread
+    int re;
+    {
+      METRICS_TIME(READ_SECONDS);
+      re = this->uring_reader[device]->read(requests);
+    }
+    if (re < 0) {
+      std::cerr << "ERR: read failed: "
+                << " error: " << strerror(-re) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    // the SSD writes straight into device memory unless we are emulated,
+    // then the sectors read are in host memory and can be cached
+    if (!this->isP2PEnabled() && this->sector_cache) {
+      planner.admitReadSectors(
+          *this->sector_cache,
+          reinterpret_cast<char *>(this->bo_raw_sample_map[device]));
+    }
+    METRICS_TIME(BO_SYNC_SECONDS);
+    if (!this->isP2PEnabled()) {
+      bo_raw_sample[device].sync(XCL_BO_SYNC_BO_TO_DEVICE,
+                                 n_used_sectors * 512, 0);
+    }
+    bo_offsets[device].sync(XCL_BO_SYNC_BO_TO_DEVICE,
+                            n_frontier * n_neighbors * sizeof(int), 0);
+    bo_buffer_offsets[device].sync(XCL_BO_SYNC_BO_TO_DEVICE,
+                                   n_frontier * n_neighbors * sizeof(int), 0);
+    if (getWeighted()) {
+      bo_coins[device].sync(XCL_BO_SYNC_BO_TO_DEVICE,
+                            n_frontier * n_neighbors * sizeof(int), 0);
+    }
   }
 
   // run the kernel
   {
     EasyTimer timer(fpga_time);
-    auto run1 = this->getXrtKernel()[0](bo_raw_sample[0], bo_sample_result[0],
-                                        bo_offsets[0], bo_buffer_offsets[0],
-                                        frontier.size() * n_neighbors);
-
-    run1.wait();
+    METRICS_TIME(KERNEL_SECONDS);
+    xrt::kernel krnl = this->getXrtKernel()[device];
+    if (getWeighted()) {
+      auto run1 = krnl(bo_raw_sample[device], bo_sample_result[device],
+                       bo_offsets[device], bo_buffer_offsets[device],
+                       bo_coins[device], n_frontier * n_neighbors);
+      run1.wait();
+    } else {
+      auto run1 = krnl(
+          bo_raw_sample[device], bo_sample_result[device], bo_offsets[device],
+          bo_buffer_offsets[device], n_frontier * n_neighbors);
+      run1.wait();
+    }
   }
 
   {
     EasyTimer timer(transfer_time);
     // sync the buffer object back to host
-    this->bo_sample_result[0].sync(XCL_BO_SYNC_BO_FROM_DEVICE,
-                                   frontier.size() * n_neighbors * sizeof(int),
-                                   0);
-    // std::copy(bo_sample_result_map[0],
-    //           bo_sample_result_map[0] + frontier.size() * n_neighbors,
+    {
+      METRICS_TIME(BO_SYNC_SECONDS);
+      this->bo_sample_result[device].sync(
+          XCL_BO_SYNC_BO_FROM_DEVICE, n_frontier * n_neighbors * sizeof(int),
+          0);
+    }
+    // std::copy(bo_sample_result_map[device],
+    //           bo_sample_result_map[device] + n_frontier * n_neighbors,
     //           std::back_inserter(result));
-    std::copy_if(bo_sample_result_map[0],
-                 bo_sample_result_map[0] + frontier.size() * n_neighbors,
+    std::copy_if(bo_sample_result_map[device],
+                 bo_sample_result_map[device] + n_frontier * n_neighbors,
                  std::back_inserter(result),
                  [](uint i) { return i != static_cast<uint>(-1); });
   }
+}
 
-  return result;
+void RandomReadSampler::sampleOneLayer(Span<const uint> frontier,
+                                       uint n_neighbors, const Philox &draws,
+                                       std::vector<uint> &result) {
+  // give every device a contiguous slice of the frontier, one worker each,
+  // and concatenate the slices in order afterwards
+  size_t n_devices = this->getXrtDevice().size();
+  size_t slice_size = (frontier.size() + n_devices - 1) / n_devices;
+  this->slice_transfer_time.assign(n_devices, 0);
+  this->slice_fpga_time.assign(n_devices, 0);
+  for (size_t d = 0; d < n_devices; d++) {
+    this->slice_result[d].clear();
+  }
+  if (n_devices == 1) {
+    // no worker thread needed
+    sampleSliceOnDevice(0, frontier.data(), frontier.size(), n_neighbors,
+                        draws, this->slice_result[0],
+                        this->slice_transfer_time[0], this->slice_fpga_time[0]);
+  } else {
+    this->workers.clear();
+    for (size_t d = 0; d < n_devices; d++) {
+      size_t begin = std::min(d * slice_size, frontier.size());
+      size_t end = std::min(begin + slice_size, frontier.size());
+      if (begin == end) {
+        break;
+      }
+      this->workers.emplace_back([&, d, begin, end]() {
+        sampleSliceOnDevice(d, frontier.data() + begin, end - begin,
+                            n_neighbors, draws, this->slice_result[d],
+                            this->slice_transfer_time[d],
+                            this->slice_fpga_time[d]);
+      });
+    }
+    for (auto &worker : this->workers) {
+      worker.join();
+    }
+  }
+
+  for (size_t d = 0; d < n_devices; d++) {
+    result.insert(result.end(), this->slice_result[d].begin(),
+                  this->slice_result[d].end());
+  }
+  // devices run side by side, so count the slowest one
+  this->transfer_time += *std::max_element(this->slice_transfer_time.begin(),
+                                           this->slice_transfer_time.end());
+  this->fpga_time += *std::max_element(this->slice_fpga_time.begin(),
+                                       this->slice_fpga_time.end());
 }
 
-std::vector<std::vector<uint>>
-RandomReadSampler::getSample(std::vector<uint> frontier) {
-  std::vector<std::vector<uint>> result;
+void RandomReadSampler::sampleLayer(Span<const uint> frontier,
+                                    uint n_neighbors,
+                                    std::vector<uint> &result,
+                                    const Philox &draws) {
+  size_t layer_begin = result.size();
+  {
+    METRICS_TIME(LAYER_SECONDS);
+    sampleOneLayer(frontier, n_neighbors, draws, result);
+  }
+  // deduplicate the sample result
+  METRICS_TIME(DEDUP_SECONDS);
+  std::sort(result.begin() + layer_begin, result.end());
+  result.erase(std::unique(result.begin() + layer_begin, result.end()),
+               result.end());
+}
+
+const ArrayFile &RandomReadSampler::getOffsets() {
+  return this->offsets;
+}
+
+size_t RandomReadSampler::getSectorsRead() { return this->sectors_read; }
+
+size_t RandomReadSampler::getReadsIssued() { return this->reads_issued; }
+
+void RandomReadSampler::setSectorCache(size_t budget_byte, bool prewarm) {
+  if (budget_byte == 0) {
+    this->sector_cache.reset();
+    return;
+  }
+  this->sector_cache.reset(new SectorCache(budget_byte));
+  if (prewarm) {
+    this->sector_cache->prewarm(this->edge_file_handler, this->offsets,
+                                getWeighted() ? sizeof(AliasEntry) : 4);
+  }
+}
+
+SectorCache *RandomReadSampler::getSectorCache() {
+  return this->sector_cache.get();
+}
+
+void RandomReadSampler::sample(Span<const uint> frontier,
+                               SampleWorkspace &workspace) {
+  frontier = toReordered(frontier);
+  workspace.clear();
+  uint32_t call = beginCall();
+  const std::vector<uint> &fanouts = this->getFanouts();
   // sample for each layer
-  for (size_t i = 0; i < this->getFanouts().size(); i++) {
-    // std::cout << "Sample for layer " << i << std::endl;
-    std::vector<uint> sample_result =
-        sampleOneLayer(frontier, this->getFanouts()[i]);
-
-    // deduplicate the sample result
-    std::sort(sample_result.begin(), sample_result.end());
-    auto last = std::unique(sample_result.begin(), sample_result.end());
-    sample_result.erase(last, sample_result.end());
-
-    result.push_back(sample_result);
-
-    // std::cout << "sample_result size: " << sample_result.size() << std::endl;
-
-    // the sampled result is the frontier for the next layer
-    if (i < this->getFanouts().size() - 1) {
-      // frontier.clear();
-      // std::copy_if(sample_result.begin(), sample_result.end(),
-      //              std::back_inserter(frontier),
-      //              [](uint i) { return i != static_cast<uint>(-1); });
-      frontier = sample_result;
-      // std::cout << "Next Frontier size: " << frontier.size() << std::endl;
+  for (size_t i = 0; i < fanouts.size(); i++) {
+    size_t layer_begin = workspace.values.size();
+    METRICS_SET_LAYER(LAYER_FRONTIER_SIZE, i,
+                      i == 0 ? frontier.size() : this->layer_frontier.size());
+    sampleLayer(i == 0 ? frontier
+                       : Span<const uint>(this->layer_frontier.data(),
+                                          this->layer_frontier.size()),
+                fanouts[i], workspace.values, Philox(getSeed(), call, i));
+    workspace.endLayer();
+    METRICS_SET_LAYER(LAYER_SAMPLED_SIZE, i,
+                      workspace.values.size() - layer_begin);
+
+    // the sampled result is the frontier for the next layer, copied because
+    // the workspace may move when the next layer is appended
+    if (i < fanouts.size() - 1) {
+      this->layer_frontier.assign(workspace.values.begin() + layer_begin,
+                                  workspace.values.end());
     }
   }
+  toOriginal(workspace.values.data(), workspace.values.size());
+}
 
-  return result;
-}
\ No newline at end of file
+std::vector<std::vector<uint>>
+RandomReadSampler::getSample(std::vector<uint> frontier) {
+  sample(Span<const uint>(frontier.data(), frontier.size()), this->workspace);
+  return toVectors(this->workspace);
+}
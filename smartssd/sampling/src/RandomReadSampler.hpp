@@ -1,25 +1,57 @@
 #ifndef RANDOM_READ_SAMPLER_HPP
 #define RANDOM_READ_SAMPLER_HPP
+#include "ReadPlanner.hpp"
 #include "SamplerBase.hpp"
+#include "SectorCache.hpp"
 #include "SmartSSDBase.hpp"
+#include "utils/array_file.hpp"
+#include "utils/uring_reader.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <vector>
 
 class RandomReadSampler : public SmartSSDBase, public SamplerBase {
 private:
   int edge_file_handler;
   off_t edge_file_size_byte;
-  std::vector<off64_t> offsets;
+  ArrayFile offsets;
   std::vector<uint> degrees;
   size_t max_batch_sample_size;
   std::vector<xrt::bo> bo_raw_sample;     // ~1.5GB
   std::vector<xrt::bo> bo_offsets;        // ~12MB
   std::vector<xrt::bo> bo_buffer_offsets; // ~12MB
   std::vector<xrt::bo> bo_sample_result;  // ~12MB
+  // the coin of every sample, only for weighted sampling
+  std::vector<xrt::bo> bo_coins; // ~12MB
 
   std::vector<uint *> bo_raw_sample_map;
   std::vector<uint *> bo_offsets_map;
   std::vector<uint *> bo_buffer_offsets_map;
   std::vector<uint *> bo_sample_result_map;
+  std::vector<uint *> bo_coins_map;
+
+  // io_uring read engine, read planner and the read requests of the current
+  // slice, for each device
+  unsigned read_queue_depth = 256;
+  std::vector<std::unique_ptr<UringReader>> uring_reader;
+  std::vector<ReadPlanner> read_planner;
+  std::vector<std::vector<UringReader::ReadRequest>> read_requests;
+
+  // kept across calls so that sampling does not allocate once they have
+  // grown
+  std::vector<uint> layer_frontier;
+  std::vector<std::vector<uint>> slice_result;
+  std::vector<float> slice_transfer_time;
+  std::vector<float> slice_fpga_time;
+  std::vector<std::thread> workers;
+
+  // 512 byte sectors read for sampling so far, and the reads they took
+  std::atomic<size_t> sectors_read{0};
+  std::atomic<size_t> reads_issued{0};
+
+  // host memory cache of hot sectors, shared by all devices
+  std::unique_ptr<SectorCache> sector_cache;
 
   float transfer_time = 0;
   float fpga_time = 0;
@@ -30,7 +62,7 @@ private:
   int openEdgeFile(std::string edge_file_path);
 
   /**
-   * Load the offsets information of all the nodes in the edge file
+   * Map the offsets of all the nodes in the edge file, of 4 or 8 bytes
    */
   int loadOffsets(std::string offsets_file_path);
 
@@ -40,10 +72,27 @@ private:
   void allocateBufferObject();
 
   /**
-   * Helper funtion to smaple one layer
+   * Set up one io_uring read engine for each device, with the raw sample
+   * buffer of that device registered as its fixed buffer
    */
-  std::vector<uint> sampleOneLayer(std::vector<uint> frontier,
-                                   uint n_neighbors);
+  void setupReadEngine();
+
+  /**
+   * Sample one layer for a slice of the frontier on one device, appending
+   * the sampled neighbors to `result`
+   */
+  void sampleSliceOnDevice(size_t device, const uint *frontier,
+                           size_t n_frontier, uint n_neighbors,
+                           const Philox &draws, std::vector<uint> &result,
+                           float &transfer_time, float &fpga_time);
+
+  /**
+   * Helper funtion to smaple one layer. The frontier is split into one slice
+   * per loaded device and the slices are sampled in parallel. The sampled
+   * neighbors are appended to `result`.
+   */
+  void sampleOneLayer(Span<const uint> frontier, uint n_neighbors,
+                      const Philox &draws, std::vector<uint> &result);
 
   /**
    * Get the degree of a node by its two offsets
@@ -66,6 +115,14 @@ public:
                     std::string kernel_name, std::string edge_file_path,
                     std::string offsets_file_path, std::vector<uint> fanouts);
 
+  /**
+   * Sample by edge weight. The edge file must be weighted_edges.bin and the
+   * kernel weighted_random_read_sampler, which takes the coins of the draws
+   * as one more buffer. Call it before setSectorCache, whose prewarm reads
+   * the edge file.
+   */
+  void setWeighted(bool weighted) override;
+
   /**
    * Get the maximum batch sample size
    */
@@ -73,7 +130,7 @@ public:
 
   /**
    * Set the maximum batch sample size. This affect the buffer object size we
-   * allocate.
+   * allocate; the buffers of every device are allocated again with it.
    */
   void setMaxBatchSampleSize(size_t max_batch_sample_size);
 
@@ -82,6 +139,52 @@ public:
    */
   std::vector<std::vector<uint>> getSample(std::vector<uint> fontier) override;
 
+  /**
+   * Sample the layers of the frontier into the workspace, the same layers as
+   * getSample
+   */
+  void sample(Span<const uint> frontier, SampleWorkspace &workspace) override;
+
+  /**
+   * Sample one layer of the frontier and append the sorted distinct sampled
+   * nodes to `result`
+   * @param draws: The random draws of the layer
+   */
+  void sampleLayer(Span<const uint> frontier, uint n_neighbors,
+                   std::vector<uint> &result, const Philox &draws);
+
+  /**
+   * Get the offsets of the edge lists of all nodes, offsets[n] to
+   * offsets[n + 1] being the edges of node n
+   */
+  const ArrayFile &getOffsets();
+
+  /**
+   * Number of 512 byte sectors read from the SSD for sampling so far
+   */
+  size_t getSectorsRead();
+
+  /**
+   * Number of reads submitted to the SSD for sampling so far, a read covering
+   * one or more adjacent sectors
+   */
+  size_t getReadsIssued();
+
+  /**
+   * Serve sampled sectors from a host memory cache, so only the misses are
+   * read from the SSD. Without P2P, the sectors read are added to the cache
+   * as they are read; with P2P they land in device memory, so the cache only
+   * holds the prewarmed sectors.
+   * @param budget_byte: Host memory for the cache, 0 to disable it
+   * @param prewarm: Fill the cache with the highest degree nodes first
+   */
+  void setSectorCache(size_t budget_byte, bool prewarm = true);
+
+  /**
+   * Get the sector cache, nullptr if there is none
+   */
+  SectorCache *getSectorCache();
+
   /**
    * get fpga time
    */
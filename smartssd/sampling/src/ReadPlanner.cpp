@@ -0,0 +1,205 @@
+#include "ReadPlanner.hpp"
+#include "utils/alias_table.hpp"
+#include <algorithm>
+#include <omp.h>
+
+// 512 byte sectors of 4 byte integers
+static const uint64_t EDGES_PER_SECTOR = 128;
+static const uint64_t NO_EDGE = static_cast<uint64_t>(-1);
+
+ReadPlanner::ReadPlanner(size_t max_gap_sectors, size_t max_run_sectors)
+    : max_gap_sectors(max_gap_sectors), max_run_sectors(max_run_sectors),
+      n_samples(0), n_sectors(0), n_buffer_sectors(0), n_read_sectors(0),
+      n_cached_sectors(0) {}
+
+ssize_t ReadPlanner::plan(const uint *frontier, size_t n_frontier,
+                          uint n_neighbors, const ArrayFile &offsets,
+                          size_t buffer_sectors, const Philox &draws,
+                          uint *sector_offsets, uint *buffer_offsets,
+                          std::vector<UringReader::ReadRequest> &requests,
+                          SectorCache *cache, char *buffer, uint *coins) {
+  size_t n_slots = n_frontier * n_neighbors;
+  requests.clear();
+  // an edge is an alias entry when weighted
+  uint64_t edges_per_sector =
+      this->weighted ? AliasTable::ENTRIES_PER_SECTOR : EDGES_PER_SECTOR;
+  uint64_t edge_ints = this->weighted ? AliasTable::ENTRY_INTS : 1;
+
+  // pick the edge of every slot
+  this->slot_edge.resize(n_slots);
+#pragma omp parallel for
+  for (size_t i = 0; i < n_frontier; i++) {
+    uint64_t first_edge = offsets[frontier[i]];
+    uint64_t degree = offsets[frontier[i] + 1] - first_edge;
+    uint64_t *edge = this->slot_edge.data() + i * n_neighbors;
+    if (this->weighted && degree > 0) {
+      draws.drawAlias(frontier[i], degree, n_neighbors, edge,
+                      coins + i * n_neighbors);
+      for (size_t j = 0; j < n_neighbors; j++) {
+        edge[j] += first_edge;
+      }
+    } else if (degree < n_neighbors || this->weighted) {
+      // weighted nodes only get here without neighbors
+      for (size_t j = 0; j < degree; j++) {
+        edge[j] = first_edge + j;
+      }
+      for (size_t j = degree; j < n_neighbors; j++) {
+        edge[j] = NO_EDGE;
+      }
+    } else {
+      if (this->replace) {
+        draws.drawBelow(frontier[i], degree, n_neighbors, edge);
+      } else {
+        draws.drawDistinct(frontier[i], degree, n_neighbors, edge);
+      }
+      for (size_t j = 0; j < n_neighbors; j++) {
+        edge[j] += first_edge;
+      }
+    }
+  }
+
+  // every distinct sector of the layer, in file order
+  this->sectors.clear();
+  for (size_t slot = 0; slot < n_slots; slot++) {
+    if (this->slot_edge[slot] != NO_EDGE) {
+      this->sectors.push_back(this->slot_edge[slot] / edges_per_sector);
+    }
+  }
+  this->n_samples = this->sectors.size();
+  std::sort(this->sectors.begin(), this->sectors.end());
+  this->sectors.erase(std::unique(this->sectors.begin(), this->sectors.end()),
+                      this->sectors.end());
+  this->n_sectors = this->sectors.size();
+
+  this->sector_cached.assign(this->sectors.size(), 0);
+  if (cache != nullptr) {
+#pragma omp parallel for
+    for (size_t k = 0; k < this->sectors.size(); k++) {
+      this->sector_cached[k] = cache->lookup(this->sectors[k]);
+    }
+  }
+
+  // merge sectors that are close into one read, the sectors of a read are
+  // laid out back to back in the buffer, gaps included
+  this->sector_buffer_slot.resize(this->sectors.size());
+  size_t used = 0;
+  bool in_run = false;
+  size_t run_begin = 0;
+  size_t run_end = 0;
+  auto close_run = [&]() {
+    requests.push_back(
+        {this->sectors[run_begin] * 512,
+         (uint64_t)this->sector_buffer_slot[run_begin] * 512,
+         (uint32_t)((this->sectors[run_end] - this->sectors[run_begin] + 1) *
+                    512)});
+  };
+  for (size_t k = 0; k < this->sectors.size(); k++) {
+    if (this->sector_cached[k]) {
+      continue;
+    }
+    if (in_run) {
+      uint64_t gap = this->sectors[k] - this->sectors[run_end] - 1;
+      uint64_t run_length =
+          this->sectors[k] - this->sectors[run_begin] + 1;
+      if (gap <= this->max_gap_sectors &&
+          run_length <= this->max_run_sectors &&
+          used + gap + 1 <= buffer_sectors) {
+        used += gap + 1;
+        this->sector_buffer_slot[k] =
+            this->sector_buffer_slot[run_begin] +
+            (this->sectors[k] - this->sectors[run_begin]);
+        run_end = k;
+        continue;
+      }
+      close_run();
+    }
+    if (used + 1 > buffer_sectors) {
+      return -1;
+    }
+    in_run = true;
+    run_begin = run_end = k;
+    this->sector_buffer_slot[k] = used;
+    used += 1;
+  }
+  if (in_run) {
+    close_run();
+  }
+  this->n_read_sectors = used;
+
+  // the cached sectors go after the read ones
+  this->n_cached_sectors = 0;
+  if (cache != nullptr) {
+    for (size_t k = 0; k < this->sectors.size(); k++) {
+      if (this->sector_cached[k]) {
+        if (used + 1 > buffer_sectors) {
+          return -1;
+        }
+        this->sector_buffer_slot[k] = used;
+        used += 1;
+      }
+    }
+#pragma omp parallel for
+    for (size_t k = 0; k < this->sectors.size(); k++) {
+      if (this->sector_cached[k] &&
+          !cache->copyTo(this->sectors[k],
+                         buffer + (size_t)this->sector_buffer_slot[k] * 512)) {
+        // evicted by another device since the lookup
+        this->sector_cached[k] = 2;
+      }
+    }
+    for (size_t k = 0; k < this->sectors.size(); k++) {
+      if (this->sector_cached[k] == 2) {
+        this->sector_cached[k] = 0;
+        requests.push_back({this->sectors[k] * 512,
+                            (uint64_t)this->sector_buffer_slot[k] * 512, 512});
+        this->n_read_sectors++;
+      } else if (this->sector_cached[k]) {
+        this->n_cached_sectors++;
+      }
+    }
+  }
+  this->n_buffer_sectors = used;
+
+  // point every slot at the buffer sector holding its edge
+#pragma omp parallel for
+  for (size_t slot = 0; slot < n_slots; slot++) {
+    uint64_t edge = this->slot_edge[slot];
+    if (edge == NO_EDGE) {
+      sector_offsets[slot] = -1;
+      buffer_offsets[slot] = 0;
+      continue;
+    }
+    size_t k = std::lower_bound(this->sectors.begin(), this->sectors.end(),
+                                edge / edges_per_sector) -
+               this->sectors.begin();
+    sector_offsets[slot] = edge % edges_per_sector * edge_ints;
+    // the kernel reads buffer sector (slot - buffer_offsets[slot]), this
+    // wraps around for sectors placed after the slot
+    buffer_offsets[slot] = (uint32_t)slot - this->sector_buffer_slot[k];
+  }
+  return used;
+}
+
+void ReadPlanner::setReplace(bool replace) { this->replace = replace; }
+
+void ReadPlanner::setWeighted(bool weighted) { this->weighted = weighted; }
+
+size_t ReadPlanner::getNumSamples() { return this->n_samples; }
+
+size_t ReadPlanner::getNumSectors() { return this->n_sectors; }
+
+size_t ReadPlanner::getNumBufferSectors() { return this->n_buffer_sectors; }
+
+size_t ReadPlanner::getNumReadSectors() { return this->n_read_sectors; }
+
+size_t ReadPlanner::getNumCachedSectors() { return this->n_cached_sectors; }
+
+void ReadPlanner::admitReadSectors(SectorCache &cache, const char *buffer) {
+#pragma omp parallel for schedule(dynamic, 256)
+  for (size_t k = 0; k < this->sectors.size(); k++) {
+    if (!this->sector_cached[k]) {
+      cache.insert(this->sectors[k],
+                   buffer + (size_t)this->sector_buffer_slot[k] * 512);
+    }
+  }
+}
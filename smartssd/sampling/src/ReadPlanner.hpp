@@ -0,0 +1,122 @@
+/**
+ * This file defines the read planner of the random read sampler. Before any
+ * I/O is issued, it picks the sampled edge of every slot of a layer, maps the
+ * edges to 512 byte sectors, reads every distinct sector only once and merges
+ * neighbouring sectors into multi-sector reads. Sectors found in a
+ * SectorCache are copied into the buffer instead of being read.
+ */
+#ifndef READ_PLANNER_HPP
+#define READ_PLANNER_HPP
+
+#include "SectorCache.hpp"
+#include "utils/philox.hpp"
+#include "utils/uring_reader.hpp"
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+class ReadPlanner {
+private:
+  size_t max_gap_sectors;
+  size_t max_run_sectors;
+  bool replace = true;
+  bool weighted = false;
+
+  // workspace, kept across calls so that planning does not allocate
+  std::vector<uint64_t> slot_edge;
+  std::vector<uint64_t> sectors;
+  std::vector<uint32_t> sector_buffer_slot;
+  // 1 for the sectors copied from the cache
+  std::vector<uint8_t> sector_cached;
+
+  // statistics of the last plan
+  size_t n_samples;
+  size_t n_sectors;
+  size_t n_buffer_sectors;
+  size_t n_read_sectors;
+  size_t n_cached_sectors;
+
+public:
+  /**
+   * @param max_gap_sectors: Two reads are merged if at most this many unused
+   * sectors lie between them; the gap is read too
+   * @param max_run_sectors: The maximum number of sectors of one read
+   */
+  ReadPlanner(size_t max_gap_sectors = 1, size_t max_run_sectors = 256);
+
+  /**
+   * Pick the neighbors of a node with replacement, the default, or distinct
+   * ones, so no slot reads a neighbor another slot of the node has
+   */
+  void setReplace(bool replace);
+
+  /**
+   * Plan weighted draws on the alias entries of weighted_edges.bin instead
+   * of edges: every slot of a node with neighbors draws a column and a coin
+   * of the node's alias table (see AliasTable). sector_offsets then point at
+   * the first word of the entry and the coins go to the kernel too.
+   */
+  void setWeighted(bool weighted);
+
+  /**
+   * Plan the reads for sampling n_neighbors neighbors of each frontier node.
+   * Slot i * n_neighbors + j holds neighbor j of frontier[i]; nodes with
+   * fewer neighbors get all of them and -1 in the remaining slots.
+   *
+   * For every slot, sector_offsets gets the word of the neighbor in its
+   * sector, and buffer_offsets gets the distance from the slot back to the
+   * buffer sector holding it (modulo 2^32), which is what the kernel
+   * expects. The sectors to read into the buffer are written to requests.
+   * With a cache, the cached sectors get buffer sectors after the read ones
+   * and are copied there right away.
+   *
+   * @param offsets: The offset of the first edge of every node
+   * @param buffer_sectors: The number of 512 byte sectors in the buffer
+   * @param draws: The random draws of the layer, neighbor j of node n is
+   * picked by draw j of n
+   * @param cache: The sector cache to serve sectors from, or nullptr
+   * @param buffer: The buffer the cached sectors are copied to
+   * @param coins: The coin of every slot, only written when weighted
+   * @return The number of buffer sectors used, or -1 if they do not fit
+   */
+  ssize_t plan(const uint *frontier, size_t n_frontier, uint n_neighbors,
+               const ArrayFile &offsets, size_t buffer_sectors,
+               const Philox &draws, uint *sector_offsets,
+               uint *buffer_offsets,
+               std::vector<UringReader::ReadRequest> &requests,
+               SectorCache *cache = nullptr, char *buffer = nullptr,
+               uint *coins = nullptr);
+
+  /**
+   * Add the sectors the last plan read to the cache, once the reads are done
+   * @param buffer: The buffer the sectors were read to
+   */
+  void admitReadSectors(SectorCache &cache, const char *buffer);
+
+  /**
+   * Number of sampled edges in the last plan
+   */
+  size_t getNumSamples();
+
+  /**
+   * Number of distinct sectors the samples of the last plan fall into
+   */
+  size_t getNumSectors();
+
+  /**
+   * Number of buffer sectors used by the last plan, including merged gaps
+   */
+  size_t getNumBufferSectors();
+
+  /**
+   * Number of sectors read by the last plan, including merged gaps
+   */
+  size_t getNumReadSectors();
+
+  /**
+   * Number of sectors the last plan copied from the cache
+   */
+  size_t getNumCachedSectors();
+};
+
+#endif // READ_PLANNER_HPP
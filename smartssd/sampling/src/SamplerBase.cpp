@@ -1,9 +1,123 @@
 #include "SamplerBase.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <random>
 
-SamplerBase::SamplerBase(std::vector<uint> fanouts) { this->fanouts = fanouts; }
+void SampleWorkspace::clear() {
+  this->values.clear();
+  this->offsets.assign(1, 0);
+}
+
+size_t SampleWorkspace::getNumLayers() const {
+  return this->offsets.size() - 1;
+}
+
+Span<const uint> SampleWorkspace::getLayer(size_t layer) const {
+  return Span<const uint>(this->values.data() + this->offsets[layer],
+                          this->offsets[layer + 1] - this->offsets[layer]);
+}
+
+void SampleWorkspace::endLayer() {
+  this->offsets.push_back(this->values.size());
+}
+
+static uint64_t randomSeed() {
+  std::random_device rd;
+  return (uint64_t(rd()) << 32) | rd();
+}
+
+SamplerBase::SamplerBase() : seed(randomSeed()) {}
+
+SamplerBase::SamplerBase(std::vector<uint> fanouts) : seed(randomSeed()) {
+  this->fanouts = fanouts;
+}
 
 void SamplerBase::setFanouts(std::vector<uint> fanouts) {
   this->fanouts = fanouts;
 }
 
-std::vector<uint> SamplerBase::getFanouts() { return this->fanouts; }
+const std::vector<uint> &SamplerBase::getFanouts() { return this->fanouts; }
+
+void SamplerBase::setSeed(uint64_t seed) {
+  this->seed = seed;
+  this->n_calls = 0;
+}
+
+uint64_t SamplerBase::getSeed() { return this->seed; }
+
+void SamplerBase::setReplace(bool replace) { this->replace = replace; }
+
+bool SamplerBase::getReplace() { return this->replace; }
+
+void SamplerBase::setWeighted(bool weighted) { this->weighted = weighted; }
+
+bool SamplerBase::getWeighted() { return this->weighted; }
+
+uint32_t SamplerBase::beginCall() { return this->n_calls++; }
+
+void SamplerBase::rewindCalls(uint32_t n) { this->n_calls -= n; }
+
+void SamplerBase::setNodeMap(std::string old_to_new_path,
+                             std::string new_to_old_path) {
+  this->old_to_new = ArrayFile(old_to_new_path);
+  this->new_to_old = ArrayFile(new_to_old_path);
+  if (this->old_to_new.size() != this->new_to_old.size() ||
+      this->old_to_new.getWidth() != 4 || this->new_to_old.getWidth() != 4) {
+    std::cerr << "ERR: " << old_to_new_path << " and " << new_to_old_path
+              << " are not the two maps of one graph" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+bool SamplerBase::hasNodeMap() { return !this->old_to_new.empty(); }
+
+Span<const uint> SamplerBase::toReordered(Span<const uint> frontier) {
+  if (!hasNodeMap()) {
+    return frontier;
+  }
+  Span<const uint32_t> map = this->old_to_new.view<uint32_t>();
+  this->reordered_frontier.resize(frontier.size());
+  for (size_t i = 0; i < frontier.size(); i++) {
+    if (frontier[i] >= map.size()) {
+      std::cerr << "ERR: node " << frontier[i] << " is not in the graph of "
+                << map.size() << " nodes" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    this->reordered_frontier[i] = map[frontier[i]];
+  }
+  return Span<const uint>(this->reordered_frontier.data(),
+                          this->reordered_frontier.size());
+}
+
+void SamplerBase::toOriginal(uint *nodes, size_t n) {
+  if (!hasNodeMap()) {
+    return;
+  }
+  Span<const uint32_t> map = this->new_to_old.view<uint32_t>();
+#pragma omp parallel for if (n > (1 << 16))
+  for (size_t i = 0; i < n; i++) {
+    nodes[i] = map[nodes[i]];
+  }
+}
+
+std::vector<std::vector<uint>>
+SamplerBase::toVectors(const SampleWorkspace &workspace) {
+  std::vector<std::vector<uint>> result;
+  for (size_t i = 0; i < workspace.getNumLayers(); i++) {
+    Span<const uint> layer = workspace.getLayer(i);
+    result.push_back(std::vector<uint>(layer.begin(), layer.end()));
+  }
+  return result;
+}
+
+void SamplerBase::sample(Span<const uint> frontier,
+                         SampleWorkspace &workspace) {
+  std::vector<std::vector<uint>> result =
+      getSample(std::vector<uint>(frontier.begin(), frontier.end()));
+  workspace.clear();
+  for (auto &layer : result) {
+    workspace.values.insert(workspace.values.end(), layer.begin(),
+                            layer.end());
+    workspace.endLayer();
+  }
+}
@@ -3,15 +3,103 @@
  */
 #ifndef SamplerBase_HPP
 #define SamplerBase_HPP
+#include "utils/array_file.hpp"
+#include "utils/span.hpp"
+#include <cstdint>
+#include <string>
 #include <sys/types.h>
 #include <vector>
 
+/**
+ * Caller owned output of SamplerBase::sample. The sampled nodes of all layers
+ * are stored back to back in one buffer, layer l being
+ * values[offsets[l], offsets[l + 1]). The buffers keep their capacity across
+ * calls, so reusing one workspace does not allocate once it has grown.
+ */
+class SampleWorkspace {
+public:
+  std::vector<uint> values;
+  std::vector<size_t> offsets;
+
+  SampleWorkspace() : offsets(1, 0) {}
+
+  /**
+   * Drop the layers, keep the memory
+   */
+  void clear();
+
+  /**
+   * Number of layers in the workspace
+   */
+  size_t getNumLayers() const;
+
+  /**
+   * The sampled nodes of layer `layer`
+   */
+  Span<const uint> getLayer(size_t layer) const;
+
+  /**
+   * Close the layer made of the values added since the last call
+   */
+  void endLayer();
+};
+
 class SamplerBase {
 private:
   std::vector<uint> fanouts;
 
+  // the random draws are keyed by the seed and the number of the call, see
+  // utils/philox.hpp
+  uint64_t seed;
+  uint32_t n_calls = 0;
+
+  bool replace = true;
+  bool weighted = false;
+
+  // the id maps of a reordered graph (see utils/node_order.hpp), empty when
+  // the ids are the original ones
+  ArrayFile old_to_new;
+  ArrayFile new_to_old;
+  std::vector<uint> reordered_frontier;
+
+protected:
+  // output of getSample when it is implemented with sample
+  SampleWorkspace workspace;
+
+  /**
+   * Copy the layers of `workspace` out as vectors, for getSample
+   */
+  static std::vector<std::vector<uint>>
+  toVectors(const SampleWorkspace &workspace);
+
+  /**
+   * Number the next sample call or epoch, the call word of its draws
+   */
+  uint32_t beginCall();
+
+  /**
+   * Take back the last n calls, whose draws were dropped unused
+   */
+  void rewindCalls(uint32_t n);
+
+  /**
+   * The frontier in the ids of the graph files, the frontier itself if there
+   * is no node map; valid until the next call
+   */
+  Span<const uint> toReordered(Span<const uint> frontier);
+
+  /**
+   * Turn n nodes of the graph files back to their original ids, in place
+   */
+  void toOriginal(uint *nodes, size_t n);
+
 public:
-  SamplerBase() {}
+  /**
+   * The seed is random until setSeed is called
+   */
+  SamplerBase();
+
+  virtual ~SamplerBase() {}
 
   /**
    * Constructor for the SamplerBase class with sample size for each layer
@@ -23,12 +111,52 @@ public:
    * Set the number of neightbors to sample. The size of fanouts represent the
    * number of layers of our sample.
    */
-  void setFanouts(std::vector<uint> fanouts);
+  virtual void setFanouts(std::vector<uint> fanouts);
 
   /**
    * Get the number of neightbors to sample
    */
-  std::vector<uint> getFanouts();
+  const std::vector<uint> &getFanouts();
+
+  /**
+   * Set the seed of the neighbor selection and start counting calls from 0
+   * again, so the same seed and calls give the same samples
+   */
+  virtual void setSeed(uint64_t seed);
+
+  uint64_t getSeed();
+
+  /**
+   * Sample the neighbors of a node with replacement (the default), or
+   * without, so that a node with more neighbors than the fanout gets fanout
+   * distinct ones
+   */
+  virtual void setReplace(bool replace);
+
+  bool getReplace();
+
+  /**
+   * Sample neighbors by their edge weight instead of uniformly. The edge
+   * files given must then be the weighted ones, the alias tables of
+   * utils/alias_table.hpp. Weighted draws are always with replacement and
+   * always fanout of them, so a neighbor of weight 0 is never sampled, also
+   * for nodes with fewer neighbors than the fanout.
+   */
+  virtual void setWeighted(bool weighted);
+
+  bool getWeighted();
+
+  /**
+   * Take and give nodes by their original ids on a graph whose ids were
+   * reordered by preprocess --reorder. The maps are old_to_new.bin and
+   * new_to_old.bin of the preprocessed graph; exit if they do not match.
+   * Only sample and getSample translate: the layers hold the same nodes,
+   * but in the order of the reordered ids.
+   */
+  virtual void setNodeMap(std::string old_to_new_path,
+                          std::string new_to_old_path);
+
+  bool hasNodeMap();
 
   /**
    * Get the sample for the given frontier.
@@ -36,6 +164,16 @@ public:
    */
   virtual std::vector<std::vector<uint>>
   getSample(std::vector<uint> frontier) = 0;
+
+  /**
+   * Get the sample for the given frontier into `workspace`, one layer per
+   * fanout. Samplers override this to sample without allocating; the
+   * default goes through getSample.
+   * @param frontier: The frontier that we want to sample
+   * @param workspace: Where the layers are written, its old content is
+   * dropped
+   */
+  virtual void sample(Span<const uint> frontier, SampleWorkspace &workspace);
 };
 
-#endif // SamplerBase_HPP
\ No newline at end of file
+#endif // SamplerBase_HPP
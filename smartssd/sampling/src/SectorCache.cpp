@@ -0,0 +1,269 @@
+#include "SectorCache.hpp"
+#include "utils/metrics.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <unistd.h>
+
+static const size_t SECTOR_SIZE = 512;
+static const uint64_t NO_SECTOR = static_cast<uint64_t>(-1);
+// the longest read of the prewarm
+static const size_t MAX_RUN_SECTORS = 256;
+
+SectorCache::SectorCache(size_t budget_byte, size_t n_shards)
+    : n_shards(std::max<size_t>(1, n_shards)),
+      shards(std::max<size_t>(1, n_shards)) {
+  this->slots_per_shard = budget_byte / SECTOR_SIZE / this->n_shards;
+  size_t data_size_byte = this->n_shards * this->slots_per_shard * SECTOR_SIZE;
+  this->data = nullptr;
+  if (data_size_byte > 0) {
+    // sectors are copied to and from O_DIRECT buffers, keep them page aligned
+    this->data = static_cast<char *>(
+        aligned_alloc(4096, (data_size_byte + 4095) / 4096 * 4096));
+    if (this->data == nullptr) {
+      std::cerr << "ERR: cannot allocate " << data_size_byte
+                << " bytes for the sector cache" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  for (auto &shard : this->shards) {
+    shard.index.reserve(this->slots_per_shard);
+    shard.slot_sector.assign(this->slots_per_shard, NO_SECTOR);
+    shard.slot_referenced.assign(this->slots_per_shard, 0);
+  }
+}
+
+SectorCache::~SectorCache() { free(this->data); }
+
+inline SectorCache::Shard &SectorCache::getShard(uint64_t sector,
+                                                 size_t &shard_id) {
+  // Fibonacci hashing, so that the sectors of one neighbor list spread out
+  shard_id = ((sector * 0x9E3779B97F4A7C15ULL) >> 32) % this->n_shards;
+  return this->shards[shard_id];
+}
+
+inline char *SectorCache::getSlot(size_t shard_id, size_t slot) {
+  return this->data + (shard_id * this->slots_per_shard + slot) * SECTOR_SIZE;
+}
+
+size_t SectorCache::getCapacity() {
+  return this->n_shards * this->slots_per_shard;
+}
+
+size_t SectorCache::size() {
+  size_t n_used = 0;
+  for (auto &shard : this->shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    n_used += shard.n_used;
+  }
+  return n_used;
+}
+
+bool SectorCache::lookup(uint64_t sector) {
+  size_t shard_id;
+  Shard &shard = getShard(sector, shard_id);
+  std::lock_guard<std::mutex> guard(shard.lock);
+  shard.n_lookups++;
+  auto it = shard.index.find(sector);
+  if (it == shard.index.end()) {
+    return false;
+  }
+  shard.slot_referenced[it->second] = 1;
+  shard.n_hits++;
+  return true;
+}
+
+bool SectorCache::contains(uint64_t sector) {
+  size_t shard_id;
+  Shard &shard = getShard(sector, shard_id);
+  std::lock_guard<std::mutex> guard(shard.lock);
+  return shard.index.count(sector) > 0;
+}
+
+bool SectorCache::copyTo(uint64_t sector, void *dst) {
+  size_t shard_id;
+  Shard &shard = getShard(sector, shard_id);
+  std::lock_guard<std::mutex> guard(shard.lock);
+  auto it = shard.index.find(sector);
+  if (it == shard.index.end()) {
+    return false;
+  }
+  memcpy(dst, getSlot(shard_id, it->second), SECTOR_SIZE);
+  return true;
+}
+
+void SectorCache::insert(uint64_t sector, const void *src) {
+  if (this->slots_per_shard == 0) {
+    return;
+  }
+  size_t shard_id;
+  Shard &shard = getShard(sector, shard_id);
+  std::lock_guard<std::mutex> guard(shard.lock);
+  if (shard.index.count(sector)) {
+    return;
+  }
+  size_t slot;
+  if (shard.n_used < this->slots_per_shard) {
+    slot = shard.n_used++;
+  } else {
+    // give every referenced slot a second chance, this ends within one
+    // round because the hand clears the bits it passes
+    while (shard.slot_referenced[shard.clock_hand]) {
+      shard.slot_referenced[shard.clock_hand] = 0;
+      shard.clock_hand = (shard.clock_hand + 1) % this->slots_per_shard;
+    }
+    slot = shard.clock_hand;
+    shard.clock_hand = (shard.clock_hand + 1) % this->slots_per_shard;
+    shard.index.erase(shard.slot_sector[slot]);
+  }
+  memcpy(getSlot(shard_id, slot), src, SECTOR_SIZE);
+  shard.slot_sector[slot] = sector;
+  shard.slot_referenced[slot] = 0;
+  shard.index[sector] = slot;
+}
+
+size_t SectorCache::prewarm(int edge_file_handler, const ArrayFile &offsets,
+                            size_t edge_size_byte) {
+  METRICS_TIME(PREWARM_SECONDS);
+  if (offsets.size() < 2 || getCapacity() == 0) {
+    return 0;
+  }
+  size_t n_nodes = offsets.size() - 1;
+  uint64_t edges_per_sector = SECTOR_SIZE / edge_size_byte;
+  auto first_sector = [&](size_t node) {
+    return (uint64_t)offsets[node] / edges_per_sector;
+  };
+  auto n_node_sectors = [&](size_t node) -> uint64_t {
+    if (offsets[node + 1] == offsets[node]) {
+      return 0;
+    }
+    return (offsets[node + 1] - 1) / edges_per_sector - first_sector(node) + 1;
+  };
+
+  // the sectors of all nodes of each degree, to find the lowest degree that
+  // still fits without sorting the nodes
+  uint64_t max_degree = 0;
+  for (size_t i = 0; i < n_nodes; i++) {
+    max_degree = std::max<uint64_t>(max_degree, offsets[i + 1] - offsets[i]);
+  }
+  std::vector<uint64_t> degree_sectors(max_degree + 1, 0);
+  for (size_t i = 0; i < n_nodes; i++) {
+    degree_sectors[offsets[i + 1] - offsets[i]] += n_node_sectors(i);
+  }
+  uint64_t min_degree = max_degree + 1;
+  uint64_t n_sectors = 0;
+  while (min_degree > 1 &&
+         n_sectors + degree_sectors[min_degree - 1] <= getCapacity()) {
+    min_degree--;
+    n_sectors += degree_sectors[min_degree];
+  }
+  // some nodes of the next degree fit too
+  uint64_t partial_degree = min_degree - 1;
+  uint64_t partial_budget = getCapacity() - n_sectors;
+
+  std::vector<uint64_t> sectors;
+  std::vector<size_t> nodes;
+  for (size_t i = 0; i < n_nodes; i++) {
+    uint64_t degree = offsets[i + 1] - offsets[i];
+    uint64_t n = n_node_sectors(i);
+    if (degree == 0) {
+      continue;
+    }
+    if (degree == partial_degree && n <= partial_budget) {
+      partial_budget -= n;
+    } else if (degree < min_degree) {
+      continue;
+    }
+    for (uint64_t s = 0; s < n; s++) {
+      sectors.push_back(first_sector(i) + s);
+    }
+    nodes.push_back(i);
+  }
+  std::sort(sectors.begin(), sectors.end());
+  sectors.erase(std::unique(sectors.begin(), sectors.end()), sectors.end());
+
+  // read back to back sectors together
+  std::vector<size_t> run_begin;
+  for (size_t k = 0; k < sectors.size(); k++) {
+    if (k == 0 || sectors[k] != sectors[k - 1] + 1 ||
+        k - run_begin.back() == MAX_RUN_SECTORS) {
+      run_begin.push_back(k);
+    }
+  }
+  run_begin.push_back(sectors.size());
+
+  bool failed = false;
+#pragma omp parallel
+  {
+    char *buffer = static_cast<char *>(
+        aligned_alloc(4096, MAX_RUN_SECTORS * SECTOR_SIZE));
+#pragma omp for schedule(dynamic, 16)
+    for (size_t r = 0; r < run_begin.size() - 1; r++) {
+      size_t length =
+          (run_begin[r + 1] - run_begin[r]) * SECTOR_SIZE;
+      // O_DIRECT needs whole pages
+      size_t read_length = (length + 4095) / 4096 * 4096;
+      ssize_t re = pread(edge_file_handler, buffer, read_length,
+                         sectors[run_begin[r]] * SECTOR_SIZE);
+      if (re < (ssize_t)length) {
+#pragma omp critical
+        failed = true;
+        continue;
+      }
+      for (size_t k = run_begin[r]; k < run_begin[r + 1]; k++) {
+        insert(sectors[k], buffer + (k - run_begin[r]) * SECTOR_SIZE);
+      }
+    }
+    free(buffer);
+  }
+  if (failed) {
+    std::cerr << "ERR: reading the edge file for the sector cache failed: "
+              << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // the budget is for the whole cache, but the sectors are spread over the
+  // shards unevenly, so a full shard may have evicted some of them again
+  size_t n_cached_nodes = 0;
+  for (size_t node : nodes) {
+    bool cached = true;
+    for (uint64_t s = 0; cached && s < n_node_sectors(node); s++) {
+      cached = contains(first_sector(node) + s);
+    }
+    n_cached_nodes += cached;
+  }
+  return n_cached_nodes;
+}
+
+double SectorCache::getHitRate() {
+  size_t n_lookups = getNumLookups();
+  return n_lookups == 0 ? 0 : (double)getNumHits() / n_lookups;
+}
+
+size_t SectorCache::getNumHits() {
+  size_t n_hits = 0;
+  for (auto &shard : this->shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    n_hits += shard.n_hits;
+  }
+  return n_hits;
+}
+
+size_t SectorCache::getNumLookups() {
+  size_t n_lookups = 0;
+  for (auto &shard : this->shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    n_lookups += shard.n_lookups;
+  }
+  return n_lookups;
+}
+
+void SectorCache::resetStats() {
+  for (auto &shard : this->shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.n_hits = 0;
+    shard.n_lookups = 0;
+  }
+}
@@ -0,0 +1,135 @@
+/**
+ * This file defines a host memory cache of 512 byte edge file sectors for the
+ * random read sampler. A few hub nodes account for most sampled edges, so
+ * keeping their sectors in DRAM takes a large share of the reads off the SSD.
+ *
+ * The cache is split into shards by sector, each with its own lock, index and
+ * CLOCK hand, so threads of different devices rarely wait on each other.
+ */
+#ifndef SECTOR_CACHE_HPP
+#define SECTOR_CACHE_HPP
+
+#include "utils/array_file.hpp"
+#include <cstdint>
+#include <mutex>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+class SectorCache {
+private:
+  struct Shard {
+    std::mutex lock;
+    // sector -> slot in this shard
+    std::unordered_map<uint64_t, uint32_t> index;
+    // sector held by each slot, -1 when the slot is free
+    std::vector<uint64_t> slot_sector;
+    // CLOCK reference bit of each slot
+    std::vector<uint8_t> slot_referenced;
+    size_t clock_hand = 0;
+    size_t n_used = 0;
+    size_t n_hits = 0;
+    size_t n_lookups = 0;
+  };
+
+  size_t n_shards;
+  size_t slots_per_shard;
+  std::vector<Shard> shards;
+  // all the slots, shard s owns slots [s * slots_per_shard,
+  // (s + 1) * slots_per_shard)
+  char *data;
+
+  /**
+   * The shard a sector belongs to, neighbouring sectors go to different
+   * shards
+   */
+  inline Shard &getShard(uint64_t sector, size_t &shard_id);
+
+  /**
+   * The memory of a slot of a shard
+   */
+  inline char *getSlot(size_t shard_id, size_t slot);
+
+  /**
+   * Whether a sector is cached, without counting an access
+   */
+  bool contains(uint64_t sector);
+
+public:
+  /**
+   * @param budget_byte: Host memory for the cached sectors, rounded down to
+   * whole sectors per shard
+   * @param n_shards: The number of independently locked shards
+   */
+  SectorCache(size_t budget_byte, size_t n_shards = 64);
+
+  ~SectorCache();
+
+  SectorCache(const SectorCache &) = delete;
+  SectorCache &operator=(const SectorCache &) = delete;
+
+  /**
+   * Number of sectors the cache can hold
+   */
+  size_t getCapacity();
+
+  /**
+   * Number of sectors the cache holds
+   */
+  size_t size();
+
+  /**
+   * Record an access to a sector and mark it recently used.
+   * @return true if the sector is cached
+   */
+  bool lookup(uint64_t sector);
+
+  /**
+   * Copy a cached sector to dst without counting an access.
+   * @return false if the sector is not, or no longer, cached
+   */
+  bool copyTo(uint64_t sector, void *dst);
+
+  /**
+   * Cache a sector, evicting the first slot of its shard the CLOCK hand finds
+   * unreferenced if the shard is full
+   */
+  void insert(uint64_t sector, const void *src);
+
+  /**
+   * Fill the cache with the sectors of the highest degree nodes, read from
+   * the edge file. Of the lowest degree taken, nodes are added in id order
+   * while they fit.
+   * @param edge_file_handler: The edge file, may be opened with O_DIRECT
+   * @param offsets: The offset of the first edge of every node
+   * @param edge_size_byte: The size of an edge in the file, 16 for the
+   * alias entries of a weighted edge file
+   * @return The number of nodes whose sectors are all cached afterwards.
+   * The sectors of a full shard evict each other, so this can be fewer than
+   * the nodes read.
+   */
+  size_t prewarm(int edge_file_handler, const ArrayFile &offsets,
+                 size_t edge_size_byte = 4);
+
+  /**
+   * Fraction of the accesses so far that hit the cache
+   */
+  double getHitRate();
+
+  /**
+   * Number of accesses so far that hit the cache
+   */
+  size_t getNumHits();
+
+  /**
+   * Number of accesses so far
+   */
+  size_t getNumLookups();
+
+  /**
+   * Reset the hit and access counters
+   */
+  void resetStats();
+};
+
+#endif // SECTOR_CACHE_HPP
@@ -1,4 +1,5 @@
 #include "SmartSSDBase.hpp"
+#include <cstdlib>
 
 SmartSSDBase::SmartSSDBase() {}
 
@@ -32,7 +33,7 @@ void SmartSSDBase::loadXrtDevice(std::vector<uint> xrt_device_id) {
   }
 }
 
-std::vector<xrt::device> SmartSSDBase::getXrtDevice() {
+const std::vector<xrt::device> &SmartSSDBase::getXrtDevice() {
   return this->xrt_device;
 }
 
@@ -43,7 +44,9 @@ void SmartSSDBase::loadXrtUUID(std::string xclbin_file) {
   }
 }
 
-std::vector<xrt::uuid> SmartSSDBase::getXrtUUID() { return this->xrt_uuid; }
+const std::vector<xrt::uuid> &SmartSSDBase::getXrtUUID() {
+  return this->xrt_uuid;
+}
 
 void SmartSSDBase::loadXrtKernel(std::string kernel_name) {
   for (size_t i = 0; i < this->xrt_device.size(); i++) {
@@ -53,6 +56,15 @@ void SmartSSDBase::loadXrtKernel(std::string kernel_name) {
   }
 }
 
-std::vector<xrt::kernel> SmartSSDBase::getXrtKernel() {
+const std::vector<xrt::kernel> &SmartSSDBase::getXrtKernel() {
   return this->xrt_kernel;
 }
+
+
+bool SmartSSDBase::isP2PEnabled() {
+  return std::getenv("XCL_EMULATION_MODE") == nullptr;
+}
+
+xrt::bo::flags SmartSSDBase::getP2PFlags() {
+  return this->isP2PEnabled() ? xrt::bo::flags::p2p : xrt::bo::flags::normal;
+}
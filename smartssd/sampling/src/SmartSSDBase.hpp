@@ -49,7 +49,7 @@ public:
   /**
    * Get all the XRT device that are loaded
    */
-  std::vector<xrt::device> getXrtDevice();
+  const std::vector<xrt::device> &getXrtDevice();
 
   /**
    * Load the XRT UUID to match an expected xclbin
@@ -59,7 +59,7 @@ public:
   /**
    * Get the XRT UUID vector
    */
-  std::vector<xrt::uuid> getXrtUUID();
+  const std::vector<xrt::uuid> &getXrtUUID();
 
   /**
    * Load the XRT kernel
@@ -69,7 +69,19 @@ public:
   /**
    * Get the kernel name
    */
-  std::vector<xrt::kernel> getXrtKernel();
+  const std::vector<xrt::kernel> &getXrtKernel();
+
+  /**
+   * Whether the SSD can DMA directly into device buffers. P2P is not
+   * available when running under XRT emulation (XCL_EMULATION_MODE is set).
+   */
+  bool isP2PEnabled();
+
+  /**
+   * Get the flags for buffers that are filled straight from the SSD. Falls
+   * back to normal buffers under emulation, which then need an explicit sync.
+   */
+  xrt::bo::flags getP2PFlags();
 };
 
 #endif // SmartSSD_Base_HPP
\ No newline at end of file
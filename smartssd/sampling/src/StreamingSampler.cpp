@@ -1,8 +1,18 @@
 #include "StreamingSampler.hpp"
+#include "utils/alias_table.hpp"
+#include "utils/array_file.hpp"
+#include "utils/metrics.hpp"
 #include "utils/timer.hpp"
+#include <algorithm>
 #include <fcntl.h>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <omp.h>
+#include <thread>
+#include <iostream>
 #include <sys/stat.h>
+#include <unistd.h>
 
 StreamingSampler::StreamingSampler(
     std::vector<uint> xrt_device_id, std::string xclbin_file,
@@ -11,18 +21,25 @@ StreamingSampler::StreamingSampler(
     std::vector<uint> fanouts, size_t edge_chunk_size)
     : SmartSSDBase(xrt_device_id, xclbin_file, kernel_name),
       SamplerBase(fanouts) {
+  METRICS_TIME(SETUP_SECONDS);
   openEdgeFile(edge_file_path);
   loadChunkInfo(chunk_info_file_path);
   loadTargetNodes(target_node_file_path);
+  this->frontier_partitioner = FrontierPartitioner(this->chunk_offsets);
   setEdgeChunkSize(edge_chunk_size);
-  setMaxSampleSizePerChunk(460000000);
-  setMaxTargetSize(46000000);
+  if (this->compressed_edges &&
+      this->compressed_raw_chunk_size_byte > edge_chunk_size * sizeof(int)) {
+    std::cerr << "ERR: the edge file has chunks of "
+              << this->compressed_raw_chunk_size_byte
+              << " bytes, more than the edge chunk size" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  loadChunkIndex(chunk_info_file_path);
   allocateBufferObject();
-  current_bo_index = 1;
-  this->sample_result.push_back(std::vector<std::vector<uint>>());
-  this->sample_result.push_back(std::vector<std::vector<uint>>());
-  this->sample_result_size.push_back(std::vector<std::vector<uint>>());
-  this->sample_result_size.push_back(std::vector<std::vector<uint>>());
+  loadChunkHeaders();
+  setupReadEngine();
+  batch_size = 1000;
+  setFusedEpochs(1);
 }
 
 int StreamingSampler::openEdgeFile(std::string edge_file_path) {
@@ -37,75 +54,186 @@ int StreamingSampler::openEdgeFile(std::string edge_file_path) {
     return -1;
   }
   this->edge_file_size_byte = statbuf.st_size;
+  this->compressed_edges = loadCompressedFileHeader();
   return 0;
 }
 
+bool StreamingSampler::loadCompressedFileHeader() {
+  const size_t PAGE = EdgeCodec::PAGE_SIZE;
+  if (this->edge_file_size_byte < (off_t)PAGE) {
+    return false;
+  }
+  // O_DIRECT needs an aligned buffer
+  char *buffer = static_cast<char *>(aligned_alloc(PAGE, PAGE));
+  ssize_t re = pread(this->edge_file_handler, buffer, PAGE, 0);
+  uint32_t magic, n_chunks;
+  memcpy(&magic, buffer, 4);
+  memcpy(&n_chunks, buffer + 4, 4);
+  if (re < (ssize_t)PAGE || magic != EdgeCodec::FILE_MAGIC) {
+    free(buffer);
+    return false;
+  }
+  size_t header_size_byte = EdgeCodec::fileHeaderSize(n_chunks);
+  free(buffer);
+  buffer = static_cast<char *>(aligned_alloc(PAGE, header_size_byte));
+  re = pread(this->edge_file_handler, buffer, header_size_byte, 0);
+  if (re < (ssize_t)header_size_byte) {
+    std::cerr << "ERR: reading the header of the compressed edge file failed"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  uint64_t raw_chunk_size_byte;
+  memcpy(&raw_chunk_size_byte, buffer + 8, 8);
+  this->compressed_raw_chunk_size_byte = raw_chunk_size_byte;
+  this->chunk_file_pos.resize((size_t)n_chunks + 1);
+  memcpy(this->chunk_file_pos.data(), buffer + 16,
+         ((size_t)n_chunks + 1) * 8);
+  free(buffer);
+  return true;
+}
+
 off_t StreamingSampler::getEdgeFileSizeByte() {
   return this->edge_file_size_byte;
 }
 
 int StreamingSampler::loadChunkInfo(std::string chunk_info_file_path) {
-  std::ifstream chunk_info_file(chunk_info_file_path);
-  int32_t buffer;
-  while (chunk_info_file.read(reinterpret_cast<char *>(&buffer),
-                               sizeof(buffer))) {
-    this->chunk_offsets.push_back(buffer);
+  ArrayFile chunk_info(chunk_info_file_path, 4);
+  Span<const uint> chunk_ends = chunk_info.view<uint>();
+  if (chunk_ends.size() != chunk_info.size()) {
+    std::cerr << "ERR: " << chunk_info_file_path
+              << " has to hold 4 byte node ids" << std::endl;
+    exit(EXIT_FAILURE);
   }
-  chunk_info_file.close();
+  this->chunk_offsets.assign(chunk_ends.begin(), chunk_ends.end());
   return 0;
 }
 
 int StreamingSampler::loadTargetNodes(std::string target_node_file_path) {
-  std::ifstream target_node_file(target_node_file_path);
-  int32_t buffer;
-  while (target_node_file.read(reinterpret_cast<char *>(&buffer),
-                               sizeof(buffer))) {
-    this->target_nodes.push_back(buffer);
+  ArrayFile target_node_file(target_node_file_path, 4);
+  Span<const uint> nodes = target_node_file.view<uint>();
+  if (nodes.size() != target_node_file.size()) {
+    std::cerr << "ERR: " << target_node_file_path
+              << " has to hold 4 byte node ids" << std::endl;
+    exit(EXIT_FAILURE);
   }
-  target_node_file.close();
+  this->target_nodes.assign(nodes.begin(), nodes.end());
   sort(target_nodes.begin(), target_nodes.end());
   return 0;
 }
 
 int StreamingSampler::getEdgeFileHandler() { return this->edge_file_handler; }
 
-std::vector<uint> StreamingSampler::getChunkOffsets() {
+const std::vector<uint> &StreamingSampler::getChunkOffsets() {
   return this->chunk_offsets;
 }
 
-std::vector<uint> StreamingSampler::getTargetNodes() {
+const std::vector<uint> &StreamingSampler::getTargetNodes() {
   return this->target_nodes;
 }
 
-void StreamingSampler::setMaxSampleSizePerChunk(
-    size_t max_sample_size_per_chunk) {
-  this->max_sample_size_per_chunk = max_sample_size_per_chunk;
-}
-
 size_t StreamingSampler::getMaxSampleSizePerChunk() {
   return this->max_sample_size_per_chunk;
 }
 
-void StreamingSampler::setMaxTargetSize(size_t max_target_size) {
-  this->max_target_size = max_target_size;
+size_t StreamingSampler::getMaxTargetSize() { return this->max_target_size; }
+
+void StreamingSampler::setDeviceMemory(size_t device_memory_byte) {
+  discardPendingEpochs();
+  this->device_memory_byte = device_memory_byte;
+  allocateTargetBuffers();
 }
 
-size_t StreamingSampler::getMaxTargetSize() { return this->max_target_size; }
+size_t StreamingSampler::getDeviceMemory() { return this->device_memory_byte; }
+
+size_t StreamingSampler::getNumSpannedNodes() {
+  return this->spanned_nodes.size();
+}
 
 void StreamingSampler::setEdgeChunkSize(size_t edge_chunk_size) {
+  discardPendingEpochs();
   this->edge_chunk_size = edge_chunk_size;
 }
 
 size_t StreamingSampler::getEdgeChunkSize() { return this->edge_chunk_size; }
 
+void StreamingSampler::setSelectiveReadDensity(double density) {
+  discardPendingEpochs();
+  this->selective_read_density = density;
+}
+
+double StreamingSampler::getSelectiveReadDensity() {
+  return this->selective_read_density;
+}
+
+size_t StreamingSampler::getEdgeBytesRead() { return this->edge_bytes_read; }
+
+float StreamingSampler::getFpgaTime() { return this->fpga_time; }
+
+float StreamingSampler::getTransferTime() { return this->transfer_time; }
+
+void StreamingSampler::setBatchSize(size_t batch_size) {
+  discardPendingEpochs();
+  this->batch_size = batch_size;
+}
+
+size_t StreamingSampler::getBatchSize() { return this->batch_size; }
+
+void StreamingSampler::loadChunkIndex(std::string chunk_info_file_path) {
+  if (this->compressed_edges) {
+    return;
+  }
+  // chunk_info.bin -> chunk_index.bin, and the same for the weighted files
+  std::string chunk_index_path = chunk_info_file_path;
+  size_t name_pos = chunk_index_path.rfind("chunk_info");
+  struct stat statbuf;
+  if (name_pos != std::string::npos) {
+    chunk_index_path.replace(name_pos, 10, "chunk_index");
+  }
+  if (name_pos == std::string::npos ||
+      stat(chunk_index_path.c_str(), &statbuf) != 0) {
+    // raw chunks without an index are laid out at a fixed stride
+    size_t stride = this->edge_chunk_size * sizeof(int);
+    this->chunk_file_pos.clear();
+    for (size_t pos = 0; pos < (size_t)this->edge_file_size_byte;
+         pos += stride) {
+      this->chunk_file_pos.push_back(pos);
+    }
+    this->chunk_file_pos.push_back(this->edge_file_size_byte);
+    return;
+  }
+
+  ArrayFile chunk_index(chunk_index_path, 8);
+  Span<const uint64_t> positions = chunk_index.view<uint64_t>();
+  if (positions.size() != chunk_index.size() ||
+      positions.size() != this->chunk_offsets.size() + 1 ||
+      positions[positions.size() - 1] > (uint64_t)this->edge_file_size_byte) {
+    std::cerr << "ERR: " << chunk_index_path
+              << " does not fit the chunk info and the edge file" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  this->chunk_file_pos.assign(positions.begin(), positions.end());
+  size_t max_chunk_size_byte = 0;
+  for (size_t chunk = 0; chunk + 1 < this->chunk_file_pos.size(); chunk++) {
+    // O_DIRECT reads start on a sector
+    if (this->chunk_file_pos[chunk + 1] < this->chunk_file_pos[chunk] ||
+        this->chunk_file_pos[chunk] % 512 != 0) {
+      std::cerr << "ERR: chunk " << chunk << " of " << chunk_index_path
+                << " is not at a sector after the chunk before it"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    max_chunk_size_byte =
+        std::max<size_t>(max_chunk_size_byte, getChunkStoredSize(chunk));
+  }
+  // the edge buffers hold the largest chunk in whole pages
+  this->edge_chunk_size =
+      (max_chunk_size_byte + 4095) / 4096 * 4096 / sizeof(int);
+}
+
 void StreamingSampler::allocateBufferObject() {
-  // calculate the size of the input and output buffer
+  // the edge buffers hold a chunk, the last one might be smaller
   this->input_size_byte = this->edge_chunk_size * sizeof(int);
-  size_t output_size_byte = this->max_sample_size_per_chunk * sizeof(int);
-  size_t target_size_byte = this->max_target_size * sizeof(int);
-
-  // Allocate Memory for Each SmartSSD device
-  xrt::bo::flags flags = xrt::bo::flags::p2p;
+  xrt::bo::flags flags = this->getP2PFlags();
   for (size_t i = 0; i < this->getXrtDevice().size(); i++) {
     auto device = this->getXrtDevice()[i];
     auto krnl = this->getXrtKernel()[i];
@@ -113,152 +241,718 @@ void StreamingSampler::allocateBufferObject() {
         xrt::bo(device, this->input_size_byte, flags, krnl.group_id(0)),
         xrt::bo(device, this->input_size_byte, flags, krnl.group_id(0)),
     });
+    bo_edge_map.push_back(
+        {bo_edge[i][0].map<uint *>(), bo_edge[i][1].map<uint *>()});
+  }
+  allocateTargetBuffers();
+}
+
+void StreamingSampler::allocateTargetBuffers() {
+  const std::vector<uint> &fanouts = this->getFanouts();
+  size_t max_fanout = std::max<size_t>(
+      1, fanouts.empty() ? 1 : *std::max_element(fanouts.begin(),
+                                                 fanouts.end()));
+  // two slots of a target and max_fanout results for every target
+  size_t min_size_byte = 2 * this->input_size_byte +
+                         2 * 4096 * (1 + max_fanout) * sizeof(int);
+  if (this->device_memory_byte < min_size_byte) {
+    std::cerr << "ERR: " << this->device_memory_byte
+              << " bytes of device memory do not hold the buffers, at least "
+              << min_size_byte << " are needed" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  size_t n_targets = (this->device_memory_byte - 2 * this->input_size_byte) /
+                     sizeof(int) / (1 + max_fanout);
+  this->max_target_size = n_targets;
+  this->max_sample_size_per_chunk = n_targets * max_fanout;
+  size_t output_size_byte = this->max_sample_size_per_chunk * sizeof(int);
+  size_t target_size_byte = this->max_target_size * sizeof(int);
+  // the result and target buffers are split in half for the two slots,
+  // sub-buffers have to start on a 4K boundary
+  size_t output_slot_size_byte = output_size_byte / 2 / 4096 * 4096;
+  size_t target_slot_size_byte = target_size_byte / 2 / 4096 * 4096;
+
+  this->bo_sample_result.clear();
+  this->bo_target_nodes.clear();
+  this->bo_sample_result_slot.clear();
+  this->bo_target_nodes_slot.clear();
+  this->bo_sample_result_map.clear();
+  this->bo_target_nodes_map.clear();
+  for (size_t i = 0; i < this->getXrtDevice().size(); i++) {
+    auto device = this->getXrtDevice()[i];
+    auto krnl = this->getXrtKernel()[i];
     bo_sample_result.push_back(
         xrt::bo(device, output_size_byte, krnl.group_id(1)));
     bo_target_nodes.push_back(
         xrt::bo(device, target_size_byte, krnl.group_id(2)));
+    bo_sample_result_slot.push_back({
+        xrt::bo(bo_sample_result[i], output_slot_size_byte, 0),
+        xrt::bo(bo_sample_result[i], output_slot_size_byte,
+                output_slot_size_byte),
+    });
+    bo_target_nodes_slot.push_back({
+        xrt::bo(bo_target_nodes[i], target_slot_size_byte, 0),
+        xrt::bo(bo_target_nodes[i], target_slot_size_byte,
+                target_slot_size_byte),
+    });
+    bo_sample_result_map.push_back({bo_sample_result_slot[i][0].map<uint *>(),
+                                    bo_sample_result_slot[i][1].map<uint *>()});
+    bo_target_nodes_map.push_back({bo_target_nodes_slot[i][0].map<uint *>(),
+                                   bo_target_nodes_slot[i][1].map<uint *>()});
   }
+}
 
-  // Map Global Memory Buffer to Host Pointer
-  for (size_t i = 0; i < this->getXrtDevice().size(); i++) {
-    bo_edge_map.push_back(
-        {bo_edge[i][0].map<uint *>(), bo_edge[i][1].map<uint *>()});
-    bo_sample_result_map.push_back(bo_sample_result[i].map<uint *>());
-    bo_target_nodes_map.push_back(bo_target_nodes[i].map<uint *>());
+size_t StreamingSampler::getSlotTargets(int n_neighbors) {
+  return std::min(bo_target_nodes_slot[0][0].size() / sizeof(int),
+                  bo_sample_result_slot[0][0].size() / sizeof(int) /
+                      std::max(n_neighbors, 1));
+}
+
+void StreamingSampler::loadChunkHeaders() {
+  size_t n_chunks = this->chunk_file_pos.size() - 1;
+  // O_DIRECT needs an aligned buffer
+  uint *buffer =
+      static_cast<uint *>(aligned_alloc(4096, this->input_size_byte));
+  this->chunk_header_pos.assign(1, 0);
+  this->chunk_headers.clear();
+  for (size_t chunk = 0; chunk < n_chunks; chunk++) {
+    // a compressed chunk starts with the header of the raw chunk too
+    size_t chunk_size_byte = std::min<size_t>(this->input_size_byte,
+                                              getChunkStoredSize(chunk));
+    // the first page tells how long the header is
+    size_t read_size_byte = std::min<size_t>(4096, chunk_size_byte);
+    ssize_t re = pread(this->edge_file_handler, buffer, read_size_byte,
+                       this->chunk_file_pos[chunk]);
+    size_t header_size_byte = re >= 8 ? ((size_t)buffer[0] + 3) * 4 : 0;
+    if (re < 8 || header_size_byte > chunk_size_byte) {
+      std::cerr << "ERR: chunk " << chunk << " has no valid header"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (header_size_byte > read_size_byte) {
+      read_size_byte =
+          std::min((header_size_byte + 511) / 512 * 512, chunk_size_byte);
+      re = pread(this->edge_file_handler, buffer, read_size_byte,
+                 this->chunk_file_pos[chunk]);
+      if (re < (ssize_t)header_size_byte) {
+        std::cerr << "ERR: reading the header of chunk " << chunk
+                  << " failed: " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    this->chunk_headers.insert(this->chunk_headers.end(), buffer,
+                               buffer + header_size_byte / 4);
+    this->chunk_header_pos.push_back(this->chunk_headers.size());
+  }
+  free(buffer);
+
+  // a chunk that starts before the end of the chunk before it goes on with
+  // the last node of that chunk
+  this->spanned_nodes.clear();
+  for (size_t chunk = 1; chunk < n_chunks; chunk++) {
+    uint start_node = getChunkHeader(chunk)[1];
+    if (chunk > this->chunk_offsets.size() ||
+        start_node >= this->chunk_offsets[chunk - 1]) {
+      continue;
+    }
+    if (!this->spanned_nodes.empty() &&
+        this->spanned_nodes.back().node == start_node &&
+        this->spanned_nodes.back().last_chunk == chunk - 1) {
+      this->spanned_nodes.back().last_chunk = chunk;
+    } else {
+      this->spanned_nodes.push_back({start_node, chunk - 1, chunk});
+    }
   }
 }
 
-std::vector<std::vector<uint>>
-StreamingSampler::splitFrontier(std::vector<uint> &frontier) {
-  // std::cout << "Splitting frontier..., frontier size " << frontier.size()
-  //           << "Last frontier" << frontier[frontier.size() - 1] << std::endl;
-  std::vector<std::vector<uint>> result;
-  uint cur_chunk = 0;
-  // int cur_chunk_start = 0;
-  uint cur_chunk_end = this->chunk_offsets[cur_chunk];
-  // std::cout << "this->chunk_offsets.size(): " << this->chunk_offsets.size()
-  //           << std::endl;
-  // std::cout << "cur_chunk_end: " << cur_chunk_end << std::endl;
-  std::vector<uint> cur_chunk_nodes;
-  // uint pre_node = -1;
-  for (size_t i = 0; i < frontier.size(); i++) {
-    if (frontier[i] >= cur_chunk_end) {
-      result.push_back(cur_chunk_nodes);
-      cur_chunk_nodes.clear();
-      cur_chunk += 1;
-      // cur_chunk_start = cur_chunk_end;
-      cur_chunk_end = this->chunk_offsets[cur_chunk];
-    }
-    // if (frontier[i] == pre_node) {
-    //   continue;
-    // }
-    cur_chunk_nodes.push_back(frontier[i]);
-    // pre_node = frontier[i];
-  }
-  result.push_back(cur_chunk_nodes);
-  // std::cout << "Splitting frontier done, number of chunks: " << result.size()
-  //           << std::endl;
-  return result;
+const uint *StreamingSampler::getChunkHeader(size_t chunk) {
+  return this->chunk_headers.data() + this->chunk_header_pos[chunk];
 }
 
-std::vector<uint> StreamingSampler::sampleOneLayer(
-    std::vector<std::vector<uint>> splitted_frontier, int n_neighbors) {
-  EasyTimer timer("Total time for Sample one layer");
-  std::cout << "Begin sample one layer, n_neighbors: " << n_neighbors
-            << ", number of chunks: " << splitted_frontier.size() << std::endl;
-  std::vector<uint> result;
-  float fpga_time = 0;
-  float data_transfer_time = 0;
-  for (size_t i = 0; i < splitted_frontier.size(); i += 1) {
-    std::cout << "Processing chunk " << i
-              << ", chunk frontier size: " << splitted_frontier[i].size()
+void StreamingSampler::setupReadEngine() {
+  // one engine per buffer slot, registered on the edge buffer of that slot
+  for (size_t i = 0; i < this->bo_edge_map.size(); i++) {
+    this->chunk_reader.push_back(
+        std::vector<std::unique_ptr<UringReader>>());
+    for (size_t slot = 0; slot < this->bo_edge_map[i].size(); slot++) {
+      this->chunk_reader[i].push_back(std::unique_ptr<UringReader>(
+          new UringReader(this->edge_file_handler)));
+      this->chunk_reader[i][slot]->setBuffer(this->bo_edge_map[i][slot],
+                                             this->input_size_byte);
+    }
+  }
+  this->chunk_read_requests.resize(this->bo_edge_map.size());
+  this->read_page_ranges.resize(this->bo_edge_map.size());
+  this->cur_pieces.resize(this->bo_edge_map.size());
+  this->next_pieces.resize(this->bo_edge_map.size());
+  this->device_fpga_time.resize(this->bo_edge_map.size());
+  this->device_transfer_time.resize(this->bo_edge_map.size());
+  this->workers.reserve(this->bo_edge_map.size());
+
+  if (this->compressed_edges) {
+    size_t max_stored_size_byte = 0;
+    for (size_t chunk = 0; chunk < this->chunk_file_pos.size() - 1; chunk++) {
+      max_stored_size_byte =
+          std::max(max_stored_size_byte, getChunkStoredSize(chunk));
+    }
+    for (size_t i = 0; i < this->bo_edge_map.size(); i++) {
+      this->compressed_buffer.push_back(std::vector<uint8_t *>());
+      for (size_t slot = 0; slot < this->bo_edge_map[i].size(); slot++) {
+        this->compressed_buffer[i].push_back(static_cast<uint8_t *>(
+            aligned_alloc(4096, (max_stored_size_byte + 4095) / 4096 * 4096)));
+      }
+    }
+  }
+}
+
+bool StreamingSampler::isCompressed() { return this->compressed_edges; }
+
+void StreamingSampler::setWeighted(bool weighted) {
+  if (weighted && this->compressed_edges) {
+    std::cerr << "ERR: weighted sampling needs the uncompressed "
+                 "weighted_streaming_edges.bin"
               << std::endl;
-    size_t this_read_size_byte;
-    // the last chunk might be smaller than chunk size
-    if (i == splitted_frontier.size() - 1) {
-      // only read the remaining size
-      this_read_size_byte = edge_file_size_byte - i * this->input_size_byte;
-    } else {
-      // read whole chunk
-      this_read_size_byte = this->input_size_byte;
+    exit(EXIT_FAILURE);
+  }
+  discardPendingEpochs();
+  SamplerBase::setWeighted(weighted);
+  if (!this->layer_budgets.empty()) {
+    // the degrees are counted in entries of the edge file
+    loadNodeImportance();
+  }
+}
+
+void StreamingSampler::loadNodeImportance() {
+  size_t edge_ints = getWeighted() ? AliasTable::ENTRY_INTS : 1;
+  this->node_importance.assign(
+      this->chunk_offsets.empty() ? 0 : this->chunk_offsets.back(), 1);
+  for (size_t chunk = 0; chunk + 1 < this->chunk_header_pos.size(); chunk++) {
+    const uint *header = getChunkHeader(chunk);
+    const uint *offsets = header + 2;
+    for (size_t j = 0; j < header[0]; j++) {
+      this->node_importance[header[1] + j] +=
+          (offsets[j + 1] - offsets[j]) / edge_ints;
+    }
+  }
+}
+
+void StreamingSampler::setLayerBudgets(std::vector<uint> budgets) {
+  if (!budgets.empty() && budgets.size() != this->getFanouts().size()) {
+    std::cerr << "ERR: " << budgets.size() << " layer budgets for "
+              << this->getFanouts().size() << " layers" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (std::find(budgets.begin(), budgets.end(), 0) != budgets.end()) {
+    std::cerr << "ERR: a layer budget of 0 samples nothing" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  discardPendingEpochs();
+  this->layer_budgets = budgets;
+  if (budgets.empty()) {
+    std::vector<float>().swap(this->node_importance);
+  } else {
+    loadNodeImportance();
+  }
+}
+
+const std::vector<uint> &StreamingSampler::getLayerBudgets() {
+  return this->layer_budgets;
+}
+
+size_t StreamingSampler::getChunkStoredSize(size_t chunk) {
+  return this->chunk_file_pos[chunk + 1] - this->chunk_file_pos[chunk];
+}
+
+bool StreamingSampler::planSelectiveRead(
+    size_t device, size_t chunk, Span<const uint> chunk_frontier,
+    size_t chunk_size_byte, std::vector<UringReader::ReadRequest> &requests) {
+  const size_t PAGE = 4096;
+  // the neighbor lists of a compressed chunk are not where the offsets say
+  if (this->selective_read_density <= 0 || this->compressed_edges ||
+      chunk >= this->chunk_header_pos.size() - 1) {
+    return false;
+  }
+  const uint *header = getChunkHeader(chunk);
+  uint start_node = header[1];
+  const uint *offsets = header + 2;
+
+  // pages holding the neighbor list of each target, in chunk order
+  std::vector<std::pair<uint64_t, uint64_t>> &ranges =
+      this->read_page_ranges[device];
+  ranges.clear();
+  for (uint node : chunk_frontier) {
+    uint64_t offset_l = offsets[node - start_node];
+    uint64_t offset_r = offsets[node - start_node + 1];
+    if (offset_r > offset_l) {
+      ranges.push_back(std::make_pair(offset_l * 4 / PAGE,
+                                      (offset_r * 4 - 1) / PAGE + 1));
     }
+  }
+  std::sort(ranges.begin(), ranges.end());
 
-    //fill sample result with -1
-    std::fill(bo_sample_result_map[0],
-              bo_sample_result_map[0] + splitted_frontier[i].size() * n_neighbors,
-              static_cast<uint32_t>(-1));
-    bo_sample_result[0].sync(XCL_BO_SYNC_BO_TO_DEVICE);
+  // merge the ranges that touch, and give up once too much is read anyway
+  requests.clear();
+  size_t chunk_pos = this->chunk_file_pos[chunk];
+  size_t n_bytes = 0;
+  for (size_t i = 0; i < ranges.size();) {
+    uint64_t first = ranges[i].first;
+    uint64_t last = ranges[i].second;
+    for (i++; i < ranges.size() && ranges[i].first <= last; i++) {
+      last = std::max(last, ranges[i].second);
+    }
+    // the last chunk ends on a 512 byte boundary, not a page
+    size_t length = std::min(last * PAGE, chunk_size_byte) - first * PAGE;
+    n_bytes += length;
+    if (n_bytes > this->selective_read_density * chunk_size_byte) {
+      return false;
+    }
+    requests.push_back({chunk_pos + first * PAGE, first * PAGE,
+                        (uint32_t)length});
+  }
+  this->edge_bytes_read += n_bytes;
+  METRICS_ADD(BYTES_READ, n_bytes);
+  METRICS_ADD(READS_ISSUED, requests.size());
+  return true;
+}
+
+void StreamingSampler::loadTargets(size_t device, size_t chunk,
+                                   Span<const uint> targets, int n_neighbors,
+                                   int slot, float &data_transfer_time) {
+  EasyTimer timer(data_transfer_time);
+  if (targets.size() > bo_target_nodes_slot[device][slot].size() / 4 ||
+      targets.size() * n_neighbors >
+          bo_sample_result_slot[device][slot].size() / 4) {
+    std::cerr << "ERR: chunk " << chunk << " has " << targets.size()
+              << " targets, which does not fit in one buffer slot"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // fill sample result with -1
+  std::fill(bo_sample_result_map[device][slot],
+            bo_sample_result_map[device][slot] + targets.size() * n_neighbors,
+            static_cast<uint32_t>(-1));
+  // copy target nodes to bo
+  std::copy(targets.begin(), targets.end(), bo_target_nodes_map[device][slot]);
+
+  METRICS_TIME(BO_SYNC_SECONDS);
+  bo_sample_result_slot[device][slot].sync(
+      XCL_BO_SYNC_BO_TO_DEVICE, targets.size() * n_neighbors * sizeof(int), 0);
+  bo_target_nodes_slot[device][slot].sync(XCL_BO_SYNC_BO_TO_DEVICE,
+                                          targets.size() * sizeof(int), 0);
+}
+
+void StreamingSampler::loadChunk(size_t device, size_t chunk,
+                                 Span<const uint> chunk_frontier,
+                                 Span<const uint> targets, int n_neighbors,
+                                 int slot, float &data_transfer_time) {
+  loadTargets(device, chunk, targets, n_neighbors, slot, data_transfer_time);
+  EasyTimer timer(data_transfer_time);
+  // the last chunk might be smaller than chunk size
+  size_t this_read_size_byte = getChunkStoredSize(chunk);
 
+  std::vector<UringReader::ReadRequest> &requests =
+      this->chunk_read_requests[device];
+  if (planSelectiveRead(device, chunk, chunk_frontier, this_read_size_byte,
+                        requests)) {
+    // read only the pages with the neighbors of the targets, to the same
+    // place in the chunk, and put the resident header in front
+    int re;
+    {
+      METRICS_TIME(READ_SECONDS);
+      re = this->chunk_reader[device][slot]->read(requests);
+    }
+    if (re < 0) {
+      std::cerr << "ERR: read of chunk " << chunk
+                << " failed: " << strerror(-re) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    const uint *header = getChunkHeader(chunk);
+    std::copy(header, header + header[0] + 3, bo_edge_map[device][slot]);
+  } else if (this->compressed_edges) {
+    // read the compressed chunk and decode it into the edge buffer
+    ssize_t re;
+    {
+      METRICS_TIME(READ_SECONDS);
+      re = pread(this->edge_file_handler, this->compressed_buffer[device][slot],
+                 this_read_size_byte, this->chunk_file_pos[chunk]);
+    }
+    if (re < (ssize_t)this_read_size_byte) {
+      std::cerr << "ERR: read of compressed chunk " << chunk
+                << " failed: " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    EdgeCodec::decodeChunk(this->compressed_buffer[device][slot],
+                           bo_edge_map[device][slot]);
+    this->edge_bytes_read += this_read_size_byte;
+    METRICS_ADD(BYTES_READ, this_read_size_byte);
+    METRICS_ADD(READS_ISSUED, 1);
+  } else {
     // read the chunk from the edge file
+    ssize_t re;
     {
-      EasyTimer timer(data_transfer_time);
-      auto re = pread(this->edge_file_handler, (void *)bo_edge_map[0][0],
-                      this_read_size_byte, i * this->input_size_byte);
-      if (re <= 0) {
-        std::cerr << "ERR: pread failed: "
-                  << " error: " << strerror(errno) << std::endl;
-        exit(EXIT_FAILURE);
-      }
+      METRICS_TIME(READ_SECONDS);
+      re = pread(this->edge_file_handler, (void *)bo_edge_map[device][slot],
+                 this_read_size_byte, this->chunk_file_pos[chunk]);
+    }
+    if (re <= 0) {
+      std::cerr << "ERR: pread failed: "
+                << " error: " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    this->edge_bytes_read += this_read_size_byte;
+    METRICS_ADD(BYTES_READ, this_read_size_byte);
+    METRICS_ADD(READS_ISSUED, 1);
+  }
 
-      // copy target nodes to bo
-      std::copy(splitted_frontier[i].begin(), splitted_frontier[i].end(),
-                bo_target_nodes_map[0]);
+  // the SSD writes straight into device memory unless we are emulated
+  if (!this->isP2PEnabled()) {
+    METRICS_TIME(BO_SYNC_SECONDS);
+    bo_edge[device][slot].sync(XCL_BO_SYNC_BO_TO_DEVICE);
+  }
+}
 
-      // std::cout << "frontiers: ";
-      // for(int i = 0; i < 5; i++) {
-      //   std::cout << bo_target_nodes_map[0][i] << " ";
-      // }
-      // std::cout << std::endl;
+void StreamingSampler::drainChunk(size_t device, size_t n_targets,
+                                  int n_neighbors, int slot, uint *result,
+                                  float &data_transfer_time) {
+  EasyTimer timer(data_transfer_time);
+  // Get the result from FPGA
+  {
+    METRICS_TIME(BO_SYNC_SECONDS);
+    bo_sample_result_slot[device][slot].sync(
+        XCL_BO_SYNC_BO_FROM_DEVICE, n_targets * n_neighbors * sizeof(int), 0);
+  }
+
+  // Copy the result from bo to its place in the result vector
+  std::copy(bo_sample_result_map[device][slot],
+            bo_sample_result_map[device][slot] + n_targets * n_neighbors,
+            result);
+}
 
-      // sync target nodes to FPGA
-      bo_target_nodes[0].sync(XCL_BO_SYNC_BO_TO_DEVICE);
+void StreamingSampler::getChunkPieces(
+    const FrontierPartitioner &splitted_frontier,
+    const std::vector<size_t> &epoch_begin, size_t chunk, size_t max_targets,
+    std::vector<ChunkPiece> &pieces) {
+  const std::vector<uint> &index = splitted_frontier.getIndex();
+  const std::vector<size_t> &chunk_begin = splitted_frontier.getChunkBegin();
+  pieces.clear();
+  size_t begin = chunk_begin[chunk];
+  for (size_t e = 0; e + 1 < epoch_begin.size(); e++) {
+    size_t end = std::lower_bound(index.begin() + begin,
+                                  index.begin() + chunk_begin[chunk + 1],
+                                  epoch_begin[e + 1]) -
+                 index.begin();
+    for (size_t run = 0; begin < end; run++) {
+      size_t run_end = std::min(end, begin + max_targets);
+      pieces.push_back({e, run, begin, run_end});
+      begin = run_end;
     }
+  }
+}
 
-    // TO BE DELETE AFTER FIX KERNEL
-    // for (size_t k = 0; k < splitted_frontier[i].size() * n_neighbors; k++) {
-    //   bo_sample_result_map[0][k] = -1;
-    // }
-    // bo_sample_result[0].sync(XCL_BO_SYNC_BO_TO_DEVICE);
+void StreamingSampler::sampleChunksOnDevice(
+    size_t device, const FrontierPartitioner &splitted_frontier,
+    int n_neighbors, const std::vector<Philox> &draws,
+    const std::vector<size_t> &epoch_begin, std::atomic<size_t> &next_chunk,
+    std::vector<uint> &result, float &fpga_time, float &data_transfer_time) {
+  size_t n_chunks = splitted_frontier.getNumChunks();
+  const uint *frontier = splitted_frontier.getFrontier().data();
+  size_t max_targets = getSlotTargets(n_neighbors);
+  auto krnl = this->getXrtKernel()[device];
+  // chunks are handed out one at a time so that devices which get sparse
+  // chunks pick up more of them, chunks without targets are not read at all
+  auto take_chunk = [&]() {
+    size_t chunk = next_chunk++;
+    while (chunk < n_chunks && splitted_frontier.getChunk(chunk).empty()) {
+      chunk = next_chunk++;
+    }
+    return chunk;
+  };
+  auto targets = [&](const ChunkPiece &piece) {
+    return Span<const uint>(frontier + piece.begin, piece.end - piece.begin);
+  };
+  size_t cur = take_chunk();
+  if (cur >= n_chunks) {
+    return;
+  }
+  std::vector<ChunkPiece> &cur_pieces = this->cur_pieces[device];
+  std::vector<ChunkPiece> &next_pieces = this->next_pieces[device];
+  getChunkPieces(splitted_frontier, epoch_begin, cur, max_targets,
+                 cur_pieces);
+  loadChunk(device, cur, splitted_frontier.getChunk(cur),
+            targets(cur_pieces[0]), n_neighbors, 0, data_transfer_time);
+  ChunkPiece pre = {0, 0, 0, 0};
+  bool has_pre = false;
+  int slot = 0;
+  for (; cur < n_chunks; slot ^= 1) {
+    METRICS_ADD(CHUNKS_SAMPLED, 1);
+    size_t nxt = n_chunks;
+    // the chunk stays in the slot while the kernel runs once per epoch
+    for (size_t p = 0; p < cur_pieces.size(); p++) {
+      const ChunkPiece &piece = cur_pieces[p];
+      if (p > 0) {
+        loadTargets(device, cur, targets(piece), n_neighbors, slot,
+                    data_transfer_time);
+      }
+      METRICS_ADD(SAMPLES, (piece.end - piece.begin) * n_neighbors);
+      Timer kernel_timer;
+      kernel_timer.start();
+      // run the kernel, this returns as soon as the kernel is started
+      auto run1 =
+          krnl(bo_edge[device][slot], bo_sample_result_slot[device][slot],
+               bo_target_nodes_slot[device][slot], piece.end - piece.begin,
+               n_neighbors, draws[piece.epoch].seedFor(cur, piece.run),
+               getReplace() ? 0u : 1u, getWeighted() ? 1u : 0u);
 
-    {
-      EasyTimer timer(fpga_time);
-      // run the kernel
-      auto run1 = this->getXrtKernel()[0](
-          bo_edge[0][0], bo_sample_result[0], bo_target_nodes[0],
-          splitted_frontier[i].size(), n_neighbors, (uint)time(NULL));
+      // overlap with the first run: copy out the previous chunk and read the
+      // next one into the other slot
+      if (p == 0) {
+        if (has_pre) {
+          drainChunk(device, pre.end - pre.begin, n_neighbors, slot ^ 1,
+                     result.data() + pre.begin * n_neighbors,
+                     data_transfer_time);
+        }
+        nxt = take_chunk();
+        if (nxt < n_chunks) {
+          getChunkPieces(splitted_frontier, epoch_begin, nxt, max_targets,
+                         next_pieces);
+          loadChunk(device, nxt, splitted_frontier.getChunk(nxt),
+                    targets(next_pieces[0]), n_neighbors, slot ^ 1,
+                    data_transfer_time);
+        }
+      }
 
       run1.wait();
+      kernel_timer.stop();
+      fpga_time += kernel_timer.getDuration();
+      METRICS_OBSERVE(KERNEL_SECONDS, kernel_timer.getDuration() / 1000);
+      // the last run is copied out while the next chunk runs
+      if (p + 1 < cur_pieces.size()) {
+        drainChunk(device, piece.end - piece.begin, n_neighbors, slot,
+                   result.data() + piece.begin * n_neighbors,
+                   data_transfer_time);
+      }
     }
+    pre = cur_pieces.back();
+    has_pre = true;
+    cur = nxt;
+    cur_pieces.swap(next_pieces);
+  }
+  // the last chunk of this device is in the slot that ran last
+  drainChunk(device, pre.end - pre.begin, n_neighbors, slot ^ 1,
+             result.data() + pre.begin * n_neighbors, data_transfer_time);
+}
 
-    {
-      EasyTimer timer(data_transfer_time);
-      // Get the result from FPGA
-      bo_sample_result[0].sync(XCL_BO_SYNC_BO_FROM_DEVICE);
-
-      // Copy the result from bo to result vector
-      std::copy(bo_sample_result_map[0],
-                bo_sample_result_map[0] +
-                    splitted_frontier[i].size() * n_neighbors,
-                std::back_inserter(result));
+void StreamingSampler::sampleSpannedNodes(
+    const FrontierPartitioner &splitted_frontier, int n_neighbors,
+    const std::vector<Philox> &draws, const std::vector<size_t> &epoch_begin,
+    std::vector<uint> &result, float &fpga_time, float &data_transfer_time) {
+  const std::vector<uint> &frontier = splitted_frontier.getFrontier();
+  const std::vector<uint> &index = splitted_frontier.getIndex();
+  const std::vector<size_t> &chunk_begin = splitted_frontier.getChunkBegin();
+  size_t nn = n_neighbors;
+  size_t edge_ints = getWeighted() ? AliasTable::ENTRY_INTS : 1;
+  bool replace = getReplace() || getWeighted();
+  size_t max_targets = getSlotTargets(n_neighbors);
+  auto krnl = this->getXrtKernel()[0];
+  for (const SpannedNode &spanned : this->spanned_nodes) {
+    // the occurrences of the node, all grouped into its first chunk, the
+    // epochs one after the other
+    this->spanned_pos.clear();
+    this->spanned_epoch.clear();
+    for (size_t j = chunk_begin[spanned.first_chunk];
+         j < chunk_begin[spanned.first_chunk + 1]; j++) {
+      if (frontier[j] == spanned.node) {
+        this->spanned_pos.push_back(j);
+        this->spanned_epoch.push_back(
+            std::upper_bound(epoch_begin.begin(), epoch_begin.end(),
+                             index[j]) -
+            epoch_begin.begin() - 1);
+      }
+    }
+    size_t n_pos = this->spanned_pos.size();
+    if (n_pos == 0) {
+      continue;
+    }
+    size_t n_pieces = spanned.last_chunk - spanned.first_chunk + 1;
+    this->spanned_degree.resize(n_pieces);
+    for (size_t i = 0; i < n_pieces; i++) {
+      const uint *header = getChunkHeader(spanned.first_chunk + i);
+      const uint *offsets = header + 2 + (spanned.node - header[1]);
+      this->spanned_degree[i] = (offsets[1] - offsets[0]) / edge_ints;
     }
 
-    std::cout << "chunk " << i << ", sample result: " << std::endl;
+    // the candidates of every piece for every occurrence, the first piece
+    // was sampled with the other targets of its chunk
+    this->spanned_candidates.resize(n_pieces * n_pos * nn);
+    for (size_t q = 0; q < n_pos; q++) {
+      std::copy(result.begin() + this->spanned_pos[q] * nn,
+                result.begin() + (this->spanned_pos[q] + 1) * nn,
+                this->spanned_candidates.begin() + q * nn);
+    }
+    this->spanned_targets.assign(n_pos, spanned.node);
+    for (size_t i = 1; i < n_pieces; i++) {
+      size_t chunk = spanned.first_chunk + i;
+      METRICS_ADD(CHUNKS_SAMPLED, 1);
+      size_t run = 0;
+      for (size_t begin = 0, end; begin < n_pos; begin = end) {
+        size_t epoch = this->spanned_epoch[begin];
+        end = begin;
+        while (end < n_pos && this->spanned_epoch[end] == epoch &&
+               end - begin < max_targets) {
+          end++;
+        }
+        run = begin > 0 && this->spanned_epoch[begin - 1] == epoch ? run + 1
+                                                                   : 0;
+        Span<const uint> targets(this->spanned_targets.data() + begin,
+                                 end - begin);
+        if (begin == 0) {
+          loadChunk(0, chunk, targets, targets, n_neighbors, 0,
+                    data_transfer_time);
+        } else {
+          loadTargets(0, chunk, targets, n_neighbors, 0, data_transfer_time);
+        }
+        METRICS_ADD(SAMPLES, (end - begin) * nn);
+        Timer kernel_timer;
+        kernel_timer.start();
+        auto run1 = krnl(bo_edge[0][0], bo_sample_result_slot[0][0],
+                         bo_target_nodes_slot[0][0], end - begin, n_neighbors,
+                         draws[epoch].seedFor(chunk, SPANNED_RUN + run),
+                         getReplace() ? 0u : 1u, getWeighted() ? 1u : 0u);
+        run1.wait();
+        kernel_timer.stop();
+        fpga_time += kernel_timer.getDuration();
+        METRICS_OBSERVE(KERNEL_SECONDS, kernel_timer.getDuration() / 1000);
+        drainChunk(0, end - begin, n_neighbors, 0,
+                   this->spanned_candidates.data() + (i * n_pos + begin) * nn,
+                   data_transfer_time);
+      }
+    }
 
-    for (int k = 0; k < n_neighbors * 5; k++) {
-      if (k && k % n_neighbors == 0) {
-        std::cout << std::endl;
+    // every draw takes from a piece by its share of the neighbors
+    uint64_t degree = 0;
+    for (size_t i = 0; i < n_pieces; i++) {
+      degree += this->spanned_degree[i];
+    }
+    this->spanned_samples.resize(nn);
+    for (size_t q = 0; q < n_pos; q++) {
+      const Philox &draw = draws[this->spanned_epoch[q]];
+      uint32_t p = index[this->spanned_pos[q]] -
+                   epoch_begin[this->spanned_epoch[q]];
+      // the neighbors left and taken of every piece, without replacement
+      this->spanned_piece.assign(2 * n_pieces, 0);
+      std::copy(this->spanned_degree.begin(), this->spanned_degree.end(),
+                this->spanned_piece.begin());
+      uint64_t left = degree;
+      for (size_t k = 0; k < nn; k++) {
+        uint32_t word = draw.draw(p, SPANNED_DRAW + 2 * k);
+        uint32_t place = draw.draw(p, SPANNED_DRAW + 2 * k + 1);
+        if (left == 0) {
+          this->spanned_samples[k] = static_cast<uint>(-1);
+          continue;
+        }
+        uint64_t x = Philox::below(word, replace ? degree : left);
+        size_t i = 0;
+        while (x >=
+               (replace ? this->spanned_degree[i] : this->spanned_piece[i])) {
+          x -= replace ? this->spanned_degree[i] : this->spanned_piece[i];
+          i++;
+        }
+        uint *candidates =
+            this->spanned_candidates.data() + (i * n_pos + q) * nn;
+        if (replace) {
+          // the kernel drew nn times from a piece larger than the fanout,
+          // and returned all the neighbors of a smaller one
+          this->spanned_samples[k] =
+              getWeighted() || this->spanned_degree[i] > nn
+                  ? candidates[k]
+                  : candidates[Philox::below(place, this->spanned_degree[i])];
+        } else {
+          // the kernel drew min(degree, nn) distinct neighbors of the piece,
+          // take a uniform subset of them
+          uint32_t taken = this->spanned_piece[n_pieces + i]++;
+          uint64_t n_candidates =
+              std::min<uint64_t>(this->spanned_degree[i], nn);
+          std::swap(candidates[taken],
+                    candidates[taken +
+                               Philox::below(place, n_candidates - taken)]);
+          this->spanned_samples[k] = candidates[taken];
+          this->spanned_piece[i]--;
+          left--;
+        }
       }
-      if(bo_sample_result_map[0][k] != 4294967295)
-        std::cout << bo_sample_result_map[0][k] << " ";
-      else 
-        std::cout << "N ";
+      std::copy(this->spanned_samples.begin(), this->spanned_samples.end(),
+                result.begin() + this->spanned_pos[q] * nn);
     }
-    std::cout << std::endl << std::endl;
   }
-  std::cout << "End sample one layer, result size: " << result.size()
-            << " fpga time: " << fpga_time
-            << " data transfer time: " << data_transfer_time << std::endl;
-  return result;
+}
+
+void StreamingSampler::sampleOneLayer(
+    const FrontierPartitioner &splitted_frontier, int n_neighbors,
+    const std::vector<Philox> &draws, const std::vector<size_t> &epoch_begin,
+    std::vector<uint> &result) {
+  METRICS_TIME(LAYER_SECONDS);
+  size_t n_devices = this->getXrtDevice().size();
+  // every device copies the samples of its chunks straight into place, so the
+  // result stays in chunk order
+  result.resize(splitted_frontier.size() * n_neighbors);
+
+  // one worker per device, each running its own ping-pong pipeline
+  std::atomic<size_t> next_chunk(0);
+  std::vector<float> &fpga_time = this->device_fpga_time;
+  std::vector<float> &data_transfer_time = this->device_transfer_time;
+  fpga_time.assign(n_devices, 0);
+  data_transfer_time.assign(n_devices, 0);
+  this->workers.clear();
+  for (size_t d = 0; d < n_devices; d++) {
+    this->workers.emplace_back([&, d]() {
+      sampleChunksOnDevice(d, splitted_frontier, n_neighbors, draws,
+                           epoch_begin, next_chunk, result, fpga_time[d],
+                           data_transfer_time[d]);
+    });
+  }
+  for (auto &worker : this->workers) {
+    worker.join();
+  }
+  if (!this->spanned_nodes.empty()) {
+    sampleSpannedNodes(splitted_frontier, n_neighbors, draws, epoch_begin,
+                       result, fpga_time[0], data_transfer_time[0]);
+  }
+
+  // the only writer is the thread sampling, so load and store do
+  this->fpga_time.store(
+      this->fpga_time.load() +
+      *std::max_element(fpga_time.begin(), fpga_time.end()));
+  this->transfer_time.store(
+      this->transfer_time.load() +
+      *std::max_element(data_transfer_time.begin(), data_transfer_time.end()));
+}
+
+void StreamingSampler::sampleLayer(Span<const uint> frontier,
+                                   uint n_neighbors,
+                                   std::vector<uint> &result,
+                                   const Philox &draws) {
+  checkDistinctFanouts({n_neighbors}, getReplace());
+  if (this->pending_epoch.valid()) {
+    this->pending_epoch.wait();
+  }
+  {
+    METRICS_TIME(FRONTIER_PREP_SECONDS);
+    this->frontier_partitioner.partition(frontier.data(), frontier.size());
+  }
+  this->layer_draws.assign(1, draws);
+  this->layer_epoch_begin.assign({0, frontier.size()});
+  sampleOneLayer(this->frontier_partitioner, n_neighbors, this->layer_draws,
+                 this->layer_epoch_begin, this->layer_samples);
+  // the layer is deduplicated as a whole, so the chunk order can stay
+  METRICS_TIME(DEDUP_SECONDS);
+  size_t layer_begin = result.size();
+  std::copy_if(this->layer_samples.begin(), this->layer_samples.end(),
+               std::back_inserter(result),
+               [](uint value) { return value != static_cast<uint>(-1); });
+  std::sort(result.begin() + layer_begin, result.end());
+  result.erase(std::unique(result.begin() + layer_begin, result.end()),
+               result.end());
 }
 
 std::vector<uint>
@@ -278,132 +972,354 @@ StreamingSampler::cleanSampleResult(std::vector<uint> &result) {
   return filtered;
 }
 
-std::vector<uint> StreamingSampler::flipBackToOriginalORder(std::vector<uint> &result, std::vector<uint> &idx, uint fanout) {
-  std::vector<uint> flipped_result(result.size());
+void StreamingSampler::scatterToOriginalOrder(const std::vector<uint> &result,
+                                              const std::vector<uint> &idx,
+                                              uint fanout,
+                                              std::vector<uint> &flipped) {
+  flipped.resize(result.size());
+  // result[j] belongs to the frontier node that was at position idx[j], idx is
+  // a permutation so the writes never collide
+#pragma omp parallel for
   for (size_t j = 0; j < idx.size(); j++) {
     for (size_t k = 0; k < fanout; k++) {
-      flipped_result[j * fanout + k] =
-          result[idx[j] * fanout + k];
+      flipped[idx[j] * fanout + k] = result[j * fanout + k];
     }
   }
+}
+
+std::vector<uint>
+StreamingSampler::flipBackToOriginalORder(const std::vector<uint> &result,
+                                          const std::vector<uint> &idx,
+                                          uint fanout) {
+  std::vector<uint> flipped_result;
+  scatterToOriginalOrder(result, idx, fanout, flipped_result);
   return flipped_result;
 }
 
-std::vector<uint> StreamingSampler::deduplicateResult(std::vector<uint> &result, std::vector<std::vector<uint>> &sample_result_size, uint fanout) {
+std::vector<uint> StreamingSampler::deduplicateResult(
+    std::vector<uint> &result,
+    std::vector<std::vector<uint>> &sample_result_size, uint fanout) {
   // vector to store the size of the result of each batch
-  std::vector<uint> cur_result_size = std::vector<uint>();
+  std::vector<uint> cur_result_size;
   std::vector<uint> deduplicated_result;
-  size_t pos = 0;
-  for(auto source_size: sample_result_size.back()) {
-      std::vector<uint> temp;
-      // copy all non -1 elements to deduplicated_result
-      std::copy_if(result.begin() + pos, result.begin() + pos + source_size * fanout, std::back_inserter(temp), [](uint value) {
-        return value != static_cast<uint>(-1); // 4,294,967,295
-      });
-      // deduplicate
-      std::sort(temp.begin(), temp.end());
-      auto last = std::unique(temp.begin(), temp.end());
-      std::copy(temp.begin(), last, std::back_inserter(deduplicated_result));
-      cur_result_size.push_back(last - temp.begin());
-      pos += source_size * fanout;
-  }
+  this->batch_deduplicator.deduplicate(result, sample_result_size.back(),
+                                       fanout, deduplicated_result,
+                                       cur_result_size);
   sample_result_size.push_back(cur_result_size);
   return deduplicated_result;
 }
 
-void StreamingSampler::sampleNextEpoch(int bo_index) {
-  std::cout << "Begin sample next epoch... bo_index: " << bo_index << std::endl;
-  std::vector<std::vector<uint>> *cur_sample_result = &sample_result[bo_index];
-  std::vector<std::vector<uint>> splited_frontier;
-  std::vector<uint32_t> idx;
-  sample_result_size[bo_index].clear();
-  uint32_t deduplicate_range = 1000;
-  cur_sample_result->clear();
+void StreamingSampler::sampleNextEpochs(size_t first_slot) {
+  const std::vector<uint> &fanouts = this->getFanouts();
+  size_t n_epochs = this->fused_epochs;
+  // the vectors of the slots are resized, not freed, so an epoch reuses the
+  // memory of the epoch sampled into its slot before
+  std::vector<uint32_t> epochs;
+  for (size_t e = 0; e < n_epochs; e++) {
+    size_t slot = first_slot + e;
+    sample_result[slot].resize(fanouts.size());
+    sample_result_size[slot].resize(fanouts.size() + 1);
+    sample_result_offsets[slot].resize(fanouts.size() + 1);
+
+    // every epoch visits the target nodes in its own order, shuffled with
+    // the draws of the layer after the last one, so an epoch is the same for
+    // the same seed
+    uint32_t epoch = beginCall();
+    epochs.push_back(epoch);
+    std::vector<uint> &target_nodes = this->epoch_target_nodes[slot];
+    target_nodes = this->target_nodes;
+    Philox order(getSeed(), epoch, fanouts.size());
+    uint32_t words[64];
+    for (size_t i = target_nodes.size(); i > 1; i--) {
+      size_t word = (target_nodes.size() - i) % 64;
+      if (word == 0) {
+        order.fill(0, (target_nodes.size() - i) / 4, 16, words);
+      }
+      std::swap(target_nodes[i - 1],
+                target_nodes[Philox::below(words[word], i)]);
+    }
+
+    // add sample_result_size for trian nodes
+    std::vector<uint> &target_size = sample_result_size[slot][0];
+    target_size.clear();
+    for (size_t j = 0; j < target_nodes.size(); j += batch_size) {
+      target_size.push_back(std::min(batch_size, target_nodes.size() - j));
+    }
+  }
+
   // Sample layer by layer
-  for (size_t i = 0; i < this->getFanouts().size(); i++) {
-    std::vector<uint> cur_frontier;
+  std::vector<Philox> draws;
+  std::vector<size_t> epoch_begin;
+  for (size_t i = 0; i < fanouts.size(); i++) {
+    // the targets for the first layer, the samples of the previous layer
+    // for the others, of every epoch one after the other
+    auto frontier = [&](size_t e) -> const std::vector<uint> & {
+      size_t slot = first_slot + e;
+      return i == 0 ? this->epoch_target_nodes[slot]
+                    : sample_result[slot][i - 1];
+    };
+    draws.clear();
+    epoch_begin.assign(1, 0);
+    for (size_t e = 0; e < n_epochs; e++) {
+      draws.push_back(Philox(getSeed(), epochs[e], i));
+      epoch_begin.push_back(epoch_begin.back() + frontier(e).size());
+    }
+    METRICS_SET_LAYER(LAYER_FRONTIER_SIZE, i, epoch_begin.back());
     {
-      EasyTimer timer("Prepair frontiers ");
-      if (i == 0) {
-        cur_frontier.resize(this->target_nodes.size());
-        idx.resize(this->target_nodes.size());
-        for (size_t i = 0; i < idx.size(); ++i) {
-          idx[i] = i;
-        }
-        // Sorting the index vector based on the original vector
-        std::sort(idx.begin(), idx.end(), [&](int i1, int i2) {
-          return this->target_nodes[i1] < this->target_nodes[i2];
-        });
-        // Reordering the elements in the original vector based on the sorted
-        // indices
-        for (size_t j = 0; j < this->target_nodes.size(); ++j) {
-          cur_frontier[j] = this->target_nodes[idx[j]];
+      METRICS_TIME(FRONTIER_PREP_SECONDS);
+      const uint *layer_frontier = frontier(0).data();
+      if (n_epochs > 1) {
+        this->layer_frontier.clear();
+        for (size_t e = 0; e < n_epochs; e++) {
+          this->layer_frontier.insert(this->layer_frontier.end(),
+                                      frontier(e).begin(), frontier(e).end());
         }
+        layer_frontier = this->layer_frontier.data();
+      }
+      this->frontier_partitioner.partition(layer_frontier,
+                                           epoch_begin.back());
+    }
+    sampleOneLayer(this->frontier_partitioner, fanouts[i], draws, epoch_begin,
+                   this->layer_samples);
+    // convert back to original order
+    scatterToOriginalOrder(this->layer_samples,
+                           this->frontier_partitioner.getIndex(), fanouts[i],
+                           this->layer_flipped);
+
+    // deduplicate, -1 is dropped here as well. The batches of all epochs
+    // are deduplicated together, then split by epoch.
+    {
+      METRICS_TIME(DEDUP_SECONDS);
+      if (n_epochs == 1) {
+        this->batch_deduplicator.deduplicate(
+            this->layer_flipped, sample_result_size[first_slot][i],
+            fanouts[i], sample_result[first_slot][i],
+            sample_result_size[first_slot][i + 1]);
       } else {
-        
-        cur_frontier.resize((*cur_sample_result)[i-1].size());
-        idx.resize(cur_frontier.size());
-        for (size_t i = 0; i < idx.size(); ++i) {
-          idx[i] = i;
+        this->layer_source_size.clear();
+        for (size_t e = 0; e < n_epochs; e++) {
+          const std::vector<uint> &sizes =
+              sample_result_size[first_slot + e][i];
+          this->layer_source_size.insert(this->layer_source_size.end(),
+                                         sizes.begin(), sizes.end());
         }
-        // Sorting the index vector based on the original vector
-        std::sort(idx.begin(), idx.end(), [&](int i1, int i2) {
-          return (*cur_sample_result)[i-1][i1] < (*cur_sample_result)[i-1][i2];
-        });
-        // Reordering the elements in the original vector based on the sorted
-        // indices
-        for (size_t j = 0; j < (*cur_sample_result)[i-1].size(); ++j) {
-          cur_frontier[j] = (*cur_sample_result)[i-1][idx[j]];
+        this->batch_deduplicator.deduplicate(
+            this->layer_flipped, this->layer_source_size, fanouts[i],
+            this->layer_deduplicated, this->layer_deduplicated_size);
+        size_t batch = 0, pos = 0;
+        for (size_t e = 0; e < n_epochs; e++) {
+          size_t slot = first_slot + e;
+          size_t n_batches = sample_result_size[slot][i].size();
+          std::vector<uint> &sizes = sample_result_size[slot][i + 1];
+          sizes.assign(this->layer_deduplicated_size.begin() + batch,
+                       this->layer_deduplicated_size.begin() + batch +
+                           n_batches);
+          size_t n_samples = 0;
+          for (uint size : sizes) {
+            n_samples += size;
+          }
+          sample_result[slot][i].assign(
+              this->layer_deduplicated.begin() + pos,
+              this->layer_deduplicated.begin() + pos + n_samples);
+          batch += n_batches;
+          pos += n_samples;
         }
       }
-      std::cout << "cur_frontier size: " << cur_frontier.size() << std::endl;
-      splited_frontier = splitFrontier(cur_frontier);
     }
-    std::vector<uint> this_layer_result =
-        sampleOneLayer(splited_frontier, this->getFanouts()[i]);
-    // convert back to original order
-    this_layer_result = flipBackToOriginalORder(this_layer_result, idx, this->getFanouts()[i]);
-
-    // deduplicate
-    if(i == 0){
-      // add sample_result_size for trian nodes
-      std::vector<uint> temp;
-      for(size_t j = 0; j < cur_frontier.size(); j+= 1000) {
-        temp.push_back(std::min(size_t(1000), cur_frontier.size() - j));
+    // layer-wise, every batch keeps its budget of the candidates
+    size_t n_sampled = 0;
+    for (size_t e = 0; e < n_epochs; e++) {
+      size_t slot = first_slot + e;
+      if (!this->layer_budgets.empty()) {
+        METRICS_TIME(LAYER_SELECT_SECONDS);
+        this->layer_selector.select(sample_result[slot][i],
+                                    sample_result_size[slot][i + 1],
+                                    this->layer_budgets[i],
+                                    this->node_importance, draws[e]);
       }
-      sample_result_size[bo_index].push_back(temp);
+      n_sampled += sample_result[slot][i].size();
     }
-    std::vector<uint> deduplicate_result = deduplicateResult(this_layer_result, sample_result_size[bo_index], this->getFanouts()[i]);
+    METRICS_SET_LAYER(LAYER_SAMPLED_SIZE, i, n_sampled);
+  }
 
-    (*cur_sample_result).push_back(deduplicate_result);
+  for (size_t e = 0; e < n_epochs; e++) {
+    size_t slot = first_slot + e;
+    // the sampling is done, the batches are served by original id
+    toOriginal(this->epoch_target_nodes[slot].data(),
+               this->epoch_target_nodes[slot].size());
+    for (std::vector<uint> &layer : sample_result[slot]) {
+      toOriginal(layer.data(), layer.size());
+    }
+    // prefix sums of the batch sizes, so a batch of any layer can be located
+    // without scanning
+    for (size_t i = 0; i < sample_result_size[slot].size(); i++) {
+      std::vector<size_t> &offsets = sample_result_offsets[slot][i];
+      offsets.assign(sample_result_size[slot][i].size() + 1, 0);
+      for (size_t b = 0; b < sample_result_size[slot][i].size(); b++) {
+        offsets[b + 1] = offsets[b] + sample_result_size[slot][i][b];
+      }
+    }
+  }
+}
 
-    // count non -1 size
-    int count = std::count_if(deduplicate_result.begin(), deduplicate_result.end(),
-                              [](uint x) { return x != -1; });
+void StreamingSampler::setFusedEpochs(size_t k) {
+  if (k == 0) {
+    std::cerr << "ERR: at least one epoch is sampled per pass" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  discardPendingEpochs();
+  this->fused_epochs = k;
+  // the last slot, so the next epoch starts the first group
+  this->current_bo_index = 2 * k - 1;
+  this->next_batch = 0;
+  this->epoch_target_nodes.assign(2 * k, std::vector<uint>());
+  this->sample_result.assign(2 * k, std::vector<std::vector<uint>>());
+  this->sample_result_size.assign(2 * k, std::vector<std::vector<uint>>());
+  this->sample_result_offsets.assign(2 * k,
+                                     std::vector<std::vector<size_t>>());
+}
+
+size_t StreamingSampler::getFusedEpochs() { return this->fused_epochs; }
 
-    std::cout << "Number of elements not equal to -1: " << count << std::endl;
+size_t StreamingSampler::getNumBatches() {
+  if (sample_result_size[current_bo_index].empty()) {
+    return 0;
   }
+  return sample_result_size[current_bo_index][0].size();
+}
 
+Span<const uint> StreamingSampler::getBatchTargets(size_t batch) {
+  const std::vector<size_t> &offsets =
+      sample_result_offsets[current_bo_index][0];
+  return Span<const uint>(epoch_target_nodes[current_bo_index].data() +
+                              offsets[batch],
+                          offsets[batch + 1] - offsets[batch]);
+}
+
+std::vector<Span<const uint>> StreamingSampler::getBatch(size_t batch) {
+  std::vector<Span<const uint>> result;
+  // layer i of the result is described by the batch sizes of level i + 1,
+  // level 0 being the target nodes
+  for (size_t i = 0; i < sample_result[current_bo_index].size(); i++) {
+    const std::vector<size_t> &offsets =
+        sample_result_offsets[current_bo_index][i + 1];
+    result.push_back(
+        Span<const uint>(sample_result[current_bo_index][i].data() +
+                             offsets[batch],
+                         offsets[batch + 1] - offsets[batch]));
+  }
+  return result;
 }
 
 std::vector<std::vector<uint>>
 StreamingSampler::getSample(std::vector<uint> target_nodes) {
   std::vector<std::vector<uint>> result;
-  // we no longer need to assemble the result, just return the result from the
-  // memory.
-
-  // TODO implment this
-
+  // we no longer need to assemble the result, just return the next batch of
+  // the epoch from memory. The batches are fixed when the epoch is sampled,
+  // so the given target nodes are not used; see getBatchTargets.
+  if (this->next_batch >= getNumBatches()) {
+    return result;
+  }
+  for (auto layer : getBatch(this->next_batch++)) {
+    result.push_back(std::vector<uint>(layer.begin(), layer.end()));
+  }
   return result;
 }
 
+void StreamingSampler::sample(Span<const uint> frontier,
+                              SampleWorkspace &workspace) {
+  workspace.clear();
+  // the next batch of the epoch, like getSample
+  if (this->next_batch >= getNumBatches()) {
+    return;
+  }
+  size_t batch = this->next_batch++;
+  for (size_t i = 0; i < sample_result[current_bo_index].size(); i++) {
+    const std::vector<size_t> &offsets =
+        sample_result_offsets[current_bo_index][i + 1];
+    const std::vector<uint> &layer = sample_result[current_bo_index][i];
+    workspace.values.insert(workspace.values.end(),
+                            layer.begin() + offsets[batch],
+                            layer.begin() + offsets[batch + 1]);
+    workspace.endLayer();
+  }
+}
+
 void StreamingSampler::newEpochStart() {
-  // shuffle for benchmark only
-  std::shuffle(target_nodes.begin(), target_nodes.end(),
-                std::default_random_engine(time(NULL)));
-  // flip the buffer object index
-  this->current_bo_index ^= 1;
-  // clear the frontier and sample result
-  // sample the next epoch
-  sampleNextEpoch(this->current_bo_index);
-}
\ No newline at end of file
+  size_t n_slots = 2 * this->fused_epochs;
+  int next_bo_index = (this->current_bo_index + 1) % n_slots;
+  this->current_bo_index = next_bo_index;
+  this->next_batch = 0;
+  // the rest of a group was sampled with its first epoch
+  if (next_bo_index % this->fused_epochs != 0) {
+    return;
+  }
+  if (this->pending_epoch.valid()) {
+    // normally done already
+    this->pending_epoch.get();
+  } else {
+    sampleNextEpochs(next_bo_index);
+  }
+  // sample the group after this one in the background, into the slots of
+  // the group that just ended
+  size_t background_slot = (next_bo_index + this->fused_epochs) % n_slots;
+  this->pending_epoch =
+      std::async(std::launch::async, [this, background_slot]() {
+        sampleNextEpochs(background_slot);
+      });
+}
+
+void StreamingSampler::discardPendingEpochs() {
+  if (!this->pending_epoch.valid()) {
+    return;
+  }
+  this->pending_epoch.get();
+  // the group gets the same epoch numbers when it is sampled again
+  rewindCalls(this->fused_epochs);
+}
+
+void StreamingSampler::checkDistinctFanouts(const std::vector<uint> &fanouts,
+                                            bool replace) {
+  for (uint fanout : fanouts) {
+    if (!replace && fanout > MAX_DISTINCT_FANOUT) {
+      std::cerr << "ERR: a fanout of " << fanout
+                << " without replacement, the kernel draws at most "
+                << MAX_DISTINCT_FANOUT << " distinct neighbors" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+void StreamingSampler::setFanouts(std::vector<uint> fanouts) {
+  checkDistinctFanouts(fanouts, getReplace());
+  discardPendingEpochs();
+  SamplerBase::setFanouts(fanouts);
+}
+
+void StreamingSampler::setSeed(uint64_t seed) {
+  discardPendingEpochs();
+  SamplerBase::setSeed(seed);
+}
+
+void StreamingSampler::setReplace(bool replace) {
+  checkDistinctFanouts(getFanouts(), replace);
+  discardPendingEpochs();
+  SamplerBase::setReplace(replace);
+}
+
+void StreamingSampler::setNodeMap(std::string old_to_new_path,
+                                  std::string new_to_old_path) {
+  discardPendingEpochs();
+  SamplerBase::setNodeMap(old_to_new_path, new_to_old_path);
+}
+
+StreamingSampler::~StreamingSampler() {
+  if (this->pending_epoch.valid()) {
+    this->pending_epoch.wait();
+  }
+  for (auto &buffers : this->compressed_buffer) {
+    for (uint8_t *buffer : buffers) {
+      free(buffer);
+    }
+  }
+}
@@ -1,41 +1,175 @@
 #ifndef STREAMING_SAMPLER_HPP
 #define STREAMING_SAMPLER_HPP
+#include "BatchDeduplicator.hpp"
+#include "FrontierPartitioner.hpp"
+#include "LayerSelector.hpp"
 #include "SamplerBase.hpp"
 #include "SmartSSDBase.hpp"
+#include "utils/edge_codec.hpp"
+#include "utils/philox.hpp"
+#include "utils/span.hpp"
+#include "utils/uring_reader.hpp"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
 #include <vector>
-#include <random>
 
 class StreamingSampler : public SmartSSDBase, public SamplerBase {
 private:
   int edge_file_handler;
   off_t edge_file_size_byte;
+  // the edge file is compressed with EdgeCodec, its chunks are decoded into
+  // the edge buffers on the host
+  bool compressed_edges = false;
+  size_t compressed_raw_chunk_size_byte = 0;
+  // file offset of every chunk and of the end of the last one
+  std::vector<uint64_t> chunk_file_pos;
+  // compressed chunk of every buffer slot, before it is decoded
+  std::vector<std::vector<uint8_t *>> compressed_buffer;
   std::vector<uint> chunk_offsets;
   std::vector<uint> target_nodes;
   size_t edge_chunk_size;
   size_t max_sample_size_per_chunk;
   size_t max_target_size;
   size_t input_size_byte;
+  // memory of one device for the buffers: the edge buffers hold the largest
+  // chunk, and the target and result buffers share the rest
+  size_t device_memory_byte = DEVICE_MEMORY_BYTE;
+  // every buffer has two slots per device so that chunk i+1 can be loaded
+  // while the kernel works on chunk i
   std::vector<std::vector<xrt::bo>> bo_edge;
   std::vector<xrt::bo> bo_sample_result;
   std::vector<xrt::bo> bo_target_nodes;
+  std::vector<std::vector<xrt::bo>> bo_sample_result_slot;
+  std::vector<std::vector<xrt::bo>> bo_target_nodes_slot;
   std::vector<std::vector<uint *>> bo_edge_map;
-  // std::vector<uint *> bo_edge_B_map;
-  std::vector<uint *> bo_sample_result_map;
-  std::vector<uint *> bo_target_nodes_map;
+  std::vector<std::vector<uint *>> bo_sample_result_map;
+  std::vector<std::vector<uint *>> bo_target_nodes_map;
+  // the header of every chunk ([n_nodes][start_node][offsets]), chunk c is
+  // chunk_headers[chunk_header_pos[c], chunk_header_pos[c + 1])
+  std::vector<uint> chunk_headers;
+  std::vector<size_t> chunk_header_pos;
+
+  /**
+   * A node whose neighbor list is split over the chunks first_chunk to
+   * last_chunk, see ArtifactWriter
+   */
+  struct SpannedNode {
+    uint node;
+    size_t first_chunk;
+    size_t last_chunk;
+  };
+  std::vector<SpannedNode> spanned_nodes;
+  // workspaces of sampleSpannedNodes
+  std::vector<size_t> spanned_pos;
+  std::vector<size_t> spanned_epoch;
+  std::vector<uint> spanned_targets;
+  std::vector<uint> spanned_candidates;
+  std::vector<uint> spanned_samples;
+  std::vector<uint32_t> spanned_piece;
+  std::vector<uint64_t> spanned_degree;
+  // chunks whose targets need at most this part of the chunk are read page
+  // by page instead of whole
+  double selective_read_density = 0.25;
+  std::atomic<size_t> edge_bytes_read{0};
+  // kernel and transfer time of the slowest device, summed over layers; they
+  // grow while an epoch is sampled in the background
+  std::atomic<float> fpga_time{0};
+  std::atomic<float> transfer_time{0};
+  // read engine of every buffer slot and the read workspace of every device
+  std::vector<std::vector<std::unique_ptr<UringReader>>> chunk_reader;
+  std::vector<std::vector<UringReader::ReadRequest>> chunk_read_requests;
+  std::vector<std::vector<std::pair<uint64_t, uint64_t>>> read_page_ranges;
   int current_bo_index;
+  size_t batch_size;
+  size_t next_batch;
+  // epochs sampled by one pass over the edge file per layer
+  size_t fused_epochs = 1;
+  // one entry per epoch slot, in two groups of fused_epochs slots: the group
+  // of current_bo_index is being served while the other one is sampled in
+  // the background
+  std::vector<std::vector<uint>> epoch_target_nodes;
   std::vector<std::vector<std::vector<uint>>> sample_result;
   std::vector<std::vector<std::vector<uint>>> sample_result_size;
+  std::vector<std::vector<std::vector<size_t>>> sample_result_offsets;
+  std::future<void> pending_epoch;
+  // groups the frontier of a layer by chunk, only used by sampleNextEpochs
+  FrontierPartitioner frontier_partitioner;
+  BatchDeduplicator batch_deduplicator;
+  // samples of the current layer in chunk order and in frontier order, kept
+  // across layers and epochs
+  std::vector<uint> layer_samples;
+  std::vector<uint> layer_flipped;
+  // the draws and frontier bounds of the single epoch passed to
+  // sampleOneLayer by sampleLayer
+  std::vector<Philox> layer_draws;
+  std::vector<size_t> layer_epoch_begin;
+  // the frontiers and batch sizes of the fused epochs of a layer one after
+  // the other, and their deduplicated samples before they are split
+  std::vector<uint> layer_frontier;
+  std::vector<uint> layer_source_size;
+  std::vector<uint> layer_deduplicated;
+  std::vector<uint> layer_deduplicated_size;
+  // nodes kept per batch in every layer, empty for node-wise sampling
+  std::vector<uint> layer_budgets;
+  // importance of every node in layer-wise sampling, its degree plus one
+  std::vector<float> node_importance;
+  LayerSelector layer_selector;
 
   /**
-   * Open the edge file to get the file handler
+   * The targets of one kernel run on one chunk, positions [begin, end) of the
+   * grouped frontier, all of epoch `epoch`. The targets of an epoch that do
+   * not fit in a buffer slot are split over runs 0, 1, ...
+   */
+  struct ChunkPiece {
+    size_t epoch;
+    size_t run;
+    size_t begin;
+    size_t end;
+  };
+  // pieces of the chunk in a slot and of the chunk read next, per device
+  std::vector<std::vector<ChunkPiece>> cur_pieces;
+  std::vector<std::vector<ChunkPiece>> next_pieces;
+  // times and worker of every device in the current layer, kept across
+  // layers so that sampling does not allocate
+  std::vector<float> device_fpga_time;
+  std::vector<float> device_transfer_time;
+  std::vector<std::thread> workers;
+
+  // the first kernel run of the pieces of a spanned node on a chunk, apart
+  // from the runs of the chunk's own targets
+  static const uint32_t SPANNED_RUN = 1 << 20;
+  // the first draw of the occurrences of spanned nodes, out of reach of the
+  // draws of a node
+  static const uint64_t SPANNED_DRAW = (uint64_t)1 << 32;
+
+  /**
+   * Open the edge file to get the file handler. A compressed edge file is
+   * recognized by its header, which also gives the chunk positions.
    */
   int openEdgeFile(std::string edge_file_path);
 
+  /**
+   * Read the header of a compressed edge file, return false if the file is
+   * not compressed
+   */
+  bool loadCompressedFileHeader();
+
   /**
    * Open the chunk file and load the chunk info
    */
   int loadChunkInfo(std::string chunk_info_file_path);
 
+  /**
+   * Load the file offset of every raw chunk from the chunk index next to the
+   * chunk info (chunk_info.bin gives chunk_index.bin), or place the chunks
+   * edge_chunk_size apart without one. With an index, the edge chunk size
+   * becomes the size of the largest chunk. A compressed edge file has the
+   * offsets in its header.
+   */
+  void loadChunkIndex(std::string chunk_info_file_path);
+
   /**
    * Open the training nodes file and load the training nodes
    */
@@ -47,10 +181,132 @@ private:
   void allocateBufferObject();
 
   /**
-   * Sample one layer of the neighbors of the frontier
+   * Allocate the target and result buffers of every device in what the edge
+   * buffers leave of the device memory, a target taking one word and a
+   * result word per neighbor of the largest fanout
+   */
+  void allocateTargetBuffers();
+
+  /**
+   * Number of targets one kernel run on a buffer slot takes
+   */
+  size_t getSlotTargets(int n_neighbors);
+
+  /**
+   * Read the header of every chunk of the edge file and keep it in memory,
+   * and find the nodes split over chunks
+   */
+  void loadChunkHeaders();
+
+  /**
+   * The resident header of chunk `chunk`
+   */
+  const uint *getChunkHeader(size_t chunk);
+
+  /**
+   * Compute the importance of every node from the resident chunk headers, in
+   * one pass and without reading the edges
+   */
+  void loadNodeImportance();
+
+  /**
+   * Set up one io_uring read engine for each edge buffer slot, and the
+   * buffers compressed chunks are read to
+   */
+  void setupReadEngine();
+
+  /**
+   * Plan the reads of only the pages of chunk `chunk` that hold the
+   * neighbors of its targets. Returns false if that is more than
+   * selective_read_density of the chunk, then the whole chunk is read.
+   */
+  bool planSelectiveRead(size_t device, size_t chunk,
+                         Span<const uint> chunk_frontier,
+                         size_t chunk_size_byte,
+                         std::vector<UringReader::ReadRequest> &requests);
+
+  /**
+   * Read chunk `chunk` from the edge file into the buffers of `slot` and
+   * load `targets` with loadTargets. Sparse chunks are read selectively, the
+   * pages of all of chunk_frontier, with the resident header copied in.
    */
-  std::vector<uint> sampleOneLayer(std::vector<std::vector<uint>> frontier,
-                                   int n_neighbors);
+  void loadChunk(size_t device, size_t chunk, Span<const uint> chunk_frontier,
+                 Span<const uint> targets, int n_neighbors, int slot,
+                 float &data_transfer_time);
+
+  /**
+   * Copy the target nodes of a kernel run on chunk `chunk` into the buffers
+   * of `slot`, and reset the sample result of that slot to -1
+   */
+  void loadTargets(size_t device, size_t chunk, Span<const uint> targets,
+                   int n_neighbors, int slot, float &data_transfer_time);
+
+  /**
+   * Copy the sample result of `slot` back from the FPGA into `result`
+   */
+  void drainChunk(size_t device, size_t n_targets, int n_neighbors, int slot,
+                  uint *result, float &data_transfer_time);
+
+  /**
+   * The pieces of chunk `chunk` with targets, by epoch, of at most
+   * max_targets. The epoch e frontier is [epoch_begin[e], epoch_begin[e + 1])
+   * of the partitioned frontier, and its targets in a chunk are consecutive
+   * since the partition keeps order.
+   */
+  void getChunkPieces(const FrontierPartitioner &splitted_frontier,
+                      const std::vector<size_t> &epoch_begin, size_t chunk,
+                      size_t max_targets, std::vector<ChunkPiece> &pieces);
+
+  /**
+   * Worker loop for one device: take chunks from `next_chunk` until all are
+   * done, run them through the ping-pong pipeline of that device and copy the
+   * samples of chunk i to its place in result. A chunk is read once and the
+   * kernel runs on it once per epoch with targets in it.
+   */
+  void sampleChunksOnDevice(size_t device,
+                            const FrontierPartitioner &splitted_frontier,
+                            int n_neighbors, const std::vector<Philox> &draws,
+                            const std::vector<size_t> &epoch_begin,
+                            std::atomic<size_t> &next_chunk,
+                            std::vector<uint> &result, float &fpga_time,
+                            float &data_transfer_time);
+
+  /**
+   * Resample the nodes split over chunks in the result of sampleOneLayer,
+   * which holds the samples of their first piece. The other pieces are read
+   * and sampled on device 0, then every draw of an occurrence takes from a
+   * piece picked by its share of the neighbors (of the ones left, without
+   * replacement), so the samples are those of the whole neighbor list.
+   */
+  void sampleSpannedNodes(const FrontierPartitioner &splitted_frontier,
+                          int n_neighbors, const std::vector<Philox> &draws,
+                          const std::vector<size_t> &epoch_begin,
+                          std::vector<uint> &result, float &fpga_time,
+                          float &data_transfer_time);
+
+  /**
+   * Sample one layer of the neighbors of the frontier. The chunks are shared
+   * among all loaded devices, and each device processes its chunks as a
+   * ping-pong pipeline over its two buffer slots: while the kernel samples
+   * chunk i, chunk i-1 is copied out and chunk i+1 is read. The result is in
+   * the grouped order of the frontier. The kernel run of the epoch e targets
+   * of chunk c is seeded with draws[e].seedFor(c), so the samples do not
+   * depend on which device takes the chunk, nor on the other epochs.
+   * @param epoch_begin: Where the frontier of every epoch starts in the
+   * partitioned frontier, and its size at the end
+   */
+  void sampleOneLayer(const FrontierPartitioner &frontier, int n_neighbors,
+                      const std::vector<Philox> &draws,
+                      const std::vector<size_t> &epoch_begin,
+                      std::vector<uint> &result);
+
+  /**
+   * Move the samples of grouped node j to the position idx[j] of its node in
+   * the frontier, writing into `flipped`
+   */
+  void scatterToOriginalOrder(const std::vector<uint> &result,
+                              const std::vector<uint> &idx, uint fanout,
+                              std::vector<uint> &flipped);
 
   /**
    * Clean up the sample result, remove -1 from the result, and also sort the
@@ -59,16 +315,33 @@ private:
   std::vector<uint> cleanSampleResult(std::vector<uint> &result);
 
   /**
-   * Internal call for this sampler to sample all the result of next layer
+   * Internal call for this sampler to sample all the layers of the next
+   * fused_epochs epochs into the slots from first_slot on, each with its own
+   * shuffle of the target nodes. Every layer is one pass over the edge file
+   * for all of them.
    */
-  void sampleNextEpoch(int bo_index);
+  void sampleNextEpochs(size_t first_slot);
 
   /**
-   * Analyze the frontier infomation and split them according to chunk info
+   * Wait for the group of epochs sampled in the background and drop it,
+   * taking back its calls, so that newEpochStart samples that group again
+   * with the settings changed since. Every setter calls this first.
    */
-  std::vector<std::vector<uint>> splitFrontier(std::vector<uint> &frontier);
+  void discardPendingEpochs();
 
 public:
+  // the DDR of the FPGA of a SmartSSD
+  static const size_t DEVICE_MEMORY_BYTE = (size_t)4 << 30;
+  // the largest fanout the kernel draws without replacement, its
+  // MAX_DISTINCT_SAMPLE
+  static const uint MAX_DISTINCT_FANOUT = 256;
+
+  /**
+   * Exit if a fanout is more than the kernel draws without replacement
+   */
+  static void checkDistinctFanouts(const std::vector<uint> &fanouts,
+                                   bool replace);
+
   /**
    * @brief Construct a new Streaming Sampler object
    * this will open the device and load xclbin file, also load the edge_file,
@@ -80,7 +353,8 @@ public:
    * @param chunk_info_file_path: The chunk info file path
    * @param target_node_file_path: The frontier file path
    * @param fanouts: The number of neighbors of each sample layer
-   * @param edge_chunk_size: The size of the chunk (number of integers)
+   * @param edge_chunk_size: The size of the chunk (number of integers), the
+   * stride of an edge file without chunk index
    */
   StreamingSampler(std::vector<uint> xrt_device_id, std::string xclbin_file,
                    std::string kernel_name, std::string edge_file_path,
@@ -101,12 +375,12 @@ public:
   /**
    * Get the chunk offsets
    */
-  std::vector<uint> getChunkOffsets();
+  const std::vector<uint> &getChunkOffsets();
 
   /**
    * Get target nodes
    */
-  std::vector<uint> getTargetNodes();
+  const std::vector<uint> &getTargetNodes();
 
   /**
    * Set the edge chunk size
@@ -119,35 +393,204 @@ public:
   size_t getEdgeChunkSize();
 
   /**
-   * Set the maxmium sample size per chunk
+   * Get the size of the result buffer of a device (number of integers), both
+   * slots
    */
-  void setMaxSampleSizePerChunk(size_t max_sample_size_per_chunk);
+  size_t getMaxSampleSizePerChunk();
 
   /**
-   * Get the maxmium sample size per chunk
+   * Get the size of the target buffer of a device (number of integers), both
+   * slots
    */
-  size_t getMaxSampleSizePerChunk();
+  size_t getMaxTargetSize();
 
   /**
-   * Set the maxmium target size
+   * Set the device memory the buffers of one device take, and size the
+   * target and result buffers again. Chunks with more targets than a buffer
+   * slot holds are sampled by several kernel runs.
    */
-  void setMaxTargetSize(size_t max_target_size);
+  void setDeviceMemory(size_t device_memory_byte);
 
   /**
-   * Get the maxmium target size
+   * Get the device memory the buffers of one device take
    */
-  size_t getMaxTargetSize();
+  size_t getDeviceMemory();
+
+  /**
+   * Number of nodes whose neighbors are split over chunks
+   */
+  size_t getNumSpannedNodes();
+
+  ~StreamingSampler();
+
+  /**
+   * Set the density above which a chunk is read whole: chunks whose targets'
+   * neighbors fill at most this part of the chunk only read those pages. 0
+   * always reads whole chunks.
+   */
+  void setSelectiveReadDensity(double density);
+
+  /**
+   * Get the selective read density
+   */
+  double getSelectiveReadDensity();
+
+  /**
+   * Number of bytes of the edge file read for sampling so far
+   */
+  size_t getEdgeBytesRead();
+
+  /**
+   * get fpga time
+   */
+  float getFpgaTime();
+
+  /**
+   * get transfer time, reading chunks included
+   */
+  float getTransferTime();
+
+  /**
+   * Whether the edge file is compressed. Compressed chunks are always read
+   * whole and decoded on the host.
+   */
+  bool isCompressed();
+
+  /**
+   * Sample by edge weight, the edge file and chunk info must be
+   * weighted_streaming_edges.bin and weighted_chunk_info.bin; exit if the
+   * edge file is compressed
+   */
+  void setWeighted(bool weighted) override;
+
+  /**
+   * Set the fanouts, exit if one is above MAX_DISTINCT_FANOUT while
+   * sampling without replacement
+   */
+  void setFanouts(std::vector<uint> fanouts) override;
+
+  void setSeed(uint64_t seed) override;
+
+  /**
+   * Sample with or without replacement, exit for the latter if a fanout is
+   * above MAX_DISTINCT_FANOUT
+   */
+  void setReplace(bool replace) override;
+
+  void setNodeMap(std::string old_to_new_path,
+                  std::string new_to_old_path) override;
+
+  /**
+   * Sample layer-wise instead of node-wise: every layer of an epoch draws
+   * fanout candidates from the neighbors of each frontier node as before,
+   * then every minibatch keeps budgets[i] of its distinct candidates of
+   * layer i, picked without replacement with probability proportional to
+   * their degree plus one. The batch layout is the same as node-wise, only
+   * the layers are capped, which bounds the frontier, and so the chunks read
+   * and the post-processing, of every next layer. An empty vector goes back
+   * to node-wise sampling.
+   * @param budgets: The nodes kept per batch, one per layer
+   */
+  void setLayerBudgets(std::vector<uint> budgets);
+
+  /**
+   * Get the layer budgets, empty for node-wise sampling
+   */
+  const std::vector<uint> &getLayerBudgets();
 
+  /**
+   * Sample the next k epochs together: every layer of the k epochs is one
+   * pass over the edge file, the kernel running once per epoch on every
+   * chunk read, so the edge file is read about k times less per epoch. The
+   * epochs are the same as sampled one by one, and all 2k of them (k served,
+   * k sampled in the background) are kept in host memory. Epochs sampled
+   * already are dropped, so set this before the first newEpochStart.
+   */
+  void setFusedEpochs(size_t k);
+
+  /**
+   * Get the number of epochs sampled by one pass
+   */
+  size_t getFusedEpochs();
+
+  /**
+   * Number of bytes a whole read of chunk `chunk` takes from the edge file
+   */
+  size_t getChunkStoredSize(size_t chunk);
+
+  /**
+   * Sample one layer of an arbitrary frontier outside of the epoch pipeline
+   * and append the sorted distinct sampled nodes to `result`. This uses the
+   * same device buffers as the epoch sampling, so it first waits for an
+   * epoch sampled in the background. Exits if n_neighbors is above
+   * MAX_DISTINCT_FANOUT while sampling without replacement.
+   * @param draws: The random draws of the layer
+   */
+  void sampleLayer(Span<const uint> frontier, uint n_neighbors,
+                   std::vector<uint> &result, const Philox &draws);
+
+  /**
+   * Set the number of target nodes in one minibatch
+   */
+  void setBatchSize(size_t batch_size);
+
+  /**
+   * Get the number of target nodes in one minibatch
+   */
+  size_t getBatchSize();
+
+  /**
+   * Return the next minibatch of the current epoch as copies. The minibatches
+   * are fixed when the epoch is sampled, so the given nodes are not used; the
+   * target nodes of a batch are given by getBatchTargets.
+   */
   std::vector<std::vector<uint>> getSample(std::vector<uint> fontier) override;
 
   /**
-   * An new epoch is started
+   * Copy the next minibatch of the current epoch into the workspace, like
+   * getSample
+   */
+  void sample(Span<const uint> frontier, SampleWorkspace &workspace) override;
+
+  /**
+   * Get the number of minibatches in the current epoch
+   */
+  size_t getNumBatches();
+
+  /**
+   * Get the target nodes of minibatch `batch` in the current epoch. With a
+   * node map, these and the batches are in original ids.
+   */
+  Span<const uint> getBatchTargets(size_t batch);
+
+  /**
+   * Get the sampled nodes of minibatch `batch` for each layer, as views into
+   * the epoch buffer. The views are valid until the next newEpochStart.
+   */
+  std::vector<Span<const uint>> getBatch(size_t batch);
+
+  /**
+   * An new epoch is started. The epoch was sampled in the background while
+   * the previous ones were served, so this is normally just a swap; when it
+   * starts a group of fused epochs, the group after it is then sampled in
+   * the background. A setter called between two epochs drops that group, so
+   * every setting applies from the next epoch on.
    */
   void newEpochStart();
 
-  std::vector<uint> flipBackToOriginalORder(std::vector<uint> &result, std::vector<uint> &idx, uint fanout);
+  std::vector<uint> flipBackToOriginalORder(const std::vector<uint> &result,
+                                            const std::vector<uint> &idx,
+                                            uint fanout);
 
-  std::vector<uint> deduplicateResult(std::vector<uint> &result, std::vector<std::vector<uint> > &sample_result_size, uint fanout);
+  /**
+   * Drop -1 and duplicates from the samples of every batch of a layer. The
+   * batch sizes of the layer are read from and appended to
+   * sample_result_size; `result` is overwritten.
+   */
+  std::vector<uint>
+  deduplicateResult(std::vector<uint> &result,
+                    std::vector<std::vector<uint>> &sample_result_size,
+                    uint fanout);
 };
 
 #endif // STREAMING_SAMPLER_HPP
\ No newline at end of file
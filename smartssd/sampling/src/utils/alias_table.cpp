@@ -0,0 +1,62 @@
+#include "alias_table.hpp"
+#include <algorithm>
+#include <cmath>
+
+bool AliasTable::build(const uint32_t *neighbors, const float *weights,
+                       size_t degree, AliasEntry *out) {
+  if (degree == 0) {
+    return true;
+  }
+  double sum = 0;
+  if (weights != nullptr) {
+    for (size_t i = 0; i < degree; i++) {
+      if (!std::isfinite(weights[i]) || weights[i] < 0) {
+        return false;
+      }
+      sum += weights[i];
+    }
+  }
+
+  // scaled to a mean of 1, a column keeps what it has below 1 and the rest
+  // of the column goes to a neighbor above 1
+  this->scaled.resize(degree);
+  this->small.clear();
+  this->large.clear();
+  for (size_t i = 0; i < degree; i++) {
+    this->scaled[i] = sum > 0 ? weights[i] * degree / sum : 1;
+    (this->scaled[i] < 1 ? this->small : this->large).push_back(i);
+  }
+  for (size_t i = 0; i < degree; i++) {
+    out[i].neighbor = neighbors[i];
+    out[i].alias = i;
+  }
+  while (!this->small.empty() && !this->large.empty()) {
+    uint32_t s = this->small.back();
+    uint32_t l = this->large.back();
+    this->small.pop_back();
+    this->large.pop_back();
+    out[s].alias = l;
+    this->scaled[l] += this->scaled[s] - 1;
+    (this->scaled[l] < 1 ? this->small : this->large).push_back(l);
+  }
+  // what is left is 1 up to rounding and keeps its neighbor
+  for (uint32_t i : this->small) {
+    this->scaled[i] = 1;
+  }
+  for (uint32_t i : this->large) {
+    this->scaled[i] = 1;
+  }
+
+  for (size_t i = 0; i < degree; i++) {
+    if (this->scaled[i] >= 1) {
+      // no coin is below 2^32, so the alias is the neighbor itself
+      out[i].threshold = UINT32_MAX;
+      out[i].alias = i;
+    } else {
+      out[i].threshold = static_cast<uint32_t>(
+          std::min(this->scaled[i] * 4294967296.0, 4294967295.0));
+    }
+    out[i].alias_neighbor = neighbors[out[i].alias];
+  }
+  return true;
+}
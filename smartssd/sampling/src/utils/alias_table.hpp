@@ -0,0 +1,61 @@
+/**
+ * Alias tables for weighted neighbor sampling (Walker, Vose). The edges of a
+ * node are replaced by one AliasEntry each, so a weighted draw costs the same
+ * as a uniform one: pick a column uniformly, then a coin decides between the
+ * neighbor of the column and its alias. An entry holds the alias neighbor
+ * itself, not just its column, so a draw reads a single entry.
+ *
+ * The entries of a node sit where its edges would, entry e of the graph is
+ * bytes [16 e, 16 e + 16) of the weighted edge files and the offsets are
+ * shared with the unweighted ones.
+ */
+#ifndef ALIAS_TABLE_HPP
+#define ALIAS_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct AliasEntry {
+  uint32_t neighbor;
+  // the column keeps its neighbor for coins below this, of 2^32
+  uint32_t threshold;
+  uint32_t alias_neighbor;
+  // the column of alias_neighbor in the node
+  uint32_t alias;
+};
+
+static_assert(sizeof(AliasEntry) == 16, "an alias entry is 4 words");
+
+class AliasTable {
+private:
+  // workspace, kept across builds so that building does not allocate
+  std::vector<double> scaled;
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+
+public:
+  // words of one entry, and entries of one 512 byte sector
+  static const size_t ENTRY_INTS = sizeof(AliasEntry) / 4;
+  static const size_t ENTRIES_PER_SECTOR = 512 / sizeof(AliasEntry);
+
+  /**
+   * Build the table of one node by Vose's algorithm, O(degree). A node
+   * whose weights are all zero is sampled uniformly.
+   * @param neighbors: The degree neighbors of the node
+   * @param weights: The weight of every edge, or nullptr for equal weights
+   * @param out: The degree entries of the node
+   * @return false if a weight is negative or not finite
+   */
+  bool build(const uint32_t *neighbors, const float *weights, size_t degree,
+             AliasEntry *out);
+
+  /**
+   * The neighbor a uniform coin picks from the entry of a uniform column
+   */
+  static uint32_t pick(const AliasEntry &entry, uint32_t coin) {
+    return coin < entry.threshold ? entry.neighbor : entry.alias_neighbor;
+  }
+};
+
+#endif // ALIAS_TABLE_HPP
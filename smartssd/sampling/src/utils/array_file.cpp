@@ -0,0 +1,153 @@
+#include "array_file.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+const uint32_t ArrayFile::MAGIC;
+const uint32_t ArrayFile::BYTE_ORDER_MARK;
+const size_t ArrayFile::HEADER_SIZE;
+
+// positions checked when guessing the width of raw offsets
+static const size_t GUESS_SAMPLES = 4096;
+
+ArrayFile::ArrayFile()
+    : map_ptr(nullptr), map_size_byte(0), data_ptr(nullptr), width(4),
+      count(0), has_header(false) {}
+
+ArrayFile::ArrayFile(std::string file_path, size_t raw_width) : ArrayFile() {
+  int fd = open(file_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "ERR: open " << file_path << " failed: " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) == -1) {
+    std::cerr << "ERR: " << file_path << " cannot be read" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  this->map_size_byte = statbuf.st_size;
+  if (this->map_size_byte == 0) {
+    close(fd);
+    return;
+  }
+  void *ptr = mmap(NULL, this->map_size_byte, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    std::cerr << "ERR: mmap " << file_path << " failed: " << strerror(errno)
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  this->map_ptr = static_cast<const char *>(ptr);
+
+  uint32_t header[4] = {0, 0, 0, 0};
+  uint64_t header_count = 0;
+  if (this->map_size_byte >= HEADER_SIZE) {
+    memcpy(header, this->map_ptr, sizeof(header));
+    memcpy(&header_count, this->map_ptr + 16, 8);
+  }
+  if (header[0] == MAGIC) {
+    if (header[1] != BYTE_ORDER_MARK) {
+      std::cerr << "ERR: " << file_path
+                << " was written on a machine of the other byte order"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if ((header[2] != 4 && header[2] != 8) ||
+        HEADER_SIZE + header_count * header[2] > this->map_size_byte) {
+      std::cerr << "ERR: " << file_path << " has a broken header" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    this->has_header = true;
+    this->width = header[2];
+    this->count = header_count;
+    this->data_ptr = this->map_ptr + HEADER_SIZE;
+    return;
+  }
+
+  this->data_ptr = this->map_ptr;
+  if (raw_width == 0) {
+    // 8 byte offsets seen as 4 byte halves go up and down, 4 byte ones never
+    // decrease
+    const uint32_t *halves = reinterpret_cast<const uint32_t *>(this->map_ptr);
+    size_t n_halves = this->map_size_byte / 4;
+    size_t stride = std::max<size_t>(2, n_halves / GUESS_SAMPLES / 2 * 2);
+    raw_width = 4;
+    if (this->map_size_byte % 8 == 0) {
+      for (size_t i = 0; i + 1 < n_halves; i += stride) {
+        if (halves[i] > halves[i + 1]) {
+          raw_width = 8;
+          break;
+        }
+      }
+    }
+  }
+  if (raw_width != 4 && raw_width != 8) {
+    std::cerr << "ERR: elements have to be 4 or 8 bytes, not " << raw_width
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  this->width = raw_width;
+  this->count = this->map_size_byte / raw_width;
+}
+
+ArrayFile::~ArrayFile() { unmap(); }
+
+void ArrayFile::unmap() {
+  if (this->map_ptr != nullptr) {
+    munmap(const_cast<char *>(this->map_ptr), this->map_size_byte);
+  }
+  this->map_ptr = nullptr;
+  this->data_ptr = nullptr;
+  this->map_size_byte = 0;
+  this->count = 0;
+}
+
+ArrayFile::ArrayFile(ArrayFile &&other) : ArrayFile() {
+  *this = std::move(other);
+}
+
+ArrayFile &ArrayFile::operator=(ArrayFile &&other) {
+  if (this != &other) {
+    unmap();
+    this->map_ptr = other.map_ptr;
+    this->map_size_byte = other.map_size_byte;
+    this->data_ptr = other.data_ptr;
+    this->width = other.width;
+    this->count = other.count;
+    this->has_header = other.has_header;
+    other.map_ptr = nullptr;
+    other.data_ptr = nullptr;
+    other.map_size_byte = 0;
+    other.count = 0;
+  }
+  return *this;
+}
+
+void ArrayFile::fillHeader(char *header, size_t width, uint64_t count) {
+  uint32_t fields[4] = {MAGIC, BYTE_ORDER_MARK, (uint32_t)width, 0};
+  memset(header, 0, HEADER_SIZE);
+  memcpy(header, fields, sizeof(fields));
+  memcpy(header + 16, &count, 8);
+}
+
+int ArrayFile::write(std::string file_path, const void *data, size_t width,
+                     size_t count) {
+  FILE *file = fopen(file_path.c_str(), "wb");
+  if (!file) {
+    return -1;
+  }
+  char header[HEADER_SIZE];
+  fillHeader(header, width, count);
+  bool ok = fwrite(header, 1, HEADER_SIZE, file) == HEADER_SIZE &&
+            fwrite(data, width, count, file) == count;
+  return fclose(file) == 0 && ok ? 0 : -1;
+}
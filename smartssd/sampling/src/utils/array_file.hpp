@@ -0,0 +1,109 @@
+/**
+ * A read only array of 4 or 8 byte integers mapped from a file, used for the
+ * offsets, chunk info and target node files so that startup does not read
+ * them element by element.
+ *
+ * Files written by ArrayFile::write start with a 64 byte header:
+ *   [magic][byte order mark][element width][0][number of elements, 64 bit]
+ * followed by the elements. Older files without the header are raw arrays;
+ * their element width is given, or for offsets guessed: offsets never
+ * decrease, which 8 byte offsets seen as 4 byte halves do.
+ */
+#ifndef ARRAY_FILE_HPP
+#define ARRAY_FILE_HPP
+
+#include "span.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class ArrayFile {
+private:
+  const char *map_ptr;
+  size_t map_size_byte;
+  const char *data_ptr;
+  size_t width;
+  size_t count;
+  bool has_header;
+
+  void unmap();
+
+public:
+  // "ARRF"
+  static const uint32_t MAGIC = 0x46525241;
+  static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+  static const size_t HEADER_SIZE = 64;
+
+  /**
+   * An empty array
+   */
+  ArrayFile();
+
+  /**
+   * Map an array file, exit if that fails
+   * @param file_path: The file to map
+   * @param raw_width: The element width of a file without header, 0 to guess
+   * it as for offsets
+   */
+  ArrayFile(std::string file_path, size_t raw_width = 4);
+
+  ~ArrayFile();
+
+  ArrayFile(ArrayFile &&other);
+  ArrayFile &operator=(ArrayFile &&other);
+  ArrayFile(const ArrayFile &) = delete;
+  ArrayFile &operator=(const ArrayFile &) = delete;
+
+  /**
+   * Number of elements
+   */
+  size_t size() const { return this->count; }
+
+  bool empty() const { return this->count == 0; }
+
+  /**
+   * Bytes of one element, 4 or 8
+   */
+  size_t getWidth() const { return this->width; }
+
+  /**
+   * Whether the file has the self describing header
+   */
+  bool hasHeader() const { return this->has_header; }
+
+  /**
+   * Element i, whatever the width
+   */
+  uint64_t operator[](size_t i) const {
+    if (this->width == 4) {
+      return reinterpret_cast<const uint32_t *>(this->data_ptr)[i];
+    }
+    return reinterpret_cast<const uint64_t *>(this->data_ptr)[i];
+  }
+
+  /**
+   * The elements as T, which has to be as wide as them
+   */
+  template <typename T> Span<const T> view() const {
+    if (sizeof(T) != this->width) {
+      return Span<const T>();
+    }
+    return Span<const T>(reinterpret_cast<const T *>(this->data_ptr),
+                         this->count);
+  }
+
+  /**
+   * Fill the HEADER_SIZE bytes of header for count elements of width bytes,
+   * for writers that do not have all the elements at once
+   */
+  static void fillHeader(char *header, size_t width, uint64_t count);
+
+  /**
+   * Write count elements of width bytes with the header
+   * @return 0 on success, -1 if the file cannot be written
+   */
+  static int write(std::string file_path, const void *data, size_t width,
+                   size_t count);
+};
+
+#endif // ARRAY_FILE_HPP
@@ -0,0 +1,328 @@
+#include "artifact_writer.hpp"
+#include "array_file.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static FILE *openOutput(std::string file_path) {
+  FILE *file = fopen(file_path.c_str(), "wb");
+  if (!file) {
+    std::cerr << "Failed to open output file " << file_path << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // large buffers, the files are written strictly in order
+  setvbuf(file, nullptr, _IOFBF, 16 << 20);
+  return file;
+}
+
+static void writeOrDie(FILE *file, const void *data, size_t size_byte) {
+  if (size_byte > 0 && fwrite(data, 1, size_byte, file) != size_byte) {
+    std::cerr << "Failed to write: " << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+ArtifactWriter::ArtifactWriter(std::string output_dir, size_t chunk_size_byte,
+                               size_t offset_width, bool sequential_read,
+                               bool raw_arrays, bool weighted,
+                               bool variable_chunks)
+    : max_chunk_ints(chunk_size_byte / 4), offset_width(offset_width),
+      sequential_read(sequential_read), raw_arrays(raw_arrays),
+      weighted(weighted), variable_chunks(variable_chunks),
+      output_dir(output_dir), zeros(1 << 20, 0) {
+  this->streaming.file = openOutput(output_dir + "/streaming_edges.bin");
+  this->streaming.chunk_info_path = output_dir + "/chunk_info.bin";
+  this->streaming.chunk_index_path = output_dir + "/chunk_index.bin";
+  this->streaming.chunk_edges.reserve(this->max_chunk_ints);
+  this->random_read_file = openOutput(output_dir + "/random_read_edges.bin");
+  this->offsets_file = openOutput(output_dir + "/offsets.bin");
+  if (!raw_arrays) {
+    // the header is written again once the number of nodes is known
+    writeOrDie(this->offsets_file, this->zeros.data(),
+               ArrayFile::HEADER_SIZE);
+  }
+  if (sequential_read) {
+    this->sequential_file =
+        openOutput(output_dir + "/sequential_read_edges.bin");
+  }
+  if (weighted) {
+    this->weighted_streaming.file =
+        openOutput(output_dir + "/weighted_streaming_edges.bin");
+    this->weighted_streaming.edge_ints = AliasTable::ENTRY_INTS;
+    this->weighted_streaming.chunk_info_path =
+        output_dir + "/weighted_chunk_info.bin";
+    this->weighted_streaming.chunk_index_path =
+        output_dir + "/weighted_chunk_index.bin";
+    this->weighted_file = openOutput(output_dir + "/weighted_edges.bin");
+  }
+}
+
+void ArtifactWriter::writeChunk(ChunkStream &stream, bool last,
+                                bool split) {
+  uint32_t n = stream.chunk_degrees.size();
+  if (n == 0) {
+    return;
+  }
+  stream.chunk_header.assign({n, (uint32_t)stream.chunk_start, n + 3});
+  for (uint32_t degree : stream.chunk_degrees) {
+    stream.chunk_header.push_back(stream.chunk_header.back() +
+                                  degree * stream.edge_ints);
+  }
+  size_t size_byte =
+      (stream.chunk_header.size() + stream.chunk_edges.size()) * 4;
+  writeOrDie(stream.file, stream.chunk_header.data(),
+             stream.chunk_header.size() * 4);
+  writeOrDie(stream.file, stream.chunk_edges.data(),
+             stream.chunk_edges.size() * 4);
+  stream.chunk_pos.push_back(
+      stream.chunk_pos.back() +
+      pad(stream.file, size_byte, last, this->variable_chunks));
+
+  if (this->sequential_read && &stream == &this->streaming) {
+    writeOrDie(this->sequential_file, stream.chunk_header.data(), 8);
+    const uint32_t *edges = stream.chunk_edges.data();
+    for (uint32_t degree : stream.chunk_degrees) {
+      writeOrDie(this->sequential_file, &degree, 4);
+      writeOrDie(this->sequential_file, edges, (size_t)degree * 4);
+      edges += degree;
+    }
+    // one word less than the streaming chunk, no closing offset
+    pad(this->sequential_file, size_byte - 4, last, false);
+  }
+
+  stream.chunk_ends.push_back(stream.chunk_start + n);
+  // a split node is the start node of the next chunk too
+  stream.chunk_start += split ? n - 1 : n;
+  stream.chunk_degrees.clear();
+  stream.chunk_edges.clear();
+}
+
+void ArtifactWriter::appendNode(ChunkStream &stream, uint32_t degree,
+                                const uint32_t *words) {
+  // the same chunking as the notebooks: a node goes to the next chunk when
+  // its offset and edges do not fit anymore
+  size_t n_words = (size_t)degree * stream.edge_ints;
+  size_t chunk_ints =
+      3 + stream.chunk_degrees.size() + stream.chunk_edges.size();
+  if (chunk_ints + n_words + 1 > this->max_chunk_ints &&
+      !stream.chunk_degrees.empty()) {
+    writeChunk(stream, false);
+  }
+  // a node larger than a chunk fills chunks of its own with whole edges,
+  // its last piece starts the next chunk
+  size_t piece_words =
+      (this->max_chunk_ints - 4) / stream.edge_ints * stream.edge_ints;
+  while (4 + n_words > this->max_chunk_ints) {
+    stream.chunk_degrees.push_back(piece_words / stream.edge_ints);
+    stream.chunk_edges.insert(stream.chunk_edges.end(), words,
+                              words + piece_words);
+    writeChunk(stream, false, true);
+    words += piece_words;
+    n_words -= piece_words;
+  }
+  stream.chunk_degrees.push_back(n_words / stream.edge_ints);
+  stream.chunk_edges.insert(stream.chunk_edges.end(), words, words + n_words);
+}
+
+size_t ArtifactWriter::pad(FILE *file, size_t size_byte, bool last,
+                           bool variable) {
+  size_t chunk_size_byte = this->max_chunk_ints * 4;
+  // a variable chunk still starts on a page, for O_DIRECT and page reads
+  size_t padding = last       ? (512 - size_byte % 512) % 512
+                   : variable ? (4096 - size_byte % 4096) % 4096
+                              : chunk_size_byte - size_byte;
+  size_byte += padding;
+  while (padding > 0) {
+    size_t n = std::min(padding, this->zeros.size());
+    writeOrDie(file, this->zeros.data(), n);
+    padding -= n;
+  }
+  return size_byte;
+}
+
+void ArtifactWriter::addNodes(uint64_t first_node, const uint32_t *degrees,
+                              size_t n, const uint32_t *edges,
+                              const float *weights) {
+  if (first_node < this->n_nodes) {
+    std::cerr << "Node " << first_node << " comes after node "
+              << this->n_nodes - 1 << ", nodes have to be ascending"
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  static const uint32_t no_degree = 0;
+  while (this->n_nodes < first_node) {
+    addNodes(this->n_nodes, &no_degree, 1, nullptr);
+  }
+
+  // offsets of the nodes, and their edges as they are for random reads
+  this->offsets_buffer.resize(n * this->offset_width);
+  uint64_t n_block_edges = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t offset = this->n_edges + n_block_edges;
+    if (this->offset_width == 4 && offset > UINT32_MAX) {
+      std::cerr << "More than 2^32 edges, use --offset-width 8" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    memcpy(this->offsets_buffer.data() + i * this->offset_width, &offset,
+           this->offset_width);
+    n_block_edges += degrees[i];
+  }
+  writeOrDie(this->offsets_file, this->offsets_buffer.data(),
+             this->offsets_buffer.size());
+  writeOrDie(this->random_read_file, edges, n_block_edges * 4);
+
+  // the alias tables take the place of the edges
+  if (this->weighted) {
+    this->entries.resize(n_block_edges);
+    uint64_t first_edge = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (!this->alias_table.build(edges + first_edge,
+                                   weights ? weights + first_edge : nullptr,
+                                   degrees[i],
+                                   this->entries.data() + first_edge)) {
+        std::cerr << "Node " << this->n_nodes + i
+                  << " has a negative or not finite edge weight" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      first_edge += degrees[i];
+    }
+    writeOrDie(this->weighted_file, this->entries.data(),
+               n_block_edges * sizeof(AliasEntry));
+  }
+
+  const AliasEntry *entries = this->entries.data();
+  for (size_t i = 0; i < n; i++) {
+    appendNode(this->streaming, degrees[i], edges);
+    if (this->weighted) {
+      appendNode(this->weighted_streaming, degrees[i],
+                 reinterpret_cast<const uint32_t *>(entries));
+      entries += degrees[i];
+    }
+    edges += degrees[i];
+    this->n_nodes++;
+  }
+  this->n_edges += n_block_edges;
+}
+
+void ArtifactWriter::writeChunkInfo(ChunkStream &stream) {
+  FILE *chunk_info_file = openOutput(stream.chunk_info_path);
+  if (!this->raw_arrays) {
+    char header[ArrayFile::HEADER_SIZE];
+    ArrayFile::fillHeader(header, 4, stream.chunk_ends.size());
+    writeOrDie(chunk_info_file, header, ArrayFile::HEADER_SIZE);
+  }
+  writeOrDie(chunk_info_file, stream.chunk_ends.data(),
+             stream.chunk_ends.size() * 4);
+  if (fclose(chunk_info_file) != 0) {
+    std::cerr << "Failed to close " << stream.chunk_info_path << ": "
+              << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  FILE *chunk_index_file = openOutput(stream.chunk_index_path);
+  if (!this->raw_arrays) {
+    char header[ArrayFile::HEADER_SIZE];
+    ArrayFile::fillHeader(header, 8, stream.chunk_pos.size());
+    writeOrDie(chunk_index_file, header, ArrayFile::HEADER_SIZE);
+  }
+  writeOrDie(chunk_index_file, stream.chunk_pos.data(),
+             stream.chunk_pos.size() * 8);
+  if (fclose(chunk_index_file) != 0) {
+    std::cerr << "Failed to close " << stream.chunk_index_path << ": "
+              << strerror(errno) << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void ArtifactWriter::finish() {
+  if (this->offset_width == 4 && this->n_edges > UINT32_MAX) {
+    std::cerr << "More than 2^32 edges, use --offset-width 8" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  writeChunk(this->streaming, true);
+  writeOrDie(this->offsets_file, &this->n_edges, this->offset_width);
+  size_t edges_size_byte = this->n_edges * 4;
+  writeOrDie(this->random_read_file, this->zeros.data(),
+             (512 - edges_size_byte % 512) % 512);
+  if (!this->raw_arrays) {
+    char header[ArrayFile::HEADER_SIZE];
+    ArrayFile::fillHeader(header, this->offset_width, this->n_nodes + 1);
+    if (fseek(this->offsets_file, 0, SEEK_SET) != 0) {
+      std::cerr << "Failed to seek: " << strerror(errno) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    writeOrDie(this->offsets_file, header, ArrayFile::HEADER_SIZE);
+  }
+  writeChunkInfo(this->streaming);
+  if (this->weighted) {
+    writeChunk(this->weighted_streaming, true);
+    // a whole number of entries per sector, so this is 0
+    writeOrDie(this->weighted_file, this->zeros.data(),
+               (512 - this->n_edges * sizeof(AliasEntry) % 512) % 512);
+    writeChunkInfo(this->weighted_streaming);
+  }
+  for (FILE *file : {this->streaming.file, this->random_read_file,
+                     this->offsets_file, this->sequential_file,
+                     this->weighted_streaming.file, this->weighted_file}) {
+    if (file && fclose(file) != 0) {
+      std::cerr << "Failed to close an output file: " << strerror(errno)
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+void ArtifactWriter::writeUintArray(std::string file_name,
+                                    const std::vector<uint32_t> &values) {
+  FILE *file = openOutput(this->output_dir + "/" + file_name);
+  if (!this->raw_arrays) {
+    char header[ArrayFile::HEADER_SIZE];
+    ArrayFile::fillHeader(header, 4, values.size());
+    writeOrDie(file, header, ArrayFile::HEADER_SIZE);
+  }
+  writeOrDie(file, values.data(), values.size() * 4);
+  fclose(file);
+}
+
+void ArtifactWriter::writeTrainNodes(
+    const std::vector<uint32_t> &train_nodes) {
+  for (uint32_t node : train_nodes) {
+    if (node >= this->n_nodes) {
+      std::cerr << "Training node " << node << " is not in the graph"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  writeUintArray("train.bin", train_nodes);
+}
+
+void ArtifactWriter::writeNodeMaps(const std::vector<uint32_t> &new_to_old) {
+  std::vector<uint32_t> old_to_new(new_to_old.size(), UINT32_MAX);
+  for (size_t i = 0; i < new_to_old.size(); i++) {
+    if (new_to_old[i] >= new_to_old.size() ||
+        old_to_new[new_to_old[i]] != UINT32_MAX) {
+      std::cerr << "The node order is not a permutation" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    old_to_new[new_to_old[i]] = i;
+  }
+  writeUintArray("old_to_new.bin", old_to_new);
+  writeUintArray("new_to_old.bin", new_to_old);
+}
+
+uint64_t ArtifactWriter::getNumNodes() { return this->n_nodes; }
+
+uint64_t ArtifactWriter::getNumEdges() { return this->n_edges; }
+
+size_t ArtifactWriter::getNumChunks() {
+  return this->streaming.chunk_ends.size();
+}
+
+size_t ArtifactWriter::getNumWeightedChunks() {
+  return this->weighted_streaming.chunk_ends.size();
+}
+
+bool ArtifactWriter::isWeighted() { return this->weighted; }
@@ -0,0 +1,177 @@
+/**
+ * Writes a graph, node by node in id order, into every file the samplers
+ * read:
+ *   streaming_edges.bin        chunks of [n_nodes][start_node][offsets][edges]
+ *   chunk_info.bin             the end node (exclusive) of every chunk, int32
+ *   chunk_index.bin            the file offset of every chunk and of the end
+ *                              of the last one, uint64
+ *   random_read_edges.bin      all the edges, padded to 512 bytes
+ *   offsets.bin                the first edge of every node and the end
+ *   train.bin                  the training nodes, uint32
+ *   sequential_read_edges.bin  chunks of [n_nodes][start_node][degree][edges]
+ *                              ..., only if asked for
+ * and for weighted graphs the alias tables (see AliasTable) of the edges:
+ *   weighted_streaming_edges.bin  chunks of [n_nodes][start_node][offsets]
+ *                                 [entries], the offsets in words
+ *   weighted_chunk_info.bin       the end node of every weighted chunk
+ *   weighted_chunk_index.bin      the file offset of every weighted chunk
+ *   weighted_edges.bin            all the entries, padded to 512 bytes
+ * and for graphs whose nodes were reordered (see NodeOrder) the id maps:
+ *   old_to_new.bin             the new id of every original node, uint32
+ *   new_to_old.bin             the original id of every node, uint32
+ * chunk_info.bin, the chunk indexes, offsets.bin, train.bin and the maps
+ * start with the ArrayFile header, unless raw arrays are asked for. Only the
+ * chunk being filled is held in memory.
+ *
+ * Chunks are padded to the chunk size, so they are at a fixed stride, or with
+ * variable chunks only to a page, and then found by the chunk index. A node
+ * with more edges than a chunk holds starts a new chunk and is split: every
+ * piece but the last fills a chunk of its own, [1][node][offsets][piece], and
+ * the last one starts the next chunk. The chunks of the pieces all end at the
+ * node + 1 in the chunk info, and a chunk whose start node is before the end
+ * of the chunk before it continues the last node of that chunk.
+ */
+#ifndef ARTIFACT_WRITER_HPP
+#define ARTIFACT_WRITER_HPP
+
+#include "alias_table.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class ArtifactWriter {
+private:
+  /**
+   * A streaming edge file and the chunk being filled, edge_ints words per
+   * edge
+   */
+  struct ChunkStream {
+    FILE *file = nullptr;
+    size_t edge_ints = 1;
+    std::string chunk_info_path;
+    std::string chunk_index_path;
+    std::vector<int32_t> chunk_ends;
+    // file offset of every chunk written and of the end of the last one
+    std::vector<uint64_t> chunk_pos = {0};
+    uint64_t chunk_start = 0;
+    std::vector<uint32_t> chunk_degrees;
+    std::vector<uint32_t> chunk_edges;
+    std::vector<uint32_t> chunk_header;
+  };
+
+  size_t max_chunk_ints;
+  size_t offset_width;
+  bool sequential_read;
+  bool raw_arrays;
+  bool weighted;
+  bool variable_chunks;
+  std::string output_dir;
+
+  ChunkStream streaming;
+  ChunkStream weighted_streaming;
+  FILE *sequential_file = nullptr;
+  FILE *random_read_file;
+  FILE *weighted_file = nullptr;
+  FILE *offsets_file;
+
+  uint64_t n_nodes = 0;
+  uint64_t n_edges = 0;
+  std::vector<char> offsets_buffer;
+  std::vector<char> zeros;
+
+  // the alias tables of the nodes added last
+  AliasTable alias_table;
+  std::vector<AliasEntry> entries;
+
+  /**
+   * Write the chunk being filled
+   * @param split: Its last node goes on in the next chunk
+   */
+  void writeChunk(ChunkStream &stream, bool last, bool split = false);
+
+  /**
+   * Add the words of the next node to the chunk of stream, first writing the
+   * chunk if they do not fit anymore, and splitting them over chunks if they
+   * do not fit in one
+   */
+  void appendNode(ChunkStream &stream, uint32_t degree,
+                  const uint32_t *words);
+
+  /**
+   * Write the chunk info and the chunk index of stream
+   */
+  void writeChunkInfo(ChunkStream &stream);
+
+  /**
+   * Write the uint32 array file file_name
+   */
+  void writeUintArray(std::string file_name,
+                      const std::vector<uint32_t> &values);
+
+  /**
+   * Pad a chunk of size_byte to the chunk size, or to a page for variable
+   * chunks, or the last one to 512 bytes
+   * @return The padded size of the chunk
+   */
+  size_t pad(FILE *file, size_t size_byte, bool last, bool variable);
+
+public:
+  /**
+   * Create the output files in output_dir, exit if that fails
+   * @param chunk_size_byte: The size of a streaming chunk, a multiple of 512
+   * @param offset_width: Bytes of one offset, 4 or 8
+   * @param sequential_read: Also write sequential_read_edges.bin
+   * @param raw_arrays: Write the array files without header
+   * @param weighted: Also write the weighted files
+   * @param variable_chunks: Pad the streaming chunks to a page instead of the
+   * chunk size, which then bounds them
+   */
+  ArtifactWriter(std::string output_dir, size_t chunk_size_byte,
+                 size_t offset_width, bool sequential_read = false,
+                 bool raw_arrays = false, bool weighted = false,
+                 bool variable_chunks = false);
+
+  /**
+   * Append n nodes starting at first_node, whose edges are back to back in
+   * `edges`. Nodes skipped since the last call get no edges.
+   * @param weights: The weight of every edge for the weighted files, or
+   * nullptr for equal weights; exit if one is negative or not finite
+   */
+  void addNodes(uint64_t first_node, const uint32_t *degrees, size_t n,
+                const uint32_t *edges, const float *weights = nullptr);
+
+  /**
+   * Write the last chunk, the closing offset, the chunk info and the chunk
+   * index
+   */
+  void finish();
+
+  /**
+   * Write train.bin, exit if a node is not in the graph
+   */
+  void writeTrainNodes(const std::vector<uint32_t> &train_nodes);
+
+  /**
+   * Write old_to_new.bin and new_to_old.bin of a reordered graph, exit if
+   * new_to_old is not a permutation
+   * @param new_to_old: The original id of every node as written
+   */
+  void writeNodeMaps(const std::vector<uint32_t> &new_to_old);
+
+  uint64_t getNumNodes();
+
+  uint64_t getNumEdges();
+
+  size_t getNumChunks();
+
+  /**
+   * Number of chunks of weighted_streaming_edges.bin
+   */
+  size_t getNumWeightedChunks();
+
+  bool isWeighted();
+};
+
+#endif // ARTIFACT_WRITER_HPP
@@ -0,0 +1,198 @@
+#include "edge_codec.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EDGE_CODEC_X86
+#endif
+
+const uint32_t EdgeCodec::FILE_MAGIC;
+const size_t EdgeCodec::PAGE_SIZE;
+const size_t EdgeCodec::PAYLOAD_PADDING;
+
+// bytes of value i of a quad with control byte `control`
+static inline size_t codeLength(uint8_t control, size_t i) {
+  return ((control >> (2 * i)) & 3) + 1;
+}
+
+static inline uint8_t lengthCode(uint32_t value) {
+  if (value < (1u << 8)) {
+    return 0;
+  }
+  if (value < (1u << 16)) {
+    return 1;
+  }
+  if (value < (1u << 24)) {
+    return 2;
+  }
+  return 3;
+}
+
+size_t EdgeCodec::maxEncodedSize(size_t n) { return (n + 3) / 4 + n * 4; }
+
+size_t EdgeCodec::encode(const uint32_t *in, size_t n, uint8_t *out) {
+  uint8_t *control = out;
+  uint8_t *data = out + (n + 3) / 4;
+  memset(control, 0, (n + 3) / 4);
+  uint32_t prev = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint32_t delta = in[i] - prev;
+    prev = in[i];
+    uint8_t code = lengthCode(delta);
+    control[i / 4] |= code << (2 * (i % 4));
+    // little endian, the low bytes of the value are the ones stored
+    memcpy(data, &delta, 4);
+    data += code + 1;
+  }
+  return data - out;
+}
+
+// the scalar decoder of up to four values
+static inline const uint8_t *decodeQuadScalar(uint8_t control,
+                                              const uint8_t *data, size_t n,
+                                              uint32_t &prev, uint32_t *out) {
+  for (size_t i = 0; i < n; i++) {
+    size_t length = codeLength(control, i);
+    uint32_t delta = 0;
+    memcpy(&delta, data, length);
+    data += length;
+    prev += delta;
+    out[i] = prev;
+  }
+  return data;
+}
+
+#ifdef EDGE_CODEC_X86
+// for every control byte, the shuffle that spreads the bytes of its four
+// values into four 32 bit lanes, and the number of bytes they take
+struct ShuffleTable {
+  uint8_t shuffle[256][16];
+  uint8_t length[256];
+
+  ShuffleTable() {
+    for (int control = 0; control < 256; control++) {
+      size_t pos = 0;
+      for (size_t i = 0; i < 4; i++) {
+        size_t length = codeLength(control, i);
+        for (size_t b = 0; b < 4; b++) {
+          // 0x80 zeroes the byte
+          this->shuffle[control][i * 4 + b] = b < length ? pos + b : 0x80;
+        }
+        pos += length;
+      }
+      this->length[control] = pos;
+    }
+  }
+};
+
+static const ShuffleTable shuffle_table;
+
+__attribute__((target("ssse3"))) static size_t
+decodeSsse3(const uint8_t *in, size_t n, uint32_t *out) {
+  const uint8_t *control = in;
+  const uint8_t *data = in + (n + 3) / 4;
+  __m128i prev = _mm_setzero_si128();
+  size_t n_quads = n / 4;
+  for (size_t q = 0; q < n_quads; q++) {
+    uint8_t c = control[q];
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    __m128i shuffle = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(shuffle_table.shuffle[c]));
+    __m128i deltas = _mm_shuffle_epi8(bytes, shuffle);
+    // prefix sum of the four deltas, plus the last value of the quad before
+    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+    __m128i values = _mm_add_epi32(deltas, prev);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + q * 4), values);
+    prev = _mm_shuffle_epi32(values, 0xFF);
+    data += shuffle_table.length[c];
+  }
+  uint32_t last = _mm_cvtsi128_si32(prev);
+  if (n % 4 != 0) {
+    data = decodeQuadScalar(control[n_quads], data, n % 4, last,
+                            out + n_quads * 4);
+  }
+  return data - in;
+}
+
+static bool hasSsse3() {
+  // this runs before the constructors that would set the CPU model up
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("ssse3");
+}
+
+static const bool has_ssse3 = hasSsse3();
+#endif
+
+size_t EdgeCodec::decode(const uint8_t *in, size_t n, uint32_t *out) {
+#ifdef EDGE_CODEC_X86
+  if (has_ssse3) {
+    return decodeSsse3(in, n, out);
+  }
+#endif
+  const uint8_t *control = in;
+  const uint8_t *data = in + (n + 3) / 4;
+  uint32_t prev = 0;
+  for (size_t q = 0; q * 4 < n; q++) {
+    size_t n_values = n - q * 4 < 4 ? n - q * 4 : 4;
+    data = decodeQuadScalar(control[q], data, n_values, prev, out + q * 4);
+  }
+  return data - in;
+}
+
+size_t EdgeCodec::encodeChunk(const uint32_t *raw_chunk,
+                              std::vector<uint8_t> &out) {
+  uint32_t n_nodes = raw_chunk[0];
+  const uint32_t *offsets = raw_chunk + 2;
+  size_t n_edges = offsets[n_nodes] - offsets[0];
+
+  size_t chunk_begin = out.size();
+  size_t header_words = 2 + 2 * ((size_t)n_nodes + 1);
+  out.resize(chunk_begin + header_words * 4 + maxEncodedSize(n_edges) +
+             n_nodes + PAYLOAD_PADDING);
+  uint32_t header[2] = {n_nodes, raw_chunk[1]};
+  memcpy(out.data() + chunk_begin, header, 8);
+  memcpy(out.data() + chunk_begin + 8, offsets, ((size_t)n_nodes + 1) * 4);
+
+  uint8_t *payload_offsets =
+      out.data() + chunk_begin + (3 + (size_t)n_nodes) * 4;
+  uint8_t *payload = out.data() + chunk_begin + header_words * 4;
+  uint32_t pos = 0;
+  for (uint32_t i = 0; i <= n_nodes; i++) {
+    memcpy(payload_offsets + (size_t)i * 4, &pos, 4);
+    if (i < n_nodes) {
+      pos += encode(raw_chunk + offsets[i], offsets[i + 1] - offsets[i],
+                    payload + pos);
+    }
+  }
+  size_t chunk_size = header_words * 4 + pos + PAYLOAD_PADDING;
+  memset(payload + pos, 0, PAYLOAD_PADDING);
+  out.resize(chunk_begin + chunk_size);
+  return chunk_size;
+}
+
+size_t EdgeCodec::decodeChunk(const uint8_t *compressed_chunk,
+                              uint32_t *raw_chunk) {
+  uint32_t n_nodes;
+  memcpy(&n_nodes, compressed_chunk, 4);
+  // the raw header is copied as it is
+  memcpy(raw_chunk, compressed_chunk, (3 + (size_t)n_nodes) * 4);
+  const uint32_t *offsets = raw_chunk + 2;
+  const uint8_t *payload_offsets =
+      compressed_chunk + (3 + (size_t)n_nodes) * 4;
+  const uint8_t *payload =
+      compressed_chunk + (4 + 2 * (size_t)n_nodes) * 4;
+  // degrees are skewed, so hand out the nodes in small pieces
+#pragma omp parallel for schedule(dynamic, 256)
+  for (size_t i = 0; i < n_nodes; i++) {
+    uint32_t pos;
+    memcpy(&pos, payload_offsets + i * 4, 4);
+    decode(payload + pos, offsets[i + 1] - offsets[i], raw_chunk + offsets[i]);
+  }
+  return offsets[n_nodes];
+}
+
+size_t EdgeCodec::fileHeaderSize(size_t n_chunks) {
+  size_t size = 16 + (n_chunks + 1) * 8;
+  return (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
@@ -0,0 +1,74 @@
+/**
+ * Compression of the streaming edge file. Every neighbor list is delta coded
+ * and the deltas are stored as stream VByte: one 2 bit length code per value,
+ * four to a control byte, followed by the 1 to 4 bytes of each value. Sorted
+ * neighbor lists have small deltas and mostly need one or two bytes per edge.
+ *
+ * A compressed chunk keeps the addressing of a raw chunk:
+ *   [n_nodes][start_node][raw offsets, n_nodes + 1]
+ *   [payload offsets, n_nodes + 1][payload][16 bytes of padding]
+ * The raw offsets are the ones of the raw chunk, so decoding a chunk gives
+ * back the raw chunk the kernel expects. Payload offsets are in bytes from the
+ * start of the payload.
+ *
+ * A compressed edge file starts with a header of whole pages:
+ *   [magic][n_chunks][raw chunk size in bytes, 64 bit]
+ *   [file offset of every chunk and of the end, n_chunks + 1, 64 bit]
+ * and every chunk starts on a page, so that it can be read with O_DIRECT.
+ */
+#ifndef EDGE_CODEC_HPP
+#define EDGE_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class EdgeCodec {
+public:
+  // "SVB1"
+  static const uint32_t FILE_MAGIC = 0x31425653;
+  static const size_t PAGE_SIZE = 4096;
+  // bytes after the payload of a chunk, so that quads can be loaded whole
+  static const size_t PAYLOAD_PADDING = 16;
+
+  /**
+   * Upper bound of the encoded size of n values
+   */
+  static size_t maxEncodedSize(size_t n);
+
+  /**
+   * Delta code and encode n values, the deltas wrap around so any order is
+   * kept, but sorted values compress best.
+   * @return The number of bytes written to out
+   */
+  static size_t encode(const uint32_t *in, size_t n, uint8_t *out);
+
+  /**
+   * Decode n values encoded by encode. Up to 16 bytes after the encoded
+   * values may be read.
+   * @return The number of bytes read from in
+   */
+  static size_t decode(const uint8_t *in, size_t n, uint32_t *out);
+
+  /**
+   * Compress one raw chunk ([n_nodes][start_node][offsets][edges]) and
+   * append it to out
+   * @return The size of the compressed chunk in bytes
+   */
+  static size_t encodeChunk(const uint32_t *raw_chunk,
+                            std::vector<uint8_t> &out);
+
+  /**
+   * Decode a compressed chunk back into the raw chunk layout
+   * @return The size of the raw chunk in 4 byte words
+   */
+  static size_t decodeChunk(const uint8_t *compressed_chunk,
+                            uint32_t *raw_chunk);
+
+  /**
+   * Size of the header of a compressed edge file with n_chunks chunks
+   */
+  static size_t fileHeaderSize(size_t n_chunks);
+};
+
+#endif // EDGE_CODEC_HPP
@@ -0,0 +1,322 @@
+#include "graph_generator.hpp"
+#include "artifact_writer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <omp.h>
+#include <random>
+
+// nodes generated by one thread at a time; blocks start at multiples of it,
+// which keeps the graph independent of the number of threads
+static const size_t BLOCK_SIZE = 1 << 16;
+
+static uint64_t splitmix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+GraphGenerator::GraphGenerator(Model model, uint64_t n_nodes,
+                               double avg_degree, uint64_t seed)
+    : model(model), n_nodes(n_nodes), avg_degree(avg_degree), seed(seed),
+      max_degree(n_nodes) {
+  if (n_nodes == 0 || n_nodes >= UINT32_MAX) {
+    std::cerr << "ERR: a graph has 1 to 2^32 - 2 nodes, not " << n_nodes
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (!(avg_degree > 0)) {
+    std::cerr << "ERR: the average degree has to be positive" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  setup();
+}
+
+GraphGenerator::Model GraphGenerator::parseModel(std::string name) {
+  if (name == "rmat") {
+    return RMAT;
+  } else if (name == "power_law") {
+    return POWER_LAW;
+  } else if (name == "log_normal") {
+    return LOG_NORMAL;
+  }
+  std::cerr << "ERR: unknown graph model " << name
+            << ", use rmat, power_law or log_normal" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+void GraphGenerator::setup() {
+  if (this->model == RMAT) {
+    double d = 1 - this->rmat_a - this->rmat_b - this->rmat_c;
+    if (this->rmat_a <= 0 || this->rmat_b <= 0 || this->rmat_c <= 0 ||
+        d <= 0) {
+      std::cerr << "ERR: the R-MAT probabilities have to be positive and add "
+                   "up to 1"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if ((this->n_nodes & (this->n_nodes - 1)) != 0) {
+      std::cerr << "ERR: R-MAT needs a power of two nodes, not "
+                << this->n_nodes << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    this->scale = 0;
+    while ((uint64_t(1) << this->scale) < this->n_nodes) {
+      this->scale++;
+    }
+    double two_32 = 4294967296.0;
+    this->right_after_top = static_cast<uint32_t>(
+        std::min(two_32 - 1,
+                 this->rmat_b / (this->rmat_a + this->rmat_b) * two_32));
+    this->right_after_bottom = static_cast<uint32_t>(
+        std::min(two_32 - 1, d / (this->rmat_c + d) * two_32));
+  } else if (this->model == POWER_LAW) {
+    if (!(this->exponent > 2)) {
+      std::cerr << "ERR: the power law exponent has to be more than 2"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    this->alpha = 1 / (this->exponent - 1);
+    // the weights summed as the integral of x^-alpha around every node
+    double n = static_cast<double>(this->n_nodes);
+    this->weight_sum =
+        (std::pow(n + 0.5, 1 - this->alpha) - std::pow(0.5, 1 - this->alpha)) /
+        (1 - this->alpha);
+  }
+
+  this->permutation_bits = 1;
+  while ((uint64_t(1) << this->permutation_bits) < this->n_nodes) {
+    this->permutation_bits++;
+  }
+  uint64_t mask = (uint64_t(1) << this->permutation_bits) - 1;
+  this->multiplier = splitmix64(this->seed) | 1;
+  // Newton's iteration doubles the correct low bits of the inverse each time
+  this->inverse_multiplier = this->multiplier;
+  for (int i = 0; i < 6; i++) {
+    this->inverse_multiplier *= 2 - this->multiplier * this->inverse_multiplier;
+  }
+  this->multiplier &= mask;
+  this->inverse_multiplier &= mask;
+  this->increment = splitmix64(this->seed + 1) & mask;
+}
+
+void GraphGenerator::setRmatProbabilities(double a, double b, double c) {
+  this->rmat_a = a;
+  this->rmat_b = b;
+  this->rmat_c = c;
+  setup();
+}
+
+void GraphGenerator::setExponent(double exponent) {
+  this->exponent = exponent;
+  setup();
+}
+
+void GraphGenerator::setSigma(double sigma) { this->sigma = sigma; }
+
+void GraphGenerator::setMaxDegree(uint64_t max_degree) {
+  this->max_degree = std::min(max_degree, this->n_nodes);
+}
+
+void GraphGenerator::setScramble(bool scramble) { this->scramble = scramble; }
+
+uint64_t GraphGenerator::getNumNodes() const { return this->n_nodes; }
+
+uint64_t GraphGenerator::permute(uint64_t node) const {
+  uint64_t mask = (uint64_t(1) << this->permutation_bits) - 1;
+  int shift = (this->permutation_bits + 1) / 2;
+  // a bijection of the power of two range, repeated until it lands inside
+  do {
+    node = (node * this->multiplier + this->increment) & mask;
+    node ^= node >> shift;
+    node = (node * this->multiplier) & mask;
+  } while (node >= this->n_nodes);
+  return node;
+}
+
+uint64_t GraphGenerator::unpermute(uint64_t node) const {
+  uint64_t mask = (uint64_t(1) << this->permutation_bits) - 1;
+  int shift = (this->permutation_bits + 1) / 2;
+  do {
+    node = (node * this->inverse_multiplier) & mask;
+    // the shift is at least half the bits, so the xor undoes itself
+    node ^= node >> shift;
+    node = ((node - this->increment) * this->inverse_multiplier) & mask;
+  } while (node >= this->n_nodes);
+  return node;
+}
+
+double GraphGenerator::expectedDegree(uint64_t u) const {
+  double n = static_cast<double>(this->n_nodes);
+  if (this->model == RMAT) {
+    // every bottom row bit of u has probability c + d
+    double bottom = 1 - this->rmat_a - this->rmat_b;
+    int ones = __builtin_popcountll(u);
+    return n * this->avg_degree * std::pow(bottom, ones) *
+           std::pow(1 - bottom, this->scale - ones);
+  }
+  return n * this->avg_degree * std::pow(u + 1.0, -this->alpha) /
+         this->weight_sum;
+}
+
+void GraphGenerator::generateBlock(uint64_t first_node, size_t n,
+                                   std::vector<uint32_t> &degrees,
+                                   std::vector<uint32_t> &edges,
+                                   std::vector<float> *weights) const {
+  degrees.resize(n);
+  edges.clear();
+  if (weights != nullptr) {
+    weights->clear();
+  }
+  std::mt19937_64 rng(splitmix64(this->seed ^ splitmix64(first_node)));
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::uniform_int_distribution<uint64_t> uniform_node(0, this->n_nodes - 1);
+  std::lognormal_distribution<double> log_normal(
+      std::log(this->avg_degree) - this->sigma * this->sigma / 2, this->sigma);
+  // power_law draws a node by inverting the integral of x^-alpha
+  double low = std::pow(0.5, 1 - this->alpha);
+  double high = std::pow(this->n_nodes + 0.5, 1 - this->alpha);
+
+  for (size_t i = 0; i < n; i++) {
+    uint64_t u = first_node + i;
+    if (this->scramble) {
+      u = unpermute(u);
+    }
+    uint64_t degree;
+    if (this->model == LOG_NORMAL) {
+      degree = std::llround(log_normal(rng));
+    } else {
+      double mean = expectedDegree(u);
+      degree = mean > 0 ? std::poisson_distribution<uint64_t>(mean)(rng) : 0;
+    }
+    degree = std::min(degree, this->max_degree);
+
+    size_t begin = edges.size();
+    for (uint64_t j = 0; j < degree; j++) {
+      uint64_t neighbor = 0;
+      if (this->model == RMAT) {
+        // descend the initiator: the row is u's bit, the column is drawn
+        uint64_t bits = 0;
+        for (int level = this->scale - 1; level >= 0; level--) {
+          if ((level & 1) == 1 || level == this->scale - 1) {
+            bits = rng();
+          }
+          uint32_t draw = static_cast<uint32_t>(bits >> (32 * (level & 1)));
+          uint32_t threshold = ((u >> level) & 1) ? this->right_after_bottom
+                                                  : this->right_after_top;
+          neighbor = (neighbor << 1) | (draw < threshold ? 1 : 0);
+        }
+      } else if (this->model == POWER_LAW) {
+        double x = std::pow(low + uniform(rng) * (high - low),
+                            1 / (1 - this->alpha));
+        neighbor = std::min<uint64_t>(x > 0.5 ? x - 0.5 : 0,
+                                      this->n_nodes - 1);
+      } else {
+        neighbor = uniform_node(rng);
+      }
+      edges.push_back(this->scramble ? permute(neighbor) : neighbor);
+    }
+    std::sort(edges.begin() + begin, edges.end());
+    edges.erase(std::unique(edges.begin() + begin, edges.end()), edges.end());
+    degrees[i] = edges.size() - begin;
+    if (weights != nullptr) {
+      for (size_t j = begin; j < edges.size(); j++) {
+        weights->push_back(getEdgeWeight(first_node + i, edges[j]));
+      }
+    }
+  }
+}
+
+float GraphGenerator::getEdgeWeight(uint64_t node, uint64_t neighbor) const {
+  uint64_t hash = splitmix64(splitmix64(this->seed + 3) ^ node);
+  hash = splitmix64(hash ^ neighbor);
+  // a standard normal by Box-Muller from the two halves of the hash
+  double u1 = ((hash >> 32) + 0.5) / 4294967296.0;
+  double u2 = (hash & 0xFFFFFFFF) / 4294967296.0;
+  double normal = std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+  return static_cast<float>(std::exp(normal));
+}
+
+bool GraphGenerator::isTrainNode(uint64_t node, double train_fraction) const {
+  uint64_t hash = splitmix64(splitmix64(this->seed + 2) ^ node);
+  return (hash >> 11) * (1.0 / 9007199254740992.0) < train_fraction;
+}
+
+/**
+ * Consecutive generated nodes with their edges and training nodes
+ */
+struct GeneratedBlock {
+  uint64_t first_node = 0;
+  std::vector<uint32_t> degrees;
+  std::vector<uint32_t> edges;
+  std::vector<float> weights;
+  std::vector<uint32_t> train_nodes;
+};
+
+void GraphGenerator::write(ArtifactWriter &writer, double train_fraction,
+                           bool verbose) const {
+  size_t n_blocks = (this->n_nodes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  // one batch is generated by all threads while the batch before is written
+  size_t batch_size = omp_get_max_threads();
+  std::vector<std::vector<GeneratedBlock>> batches(
+      2, std::vector<GeneratedBlock>(batch_size));
+  std::vector<uint32_t> train_nodes;
+  bool weighted = writer.isWeighted();
+  std::future<void> pending_write;
+  for (size_t b = 0; b * batch_size < n_blocks; b++) {
+    std::vector<GeneratedBlock> &batch = batches[b % 2];
+    size_t first_block = b * batch_size;
+    size_t n_batch_blocks = std::min(batch_size, n_blocks - first_block);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < n_batch_blocks; i++) {
+      GeneratedBlock &block = batch[i];
+      block.first_node = (first_block + i) * BLOCK_SIZE;
+      size_t n = std::min<uint64_t>(BLOCK_SIZE,
+                                    this->n_nodes - block.first_node);
+      generateBlock(block.first_node, n, block.degrees, block.edges,
+                    weighted ? &block.weights : nullptr);
+      block.train_nodes.clear();
+      for (uint64_t node = block.first_node; node < block.first_node + n;
+           node++) {
+        if (isTrainNode(node, train_fraction)) {
+          block.train_nodes.push_back(node);
+        }
+      }
+    }
+    if (pending_write.valid()) {
+      pending_write.wait();
+    }
+    std::vector<GeneratedBlock> *blocks = &batch;
+    pending_write = std::async(std::launch::async, [&writer, &train_nodes,
+                                                    blocks, n_batch_blocks,
+                                                    weighted]() {
+      for (size_t i = 0; i < n_batch_blocks; i++) {
+        GeneratedBlock &block = (*blocks)[i];
+        writer.addNodes(block.first_node, block.degrees.data(),
+                        block.degrees.size(), block.edges.data(),
+                        weighted ? block.weights.data() : nullptr);
+        train_nodes.insert(train_nodes.end(), block.train_nodes.begin(),
+                           block.train_nodes.end());
+      }
+    });
+    if (verbose) {
+      std::cout << "\rGenerated "
+                << std::min<uint64_t>((first_block + n_batch_blocks) *
+                                          BLOCK_SIZE,
+                                      this->n_nodes)
+                << " / " << this->n_nodes << " nodes";
+      std::cout.flush();
+    }
+  }
+  if (pending_write.valid()) {
+    pending_write.wait();
+  }
+  if (verbose) {
+    std::cout << std::endl;
+  }
+  writer.finish();
+  writer.writeTrainNodes(train_nodes);
+}
@@ -0,0 +1,147 @@
+/**
+ * Synthetic graphs for testing the samplers at any scale. Nodes are generated
+ * in id order, in blocks that depend only on the seed and their position, so
+ * the graph can be written to disk block by block by all threads and comes
+ * out the same for any number of threads.
+ *
+ * Models:
+ *   rmat       R-MAT, the stochastic Kronecker graph of a 2x2 initiator
+ *              (a, b, c, d). A node's edge count is Poisson with the mean
+ *              R-MAT gives its row, and each neighbor descends the initiator
+ *              from the node's row bits. n_nodes must be a power of two.
+ *   power_law  Chung-Lu with node weights (i + 1)^(-1 / (exponent - 1)):
+ *              degrees and neighbor popularity both follow a power law with
+ *              the given exponent, like the Yahoo web graph.
+ *   log_normal Log-normal degrees with uniform neighbors, a milder skew like
+ *              citation graphs such as papers100M.
+ * The neighbors of a node are sorted and distinct. With scrambling, node ids
+ * are permuted so the hubs do not all sit at the front of the id space.
+ * Edge weights, for weighted sampling, are log-normal with median 1 and
+ * sigma 1, a function of the seed and the two nodes only.
+ */
+#ifndef GRAPH_GENERATOR_HPP
+#define GRAPH_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ArtifactWriter;
+
+class GraphGenerator {
+public:
+  enum Model { RMAT, POWER_LAW, LOG_NORMAL };
+
+private:
+  Model model;
+  uint64_t n_nodes;
+  double avg_degree;
+  uint64_t seed;
+  uint64_t max_degree;
+  bool scramble = false;
+
+  // rmat: initiator probabilities, the bits of the id space, and the
+  // thresholds of a 32 bit draw for descending to the right column
+  double rmat_a = 0.57, rmat_b = 0.19, rmat_c = 0.19;
+  int scale = 0;
+  uint32_t right_after_top = 0;
+  uint32_t right_after_bottom = 0;
+
+  // power_law: the exponent and the weight function x^-alpha on
+  // [0.5, n_nodes + 0.5), alpha = 1 / (exponent - 1)
+  double exponent = 2.5;
+  double alpha = 0;
+  double weight_sum = 0;
+
+  // log_normal
+  double sigma = 1;
+
+  // scrambling: x -> (x * multiplier + increment) mod 2^bits, walked until it
+  // falls below n_nodes
+  int permutation_bits = 0;
+  uint64_t multiplier = 0, inverse_multiplier = 0, increment = 0;
+
+  void setup();
+
+  /**
+   * Expected degree of the unscrambled node u
+   */
+  double expectedDegree(uint64_t u) const;
+
+  uint64_t permute(uint64_t node) const;
+
+  uint64_t unpermute(uint64_t node) const;
+
+public:
+  /**
+   * @param n_nodes: The number of nodes, less than 2^32 - 1
+   * @param avg_degree: The mean degree before duplicates are removed
+   * @param seed: Everything generated depends on this only
+   */
+  GraphGenerator(Model model, uint64_t n_nodes, double avg_degree,
+                 uint64_t seed);
+
+  /**
+   * The model called name, rmat, power_law or log_normal, exit if there is
+   * none
+   */
+  static Model parseModel(std::string name);
+
+  /**
+   * The initiator of rmat, d is 1 - a - b - c
+   */
+  void setRmatProbabilities(double a, double b, double c);
+
+  /**
+   * The power law exponent of power_law, more than 2
+   */
+  void setExponent(double exponent);
+
+  /**
+   * The sigma of the degrees of log_normal
+   */
+  void setSigma(double sigma);
+
+  /**
+   * Cap every degree, for instance to what a streaming chunk holds
+   */
+  void setMaxDegree(uint64_t max_degree);
+
+  /**
+   * Permute the node ids with a fixed pseudo random bijection
+   */
+  void setScramble(bool scramble);
+
+  uint64_t getNumNodes() const;
+
+  /**
+   * Generate the nodes [first_node, first_node + n): their degrees, and their
+   * neighbors back to back in `edges`
+   * @param weights: The weights of the edges, if not nullptr
+   */
+  void generateBlock(uint64_t first_node, size_t n,
+                     std::vector<uint32_t> &degrees,
+                     std::vector<uint32_t> &edges,
+                     std::vector<float> *weights = nullptr) const;
+
+  /**
+   * The weight of the edge from node to neighbor
+   */
+  float getEdgeWeight(uint64_t node, uint64_t neighbor) const;
+
+  /**
+   * Whether node is one of the train_fraction of nodes used for training
+   */
+  bool isTrainNode(uint64_t node, double train_fraction) const;
+
+  /**
+   * Generate the whole graph into writer on all threads, then its training
+   * nodes, with edge weights if the writer is weighted. The writer is
+   * finished afterwards.
+   */
+  void write(ArtifactWriter &writer, double train_fraction,
+             bool verbose = false) const;
+};
+
+#endif // GRAPH_GENERATOR_HPP
@@ -0,0 +1,330 @@
+#include "metrics.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace metrics {
+
+namespace {
+
+const char *COUNTER_NAMES[NUM_COUNTERS] = {
+    "bytes_read",      "reads_issued",   "sectors_read", "sectors_deduped",
+    "sectors_cached",  "chunks_sampled", "samples"};
+
+const char *HISTOGRAM_NAMES[NUM_HISTOGRAMS] = {
+    "kernel_seconds",        "bo_sync_seconds",      "read_seconds",
+    "frontier_prep_seconds", "dedup_seconds",        "layer_select_seconds",
+    "layer_seconds",         "setup_seconds",        "prewarm_seconds"};
+
+const char *GAUGE_NAMES[NUM_GAUGES] = {"layer_frontier_size",
+                                       "layer_sampled_size"};
+
+/**
+ * The metrics of one thread. Only that thread writes them, so an add is a
+ * relaxed load and store instead of a locked instruction.
+ */
+struct Shard {
+  std::atomic<uint64_t> counters[NUM_COUNTERS];
+  std::atomic<uint64_t> buckets[NUM_HISTOGRAMS][NUM_BUCKETS];
+  std::atomic<uint64_t> count[NUM_HISTOGRAMS];
+  std::atomic<uint64_t> sum_nanoseconds[NUM_HISTOGRAMS];
+
+  Shard() { clear(); }
+
+  void clear() {
+    for (auto &value : this->counters) {
+      value.store(0, std::memory_order_relaxed);
+    }
+    for (auto &histogram : this->buckets) {
+      for (auto &value : histogram) {
+        value.store(0, std::memory_order_relaxed);
+      }
+    }
+    for (size_t h = 0; h < NUM_HISTOGRAMS; h++) {
+      this->count[h].store(0, std::memory_order_relaxed);
+      this->sum_nanoseconds[h].store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+struct Registry {
+  std::mutex mutex;
+  // shards are kept when their thread ends and handed to the next new
+  // thread, so short lived workers do not pile up shards
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::vector<Shard *> free_shards;
+  std::atomic<int64_t> gauges[NUM_GAUGES][MAX_LAYERS];
+  std::atomic<bool> gauge_set[NUM_GAUGES][MAX_LAYERS];
+
+  Registry() {
+    for (size_t g = 0; g < NUM_GAUGES; g++) {
+      for (size_t l = 0; l < MAX_LAYERS; l++) {
+        this->gauges[g][l].store(0);
+        this->gauge_set[g][l].store(false);
+      }
+    }
+  }
+};
+
+Registry &registry() {
+  // never destroyed, threads may still return their shards at exit
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+struct ShardHolder {
+  Shard *shard = nullptr;
+
+  ~ShardHolder() {
+    if (this->shard) {
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      registry().free_shards.push_back(this->shard);
+    }
+  }
+};
+
+thread_local ShardHolder local_shard;
+
+Shard &localShard() {
+  if (!local_shard.shard) {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (!r.free_shards.empty()) {
+      local_shard.shard = r.free_shards.back();
+      r.free_shards.pop_back();
+    } else {
+      r.shards.push_back(std::unique_ptr<Shard>(new Shard()));
+      local_shard.shard = r.shards.back().get();
+    }
+  }
+  return *local_shard.shard;
+}
+
+inline void bump(std::atomic<uint64_t> &value, uint64_t n) {
+  value.store(value.load(std::memory_order_relaxed) + n,
+              std::memory_order_relaxed);
+}
+
+std::string formatDouble(double value) {
+  if (std::isinf(value)) {
+    return "+Inf";
+  }
+  std::ostringstream out;
+  out.precision(10);
+  out << value;
+  return out.str();
+}
+
+} // namespace
+
+void add(Counter counter, uint64_t value) {
+  bump(localShard().counters[counter], value);
+}
+
+void observeNanoseconds(Histogram histogram, uint64_t nanoseconds) {
+  // bucket i holds latencies below 2^i ns
+  size_t bucket =
+      nanoseconds == 0 ? 0 : 64 - __builtin_clzll(nanoseconds);
+  if (bucket >= NUM_BUCKETS) {
+    bucket = NUM_BUCKETS - 1;
+  }
+  Shard &shard = localShard();
+  bump(shard.buckets[histogram][bucket], 1);
+  bump(shard.count[histogram], 1);
+  bump(shard.sum_nanoseconds[histogram], nanoseconds);
+}
+
+void setGauge(Gauge gauge, size_t layer, int64_t value) {
+  if (layer >= MAX_LAYERS) {
+    return;
+  }
+  registry().gauges[gauge][layer].store(value, std::memory_order_relaxed);
+  registry().gauge_set[gauge][layer].store(true, std::memory_order_relaxed);
+}
+
+Snapshot snapshot() {
+  Snapshot result;
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto &shard : r.shards) {
+    for (size_t c = 0; c < NUM_COUNTERS; c++) {
+      result.counters[c] +=
+          shard->counters[c].load(std::memory_order_relaxed);
+    }
+    for (size_t h = 0; h < NUM_HISTOGRAMS; h++) {
+      for (size_t b = 0; b < NUM_BUCKETS; b++) {
+        result.buckets[h][b] +=
+            shard->buckets[h][b].load(std::memory_order_relaxed);
+      }
+      result.count[h] += shard->count[h].load(std::memory_order_relaxed);
+      result.sum_seconds[h] +=
+          shard->sum_nanoseconds[h].load(std::memory_order_relaxed) * 1e-9;
+    }
+  }
+  for (size_t g = 0; g < NUM_GAUGES; g++) {
+    for (size_t l = 0; l < MAX_LAYERS; l++) {
+      result.gauge_set[g][l] = r.gauge_set[g][l].load();
+      result.gauges[g][l] = r.gauges[g][l].load();
+    }
+  }
+  return result;
+}
+
+void reset() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto &shard : r.shards) {
+    shard->clear();
+  }
+  for (size_t g = 0; g < NUM_GAUGES; g++) {
+    for (size_t l = 0; l < MAX_LAYERS; l++) {
+      r.gauge_set[g][l].store(false);
+      r.gauges[g][l].store(0);
+    }
+  }
+}
+
+const char *getName(Counter counter) { return COUNTER_NAMES[counter]; }
+
+const char *getName(Histogram histogram) {
+  return HISTOGRAM_NAMES[histogram];
+}
+
+const char *getName(Gauge gauge) { return GAUGE_NAMES[gauge]; }
+
+double getBucketBound(size_t bucket) {
+  if (bucket + 1 >= NUM_BUCKETS) {
+    return INFINITY;
+  }
+  return std::ldexp(1e-9, bucket);
+}
+
+std::string toJson(const Snapshot &snapshot) {
+  std::ostringstream json;
+  json << "{\"counters\": {";
+  for (size_t c = 0; c < NUM_COUNTERS; c++) {
+    json << (c ? ", " : "") << "\"" << COUNTER_NAMES[c]
+         << "\": " << snapshot.counters[c];
+  }
+  // gauges as an array by layer, null for the layers never set
+  json << "},\n \"gauges\": {";
+  for (size_t g = 0; g < NUM_GAUGES; g++) {
+    size_t n_layers = 0;
+    for (size_t l = 0; l < MAX_LAYERS; l++) {
+      if (snapshot.gauge_set[g][l]) {
+        n_layers = l + 1;
+      }
+    }
+    json << (g ? ", " : "") << "\"" << GAUGE_NAMES[g] << "\": [";
+    for (size_t l = 0; l < n_layers; l++) {
+      json << (l ? ", " : "");
+      if (snapshot.gauge_set[g][l]) {
+        json << snapshot.gauges[g][l];
+      } else {
+        json << "null";
+      }
+    }
+    json << "]";
+  }
+  // cumulative buckets up to the first one that holds everything
+  json << "},\n \"histograms\": {";
+  for (size_t h = 0; h < NUM_HISTOGRAMS; h++) {
+    json << (h ? ",\n  " : "\n  ") << "\"" << HISTOGRAM_NAMES[h]
+         << "\": {\"count\": " << snapshot.count[h]
+         << ", \"sum\": " << formatDouble(snapshot.sum_seconds[h])
+         << ", \"buckets\": [";
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < NUM_BUCKETS && cumulative < snapshot.count[h];
+         b++) {
+      cumulative += snapshot.buckets[h][b];
+      double bound = getBucketBound(b);
+      json << (b ? ", " : "") << "{\"le\": "
+           << (std::isinf(bound) ? "\"+Inf\"" : formatDouble(bound))
+           << ", \"count\": " << cumulative << "}";
+    }
+    json << "]}";
+  }
+  json << "}}\n";
+  return json.str();
+}
+
+std::string toPrometheus(const Snapshot &snapshot) {
+  std::ostringstream text;
+  for (size_t c = 0; c < NUM_COUNTERS; c++) {
+    text << "# TYPE sampler_" << COUNTER_NAMES[c] << "_total counter\n"
+         << "sampler_" << COUNTER_NAMES[c] << "_total "
+         << snapshot.counters[c] << "\n";
+  }
+  for (size_t g = 0; g < NUM_GAUGES; g++) {
+    text << "# TYPE sampler_" << GAUGE_NAMES[g] << " gauge\n";
+    for (size_t l = 0; l < MAX_LAYERS; l++) {
+      if (snapshot.gauge_set[g][l]) {
+        text << "sampler_" << GAUGE_NAMES[g] << "{layer=\"" << l << "\"} "
+             << snapshot.gauges[g][l] << "\n";
+      }
+    }
+  }
+  for (size_t h = 0; h < NUM_HISTOGRAMS; h++) {
+    std::string name = std::string("sampler_") + HISTOGRAM_NAMES[h];
+    text << "# TYPE " << name << " histogram\n";
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < NUM_BUCKETS; b++) {
+      cumulative += snapshot.buckets[h][b];
+      text << name << "_bucket{le=\"" << formatDouble(getBucketBound(b))
+           << "\"} " << cumulative << "\n";
+    }
+    text << name << "_sum " << formatDouble(snapshot.sum_seconds[h]) << "\n"
+         << name << "_count " << snapshot.count[h] << "\n";
+  }
+  return text.str();
+}
+
+int writeSnapshot(std::string file_path) {
+  bool prometheus = file_path.size() >= 5 &&
+                    file_path.compare(file_path.size() - 5, 5, ".prom") == 0;
+  Snapshot current = snapshot();
+  std::string text = prometheus ? toPrometheus(current) : toJson(current);
+  // write next to the file and rename over it
+  std::string temp_path = file_path + ".tmp";
+  FILE *file = fopen(temp_path.c_str(), "w");
+  if (!file) {
+    return -1;
+  }
+  bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+  if (fclose(file) != 0 || !ok ||
+      rename(temp_path.c_str(), file_path.c_str()) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+PeriodicExporter::PeriodicExporter(std::string file_path,
+                                   std::chrono::milliseconds interval)
+    : file_path(file_path), interval(interval) {
+  this->worker = std::thread([this]() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stop_signal.wait_for(lock, this->interval,
+                                       [this]() { return this->stopped; })) {
+      if (writeSnapshot(this->file_path) != 0) {
+        std::cerr << "ERR: cannot write metrics to " << this->file_path
+                  << std::endl;
+      }
+    }
+  });
+}
+
+PeriodicExporter::~PeriodicExporter() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopped = true;
+  }
+  this->stop_signal.notify_one();
+  this->worker.join();
+  writeSnapshot(this->file_path);
+}
+
+} // namespace metrics
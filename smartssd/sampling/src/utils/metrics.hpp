@@ -0,0 +1,197 @@
+/**
+ * Process wide sampler metrics: counters, per-layer gauges and latency
+ * histograms, exported as a JSON or Prometheus text snapshot.
+ *
+ * Counters and histograms are kept per thread, so recording is a plain add to
+ * memory only that thread writes; a snapshot sums all threads. The hot paths
+ * record through the METRICS_* macros, which compile to nothing unless
+ * SAMPLING_METRICS is defined (the METRICS CMake option).
+ */
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace metrics {
+
+enum Counter {
+  // bytes read from the edge files for sampling
+  BYTES_READ,
+  // reads submitted to the SSD
+  READS_ISSUED,
+  // 512 byte sectors read by the random read sampler
+  SECTORS_READ,
+  // sampled neighbors that shared a sector read for another one
+  SECTORS_DEDUPED,
+  // sectors served from the host sector cache
+  SECTORS_CACHED,
+  // streaming chunks handed to a kernel
+  CHUNKS_SAMPLED,
+  // neighbors sampled, -1 padding included
+  SAMPLES,
+  NUM_COUNTERS
+};
+
+enum Histogram {
+  // a kernel run, from its start until it is done
+  KERNEL_SECONDS,
+  // a buffer object sync between host and device
+  BO_SYNC_SECONDS,
+  // the reads of a chunk or of a batch slice
+  READ_SECONDS,
+  // grouping a layer's frontier by chunk
+  FRONTIER_PREP_SECONDS,
+  // deduplicating a layer's samples
+  DEDUP_SECONDS,
+  // keeping the budget of every batch of a layer, layer-wise sampling
+  LAYER_SELECT_SECONDS,
+  // sampling one layer on all devices
+  LAYER_SECONDS,
+  // constructing a sampler, its files mapped or loaded
+  SETUP_SECONDS,
+  // filling the sector cache of the random read sampler
+  PREWARM_SECONDS,
+  NUM_HISTOGRAMS
+};
+
+enum Gauge {
+  // nodes in the frontier of a layer, by layer
+  LAYER_FRONTIER_SIZE,
+  // distinct nodes sampled for a layer, by layer
+  LAYER_SAMPLED_SIZE,
+  NUM_GAUGES
+};
+
+// gauges keep one value per layer up to this many layers
+const size_t MAX_LAYERS = 16;
+
+// latency buckets are powers of two nanoseconds, the last one open ended
+const size_t NUM_BUCKETS = 40;
+
+/**
+ * The summed state of all threads at one point in time
+ */
+struct Snapshot {
+  uint64_t counters[NUM_COUNTERS] = {};
+  uint64_t buckets[NUM_HISTOGRAMS][NUM_BUCKETS] = {};
+  uint64_t count[NUM_HISTOGRAMS] = {};
+  double sum_seconds[NUM_HISTOGRAMS] = {};
+  bool gauge_set[NUM_GAUGES][MAX_LAYERS] = {};
+  int64_t gauges[NUM_GAUGES][MAX_LAYERS] = {};
+};
+
+void add(Counter counter, uint64_t value);
+
+void observeNanoseconds(Histogram histogram, uint64_t nanoseconds);
+
+void setGauge(Gauge gauge, size_t layer, int64_t value);
+
+/**
+ * Sum the metrics of every thread so far
+ */
+Snapshot snapshot();
+
+/**
+ * Set everything back to zero, while nothing is recorded
+ */
+void reset();
+
+const char *getName(Counter counter);
+
+const char *getName(Histogram histogram);
+
+const char *getName(Gauge gauge);
+
+/**
+ * Upper bound of latency bucket i in seconds, infinite for the last one
+ */
+double getBucketBound(size_t bucket);
+
+std::string toJson(const Snapshot &snapshot);
+
+/**
+ * The Prometheus text exposition format, metric names prefixed with
+ * sampler_
+ */
+std::string toPrometheus(const Snapshot &snapshot);
+
+/**
+ * Write a snapshot to file_path as JSON, or as Prometheus text if the path
+ * ends in .prom. The file is replaced at once, so a collector never reads
+ * half of it.
+ * @return 0 on success, -1 otherwise
+ */
+int writeSnapshot(std::string file_path);
+
+/**
+ * Records the time from its construction to its destruction
+ */
+class ScopedLatency {
+private:
+  Histogram histogram;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  explicit ScopedLatency(Histogram histogram)
+      : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+  ~ScopedLatency() {
+    observeNanoseconds(this->histogram,
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - this->start)
+                           .count());
+  }
+};
+
+/**
+ * Writes a snapshot to a file every interval in the background, for
+ * scraping while the samplers run
+ */
+class PeriodicExporter {
+private:
+  std::string file_path;
+  std::chrono::milliseconds interval;
+  bool stopped = false;
+  std::mutex mutex;
+  std::condition_variable stop_signal;
+  std::thread worker;
+
+public:
+  PeriodicExporter(std::string file_path, std::chrono::milliseconds interval);
+
+  /**
+   * Stop and write the last snapshot
+   */
+  ~PeriodicExporter();
+
+  PeriodicExporter(const PeriodicExporter &) = delete;
+  PeriodicExporter &operator=(const PeriodicExporter &) = delete;
+};
+
+} // namespace metrics
+
+#ifdef SAMPLING_METRICS
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_ADD(counter, value) metrics::add(metrics::counter, value)
+#define METRICS_SET_LAYER(gauge, layer, value)                                 \
+  metrics::setGauge(metrics::gauge, layer, value)
+#define METRICS_TIME(histogram)                                                \
+  metrics::ScopedLatency METRICS_CONCAT(metrics_latency_, __LINE__)(           \
+      metrics::histogram)
+#define METRICS_OBSERVE(histogram, seconds)                                    \
+  metrics::observeNanoseconds(metrics::histogram, (seconds) * 1e9)
+#else
+#define METRICS_ADD(counter, value) ((void)0)
+#define METRICS_SET_LAYER(gauge, layer, value) ((void)0)
+#define METRICS_TIME(histogram) ((void)0)
+#define METRICS_OBSERVE(histogram, seconds) ((void)0)
+#endif
+
+#endif // METRICS_HPP
@@ -0,0 +1,271 @@
+#include "node_order.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+static const uint32_t NONE = UINT32_MAX;
+
+NodeOrder::Method NodeOrder::parseMethod(std::string name) {
+  if (name == "degree") {
+    return DEGREE;
+  } else if (name == "rcm") {
+    return RCM;
+  } else if (name == "gorder") {
+    return GORDER;
+  }
+  std::cerr << "ERR: unknown node order " << name
+            << ", use degree, rcm or gorder" << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+std::vector<uint32_t> NodeOrder::compute(Method method, size_t n_nodes,
+                                         const uint64_t *offsets,
+                                         const uint32_t *edges) {
+  if (method == DEGREE) {
+    return hubCluster(n_nodes, offsets, edges);
+  } else if (method == RCM) {
+    return reverseCuthillMcKee(n_nodes, offsets, edges);
+  }
+  return gorder(n_nodes, offsets, edges);
+}
+
+void NodeOrder::transpose(size_t n_nodes, const uint64_t *offsets,
+                          const uint32_t *edges,
+                          std::vector<uint64_t> &in_offsets,
+                          std::vector<uint32_t> &in_edges) {
+  in_offsets.assign(n_nodes + 1, 0);
+  for (uint64_t e = 0; e < offsets[n_nodes]; e++) {
+    if (edges[e] >= n_nodes) {
+      std::cerr << "ERR: an edge goes to node " << edges[e]
+                << ", the graph has " << n_nodes << " nodes" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    in_offsets[edges[e] + 1]++;
+  }
+  for (size_t v = 0; v < n_nodes; v++) {
+    in_offsets[v + 1] += in_offsets[v];
+  }
+  // the sources come in id order, so every list is sorted
+  std::vector<uint64_t> pos(in_offsets.begin(), in_offsets.end() - 1);
+  in_edges.resize(offsets[n_nodes]);
+  for (size_t v = 0; v < n_nodes; v++) {
+    for (uint64_t e = offsets[v]; e < offsets[v + 1]; e++) {
+      in_edges[pos[edges[e]]++] = v;
+    }
+  }
+}
+
+std::vector<uint32_t> NodeOrder::hubCluster(size_t n_nodes,
+                                            const uint64_t *offsets,
+                                            const uint32_t *edges) {
+  // a node is in a frontier about as often as it is the neighbor of one
+  std::vector<uint32_t> in_degree(n_nodes, 0);
+  for (uint64_t e = 0; e < offsets[n_nodes]; e++) {
+    if (edges[e] >= n_nodes) {
+      std::cerr << "ERR: an edge goes to node " << edges[e]
+                << ", the graph has " << n_nodes << " nodes" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    in_degree[edges[e]]++;
+  }
+  double average = n_nodes == 0 ? 0 : (double)offsets[n_nodes] / n_nodes;
+
+  // the rest keeps its order and with it whatever locality it had
+  std::vector<uint32_t> order, rest;
+  for (size_t v = 0; v < n_nodes; v++) {
+    (in_degree[v] > average ? order : rest).push_back(v);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return in_degree[a] > in_degree[b];
+  });
+  order.insert(order.end(), rest.begin(), rest.end());
+  return order;
+}
+
+std::vector<uint32_t> NodeOrder::reverseCuthillMcKee(size_t n_nodes,
+                                                     const uint64_t *offsets,
+                                                     const uint32_t *edges) {
+  std::vector<uint64_t> in_offsets;
+  std::vector<uint32_t> in_edges;
+  transpose(n_nodes, offsets, edges, in_offsets, in_edges);
+  std::vector<uint64_t> degree(n_nodes);
+  for (size_t v = 0; v < n_nodes; v++) {
+    degree[v] = offsets[v + 1] - offsets[v] + in_offsets[v + 1] - in_offsets[v];
+  }
+  auto by_degree = [&](uint32_t a, uint32_t b) {
+    return degree[a] < degree[b] || (degree[a] == degree[b] && a < b);
+  };
+  // every component starts from its node of the smallest degree
+  std::vector<uint32_t> starts(n_nodes);
+  for (size_t v = 0; v < n_nodes; v++) {
+    starts[v] = v;
+  }
+  std::sort(starts.begin(), starts.end(), by_degree);
+
+  // breadth first, the order is the queue, and the new nodes of a node are
+  // placed by degree
+  std::vector<uint32_t> order;
+  order.reserve(n_nodes);
+  std::vector<char> visited(n_nodes, 0);
+  size_t next_start = 0;
+  for (size_t head = 0; order.size() < n_nodes;) {
+    if (head == order.size()) {
+      while (visited[starts[next_start]]) {
+        next_start++;
+      }
+      visited[starts[next_start]] = 1;
+      order.push_back(starts[next_start]);
+    }
+    uint32_t v = order[head++];
+    size_t first = order.size();
+    auto visit = [&](const uint32_t *begin, const uint32_t *end) {
+      for (const uint32_t *u = begin; u < end; u++) {
+        if (!visited[*u]) {
+          visited[*u] = 1;
+          order.push_back(*u);
+        }
+      }
+    };
+    visit(edges + offsets[v], edges + offsets[v + 1]);
+    visit(in_edges.data() + in_offsets[v], in_edges.data() + in_offsets[v + 1]);
+    std::sort(order.begin() + first, order.end(), by_degree);
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+namespace {
+
+/**
+ * Gorder's unit heap: the unplaced nodes in one list per score, so a score
+ * goes up or down by one in O(1) and the best node is found from the top
+ * score down
+ */
+class UnitHeap {
+private:
+  std::vector<uint32_t> score;
+  std::vector<uint32_t> prev;
+  std::vector<uint32_t> next;
+  std::vector<uint32_t> head;
+  std::vector<char> placed;
+  size_t top = 0;
+
+  void unlink(uint32_t v) {
+    if (this->prev[v] != NONE) {
+      this->next[this->prev[v]] = this->next[v];
+    } else {
+      this->head[this->score[v]] = this->next[v];
+    }
+    if (this->next[v] != NONE) {
+      this->prev[this->next[v]] = this->prev[v];
+    }
+  }
+
+  void link(uint32_t v) {
+    if (this->score[v] >= this->head.size()) {
+      this->head.resize(this->score[v] + 1, NONE);
+    }
+    this->prev[v] = NONE;
+    this->next[v] = this->head[this->score[v]];
+    if (this->next[v] != NONE) {
+      this->prev[this->next[v]] = v;
+    }
+    this->head[this->score[v]] = v;
+    this->top = std::max<size_t>(this->top, this->score[v]);
+  }
+
+public:
+  /**
+   * All nodes at score 0, the first of `first` on top
+   */
+  UnitHeap(const std::vector<uint32_t> &first)
+      : score(first.size(), 0), prev(first.size(), NONE),
+        next(first.size(), NONE), head(1, NONE), placed(first.size(), 0) {
+    for (size_t i = first.size(); i > 0; i--) {
+      link(first[i - 1]);
+    }
+  }
+
+  void add(uint32_t v, int delta) {
+    if (this->placed[v]) {
+      return;
+    }
+    unlink(v);
+    this->score[v] += delta;
+    link(v);
+  }
+
+  /**
+   * Take out the node of the highest score, the last linked of that score
+   */
+  uint32_t pop() {
+    while (this->top > 0 && this->head[this->top] == NONE) {
+      this->top--;
+    }
+    uint32_t v = this->head[this->top];
+    unlink(v);
+    this->placed[v] = 1;
+    return v;
+  }
+};
+
+} // namespace
+
+std::vector<uint32_t> NodeOrder::gorder(size_t n_nodes,
+                                        const uint64_t *offsets,
+                                        const uint32_t *edges) {
+  std::vector<uint64_t> in_offsets;
+  std::vector<uint32_t> in_edges;
+  transpose(n_nodes, offsets, edges, in_offsets, in_edges);
+
+  // without a score to go by, the node of the highest in-degree comes next
+  std::vector<uint32_t> by_in_degree(n_nodes);
+  for (size_t v = 0; v < n_nodes; v++) {
+    by_in_degree[v] = v;
+  }
+  std::stable_sort(by_in_degree.begin(), by_in_degree.end(),
+                   [&](uint32_t a, uint32_t b) {
+                     return in_offsets[a + 1] - in_offsets[a] >
+                            in_offsets[b + 1] - in_offsets[b];
+                   });
+  UnitHeap heap(by_in_degree);
+
+  // a node scores one for every edge with v and every in-neighbor it shares
+  // with v, while v is in the window
+  auto score = [&](uint32_t v, int delta) {
+    for (uint64_t e = offsets[v]; e < offsets[v + 1]; e++) {
+      heap.add(edges[e], delta);
+    }
+    for (uint64_t e = in_offsets[v]; e < in_offsets[v + 1]; e++) {
+      uint32_t x = in_edges[e];
+      heap.add(x, delta);
+      if (offsets[x + 1] - offsets[x] <= SIBLING_MAX_DEGREE) {
+        for (uint64_t f = offsets[x]; f < offsets[x + 1]; f++) {
+          if (edges[f] != v) {
+            heap.add(edges[f], delta);
+          }
+        }
+      }
+    }
+  };
+
+  std::vector<uint32_t> order;
+  order.reserve(n_nodes);
+  for (size_t i = 0; i < n_nodes; i++) {
+    uint32_t v = heap.pop();
+    order.push_back(v);
+    score(v, 1);
+    if (order.size() > WINDOW) {
+      score(order[order.size() - 1 - WINDOW], -1);
+    }
+  }
+  return order;
+}
+
+std::vector<uint32_t> NodeOrder::invert(const std::vector<uint32_t> &order) {
+  std::vector<uint32_t> inverse(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    inverse[order[i]] = i;
+  }
+  return inverse;
+}
@@ -0,0 +1,72 @@
+/**
+ * Node reorderings that improve the id locality of a graph before it is
+ * preprocessed. The streaming sampler reads the chunks holding a frontier and
+ * the random read sampler one sector per neighbor list, so when the nodes a
+ * minibatch touches have nearby ids, fewer chunks and sectors are read.
+ *
+ *   degree  hub clustering: the nodes of more than the average in-degree
+ *           first, by descending in-degree, the others in their old order
+ *   rcm     reverse Cuthill-McKee over the graph made undirected
+ *   gorder  a Gorder-like greedy (Wei et al., "Speedup Graph Processing by
+ *           Graph Ordering"): the next node is the one with the most links
+ *           to and common in-neighbors with the last WINDOW placed nodes
+ *
+ * An order is given as new_to_old, new id i being old id new_to_old[i].
+ * The graph is a CSR held in memory (mapped), offsets of n + 1 entries.
+ */
+#ifndef NODE_ORDER_HPP
+#define NODE_ORDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class NodeOrder {
+public:
+  enum Method { DEGREE, RCM, GORDER };
+
+  // nodes placed last that the next one of gorder is scored against
+  static const size_t WINDOW = 5;
+  // in-neighbors with more out-edges are not counted for common in-neighbors
+  // by gorder, which would cost the square of their degree
+  static const uint64_t SIBLING_MAX_DEGREE = 64;
+
+  /**
+   * The method called name, degree, rcm or gorder, exit if there is none
+   */
+  static Method parseMethod(std::string name);
+
+  /**
+   * The new order of the nodes by method, exit if an edge leaves the graph
+   */
+  static std::vector<uint32_t> compute(Method method, size_t n_nodes,
+                                       const uint64_t *offsets,
+                                       const uint32_t *edges);
+
+  static std::vector<uint32_t> hubCluster(size_t n_nodes,
+                                          const uint64_t *offsets,
+                                          const uint32_t *edges);
+
+  static std::vector<uint32_t> reverseCuthillMcKee(size_t n_nodes,
+                                                   const uint64_t *offsets,
+                                                   const uint32_t *edges);
+
+  static std::vector<uint32_t> gorder(size_t n_nodes, const uint64_t *offsets,
+                                      const uint32_t *edges);
+
+  /**
+   * old_to_new of new_to_old, and the other way round
+   */
+  static std::vector<uint32_t> invert(const std::vector<uint32_t> &order);
+
+  /**
+   * The in-edges of the graph as a CSR, the sources of every node sorted
+   */
+  static void transpose(size_t n_nodes, const uint64_t *offsets,
+                        const uint32_t *edges,
+                        std::vector<uint64_t> &in_offsets,
+                        std::vector<uint32_t> &in_edges);
+};
+
+#endif // NODE_ORDER_HPP
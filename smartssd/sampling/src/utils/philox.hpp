@@ -0,0 +1,204 @@
+/**
+ * Counter based random numbers for the host side samplers, Philox4x32-10
+ * (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+ *
+ * A draw is a pure function of the sampler seed and its counter
+ * (call, layer, node, draw index), so there is no generator state to share
+ * or to seed per thread: any thread can make any draw, and a sample is the
+ * same for every number of threads, devices or slices.
+ */
+#ifndef PHILOX_HPP
+#define PHILOX_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+class Philox {
+private:
+  static const uint32_t MULTIPLIER_0 = 0xD2511F53;
+  static const uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+  static const uint32_t WEYL_0 = 0x9E3779B9;
+  static const uint32_t WEYL_1 = 0xBB67AE85;
+  // blocks made side by side in fill, wide enough for 256 bit vectors
+  static const size_t LANES = 8;
+  // words drawBelow and drawDistinct make at a time
+  static const size_t BATCH_WORDS = 2 * LANES * 4;
+
+  uint32_t key[2];
+  uint32_t call;
+  uint32_t layer;
+
+public:
+  // the block index of seedFor, out of reach of the draws of a node
+  static const uint32_t SEED_BLOCK = 0xFFFFFFFF;
+
+  /**
+   * The draws of one layer of one sample call
+   * @param seed: The seed of the sampler
+   * @param call: The number of the sample call or epoch
+   * @param layer: The layer sampled
+   */
+  Philox(uint64_t seed, uint32_t call, uint32_t layer)
+      : key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+        call(call), layer(layer) {}
+
+  /**
+   * The 4 x 32 bit block of a counter under a key, 10 rounds
+   */
+  static void block(const uint32_t counter[4], const uint32_t key[2],
+                    uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2];
+    uint32_t c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+      uint64_t p0 = static_cast<uint64_t>(MULTIPLIER_0) * c0;
+      uint64_t p1 = static_cast<uint64_t>(MULTIPLIER_1) * c2;
+      c0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+      c2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+      c1 = static_cast<uint32_t>(p1);
+      c3 = static_cast<uint32_t>(p0);
+      k0 += WEYL_0;
+      k1 += WEYL_1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+  }
+
+  /**
+   * Draw `index` of a node, a uniform 32 bit word
+   */
+  uint32_t draw(uint32_t node, uint64_t index) const {
+    uint32_t counter[4] = {static_cast<uint32_t>(index / 4), node,
+                           this->layer, this->call};
+    uint32_t out[4];
+    block(counter, this->key, out);
+    return out[index % 4];
+  }
+
+  /**
+   * Draws 4 * first_block to 4 * (first_block + n_blocks) of a node. The
+   * blocks are made LANES at a time with every round applied to all lanes,
+   * which the compiler turns into vector multiplies.
+   */
+  void fill(uint32_t node, uint32_t first_block, size_t n_blocks,
+            uint32_t *out) const {
+    for (size_t begin = 0; begin < n_blocks; begin += LANES) {
+      uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+      for (size_t l = 0; l < LANES; l++) {
+        c0[l] = first_block + static_cast<uint32_t>(begin + l);
+        c1[l] = node;
+        c2[l] = this->layer;
+        c3[l] = this->call;
+      }
+      uint32_t k0 = this->key[0], k1 = this->key[1];
+      for (int round = 0; round < 10; round++) {
+        for (size_t l = 0; l < LANES; l++) {
+          uint64_t p0 = static_cast<uint64_t>(MULTIPLIER_0) * c0[l];
+          uint64_t p1 = static_cast<uint64_t>(MULTIPLIER_1) * c2[l];
+          c0[l] = static_cast<uint32_t>(p1 >> 32) ^ c1[l] ^ k0;
+          c2[l] = static_cast<uint32_t>(p0 >> 32) ^ c3[l] ^ k1;
+          c1[l] = static_cast<uint32_t>(p1);
+          c3[l] = static_cast<uint32_t>(p0);
+        }
+        k0 += WEYL_0;
+        k1 += WEYL_1;
+      }
+      size_t n_lanes = n_blocks - begin < LANES ? n_blocks - begin : LANES;
+      for (size_t l = 0; l < n_lanes; l++) {
+        uint32_t *block_out = out + (begin + l) * 4;
+        block_out[0] = c0[l];
+        block_out[1] = c1[l];
+        block_out[2] = c2[l];
+        block_out[3] = c3[l];
+      }
+    }
+  }
+
+  /**
+   * Map a uniform word to [0, range) by multiply and shift, range up to
+   * 2^32. The bias is below range / 2^32, nothing next to a node degree.
+   */
+  static uint32_t below(uint32_t random, uint64_t range) {
+    return static_cast<uint32_t>((random * range) >> 32);
+  }
+
+  /**
+   * Draws 0 to n - 1 of a node, each mapped to [0, range)
+   */
+  template <typename T>
+  void drawBelow(uint32_t node, uint64_t range, size_t n, T *out) const {
+    uint32_t words[BATCH_WORDS];
+    for (size_t begin = 0; begin < n; begin += BATCH_WORDS) {
+      size_t n_words = n - begin < BATCH_WORDS ? n - begin : BATCH_WORDS;
+      fill(node, static_cast<uint32_t>(begin / 4), (n_words + 3) / 4, words);
+      for (size_t i = 0; i < n_words; i++) {
+        out[begin + i] = below(words[i], range);
+      }
+    }
+  }
+
+  /**
+   * n distinct values of [0, range), n <= range, from draws 0 to n - 1 of a
+   * node by Floyd's algorithm: draw k picks from [0, range - n + k] and
+   * takes range - n + k itself if the pick was taken before. Every set of n
+   * values is equally likely. Taken picks are found by a scan, which is
+   * cheap for fanout sized n.
+   */
+  template <typename T>
+  void drawDistinct(uint32_t node, uint64_t range, size_t n, T *out) const {
+    uint32_t words[BATCH_WORDS];
+    for (size_t k = 0; k < n; k++) {
+      if (k % BATCH_WORDS == 0) {
+        size_t n_words = n - k < BATCH_WORDS ? n - k : BATCH_WORDS;
+        fill(node, static_cast<uint32_t>(k / 4), (n_words + 3) / 4, words);
+      }
+      uint64_t last = range - n + k;
+      T pick = below(words[k % BATCH_WORDS], last + 1);
+      for (size_t m = 0; m < k; m++) {
+        if (out[m] == pick) {
+          pick = last;
+          break;
+        }
+      }
+      out[k] = pick;
+    }
+  }
+
+  /**
+   * n draws from an alias table of range columns (see AliasTable), from
+   * draws 0 to 2n - 1 of a node: draw 2k picks column k in [0, range) and
+   * draw 2k + 1 is its coin
+   */
+  template <typename T>
+  void drawAlias(uint32_t node, uint64_t range, size_t n, T *columns,
+                 uint32_t *coins) const {
+    uint32_t words[BATCH_WORDS];
+    for (size_t begin = 0; begin < 2 * n; begin += BATCH_WORDS) {
+      // an even number of words, BATCH_WORDS is even
+      size_t n_words =
+          2 * n - begin < BATCH_WORDS ? 2 * n - begin : BATCH_WORDS;
+      fill(node, static_cast<uint32_t>(begin / 4), (n_words + 3) / 4, words);
+      for (size_t i = 0; i < n_words; i += 2) {
+        columns[(begin + i) / 2] = below(words[i], range);
+        coins[(begin + i) / 2] = words[i + 1];
+      }
+    }
+  }
+
+  /**
+   * A seed for a generator outside the host, like a kernel run, one for
+   * every unit (a chunk, a slice) of the layer, and every run on a unit,
+   * run below 2^31
+   */
+  uint32_t seedFor(uint32_t unit, uint32_t run = 0) const {
+    uint32_t counter[4] = {SEED_BLOCK - run, unit, this->layer, this->call};
+    uint32_t out[4];
+    block(counter, this->key, out);
+    // xorshift generators stall on 0
+    return out[0] ? out[0] : 1;
+  }
+};
+
+#endif // PHILOX_HPP
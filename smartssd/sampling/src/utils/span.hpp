@@ -0,0 +1,33 @@
+/**
+ * A non-owning view over a contiguous range of elements, used to hand out
+ * sample results without copying them
+ */
+#ifndef SPAN_HPP
+#define SPAN_HPP
+
+#include <cstddef>
+
+template <typename T> class Span {
+private:
+  T *ptr;
+  size_t length;
+
+public:
+  Span() : ptr(nullptr), length(0) {}
+
+  Span(T *ptr, size_t length) : ptr(ptr), length(length) {}
+
+  T *data() const { return ptr; }
+
+  size_t size() const { return length; }
+
+  bool empty() const { return length == 0; }
+
+  T *begin() const { return ptr; }
+
+  T *end() const { return ptr + length; }
+
+  T &operator[](size_t i) const { return ptr[i]; }
+};
+
+#endif // SPAN_HPP
@@ -0,0 +1,324 @@
+#include "uring_reader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// the tag of a request that is a retry of a short read
+static const uint64_t RETRY_TAG = 1ull << 63;
+// number of empty polls of the completion queue before going to sleep
+static const int SPIN_BEFORE_WAIT = 4096;
+
+static int uringSetup(unsigned entries, struct io_uring_params *params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                      unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                      flags, nullptr, 0);
+}
+
+static int uringRegister(int ring_fd, unsigned opcode, const void *arg,
+                         unsigned n_args) {
+  return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, n_args);
+}
+
+UringReader::UringReader(int file_handler, unsigned queue_depth, bool iopoll)
+    : file_handler(file_handler), ring_fd(-1), iopoll(false),
+      fixed_file(false), sq_entries(0), cq_entries(0), sq_ring_ptr(MAP_FAILED), sq_ring_size(0),
+      cq_ring_ptr(MAP_FAILED), cq_ring_size(0), sqes_ptr(MAP_FAILED),
+      sqes_size(0), buffer_base(nullptr), buffer_size(0),
+      buffer_piece_size((size_t)1 << 30), fixed_buffer(false) {
+  // IOPOLL is refused for files that cannot be polled, try without it then
+  if (iopoll && setupRing(queue_depth, true) == 0) {
+    this->iopoll = true;
+  } else {
+    setupRing(queue_depth, false);
+  }
+  if (this->ring_fd < 0) {
+    return;
+  }
+  // a registered file saves a file reference per read
+  this->fixed_file = uringRegister(this->ring_fd, IORING_REGISTER_FILES,
+                                   &this->file_handler, 1) == 0;
+}
+
+void UringReader::disableIopoll() {
+  closeRing();
+  this->iopoll = false;
+  if (setupRing(this->sq_entries, false) != 0) {
+    return;
+  }
+  this->fixed_file = uringRegister(this->ring_fd, IORING_REGISTER_FILES,
+                                   &this->file_handler, 1) == 0;
+  if (this->buffer_base != nullptr) {
+    setBuffer(this->buffer_base, this->buffer_size);
+  }
+}
+
+int UringReader::setupRing(unsigned queue_depth, bool iopoll) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  if (iopoll) {
+    params.flags |= IORING_SETUP_IOPOLL;
+  }
+  int fd = uringSetup(queue_depth, &params);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  this->sq_ring_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  this->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    this->sq_ring_size = this->cq_ring_size =
+        std::max(this->sq_ring_size, this->cq_ring_size);
+  }
+  this->sq_ring_ptr =
+      mmap(nullptr, this->sq_ring_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (this->sq_ring_ptr == MAP_FAILED) {
+    close(fd);
+    return -errno;
+  }
+  if (single_mmap) {
+    this->cq_ring_ptr = this->sq_ring_ptr;
+  } else {
+    this->cq_ring_ptr =
+        mmap(nullptr, this->cq_ring_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (this->cq_ring_ptr == MAP_FAILED) {
+      munmap(this->sq_ring_ptr, this->sq_ring_size);
+      this->sq_ring_ptr = MAP_FAILED;
+      close(fd);
+      return -errno;
+    }
+  }
+  this->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  this->sqes_ptr = mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (this->sqes_ptr == MAP_FAILED) {
+    if (!single_mmap) {
+      munmap(this->cq_ring_ptr, this->cq_ring_size);
+    }
+    munmap(this->sq_ring_ptr, this->sq_ring_size);
+    this->sq_ring_ptr = this->cq_ring_ptr = MAP_FAILED;
+    close(fd);
+    return -errno;
+  }
+
+  char *sq = (char *)this->sq_ring_ptr;
+  char *cq = (char *)this->cq_ring_ptr;
+  this->sq_head = (unsigned *)(sq + params.sq_off.head);
+  this->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  this->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+  this->sq_array = (unsigned *)(sq + params.sq_off.array);
+  this->cq_head = (unsigned *)(cq + params.cq_off.head);
+  this->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  this->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+  this->cqes = cq + params.cq_off.cqes;
+  this->sq_entries = params.sq_entries;
+  this->cq_entries = params.cq_entries;
+  this->ring_fd = fd;
+  return 0;
+}
+
+void UringReader::closeRing() {
+  if (this->ring_fd < 0) {
+    return;
+  }
+  munmap(this->sqes_ptr, this->sqes_size);
+  if (this->cq_ring_ptr != this->sq_ring_ptr) {
+    munmap(this->cq_ring_ptr, this->cq_ring_size);
+  }
+  munmap(this->sq_ring_ptr, this->sq_ring_size);
+  close(this->ring_fd);
+  this->ring_fd = -1;
+}
+
+UringReader::~UringReader() { closeRing(); }
+
+bool UringReader::isReady() { return this->ring_fd >= 0; }
+
+int UringReader::setBuffer(void *buffer_base, size_t buffer_size) {
+  this->buffer_base = (char *)buffer_base;
+  this->buffer_size = buffer_size;
+  this->fixed_buffer = false;
+  if (this->ring_fd < 0) {
+    return -1;
+  }
+  std::vector<struct iovec> pieces;
+  for (size_t pos = 0; pos < buffer_size; pos += this->buffer_piece_size) {
+    struct iovec piece;
+    piece.iov_base = this->buffer_base + pos;
+    piece.iov_len = std::min(this->buffer_piece_size, buffer_size - pos);
+    pieces.push_back(piece);
+  }
+  // this fails when the pages cannot be pinned, e.g. RLIMIT_MEMLOCK is too
+  // low; the reads then go through the normal path
+  if (uringRegister(this->ring_fd, IORING_REGISTER_BUFFERS, pieces.data(),
+                    pieces.size()) < 0) {
+    return -errno;
+  }
+  this->fixed_buffer = true;
+  return 0;
+}
+
+void UringReader::prepareRead(const ReadRequest &request, uint64_t tag) {
+  unsigned tail = *this->sq_tail;
+  unsigned index = tail & *this->sq_mask;
+  struct io_uring_sqe *sqe = (struct io_uring_sqe *)this->sqes_ptr + index;
+  memset(sqe, 0, sizeof(*sqe));
+
+  size_t piece = request.buffer_offset / this->buffer_piece_size;
+  bool in_one_piece =
+      piece ==
+      (request.buffer_offset + request.length - 1) / this->buffer_piece_size;
+  if (this->fixed_buffer && in_one_piece) {
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->buf_index = piece;
+  } else {
+    sqe->opcode = IORING_OP_READ;
+  }
+  if (this->fixed_file) {
+    sqe->fd = 0;
+    sqe->flags |= IOSQE_FIXED_FILE;
+  } else {
+    sqe->fd = this->file_handler;
+  }
+  sqe->off = request.file_offset;
+  sqe->addr = (uint64_t)(this->buffer_base + request.buffer_offset);
+  sqe->len = request.length;
+  sqe->user_data = tag;
+
+  this->sq_array[index] = index;
+  // make the entry visible to the kernel before the new tail
+  __atomic_store_n(this->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+unsigned UringReader::reapCompletions(const ReadRequest *requests,
+                                      int &error) {
+  unsigned head = *this->cq_head;
+  unsigned tail = __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE);
+  unsigned n_reaped = 0;
+  for (; head != tail; head++) {
+    struct io_uring_cqe *cqe =
+        (struct io_uring_cqe *)this->cqes + (head & *this->cq_mask);
+    n_reaped++;
+    uint64_t tag = cqe->user_data;
+    ReadRequest request = (tag & RETRY_TAG)
+                              ? this->retry_requests[tag & ~RETRY_TAG]
+                              : requests[tag];
+    if (cqe->res <= 0) {
+      // reading nothing means we are past the end of the file
+      if (error == 0) {
+        error = cqe->res < 0 ? cqe->res : -EIO;
+      }
+    } else if ((uint32_t)cqe->res < request.length) {
+      request.file_offset += cqe->res;
+      request.buffer_offset += cqe->res;
+      request.length -= cqe->res;
+      this->retry_requests.push_back(request);
+    }
+  }
+  __atomic_store_n(this->cq_head, head, __ATOMIC_RELEASE);
+  return n_reaped;
+}
+
+int UringReader::preadAll(const ReadRequest *requests, size_t n_requests) {
+  for (size_t i = 0; i < n_requests; i++) {
+    size_t done = 0;
+    while (done < requests[i].length) {
+      auto re = pread(this->file_handler,
+                      this->buffer_base + requests[i].buffer_offset + done,
+                      requests[i].length - done,
+                      requests[i].file_offset + done);
+      if (re <= 0) {
+        return re < 0 ? -errno : -EIO;
+      }
+      done += re;
+    }
+  }
+  return 0;
+}
+
+int UringReader::read(const ReadRequest *requests, size_t n_requests) {
+  if (this->ring_fd < 0) {
+    return preadAll(requests, n_requests);
+  }
+  this->retry_requests.clear();
+  size_t next_request = 0;
+  size_t next_retry = 0;
+  unsigned in_flight = 0;
+  int error = 0;
+  while (in_flight > 0 ||
+         (error == 0 && (next_request < n_requests ||
+                         next_retry < this->retry_requests.size()))) {
+    // keep the queue full, retries go first so their buffers are done early
+    unsigned to_submit = 0;
+    while (error == 0 && in_flight + to_submit < this->sq_entries) {
+      if (next_retry < this->retry_requests.size()) {
+        prepareRead(this->retry_requests[next_retry],
+                    RETRY_TAG | next_retry);
+        next_retry++;
+      } else if (next_request < n_requests) {
+        prepareRead(requests[next_request], next_request);
+        next_request++;
+      } else {
+        break;
+      }
+      to_submit++;
+    }
+    unsigned submitted = 0;
+    while (submitted < to_submit) {
+      int re = uringEnter(this->ring_fd, to_submit - submitted, 0, 0);
+      if (re < 0 && errno == EINTR) {
+        continue;
+      }
+      if (re < 0) {
+        // take back what the kernel did not consume, it is not in flight
+        error = -errno;
+        __atomic_store_n(this->sq_tail,
+                         *this->sq_tail - (to_submit - submitted),
+                         __ATOMIC_RELEASE);
+        break;
+      }
+      submitted += re;
+    }
+    in_flight += submitted;
+
+    // reap by polling the completion queue, and only sleep in the kernel
+    // when nothing shows up for a while. With IOPOLL the kernel has to be
+    // entered to poll the device. After an error, wait for everything that
+    // is still in flight before handing the buffer back.
+    for (int spin = 0; in_flight > 0; spin++) {
+      unsigned n_reaped = reapCompletions(requests, error);
+      in_flight -= n_reaped;
+      if (n_reaped > 0 && error == 0) {
+        break;
+      }
+      if (n_reaped == 0 &&
+          (this->iopoll || error != 0 || spin >= SPIN_BEFORE_WAIT)) {
+        uringEnter(this->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+      }
+    }
+  }
+  // the ring could be set up with IOPOLL, but the file turns out not to
+  // support polled reads
+  if (error == -EOPNOTSUPP && this->iopoll) {
+    disableIopoll();
+    return read(requests, n_requests);
+  }
+  return error;
+}
+
+int UringReader::read(const std::vector<ReadRequest> &requests) {
+  return read(requests.data(), requests.size());
+}
@@ -0,0 +1,133 @@
+/**
+ * A small io_uring based read engine. It keeps up to queue_depth reads in
+ * flight on one file, which is what NVMe needs to reach its rated IOPS for
+ * small random reads. It talks to the kernel interface directly, so it does
+ * not need liburing.
+ */
+#ifndef URING_READER_HPP
+#define URING_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+class UringReader {
+public:
+  /**
+   * One read of `length` bytes at `file_offset` into the registered buffer
+   * at `buffer_offset`
+   */
+  struct ReadRequest {
+    uint64_t file_offset;
+    uint64_t buffer_offset;
+    uint32_t length;
+  };
+
+private:
+  int file_handler;
+  int ring_fd;
+  bool iopoll;
+  bool fixed_file;
+  unsigned sq_entries;
+  unsigned cq_entries;
+
+  void *sq_ring_ptr;
+  size_t sq_ring_size;
+  void *cq_ring_ptr;
+  size_t cq_ring_size;
+  void *sqes_ptr;
+  size_t sqes_size;
+
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  void *cqes;
+
+  char *buffer_base;
+  size_t buffer_size;
+  // the kernel limits one registered buffer to 1GB, so bigger buffers are
+  // registered as several pieces of this size
+  size_t buffer_piece_size;
+  bool fixed_buffer;
+
+  // requests that came back short and have to be read again
+  std::vector<ReadRequest> retry_requests;
+
+  /**
+   * Create the rings and map them, leaves ring_fd at -1 on failure
+   */
+  int setupRing(unsigned queue_depth, bool iopoll);
+
+  /**
+   * Unmap the rings and close the ring file
+   */
+  void closeRing();
+
+  /**
+   * Set the ring up again without IOPOLL, with the same file and buffer
+   */
+  void disableIopoll();
+
+  /**
+   * Fill one submission queue entry for `request`, tagged with `tag`
+   */
+  void prepareRead(const ReadRequest &request, uint64_t tag);
+
+  /**
+   * Reap every completion that is ready and return how many were reaped.
+   * Short reads are queued for a retry, and `error` is set to -errno of the
+   * first failed read if it is not set yet.
+   */
+  unsigned reapCompletions(const ReadRequest *requests, int &error);
+
+  /**
+   * One pread per request, used when io_uring is not available
+   */
+  int preadAll(const ReadRequest *requests, size_t n_requests);
+
+public:
+  /**
+   * Set up a ring on an opened file
+   * @param file_handler: The file to read from
+   * @param queue_depth: The maximum number of reads in flight
+   * @param iopoll: Poll the device for completions instead of waiting for
+   * interrupts, needs O_DIRECT and polled NVMe queues
+   */
+  UringReader(int file_handler, unsigned queue_depth = 256,
+              bool iopoll = false);
+
+  ~UringReader();
+
+  UringReader(const UringReader &) = delete;
+  UringReader &operator=(const UringReader &) = delete;
+
+  /**
+   * Whether the ring is set up. If not, read() falls back to pread.
+   */
+  bool isReady();
+
+  /**
+   * Set the buffer that buffer_offset of the requests refers to, and try to
+   * register it with the kernel so the pages are not pinned on every read.
+   * Returns 0 if the buffer is registered; reads still work if it is not.
+   */
+  int setBuffer(void *buffer_base, size_t buffer_size);
+
+  /**
+   * Read all the requests and wait for them to finish. Returns 0 on success,
+   * or -errno of the first failed read.
+   */
+  int read(const ReadRequest *requests, size_t n_requests);
+
+  /**
+   * Read all the requests and wait for them to finish
+   */
+  int read(const std::vector<ReadRequest> &requests);
+};
+
+#endif // URING_READER_HPP
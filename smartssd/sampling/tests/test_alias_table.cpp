@@ -0,0 +1,110 @@
+#include "utils/alias_table.hpp"
+#include "utils/philox.hpp"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+/**
+ * The probability of every neighbor the table gives, neighbors being 0 to
+ * degree - 1
+ */
+std::vector<double> tableProbabilities(const std::vector<AliasEntry> &table) {
+  std::vector<double> probability(table.size(), 0);
+  for (const AliasEntry &entry : table) {
+    double keep = entry.threshold / 4294967296.0;
+    if (entry.threshold == UINT32_MAX) {
+      assert(entry.alias_neighbor == entry.neighbor &&
+             "a full column has no alias");
+      keep = 1;
+    }
+    probability[entry.neighbor] += keep / table.size();
+    probability[entry.alias_neighbor] += (1 - keep) / table.size();
+  }
+  return probability;
+}
+
+int main() {
+  AliasTable builder;
+  std::vector<uint32_t> neighbors = {0, 1, 2, 3, 4, 5};
+  std::vector<float> weights = {1, 2, 3, 4, 0, 10};
+  std::vector<AliasEntry> table(neighbors.size());
+  assert(builder.build(neighbors.data(), weights.data(), neighbors.size(),
+                       table.data()));
+
+  // the table gives every neighbor its share of the weight, 0 for weight 0
+  std::vector<double> probability = tableProbabilities(table);
+  for (size_t i = 0; i < neighbors.size(); i++) {
+    assert(std::abs(probability[i] - weights[i] / 20.0) < 1e-9 &&
+           "table probabilities do not follow the weights");
+    assert(table[i].alias_neighbor == neighbors[table[i].alias]);
+  }
+  assert(probability[4] == 0 && "a neighbor of weight 0 can be drawn");
+
+  // drawn through Philox as the samplers do
+  const size_t n_draws = 1 << 20;
+  std::vector<uint32_t> columns(n_draws), coins(n_draws);
+  Philox draws(7, 0, 0);
+  draws.drawAlias(3, table.size(), n_draws, columns.data(), coins.data());
+  std::vector<size_t> counts(neighbors.size(), 0);
+  for (size_t k = 0; k < n_draws; k++) {
+    counts[AliasTable::pick(table[columns[k]], coins[k])]++;
+  }
+  for (size_t i = 0; i < neighbors.size(); i++) {
+    double expected = n_draws * weights[i] / 20.0;
+    assert(std::abs(counts[i] - expected) < 5 * std::sqrt(expected) + 1 &&
+           "drawn neighbors do not follow the weights");
+  }
+  assert(counts[4] == 0);
+
+  // the columns and coins are the draws of the node, a pair each
+  uint32_t column, coin;
+  draws.drawAlias(3, table.size(), 1, &column, &coin);
+  assert(column == columns[0] && coin == coins[0]);
+  assert(coin == draws.draw(3, 1) &&
+         column == Philox::below(draws.draw(3, 0), table.size()));
+
+  // equal weights and all zero weights are uniform, every column full
+  std::vector<float> zeros(neighbors.size(), 0);
+  for (const float *w : {static_cast<const float *>(nullptr),
+                         static_cast<const float *>(zeros.data())}) {
+    assert(builder.build(neighbors.data(), w, neighbors.size(), table.data()));
+    for (size_t i = 0; i < table.size(); i++) {
+      assert(table[i].neighbor == neighbors[i] &&
+             table[i].threshold == UINT32_MAX &&
+             table[i].alias_neighbor == neighbors[i]);
+    }
+  }
+
+  // one heavy neighbor among many light ones
+  std::vector<uint32_t> hub_neighbors(1000);
+  std::vector<float> hub_weights(1000, 1e-3f);
+  for (size_t i = 0; i < hub_neighbors.size(); i++) {
+    hub_neighbors[i] = i;
+  }
+  hub_weights[17] = 1000;
+  table.resize(hub_neighbors.size());
+  assert(builder.build(hub_neighbors.data(), hub_weights.data(),
+                       hub_neighbors.size(), table.data()));
+  probability = tableProbabilities(table);
+  double hub_sum = 0;
+  for (float weight : hub_weights) {
+    hub_sum += weight;
+  }
+  for (size_t i = 0; i < hub_neighbors.size(); i++) {
+    assert(std::abs(probability[i] - hub_weights[i] / hub_sum) < 1e-9);
+  }
+
+  // bad weights are refused
+  std::vector<float> negative = {1, -1, 2, 3, 4, 5};
+  assert(!builder.build(neighbors.data(), negative.data(), neighbors.size(),
+                        table.data()));
+  std::vector<float> not_finite = {1, std::numeric_limits<float>::quiet_NaN(),
+                                   2, 3, 4, 5};
+  assert(!builder.build(neighbors.data(), not_finite.data(), neighbors.size(),
+                        table.data()));
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "utils/array_file.hpp"
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+int main() {
+  const char *file_path = "test_array_file.bin";
+
+  // with the header, the width and count come from the file
+  std::vector<uint64_t> wide = {0, 3, 3, 10, (uint64_t)1 << 33};
+  assert(ArrayFile::write(file_path, wide.data(), 8, wide.size()) == 0);
+  {
+    ArrayFile file(file_path, 4);
+    assert(file.hasHeader() && "header is not found");
+    assert(file.getWidth() == 8 && file.size() == wide.size());
+    for (size_t i = 0; i < wide.size(); i++) {
+      assert(file[i] == wide[i] && "element is not correct");
+    }
+    Span<const uint64_t> view = file.view<uint64_t>();
+    assert(view.size() == wide.size() && view[4] == wide[4]);
+    assert(file.view<uint32_t>().empty() && "view of the wrong width");
+
+    ArrayFile moved(std::move(file));
+    assert(moved.size() == wide.size() && file.size() == 0);
+    assert(moved[3] == 10);
+  }
+
+  // raw 4 byte offsets, an even number of them, are not taken for 8 byte ones
+  std::vector<uint32_t> narrow = {0, 0, 5, 7, 7, 20, 21, 40};
+  FILE *file = fopen(file_path, "wb");
+  fwrite(narrow.data(), 4, narrow.size(), file);
+  fclose(file);
+  {
+    ArrayFile guessed(file_path, 0);
+    assert(!guessed.hasHeader());
+    assert(guessed.getWidth() == 4 && guessed.size() == narrow.size());
+    assert(guessed[5] == 20);
+  }
+
+  // raw 8 byte offsets are
+  file = fopen(file_path, "wb");
+  fwrite(wide.data(), 8, wide.size(), file);
+  fclose(file);
+  {
+    ArrayFile guessed(file_path, 0);
+    assert(guessed.getWidth() == 8 && guessed.size() == wide.size());
+    assert(guessed[4] == wide[4]);
+    ArrayFile given(file_path, 4);
+    assert(given.getWidth() == 4 && given.size() == wide.size() * 2);
+  }
+
+  remove(file_path);
+  std::cout << "ArrayFile test passed" << std::endl;
+}
@@ -0,0 +1,50 @@
+#include "BatchDeduplicator.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+int main() {
+  const uint fanout = 10;
+  // the batch of 20000 sources is above the hash limit and gets sorted
+  std::vector<uint> source_size = {1000, 1000, 0, 7, 20000, 1000};
+  BatchDeduplicator deduplicator(1 << 16);
+
+  std::vector<uint> samples;
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<uint> dis(0, 5000);
+  for (uint size : source_size) {
+    for (size_t i = 0; i < size * fanout; i++) {
+      // about one in ten samples is padding
+      samples.push_back(i % 10 == 3 ? static_cast<uint>(-1) : dis(gen));
+    }
+  }
+  std::vector<uint> original = samples;
+
+  std::vector<uint> result;
+  std::vector<uint> result_size;
+  deduplicator.deduplicate(samples, source_size, fanout, result, result_size);
+  assert(result_size.size() == source_size.size() &&
+         "number of batches is not correct");
+
+  size_t in_pos = 0;
+  size_t out_pos = 0;
+  for (size_t b = 0; b < source_size.size(); b++) {
+    std::set<uint> expected(original.begin() + in_pos,
+                            original.begin() + in_pos + source_size[b] * fanout);
+    expected.erase(static_cast<uint>(-1));
+    std::vector<uint> batch(result.begin() + out_pos,
+                            result.begin() + out_pos + result_size[b]);
+    std::sort(batch.begin(), batch.end());
+    assert(std::vector<uint>(expected.begin(), expected.end()) == batch &&
+           "batch is not deduplicated correctly");
+    std::cout << "batch " << b << ": " << result_size[b] << " distinct"
+              << std::endl;
+    in_pos += source_size[b] * fanout;
+    out_pos += result_size[b];
+  }
+  assert(out_pos == result.size() && "result has extra samples");
+  return 0;
+}
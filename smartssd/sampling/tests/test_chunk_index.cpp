@@ -0,0 +1,105 @@
+#include "utils/alias_table.hpp"
+#include "utils/array_file.hpp"
+#include "utils/artifact_writer.hpp"
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+#include <vector>
+
+const size_t CHUNK_SIZE_BYTE = 4096;
+
+std::vector<uint32_t> readFile(std::string path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  assert(file != nullptr);
+  std::vector<uint32_t> words;
+  uint32_t word;
+  while (fread(&word, 4, 1, file) == 1) {
+    words.push_back(word);
+  }
+  fclose(file);
+  return words;
+}
+
+/**
+ * Check the chunks of a streaming edge file against its index and chunk
+ * info, and collect the words of every node over its pieces
+ */
+void checkChunks(std::string dir, std::string prefix, size_t edge_ints,
+                 const std::vector<uint32_t> &degrees,
+                 std::vector<std::vector<uint32_t>> &node_words) {
+  std::vector<uint32_t> file =
+      readFile(dir + "/" + prefix + "streaming_edges.bin");
+  ArrayFile chunk_info(dir + "/" + prefix + "chunk_info.bin", 4);
+  ArrayFile chunk_index(dir + "/" + prefix + "chunk_index.bin", 8);
+  Span<const uint32_t> ends = chunk_info.view<uint32_t>();
+  Span<const uint64_t> positions = chunk_index.view<uint64_t>();
+  assert(positions.size() == ends.size() + 1);
+  assert(positions[0] == 0 &&
+         positions[positions.size() - 1] == file.size() * 4);
+
+  node_words.assign(degrees.size(), std::vector<uint32_t>());
+  uint32_t prev_end = 0;
+  for (size_t c = 0; c < ends.size(); c++) {
+    size_t size_byte = positions[c + 1] - positions[c];
+    assert(size_byte <= CHUNK_SIZE_BYTE && "a chunk is larger than the size");
+    // a variable chunk is padded to a page, the last one to a sector
+    assert(size_byte % (c + 1 < ends.size() ? 4096 : 512) == 0);
+    const uint32_t *chunk = file.data() + positions[c] / 4;
+    uint32_t n_nodes = chunk[0], start = chunk[1];
+    const uint32_t *offsets = chunk + 2;
+    // a chunk starts at the end of the one before, or goes on with its node
+    assert(start == prev_end || start + 1 == prev_end);
+    assert(start + n_nodes == ends[c]);
+    for (uint32_t j = 0; j < n_nodes; j++) {
+      assert((offsets[j + 1] - offsets[j]) % edge_ints == 0 &&
+             "a piece splits an edge");
+      std::vector<uint32_t> &words = node_words[start + j];
+      words.insert(words.end(), chunk + offsets[j], chunk + offsets[j + 1]);
+    }
+    prev_end = ends[c];
+  }
+  for (size_t v = 0; v < degrees.size(); v++) {
+    assert(node_words[v].size() == degrees[v] * edge_ints);
+  }
+}
+
+int main() {
+  // node 1 needs three chunks, the others fit in one with their neighbors
+  std::vector<uint32_t> degrees = {10, 2500, 3, 5};
+  std::vector<uint32_t> edges;
+  for (uint32_t v = 0; v < degrees.size(); v++) {
+    for (uint32_t k = 0; k < degrees[v]; k++) {
+      edges.push_back((v * 7 + k) % degrees.size());
+    }
+  }
+  std::vector<float> weights(edges.size(), 1);
+  std::string dir = "/tmp/test_chunk_index";
+  mkdir(dir.c_str(), 0755);
+  ArtifactWriter writer(dir, CHUNK_SIZE_BYTE, 4, false, false, true, true);
+  writer.addNodes(0, degrees.data(), degrees.size(), edges.data(),
+                  weights.data());
+  writer.finish();
+  assert(writer.getNumChunks() == 4);
+
+  // the pieces of node 1 end at node 2 in the chunk info, and together hold
+  // its neighbor list in order
+  std::vector<std::vector<uint32_t>> node_words;
+  checkChunks(dir, "", 1, degrees, node_words);
+  ArrayFile chunk_info(dir + "/chunk_info.bin", 4);
+  assert(chunk_info.view<uint32_t>()[1] == 2 &&
+         chunk_info.view<uint32_t>()[2] == 2);
+  size_t edge = 0;
+  for (size_t v = 0; v < degrees.size(); v++) {
+    for (uint32_t neighbor : node_words[v]) {
+      assert(neighbor == edges[edge++]);
+    }
+  }
+
+  // weighted pieces hold whole entries
+  checkChunks(dir, "weighted_", AliasTable::ENTRY_INTS, degrees, node_words);
+  assert(writer.getNumWeightedChunks() > 4);
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,64 @@
+#include "utils/edge_codec.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main() {
+  std::mt19937 gen(0);
+
+  // lists of every length around the quad size, sorted and not, with values
+  // of every byte length
+  for (size_t n = 0; n < 40; n++) {
+    for (int sorted = 0; sorted < 2; sorted++) {
+      std::vector<uint32_t> values(n);
+      for (size_t i = 0; i < n; i++) {
+        values[i] = gen() >> (8 * (i % 4));
+      }
+      if (sorted) {
+        std::sort(values.begin(), values.end());
+      }
+      std::vector<uint8_t> encoded(EdgeCodec::maxEncodedSize(n) + 16);
+      size_t size = EdgeCodec::encode(values.data(), n, encoded.data());
+      assert(size <= EdgeCodec::maxEncodedSize(n));
+      std::vector<uint32_t> decoded(n);
+      assert(EdgeCodec::decode(encoded.data(), n, decoded.data()) == size &&
+             "decoded size is not correct");
+      assert(decoded == values && "decoded values are not correct");
+    }
+  }
+
+  // a raw chunk of 1000 nodes with sorted neighbor lists
+  const uint32_t n_nodes = 1000;
+  std::vector<uint32_t> raw = {n_nodes, 5000, n_nodes + 3};
+  std::vector<uint32_t> edges;
+  std::uniform_int_distribution<uint32_t> node_dis(0, 1 << 20);
+  for (uint32_t i = 0; i < n_nodes; i++) {
+    size_t degree = i % 7 == 0 ? 0 : gen() % 50;
+    std::vector<uint32_t> list(degree);
+    for (auto &v : list) {
+      v = node_dis(gen);
+    }
+    std::sort(list.begin(), list.end());
+    edges.insert(edges.end(), list.begin(), list.end());
+    raw.push_back(raw.back() + degree);
+  }
+  raw.insert(raw.end(), edges.begin(), edges.end());
+
+  std::vector<uint8_t> compressed(3, 0xAB);
+  size_t size = EdgeCodec::encodeChunk(raw.data(), compressed);
+  assert(compressed.size() == 3 + size && "chunk is not appended");
+  assert(size < raw.size() * 4 * 3 / 4 && "sorted lists do not compress");
+
+  std::vector<uint32_t> decoded(raw.size() + 16);
+  assert(EdgeCodec::decodeChunk(compressed.data() + 3, decoded.data()) ==
+         raw.size());
+  assert(std::equal(raw.begin(), raw.end(), decoded.begin()) &&
+         "decoded chunk is not correct");
+
+  assert(EdgeCodec::fileHeaderSize(10) == 4096);
+  assert(EdgeCodec::fileHeaderSize(600) == 8192);
+  std::cout << "EdgeCodec test passed, " << raw.size() * 4 << " -> " << size
+            << " bytes" << std::endl;
+}
@@ -0,0 +1,128 @@
+#include "StreamingSampler.hpp"
+#include "utils/artifact_writer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <sys/stat.h>
+#include <vector>
+
+const uint N_NODES = 2000;
+const uint DEGREE = 8;
+
+std::vector<uint> batchTargets(StreamingSampler &sampler, size_t batch) {
+  Span<const uint> targets = sampler.getBatchTargets(batch);
+  return std::vector<uint>(targets.begin(), targets.end());
+}
+
+int main() {
+  // the edge file is opened with O_DIRECT, so it is written next to the test
+  // binary rather than to a tmpfs
+  std::string dir = "epoch_settings_graph";
+  mkdir(dir.c_str(), 0755);
+  std::vector<uint32_t> degrees(N_NODES, DEGREE), edges, train;
+  for (uint v = 0; v < N_NODES; v++) {
+    for (uint k = 0; k < DEGREE; k++) {
+      edges.push_back((v * 31 + k * 97) % N_NODES);
+    }
+    train.push_back(v);
+  }
+  ArtifactWriter writer(dir, 4096, 4);
+  writer.addNodes(0, degrees.data(), N_NODES, edges.data());
+  writer.finish();
+  writer.writeTrainNodes(train);
+
+  StreamingSampler sampler(
+      {0}, "parallel_streaming_sampler.xclbin", "parallel_streaming_sampler",
+      dir + "/streaming_edges.bin", dir + "/chunk_info.bin",
+      dir + "/train.bin", {4, 4}, 4096 / sizeof(int));
+  sampler.setDeviceMemory(64 << 20);
+  sampler.setBatchSize(64);
+  sampler.setSeed(7);
+  sampler.newEpochStart();
+  std::vector<uint> first = batchTargets(sampler, 0);
+  sampler.newEpochStart();
+  std::vector<uint> second = batchTargets(sampler, 0);
+  assert(second.size() == 64);
+
+  // the next epoch is sampled in the background by now, a setter drops it
+  // and the epoch is sampled again with the new setting and the same order
+  sampler.setSeed(7);
+  sampler.newEpochStart();
+  assert(batchTargets(sampler, 0) == first &&
+         "an epoch after setSeed is not the first epoch of that seed");
+  sampler.setBatchSize(32);
+  sampler.newEpochStart();
+  std::vector<uint> smaller = batchTargets(sampler, 0);
+  assert(smaller.size() == 32 &&
+         "the batch size did not apply to the next epoch");
+  assert(std::equal(smaller.begin(), smaller.end(), second.begin()) &&
+         "the epoch sampled again has another order");
+
+  // sampleLayer waits for the epoch in the background
+  std::vector<uint> frontier = {0, 1, 2}, result;
+  sampler.sampleLayer(Span<const uint>(frontier.data(), frontier.size()), 4,
+                      result, Philox(7, 100, 0));
+  for (uint node : result) {
+    bool found = false;
+    for (uint f : frontier) {
+      for (uint k = 0; k < DEGREE; k++) {
+        found = found || edges[f * DEGREE + k] == node;
+      }
+    }
+    assert(found && "a sampled node is not a neighbor");
+  }
+
+  // every batch has one span per layer, each layer the distinct neighbors
+  // drawn for the layer before it, and the batches serve every target once
+  std::vector<uint> served;
+  for (size_t b = 0; b < sampler.getNumBatches(); b++) {
+    std::vector<uint> previous = batchTargets(sampler, b);
+    served.insert(served.end(), previous.begin(), previous.end());
+    std::vector<Span<const uint>> batch = sampler.getBatch(b);
+    assert(batch.size() == sampler.getFanouts().size() &&
+           "number of layers is not correct");
+    for (auto &layer : batch) {
+      std::vector<uint> nodes(layer.begin(), layer.end());
+      std::sort(nodes.begin(), nodes.end());
+      assert(!nodes.empty() && nodes.size() <= previous.size() * 4);
+      assert(std::adjacent_find(nodes.begin(), nodes.end()) == nodes.end() &&
+             "a layer is not deduplicated");
+      for (uint node : nodes) {
+        bool found = false;
+        for (uint f : previous) {
+          found = found || std::count(edges.begin() + f * DEGREE,
+                                      edges.begin() + (f + 1) * DEGREE, node);
+        }
+        assert(found && "a sampled node is not a neighbor");
+      }
+      previous = nodes;
+    }
+  }
+  std::sort(served.begin(), served.end());
+  assert(served == train && "the batches do not serve every target once");
+
+  // epochs sampled 3 per pass are the epochs sampled one by one
+  std::vector<std::vector<uint>> one_by_one;
+  for (size_t fused : {1, 3}) {
+    sampler.setFusedEpochs(fused);
+    sampler.setSeed(7);
+    for (size_t epoch = 0; epoch < 3; epoch++) {
+      sampler.newEpochStart();
+      std::vector<uint> first_batch;
+      for (auto &layer : sampler.getBatch(0)) {
+        first_batch.insert(first_batch.end(), layer.begin(), layer.end());
+      }
+      if (fused == 1) {
+        one_by_one.push_back(first_batch);
+      } else {
+        assert(first_batch == one_by_one[epoch] &&
+               "fused epochs differ from the epochs one by one");
+      }
+    }
+  }
+  assert(one_by_one[0] != one_by_one[1]);
+  sampler.setFusedEpochs(1);
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
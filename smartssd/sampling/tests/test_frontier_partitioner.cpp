@@ -0,0 +1,48 @@
+#include "FrontierPartitioner.hpp"
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <vector>
+
+int main() {
+  // chunk c holds the nodes below chunk_offsets[c], chunk 2 stays empty
+  std::vector<uint> chunk_offsets = {100, 250, 250, 1000};
+  FrontierPartitioner partitioner(chunk_offsets);
+
+  std::vector<uint> frontier;
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<uint> dis(0, 999);
+  for (size_t i = 0; i < 100000; i++) {
+    frontier.push_back(dis(gen));
+  }
+  partitioner.partition(frontier.data(), frontier.size());
+
+  assert(partitioner.getNumChunks() == chunk_offsets.size() &&
+         "number of chunks is not correct");
+  assert(partitioner.size() == frontier.size() &&
+         "number of nodes is not correct");
+  assert(partitioner.getChunk(2).empty() && "empty chunk has nodes");
+
+  const std::vector<uint> &idx = partitioner.getIndex();
+  std::vector<bool> seen(frontier.size(), false);
+  for (size_t c = 0; c < partitioner.getNumChunks(); c++) {
+    uint chunk_start = c == 0 ? 0 : chunk_offsets[c - 1];
+    size_t begin = partitioner.getChunkBegin()[c];
+    Span<const uint> chunk = partitioner.getChunk(c);
+    for (size_t j = 0; j < chunk.size(); j++) {
+      assert(chunk[j] >= chunk_start && chunk[j] < chunk_offsets[c] &&
+             "node is in the wrong chunk");
+      assert(frontier[idx[begin + j]] == chunk[j] && "index is not correct");
+      // nodes of the same chunk keep their order
+      assert((j == 0 || idx[begin + j - 1] < idx[begin + j]) &&
+             "partition is not stable");
+      seen[idx[begin + j]] = true;
+    }
+    std::cout << "chunk " << c << ": " << chunk.size() << " nodes"
+              << std::endl;
+  }
+  for (bool s : seen) {
+    assert(s && "index is not a permutation");
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include "utils/graph_generator.hpp"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+/**
+ * Check the nodes [first, first + n) of a generator: sorted distinct
+ * neighbors inside the graph, no more than max_degree each
+ */
+size_t checkBlock(const GraphGenerator &generator, uint64_t first, size_t n,
+                  uint64_t max_degree) {
+  std::vector<uint32_t> degrees, edges;
+  generator.generateBlock(first, n, degrees, edges);
+  assert(degrees.size() == n);
+  size_t pos = 0;
+  for (size_t i = 0; i < n; i++) {
+    assert(degrees[i] <= max_degree && "degree is over the cap");
+    for (size_t j = 0; j < degrees[i]; j++) {
+      assert(edges[pos + j] < generator.getNumNodes());
+      assert((j == 0 || edges[pos + j - 1] < edges[pos + j]) &&
+             "neighbors are not sorted and distinct");
+    }
+    pos += degrees[i];
+  }
+  assert(pos == edges.size());
+
+  // the same block again is the same
+  std::vector<uint32_t> again_degrees, again_edges;
+  generator.generateBlock(first, n, again_degrees, again_edges);
+  assert(again_degrees == degrees && again_edges == edges);
+  return edges.size();
+}
+
+int main() {
+  const uint64_t n_nodes = 1 << 16;
+  const char *models[] = {"rmat", "power_law", "log_normal"};
+  for (const char *name : models) {
+    for (int scramble = 0; scramble < 2; scramble++) {
+      GraphGenerator generator(GraphGenerator::parseModel(name), n_nodes, 8,
+                               7);
+      generator.setScramble(scramble);
+      generator.setMaxDegree(1000);
+      size_t n_edges = checkBlock(generator, 0, n_nodes, 1000);
+      // duplicates are dropped, so a bit less than 8 per node on average
+      std::cout << name << (scramble ? " scrambled" : "") << ": " << n_edges
+                << " edges" << std::endl;
+      assert(n_edges > n_nodes * 4 && n_edges <= n_nodes * 9);
+    }
+  }
+
+  // the hubs of rmat are the nodes with few bottom row bits, node 0 first
+  GraphGenerator rmat(GraphGenerator::RMAT, n_nodes, 8, 7);
+  std::vector<uint32_t> degrees, edges;
+  rmat.generateBlock(0, 1, degrees, edges);
+  std::vector<uint32_t> last_degrees, last_edges;
+  rmat.generateBlock(n_nodes - 1, 1, last_degrees, last_edges);
+  assert(degrees[0] > 100 && last_degrees[0] == 0);
+
+  // a different seed gives a different graph
+  GraphGenerator other(GraphGenerator::RMAT, n_nodes, 8, 8);
+  std::vector<uint32_t> other_degrees, other_edges;
+  other.generateBlock(0, 1, other_degrees, other_edges);
+  assert(other_edges != edges);
+
+  // about the asked fraction of training nodes
+  size_t n_train = 0;
+  for (uint64_t node = 0; node < n_nodes; node++) {
+    n_train += rmat.isTrainNode(node, 0.1);
+  }
+  assert(n_train > n_nodes / 20 && n_train < n_nodes / 5);
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
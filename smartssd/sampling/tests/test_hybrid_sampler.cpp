@@ -0,0 +1,180 @@
+#include "HybridSampler.hpp"
+#include "utils/artifact_writer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <sys/stat.h>
+#include <vector>
+
+const uint N_NODES = 2048;
+const uint DEGREE = 8;
+const uint FANOUT = 4;
+// streaming every chunk costs as much as this many random sector reads
+const double STREAM_ALL_SECTORS = 40.5;
+
+/**
+ * Write a graph whose nodes [0, n_linked) have DEGREE neighbors each and the
+ * others none. DEGREE divides a sector, so every neighbor list is in one
+ * sector and random reads take exactly one sector per linked node.
+ * @param new_to_old: The original id of every node, empty for no node map
+ */
+void writeGraph(std::string dir, uint n_linked,
+                const std::vector<uint32_t> &new_to_old) {
+  mkdir(dir.c_str(), 0755);
+  std::vector<uint32_t> degrees(N_NODES, 0), edges, train;
+  for (uint v = 0; v < N_NODES; v++) {
+    if (v < n_linked) {
+      degrees[v] = DEGREE;
+      for (uint k = 0; k < DEGREE; k++) {
+        edges.push_back((v * 31 + k * 97) % n_linked);
+      }
+    }
+    train.push_back(v);
+  }
+  ArtifactWriter writer(dir, 4096, 4);
+  writer.addNodes(0, degrees.data(), N_NODES, edges.data());
+  writer.finish();
+  writer.writeTrainNodes(train);
+  if (!new_to_old.empty()) {
+    writer.writeNodeMaps(new_to_old);
+  }
+}
+
+/**
+ * A hybrid sampler over the graph in dir, each engine on an emulated device
+ */
+HybridSampler *newHybridSampler(std::string dir,
+                                std::shared_ptr<RandomReadSampler> &random_read,
+                                std::shared_ptr<StreamingSampler> &streaming) {
+  std::vector<uint> fanouts = {FANOUT, FANOUT};
+  random_read = std::make_shared<RandomReadSampler>(
+      std::vector<uint>{0}, "random_read_sampler.xclbin",
+      "random_read_sampler", dir + "/random_read_edges.bin",
+      dir + "/offsets.bin", fanouts);
+  streaming = std::make_shared<StreamingSampler>(
+      std::vector<uint>{1}, "parallel_streaming_sampler.xclbin",
+      "parallel_streaming_sampler", dir + "/streaming_edges.bin",
+      dir + "/chunk_info.bin", dir + "/train.bin", fanouts, 4096 / sizeof(int));
+  streaming->setDeviceMemory(64 << 20);
+  return new HybridSampler(random_read, streaming, fanouts);
+}
+
+int main() {
+  // the edge files are opened with O_DIRECT, so they are written next to the
+  // test binary rather than to a tmpfs
+  std::string dir = "hybrid_sampler_graph";
+  writeGraph(dir, N_NODES, {});
+  std::shared_ptr<RandomReadSampler> random_read;
+  std::shared_ptr<StreamingSampler> streaming;
+  std::unique_ptr<HybridSampler> sampler(
+      newHybridSampler(dir, random_read, streaming));
+
+  // one node of every chunk in turn, so that every chunk is touched once the
+  // frontier has as many nodes as there are chunks
+  const std::vector<uint> &chunk_ends = streaming->getChunkOffsets();
+  std::vector<std::pair<uint, uint>> by_place;
+  for (uint v = 0; v < N_NODES; v++) {
+    size_t chunk =
+        std::upper_bound(chunk_ends.begin(), chunk_ends.end(), v) -
+        chunk_ends.begin();
+    uint chunk_start = chunk == 0 ? 0 : chunk_ends[chunk - 1];
+    by_place.push_back({v - chunk_start, v});
+  }
+  std::sort(by_place.begin(), by_place.end());
+  std::vector<uint> nodes;
+  for (auto &place : by_place) {
+    nodes.push_back(place.second);
+  }
+  assert(chunk_ends.size() < STREAM_ALL_SECTORS);
+
+  // a sector read takes 1 ms and streaming the whole file
+  // STREAM_ALL_SECTORS ms, so random reads win up to that many nodes
+  double file_bytes = 0;
+  for (size_t c = 0; c < chunk_ends.size(); c++) {
+    file_bytes += streaming->getChunkStoredSize(c);
+  }
+  double bandwidth = 1000 * file_bytes / STREAM_ALL_SECTORS;
+  sampler->setDeviceModel(bandwidth, 1000, 0);
+  for (size_t n : {1, 10, 40, 41, 100, 2048}) {
+    double random_read_cost, streaming_cost;
+    HybridSampler::Engine engine =
+        sampler->chooseEngine(Span<const uint>(nodes.data(), n), FANOUT,
+                              random_read_cost, streaming_cost);
+    assert(random_read_cost == n && "not one sector per node");
+    assert(engine == (n <= STREAM_ALL_SECTORS
+                          ? HybridSampler::Engine::RandomRead
+                          : HybridSampler::Engine::Streaming) &&
+           "the engines do not switch at the modeled frontier size");
+  }
+
+  // a sample takes the engine of the model for its first layer, and gives
+  // what the engine of every layer gives for the same draws
+  sampler->setSeed(7);
+  uint32_t call = 0;
+  for (size_t n : {40, 41}) {
+    sampler->setDeviceModel(bandwidth, 1000, 0);
+    std::vector<uint> frontier(nodes.begin(), nodes.begin() + n);
+    std::vector<std::vector<uint>> result = sampler->getSample(frontier);
+    const std::vector<HybridSampler::Engine> &engines =
+        sampler->getLastEngines();
+    assert(result.size() == 2 && engines.size() == 2);
+    assert(engines[0] == (n == 40 ? HybridSampler::Engine::RandomRead
+                                  : HybridSampler::Engine::Streaming));
+    for (size_t i = 0; i < result.size(); i++) {
+      std::vector<uint> expected;
+      Philox draws(7, call, i);
+      Span<const uint> layer_frontier(frontier.data(), frontier.size());
+      if (engines[i] == HybridSampler::Engine::RandomRead) {
+        random_read->sampleLayer(layer_frontier, FANOUT, expected, draws);
+      } else {
+        streaming->sampleLayer(layer_frontier, FANOUT, expected, draws);
+      }
+      assert(result[i] == expected &&
+             "a layer differs from the engine it was sampled with");
+      if (i == 0) {
+        // and not what the other engine gives
+        std::vector<uint> other;
+        if (engines[i] == HybridSampler::Engine::RandomRead) {
+          streaming->sampleLayer(layer_frontier, FANOUT, other, draws);
+        } else {
+          random_read->sampleLayer(layer_frontier, FANOUT, other, draws);
+        }
+        assert(other != expected);
+      }
+      frontier = result[i];
+    }
+    call++;
+  }
+
+  // calibration replaces the model by what it measures
+  sampler->setDeviceModel(1, 1, 0);
+  std::vector<uint> probe(nodes.begin(), nodes.begin() + 500);
+  sampler->calibrate(Span<const uint>(probe.data(), probe.size()), FANOUT);
+  assert(sampler->getIops() > 1 && sampler->getBandwidth() > 1 &&
+         "calibrate did not move the model");
+
+  // on a reordered graph the probe is in the original ids: the nodes linked
+  // in the files are the old ids [N_NODES / 2, N_NODES), and the same ids in
+  // the files have no neighbors to read
+  std::string reordered_dir = "hybrid_sampler_reordered_graph";
+  std::vector<uint32_t> new_to_old(N_NODES);
+  for (uint v = 0; v < N_NODES; v++) {
+    new_to_old[v] = (v + N_NODES / 2) % N_NODES;
+  }
+  writeGraph(reordered_dir, N_NODES / 2, new_to_old);
+  std::unique_ptr<HybridSampler> reordered(
+      newHybridSampler(reordered_dir, random_read, streaming));
+  reordered->setNodeMap(reordered_dir + "/old_to_new.bin",
+                        reordered_dir + "/new_to_old.bin");
+  reordered->setDeviceModel(1, 1, 0);
+  for (uint v = 0; v < probe.size(); v++) {
+    probe[v] = N_NODES / 2 + v;
+  }
+  reordered->calibrate(Span<const uint>(probe.data(), probe.size()), FANOUT);
+  assert(reordered->getIops() > 1 &&
+         "calibrate read the probe in the ids of the files");
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
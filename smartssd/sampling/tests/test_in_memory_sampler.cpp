@@ -0,0 +1,123 @@
+#include "InMemorySampler.hpp"
+#include "utils/artifact_writer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+#include <set>
+#include <sys/stat.h>
+#include <vector>
+
+// node i has i % 40 neighbors, (i * 31 + k) % N_NODES for k < i % 40
+const uint N_NODES = 1000;
+
+void writeGraph(std::string edge_file_path, std::string offsets_file_path) {
+  std::ofstream edge_file(edge_file_path, std::ios::binary);
+  std::ofstream offsets_file(offsets_file_path, std::ios::binary);
+  uint32_t offset = 0;
+  for (uint i = 0; i < N_NODES; i++) {
+    offsets_file.write(reinterpret_cast<char *>(&offset), sizeof(offset));
+    for (uint k = 0; k < i % 40; k++) {
+      uint32_t neighbor = (i * 31 + k) % N_NODES;
+      edge_file.write(reinterpret_cast<char *>(&neighbor), sizeof(neighbor));
+      offset++;
+    }
+  }
+  offsets_file.write(reinterpret_cast<char *>(&offset), sizeof(offset));
+}
+
+bool isNeighbor(uint node, uint neighbor) {
+  return (neighbor + N_NODES - node * 31 % N_NODES) % N_NODES < node % 40;
+}
+
+int main() {
+  writeGraph("/tmp/test_in_memory_edges.bin", "/tmp/test_in_memory_offsets.bin");
+  InMemorySampler sampler("/tmp/test_in_memory_edges.bin",
+                          "/tmp/test_in_memory_offsets.bin", {25, 10});
+  assert(sampler.getNumNodes() == N_NODES && "number of nodes is not correct");
+
+  std::vector<uint> frontier = {1, 7, 39, 40, 123, 999};
+  auto result = sampler.getSample(frontier);
+  assert(result.size() == 2 && "number of layers is not correct");
+
+  for (size_t layer = 0; layer < result.size(); layer++) {
+    std::vector<uint> &sample = result[layer];
+    assert(std::is_sorted(sample.begin(), sample.end()) &&
+           std::adjacent_find(sample.begin(), sample.end()) == sample.end() &&
+           "sample is not sorted and deduplicated");
+    for (uint node : sample) {
+      bool found = std::any_of(frontier.begin(), frontier.end(),
+                               [&](uint f) { return isNeighbor(f, node); });
+      assert(found && "sampled node is not a neighbor of the frontier");
+    }
+    std::cout << "layer " << layer << ": " << sample.size() << " nodes"
+              << std::endl;
+    frontier = sample;
+  }
+
+  // nodes with fewer neighbors than the fanout get all of them
+  result = sampler.getSample({7, 20});
+  std::set<uint> expected;
+  for (uint k = 0; k < 7; k++) {
+    expected.insert((7 * 31 + k) % N_NODES);
+  }
+  for (uint k = 0; k < 20; k++) {
+    expected.insert((20 * 31 + k) % N_NODES);
+  }
+  assert(std::vector<uint>(expected.begin(), expected.end()) == result[0] &&
+         "low degree nodes are not fully sampled");
+
+  // the same seed gives the same samples for any number of threads, and the
+  // next call other ones
+  std::vector<uint> targets;
+  for (uint i = 0; i < N_NODES; i += 3) {
+    targets.push_back(i);
+  }
+  sampler.setSeed(5);
+  omp_set_num_threads(1);
+  auto one_thread = sampler.getSample(targets);
+  auto next_call = sampler.getSample(targets);
+  sampler.setSeed(5);
+  omp_set_num_threads(4);
+  assert(sampler.getSample(targets) == one_thread &&
+         "samples depend on the number of threads");
+  assert(sampler.getSample(targets) == next_call && next_call != one_thread);
+
+  // without replacement a node gets fanout distinct neighbors
+  sampler.setReplace(false);
+  for (uint node : {25u, 39u, 79u}) {
+    result = sampler.getSample({node});
+    assert(result[0].size() == std::min<uint>(25, node % 40) &&
+           "neighbors sampled without replacement are not distinct");
+  }
+
+  // weighted sampling never draws a neighbor of weight 0, also for nodes
+  // with fewer neighbors than the fanout, and draws the others
+  std::string dir = "/tmp/test_in_memory_weighted";
+  mkdir(dir.c_str(), 0755);
+  ArtifactWriter writer(dir, 4096, 4, false, false, true);
+  std::vector<uint32_t> degrees = {10, 2, 0, 1};
+  std::vector<uint32_t> edges = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 2, 3, 0};
+  std::vector<float> weights = {0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 5, 0};
+  writer.addNodes(0, degrees.data(), degrees.size(), edges.data(),
+                  weights.data());
+  writer.finish();
+  struct stat statbuf;
+  assert(stat((dir + "/weighted_edges.bin").c_str(), &statbuf) == 0 &&
+         statbuf.st_size == 512 && "alias entries are not padded to 512");
+  InMemorySampler weighted_sampler(dir + "/weighted_edges.bin",
+                                   dir + "/offsets.bin", {100}, 0);
+  weighted_sampler.setSeed(1);
+  weighted_sampler.setWeighted(true);
+  result = weighted_sampler.getSample({0, 1, 2});
+  std::vector<uint> expected_weighted = {2, 3, 4, 5, 6, 7, 8, 9, 10};
+  assert(result[0] == expected_weighted &&
+         "weighted sample is not the neighbors of positive weight");
+  // only weight 0, sampled uniformly
+  result = weighted_sampler.getSample({3});
+  assert(result[0] == std::vector<uint>({0}));
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
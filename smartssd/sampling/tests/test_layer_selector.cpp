@@ -0,0 +1,74 @@
+#include "LayerSelector.hpp"
+#include "utils/philox.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <vector>
+
+int main() {
+  // distinct candidates of 4 batches, the small ones are under the budget
+  std::vector<uint> batch_size = {3, 50, 0, 40};
+  std::vector<uint> nodes;
+  for (size_t b = 0; b < batch_size.size(); b++) {
+    for (uint i = 0; i < batch_size[b]; i++) {
+      nodes.push_back(1000 * b + 7 * i);
+    }
+  }
+  std::vector<float> importance(4000, 1);
+  const uint budget = 10;
+  std::vector<uint> original = nodes;
+  std::vector<uint> original_size = batch_size;
+
+  LayerSelector selector;
+  Philox draws(3, 0, 1);
+  selector.select(nodes, batch_size, budget, importance, draws);
+  assert(batch_size == std::vector<uint>({3, 10, 0, 10}) &&
+         "batches are not capped at the budget");
+  assert(nodes.size() == 23);
+  size_t in_pos = 0, out_pos = 0;
+  for (size_t b = 0; b < batch_size.size(); b++) {
+    std::set<uint> candidates(original.begin() + in_pos,
+                              original.begin() + in_pos + original_size[b]);
+    std::set<uint> kept(nodes.begin() + out_pos,
+                        nodes.begin() + out_pos + batch_size[b]);
+    assert(kept.size() == batch_size[b] && "a node is kept twice");
+    for (uint node : kept) {
+      assert(candidates.count(node) && "a kept node is not a candidate");
+    }
+    in_pos += original_size[b];
+    out_pos += batch_size[b];
+  }
+  // the batch under the budget keeps all of its candidates in place
+  assert(std::equal(nodes.begin(), nodes.begin() + 3, original.begin()));
+
+  // the same draws select the same nodes
+  std::vector<uint> again = original;
+  std::vector<uint> again_size = original_size;
+  selector.select(again, again_size, budget, importance, draws);
+  assert(again == nodes && again_size == batch_size);
+
+  // one node of {0, 1, 2, 3} kept per batch, in proportion to importance
+  const size_t n_batches = 1 << 16;
+  std::vector<float> weights = {1, 2, 3, 4};
+  nodes.clear();
+  for (size_t b = 0; b < n_batches; b++) {
+    nodes.insert(nodes.end(), {0, 1, 2, 3});
+  }
+  batch_size.assign(n_batches, 4);
+  selector.select(nodes, batch_size, 1, weights, draws);
+  assert(nodes.size() == n_batches);
+  std::vector<size_t> counts(4, 0);
+  for (uint node : nodes) {
+    counts[node]++;
+  }
+  for (size_t v = 0; v < 4; v++) {
+    double expected = n_batches * weights[v] / 10.0;
+    assert(std::abs(counts[v] - expected) < 5 * std::sqrt(expected) &&
+           "kept nodes do not follow the importance");
+  }
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include "utils/metrics.hpp"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::string readFile(std::string file_path) {
+  std::ifstream file(file_path);
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+int main() {
+  metrics::reset();
+
+  // counters of every thread are summed, also of threads that ended
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < 1000; i++) {
+        metrics::add(metrics::BYTES_READ, 512);
+        metrics::add(metrics::READS_ISSUED, 1);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  metrics::Snapshot snapshot = metrics::snapshot();
+  assert(snapshot.counters[metrics::BYTES_READ] == 4 * 1000 * 512);
+  assert(snapshot.counters[metrics::READS_ISSUED] == 4000);
+  assert(snapshot.counters[metrics::SAMPLES] == 0);
+
+  // 1000 ns falls in the bucket below 1024 ns
+  metrics::observeNanoseconds(metrics::KERNEL_SECONDS, 1000);
+  metrics::observeNanoseconds(metrics::KERNEL_SECONDS, 3000);
+  metrics::observeNanoseconds(metrics::KERNEL_SECONDS, 0);
+  snapshot = metrics::snapshot();
+  assert(snapshot.count[metrics::KERNEL_SECONDS] == 3);
+  assert(snapshot.buckets[metrics::KERNEL_SECONDS][0] == 1);
+  assert(snapshot.buckets[metrics::KERNEL_SECONDS][10] == 1);
+  assert(snapshot.buckets[metrics::KERNEL_SECONDS][12] == 1);
+  assert(metrics::getBucketBound(10) == 1024e-9);
+  assert(snapshot.sum_seconds[metrics::KERNEL_SECONDS] > 3.9e-6 &&
+         snapshot.sum_seconds[metrics::KERNEL_SECONDS] < 4.1e-6);
+
+  // a scope is recorded when it ends
+  {
+    metrics::ScopedLatency latency(metrics::DEDUP_SECONDS);
+  }
+  assert(metrics::snapshot().count[metrics::DEDUP_SECONDS] == 1);
+
+  // gauges keep the last value by layer, other layers stay unset
+  metrics::setGauge(metrics::LAYER_FRONTIER_SIZE, 1, 7);
+  metrics::setGauge(metrics::LAYER_FRONTIER_SIZE, 1, 9);
+  metrics::setGauge(metrics::LAYER_FRONTIER_SIZE, metrics::MAX_LAYERS, 1);
+  snapshot = metrics::snapshot();
+  assert(snapshot.gauge_set[metrics::LAYER_FRONTIER_SIZE][1]);
+  assert(snapshot.gauges[metrics::LAYER_FRONTIER_SIZE][1] == 9);
+  assert(!snapshot.gauge_set[metrics::LAYER_FRONTIER_SIZE][0]);
+
+  std::string prometheus = metrics::toPrometheus(snapshot);
+  assert(prometheus.find("sampler_bytes_read_total 2048000\n") !=
+         std::string::npos);
+  assert(prometheus.find("sampler_layer_frontier_size{layer=\"1\"} 9\n") !=
+         std::string::npos);
+  assert(prometheus.find("sampler_kernel_seconds_count 3\n") !=
+         std::string::npos);
+  assert(prometheus.find("sampler_kernel_seconds_bucket{le=\"+Inf\"} 3\n") !=
+         std::string::npos);
+
+  std::string json = metrics::toJson(snapshot);
+  assert(json.find("\"reads_issued\": 4000") != std::string::npos);
+  assert(json.find("\"layer_frontier_size\": [null, 9]") !=
+         std::string::npos);
+
+  // the file format follows the extension
+  assert(metrics::writeSnapshot("test_metrics.prom") == 0);
+  assert(readFile("test_metrics.prom") == prometheus);
+  assert(metrics::writeSnapshot("test_metrics.json") == 0);
+  assert(readFile("test_metrics.json") == json);
+  remove("test_metrics.prom");
+  remove("test_metrics.json");
+  assert(metrics::writeSnapshot("/nonexistent/metrics.json") == -1);
+
+  metrics::reset();
+  snapshot = metrics::snapshot();
+  assert(snapshot.counters[metrics::BYTES_READ] == 0);
+  assert(snapshot.count[metrics::KERNEL_SECONDS] == 0);
+  assert(!snapshot.gauge_set[metrics::LAYER_FRONTIER_SIZE][1]);
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
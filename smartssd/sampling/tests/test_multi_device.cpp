@@ -0,0 +1,121 @@
+#include "RandomReadSampler.hpp"
+#include "StreamingSampler.hpp"
+#include "utils/artifact_writer.hpp"
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <sys/stat.h>
+#include <vector>
+
+const uint N_NODES = 8000;
+const uint DEGREE = 8;
+const uint N_DEVICES = 3;
+
+/**
+ * All batches of the current epoch, the target nodes of each followed by its
+ * layers
+ */
+std::vector<std::vector<uint>> epochBatches(StreamingSampler &sampler) {
+  std::vector<std::vector<uint>> batches;
+  for (size_t b = 0; b < sampler.getNumBatches(); b++) {
+    Span<const uint> targets = sampler.getBatchTargets(b);
+    std::vector<uint> batch(targets.begin(), targets.end());
+    for (auto &layer : sampler.getBatch(b)) {
+      batch.insert(batch.end(), layer.begin(), layer.end());
+    }
+    batches.push_back(batch);
+  }
+  return batches;
+}
+
+StreamingSampler *newStreamingSampler(std::string dir,
+                                      std::vector<uint> devices) {
+  StreamingSampler *sampler = new StreamingSampler(
+      devices, "parallel_streaming_sampler.xclbin",
+      "parallel_streaming_sampler", dir + "/streaming_edges.bin",
+      dir + "/chunk_info.bin", dir + "/train.bin", {4, 4}, 4096 / sizeof(int));
+  sampler->setDeviceMemory(64 << 20);
+  sampler->setBatchSize(64);
+  return sampler;
+}
+
+int main() {
+  // the edge files are opened with O_DIRECT, so they are written next to the
+  // test binary rather than to a tmpfs
+  std::string dir = "multi_device_graph";
+  mkdir(dir.c_str(), 0755);
+  std::vector<uint32_t> degrees(N_NODES, DEGREE), edges, train;
+  for (uint v = 0; v < N_NODES; v++) {
+    for (uint k = 0; k < DEGREE; k++) {
+      edges.push_back((v * 31 + k * 97) % N_NODES);
+    }
+    train.push_back(v);
+  }
+  ArtifactWriter writer(dir, 4096, 4);
+  writer.addNodes(0, degrees.data(), N_NODES, edges.data());
+  writer.finish();
+  writer.writeTrainNodes(train);
+
+  // the same seeded epochs on one device and on several: every device takes
+  // enough chunks to go through both of its slots many times, and fused
+  // epochs run the kernel more than once on a chunk in a slot
+  std::unique_ptr<StreamingSampler> one(newStreamingSampler(dir, {0}));
+  std::vector<uint> devices;
+  for (uint d = 0; d < N_DEVICES; d++) {
+    devices.push_back(d);
+  }
+  std::unique_ptr<StreamingSampler> many(newStreamingSampler(dir, devices));
+  assert(one->getChunkOffsets().size() >= 8 * N_DEVICES);
+  for (size_t fused : {1, 3}) {
+    one->setFusedEpochs(fused);
+    many->setFusedEpochs(fused);
+    one->setSeed(7);
+    many->setSeed(7);
+    for (size_t epoch = 0; epoch < 3; epoch++) {
+      one->newEpochStart();
+      many->newEpochStart();
+      assert(epochBatches(*one) == epochBatches(*many) &&
+             "an epoch differs between one device and several");
+    }
+  }
+
+  // a layer sampled on its own as well
+  std::vector<uint> frontier, one_result, many_result;
+  for (uint v = 0; v < N_NODES; v += 3) {
+    frontier.push_back(v);
+  }
+  Span<const uint> layer_frontier(frontier.data(), frontier.size());
+  one->sampleLayer(layer_frontier, 4, one_result, Philox(7, 100, 0));
+  many->sampleLayer(layer_frontier, 4, many_result, Philox(7, 100, 0));
+  assert(!one_result.empty() && one_result == many_result &&
+         "a layer differs between one device and several");
+
+  // random reads give every device a slice of the frontier, the slices are
+  // put back in order; a frontier smaller than the devices leaves one idle.
+  // Every device pins a raw sample buffer of the largest batch, so the
+  // buffers are made small before the next sampler is opened.
+  RandomReadSampler random_one({0}, "random_read_sampler.xclbin",
+                               "random_read_sampler",
+                               dir + "/random_read_edges.bin",
+                               dir + "/offsets.bin", {4, 4});
+  random_one.setMaxBatchSampleSize(4 * N_NODES);
+  RandomReadSampler random_many({0, 1}, "random_read_sampler.xclbin",
+                                "random_read_sampler",
+                                dir + "/random_read_edges.bin",
+                                dir + "/offsets.bin", {4, 4});
+  random_many.setMaxBatchSampleSize(4 * N_NODES);
+  for (size_t n : {frontier.size(), (size_t)1000, (size_t)1}) {
+    for (uint32_t call = 0; call < 3; call++) {
+      Span<const uint> slice(frontier.data(), n);
+      one_result.clear();
+      many_result.clear();
+      random_one.sampleLayer(slice, 4, one_result, Philox(7, call, 0));
+      random_many.sampleLayer(slice, 4, many_result, Philox(7, call, 0));
+      assert(!one_result.empty() && one_result == many_result &&
+             "a random read layer differs between one device and several");
+    }
+  }
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
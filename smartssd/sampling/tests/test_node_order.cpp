@@ -0,0 +1,138 @@
+#include "InMemorySampler.hpp"
+#include "utils/artifact_writer.hpp"
+#include "utils/node_order.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <sys/stat.h>
+#include <vector>
+
+// a ring of N_NODES nodes, both directions, the node at position p of the
+// ring has id (p * STRIDE) % N_NODES, so ring neighbors are far apart
+const uint N_NODES = 512;
+const uint STRIDE = 173;
+
+uint ringId(uint position) { return (position * STRIDE) % N_NODES; }
+
+void ringGraph(std::vector<uint64_t> &offsets, std::vector<uint32_t> &edges) {
+  std::vector<uint> position(N_NODES);
+  for (uint p = 0; p < N_NODES; p++) {
+    position[ringId(p)] = p;
+  }
+  offsets.assign(1, 0);
+  edges.clear();
+  for (uint v = 0; v < N_NODES; v++) {
+    edges.push_back(ringId((position[v] + N_NODES - 1) % N_NODES));
+    edges.push_back(ringId((position[v] + 1) % N_NODES));
+    offsets.push_back(edges.size());
+  }
+}
+
+bool isPermutation(std::vector<uint32_t> order, size_t n) {
+  std::sort(order.begin(), order.end());
+  for (size_t i = 0; i < order.size(); i++) {
+    if (order[i] != i) {
+      return false;
+    }
+  }
+  return order.size() == n;
+}
+
+// the largest and the summed id distance of the edges in the new order
+void distances(const std::vector<uint64_t> &offsets,
+               const std::vector<uint32_t> &edges,
+               const std::vector<uint32_t> &old_to_new, uint &largest,
+               uint64_t &sum) {
+  largest = 0;
+  sum = 0;
+  for (uint v = 0; v < N_NODES; v++) {
+    for (uint64_t e = offsets[v]; e < offsets[v + 1]; e++) {
+      uint distance = std::abs((int)old_to_new[v] - (int)old_to_new[edges[e]]);
+      largest = std::max(largest, distance);
+      sum += distance;
+    }
+  }
+}
+
+int main() {
+  std::vector<uint64_t> offsets;
+  std::vector<uint32_t> edges;
+  ringGraph(offsets, edges);
+  std::vector<uint32_t> identity(N_NODES);
+  for (uint v = 0; v < N_NODES; v++) {
+    identity[v] = v;
+  }
+  uint largest;
+  uint64_t scrambled_sum;
+  distances(offsets, edges, identity, largest, scrambled_sum);
+
+  for (auto method : {NodeOrder::DEGREE, NodeOrder::RCM, NodeOrder::GORDER}) {
+    std::vector<uint32_t> order =
+        NodeOrder::compute(method, N_NODES, offsets.data(), edges.data());
+    assert(isPermutation(order, N_NODES) && "an order is not a permutation");
+    std::vector<uint32_t> old_to_new = NodeOrder::invert(order);
+    assert(NodeOrder::invert(old_to_new) == order);
+
+    uint64_t sum;
+    distances(offsets, edges, old_to_new, largest, sum);
+    if (method == NodeOrder::RCM) {
+      // the bandwidth of a ring in breadth first order
+      assert(largest <= 2 && "rcm does not place ring neighbors together");
+    } else if (method == NodeOrder::GORDER) {
+      assert(sum * 10 < scrambled_sum &&
+             "gorder does not place ring neighbors together");
+    }
+  }
+
+  // hubs by descending in-degree, the others in their old order
+  std::vector<uint64_t> star_offsets = {0, 1, 2, 3, 5, 5, 5};
+  std::vector<uint32_t> star_edges = {5, 5, 2, 5, 2};
+  std::vector<uint32_t> order = NodeOrder::hubCluster(
+      6, star_offsets.data(), star_edges.data());
+  assert(order == std::vector<uint32_t>({5, 2, 0, 1, 3, 4}));
+
+  assert(NodeOrder::parseMethod("rcm") == NodeOrder::RCM);
+
+  // a graph written in the new order samples the neighbors of the old ids
+  // once the samplers have its maps
+  order = NodeOrder::compute(NodeOrder::RCM, N_NODES, offsets.data(),
+                             edges.data());
+  std::vector<uint32_t> old_to_new = NodeOrder::invert(order);
+  std::vector<uint32_t> degrees(N_NODES), new_edges;
+  for (uint i = 0; i < N_NODES; i++) {
+    uint v = order[i];
+    degrees[i] = offsets[v + 1] - offsets[v];
+    for (uint64_t e = offsets[v]; e < offsets[v + 1]; e++) {
+      new_edges.push_back(old_to_new[edges[e]]);
+    }
+  }
+  std::string dir = "/tmp/test_node_order";
+  mkdir(dir.c_str(), 0755);
+  ArtifactWriter writer(dir, 4096, 4, false, false, false);
+  writer.addNodes(0, degrees.data(), N_NODES, new_edges.data());
+  writer.finish();
+  writer.writeNodeMaps(order);
+
+  InMemorySampler sampler(dir + "/random_read_edges.bin",
+                          dir + "/offsets.bin", {2, 2}, 0);
+  assert(!sampler.hasNodeMap());
+  sampler.setNodeMap(dir + "/old_to_new.bin", dir + "/new_to_old.bin");
+  assert(sampler.hasNodeMap());
+  std::vector<uint> frontier = {ringId(0), ringId(100), ringId(300)};
+  auto result = sampler.getSample(frontier);
+  assert(result.size() == 2);
+  for (auto &layer : result) {
+    for (uint node : layer) {
+      bool found = std::any_of(frontier.begin(), frontier.end(), [&](uint f) {
+        return std::count(edges.begin() + offsets[f],
+                          edges.begin() + offsets[f + 1], node) > 0;
+      });
+      assert(found && "a sampled node is not a neighbor in the old ids");
+    }
+    frontier = layer;
+  }
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
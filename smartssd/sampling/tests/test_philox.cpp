@@ -0,0 +1,84 @@
+#include "utils/philox.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+int main() {
+  // known answers of Philox4x32-10 from the Random123 distribution
+  uint32_t zero_counter[4] = {0, 0, 0, 0};
+  uint32_t zero_key[2] = {0, 0};
+  uint32_t out[4];
+  Philox::block(zero_counter, zero_key, out);
+  assert(out[0] == 0x6627e8d5 && out[1] == 0xe169c58d &&
+         out[2] == 0xbc57ac4c && out[3] == 0x9b00dbd8);
+  uint32_t ones_counter[4] = {0xffffffff, 0xffffffff, 0xffffffff,
+                              0xffffffff};
+  uint32_t ones_key[2] = {0xffffffff, 0xffffffff};
+  Philox::block(ones_counter, ones_key, out);
+  assert(out[0] == 0x408f276d && out[1] == 0x41c83b0e &&
+         out[2] == 0xa20bc7c6 && out[3] == 0x6d5451fd);
+
+  // the batched blocks are the single draws, for any number of blocks
+  Philox draws(42, 3, 1);
+  for (size_t n_blocks : {1, 7, 8, 9, 20}) {
+    std::vector<uint32_t> words(n_blocks * 4);
+    draws.fill(123, 5, n_blocks, words.data());
+    for (size_t i = 0; i < words.size(); i++) {
+      assert(words[i] == draws.draw(123, 20 + i));
+    }
+  }
+
+  // every word of the counter and the key changes the draws
+  uint32_t first = draws.draw(123, 0);
+  assert(Philox(43, 3, 1).draw(123, 0) != first);
+  assert(Philox(42 + (uint64_t(1) << 32), 3, 1).draw(123, 0) != first);
+  assert(Philox(42, 4, 1).draw(123, 0) != first);
+  assert(Philox(42, 3, 2).draw(123, 0) != first);
+  assert(draws.draw(124, 0) != first && draws.draw(123, 1) != first);
+  assert(draws.seedFor(0) != draws.seedFor(1));
+
+  // draws below a range stay in it and hit every value about as often
+  const uint64_t range = 10;
+  const size_t n = 100000;
+  std::vector<uint64_t> picks(n);
+  draws.drawBelow(7, range, n, picks.data());
+  std::vector<size_t> hits(range, 0);
+  for (size_t i = 0; i < n; i++) {
+    assert(picks[i] < range);
+    assert(picks[i] == Philox::below(draws.draw(7, i), range));
+    hits[picks[i]]++;
+  }
+  for (size_t h : hits) {
+    assert(h > n / range * 9 / 10 && h < n / range * 11 / 10);
+  }
+  assert(Philox::below(0xffffffff, uint64_t(1) << 32) == 0xffffffff);
+  assert(Philox::below(0xffffffff, 1) == 0);
+
+  // distinct draws are distinct, in range, and every value is as likely
+  std::vector<size_t> distinct_hits(range, 0);
+  for (uint32_t node = 0; node < 10000; node++) {
+    uint32_t distinct[7];
+    draws.drawDistinct(node, range, 7, distinct);
+    for (size_t k = 0; k < 7; k++) {
+      assert(distinct[k] < range);
+      for (size_t m = 0; m < k; m++) {
+        assert(distinct[m] != distinct[k]);
+      }
+      distinct_hits[distinct[k]]++;
+    }
+  }
+  for (size_t h : distinct_hits) {
+    assert(h > 7000 * 9 / 10 && h < 7000 * 11 / 10);
+  }
+  // all of the range, and more draws than one batch
+  std::vector<uint64_t> all(300);
+  draws.drawDistinct(9, 300, 300, all.data());
+  std::sort(all.begin(), all.end());
+  for (size_t i = 0; i < all.size(); i++) {
+    assert(all[i] == i);
+  }
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
@@ -1,19 +1,14 @@
 #include "RandomReadSampler.hpp"
+#include "utils/array_file.hpp"
 #include "utils/timer.hpp"
 #include <algorithm>
-#include <fstream>
 #include <iostream>
 #include <random>
 
 std::vector<uint32_t> loadTargetNodes(std::string target_node_file_path) {
-  std::vector<uint32_t> target_nodes;
-  std::ifstream target_node_file(target_node_file_path);
-  int32_t buffer;
-  while (target_node_file.read(reinterpret_cast<char *>(&buffer),
-                               sizeof(buffer))) {
-    target_nodes.push_back(buffer);
-  }
-  target_node_file.close();
+  ArrayFile target_node_file(target_node_file_path, 4);
+  Span<const uint32_t> nodes = target_node_file.view<uint32_t>();
+  std::vector<uint32_t> target_nodes(nodes.begin(), nodes.end());
   sort(target_nodes.begin(), target_nodes.end());
   return target_nodes;
 }
@@ -0,0 +1,295 @@
+#include "ReadPlanner.hpp"
+#include "SmartSSDBase.hpp"
+#include "utils/alias_table.hpp"
+#include "utils/artifact_writer.hpp"
+#include "utils/graph_generator.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <set>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+const uint64_t N_NODES = 1 << 15;
+const size_t N_FRONTIER = 3000;
+const uint N_NEIGHBORS = 10;
+const size_t BUFFER_SECTORS = 1 << 14;
+const uint64_t NO_EDGE = static_cast<uint64_t>(-1);
+
+/**
+ * The graph files, and the buffers and kernels of an emulated device
+ */
+struct Setup {
+  ArrayFile offsets;
+  std::vector<uint32_t> edges;
+  std::vector<AliasEntry> entries;
+  int edge_file;
+  int entry_file;
+  SmartSSDBase uniform;
+  SmartSSDBase weighted;
+  xrt::bo in;
+  xrt::bo out;
+  xrt::bo sector_offsets;
+  xrt::bo buffer_offsets;
+  xrt::bo coins;
+};
+
+template <typename T> std::vector<T> readFile(std::string path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  assert(file != nullptr);
+  std::vector<T> values;
+  T value;
+  while (fread(&value, sizeof(T), 1, file) == 1) {
+    values.push_back(value);
+  }
+  fclose(file);
+  return values;
+}
+
+/**
+ * The neighbor slot j of node gets in a layer of draws, read from the edge
+ * files directly, or -1, and the edge (or alias entry) it is in
+ */
+std::vector<uint> expectedSlots(const Setup &setup, uint node,
+                                const Philox &draws, bool replace,
+                                bool weighted, std::vector<uint64_t> &edges) {
+  uint64_t first = setup.offsets[node];
+  uint64_t degree = setup.offsets[node + 1] - first;
+  std::vector<uint> slots(N_NEIGHBORS, static_cast<uint>(-1));
+  std::vector<uint32_t> coins(N_NEIGHBORS);
+  edges.assign(N_NEIGHBORS, NO_EDGE);
+  if (weighted && degree > 0) {
+    draws.drawAlias(node, degree, N_NEIGHBORS, edges.data(), coins.data());
+  } else if (degree < N_NEIGHBORS || weighted) {
+    for (uint j = 0; j < degree; j++) {
+      edges[j] = j;
+    }
+  } else if (replace) {
+    draws.drawBelow(node, degree, N_NEIGHBORS, edges.data());
+  } else {
+    draws.drawDistinct(node, degree, N_NEIGHBORS, edges.data());
+  }
+  for (uint j = 0; j < N_NEIGHBORS; j++) {
+    if (edges[j] == NO_EDGE) {
+      continue;
+    }
+    edges[j] += first;
+    slots[j] = weighted ? AliasTable::pick(setup.entries[edges[j]], coins[j])
+                        : setup.edges[edges[j]];
+  }
+  return slots;
+}
+
+/**
+ * Plan one layer, read its sectors and run the kernel on them, then check
+ * every slot against the edge files and the reads against the plan
+ * @return The number of sectors the lookups found in the cache
+ */
+size_t checkLayer(Setup &setup, ReadPlanner &planner,
+                  const std::vector<uint> &frontier, const Philox &draws,
+                  bool replace, bool weighted, size_t max_gap_sectors,
+                  size_t max_run_sectors, SectorCache *cache = nullptr) {
+  size_t n_slots = frontier.size() * N_NEIGHBORS;
+  char *buffer = setup.in.map<char *>();
+  uint *sector_offsets = setup.sector_offsets.map<uint *>();
+  uint *buffer_offsets = setup.buffer_offsets.map<uint *>();
+  uint *coins = setup.coins.map<uint *>();
+  // a slot pointed at a sector of an earlier layer gets garbage
+  memset(buffer, 0xff, BUFFER_SECTORS * 512);
+  planner.setReplace(replace);
+  planner.setWeighted(weighted);
+  std::vector<UringReader::ReadRequest> requests;
+  size_t n_hits = cache ? cache->getNumHits() : 0;
+  ssize_t used = planner.plan(frontier.data(), frontier.size(), N_NEIGHBORS,
+                              setup.offsets, BUFFER_SECTORS, draws,
+                              sector_offsets, buffer_offsets, requests, cache,
+                              buffer, weighted ? coins : nullptr);
+  n_hits = cache ? cache->getNumHits() - n_hits : 0;
+  assert(used > 0 && (size_t)used == planner.getNumBufferSectors());
+  assert(planner.getNumReadSectors() + planner.getNumCachedSectors() <=
+         (size_t)used);
+
+  // the edge of every slot, and the distinct sectors they are in
+  uint64_t per_sector = weighted ? AliasTable::ENTRIES_PER_SECTOR : 128;
+  std::vector<std::vector<uint>> expected(frontier.size());
+  std::vector<uint64_t> edges;
+  std::set<uint64_t> sectors;
+  size_t n_samples = 0;
+  for (size_t i = 0; i < frontier.size(); i++) {
+    expected[i] =
+        expectedSlots(setup, frontier[i], draws, replace, weighted, edges);
+    for (uint64_t edge : edges) {
+      if (edge != NO_EDGE) {
+        sectors.insert(edge / per_sector);
+        n_samples++;
+      }
+    }
+  }
+  assert(planner.getNumSamples() == n_samples);
+  assert(planner.getNumSectors() == sectors.size() &&
+         "sectors are not read once each");
+
+  // the reads fit the buffer, and without a cache obey the merging limits
+  size_t n_read_sectors = 0;
+  for (size_t r = 0; r < requests.size(); r++) {
+    const UringReader::ReadRequest &request = requests[r];
+    assert(request.length % 512 == 0 && request.length > 0);
+    assert(request.length <= max_run_sectors * 512 && "a read is too long");
+    assert(request.buffer_offset + request.length <= (size_t)used * 512);
+    n_read_sectors += request.length / 512;
+    if (cache == nullptr && r > 0) {
+      const UringReader::ReadRequest &prev = requests[r - 1];
+      uint64_t gap =
+          (request.file_offset - prev.file_offset - prev.length) / 512;
+      assert(request.file_offset >= prev.file_offset + prev.length);
+      assert(request.buffer_offset == prev.buffer_offset + prev.length &&
+             "reads are not back to back in the buffer");
+      assert((gap > max_gap_sectors ||
+              (request.file_offset + request.length - prev.file_offset) /
+                      512 >
+                  max_run_sectors) &&
+             "close reads were not merged");
+    }
+  }
+  assert(n_read_sectors == planner.getNumReadSectors());
+
+  int file = weighted ? setup.entry_file : setup.edge_file;
+  UringReader reader(file, 64);
+  reader.setBuffer(buffer, BUFFER_SECTORS * 512);
+  assert(reader.read(requests) == 0);
+  if (cache != nullptr) {
+    planner.admitReadSectors(*cache, buffer);
+  }
+  if (weighted) {
+    xrt::kernel krnl = setup.weighted.getXrtKernel()[0];
+    auto run = krnl(setup.in, setup.out, setup.sector_offsets,
+                    setup.buffer_offsets, setup.coins, n_slots);
+    run.wait();
+  } else {
+    xrt::kernel krnl = setup.uniform.getXrtKernel()[0];
+    auto run = krnl(setup.in, setup.out, setup.sector_offsets,
+                    setup.buffer_offsets, n_slots);
+    run.wait();
+  }
+
+  const uint *out = setup.out.map<uint *>();
+  size_t n_wrapped = 0;
+  for (size_t i = 0; i < frontier.size(); i++) {
+    for (uint j = 0; j < N_NEIGHBORS; j++) {
+      size_t slot = i * N_NEIGHBORS + j;
+      assert(out[slot] == expected[i][j] && "a slot got the wrong neighbor");
+      // the kernel wraps around to buffer sectors after the slot
+      n_wrapped += expected[i][j] != static_cast<uint>(-1) &&
+                   buffer_offsets[slot] > slot;
+    }
+    uint64_t degree =
+        setup.offsets[frontier[i] + 1] - setup.offsets[frontier[i]];
+    if (!replace && !weighted && degree >= N_NEIGHBORS) {
+      std::set<uint> distinct(out + i * N_NEIGHBORS,
+                              out + (i + 1) * N_NEIGHBORS);
+      assert(distinct.size() == N_NEIGHBORS && "a neighbor is drawn twice");
+    }
+  }
+  assert(n_wrapped > 0 && "no slot reads a buffer sector after it");
+  if (cache == nullptr) {
+    // every distinct sector needs a buffer sector
+    std::vector<UringReader::ReadRequest> small_requests;
+    assert(planner.plan(frontier.data(), frontier.size(), N_NEIGHBORS,
+                        setup.offsets, sectors.size() - 1, draws,
+                        sector_offsets, buffer_offsets, small_requests,
+                        nullptr, buffer, weighted ? coins : nullptr) == -1);
+  }
+  return n_hits;
+}
+
+int main() {
+  // the edge files are read with O_DIRECT, so they are written next to the
+  // test binary rather than to a tmpfs
+  std::string dir = "read_planner_graph";
+  mkdir(dir.c_str(), 0755);
+  GraphGenerator generator(GraphGenerator::LOG_NORMAL, N_NODES, 16, 5);
+  generator.setMaxDegree(1000);
+  ArtifactWriter writer(dir, 16384, 8, false, false, true);
+  generator.write(writer, 0.1);
+
+  Setup setup;
+  setup.offsets = ArrayFile(dir + "/offsets.bin", 0);
+  setup.edges = readFile<uint32_t>(dir + "/random_read_edges.bin");
+  setup.entries = readFile<AliasEntry>(dir + "/weighted_edges.bin");
+  setup.edge_file =
+      open((dir + "/random_read_edges.bin").c_str(), O_RDONLY | O_DIRECT);
+  setup.entry_file =
+      open((dir + "/weighted_edges.bin").c_str(), O_RDONLY | O_DIRECT);
+  assert(setup.edge_file >= 0 && setup.entry_file >= 0);
+  setup.uniform.loadXrtDevice({0});
+  setup.uniform.loadXrtUUID("random_read_sampler.xclbin");
+  setup.uniform.loadXrtKernel("random_read_sampler");
+  setup.weighted.loadXrtDevice({0});
+  setup.weighted.loadXrtUUID("weighted_random_read_sampler.xclbin");
+  setup.weighted.loadXrtKernel("weighted_random_read_sampler");
+  const xrt::device &device = setup.uniform.getXrtDevice()[0];
+  xrt::bo::flags flags = setup.uniform.getP2PFlags();
+  size_t slots_byte = N_FRONTIER * N_NEIGHBORS * sizeof(uint);
+  setup.in = xrt::bo(device, BUFFER_SECTORS * 512, flags, 0);
+  setup.out = xrt::bo(device, slots_byte, flags, 0);
+  setup.sector_offsets = xrt::bo(device, slots_byte, flags, 0);
+  setup.buffer_offsets = xrt::bo(device, slots_byte, flags, 0);
+  setup.coins = xrt::bo(device, slots_byte, flags, 0);
+
+  // the frontier repeats nodes and takes the hubs too, so slots share
+  // sectors and nodes span several
+  std::vector<uint> frontier;
+  Philox nodes(3, 0, 0);
+  for (size_t i = 0; i < N_FRONTIER; i++) {
+    uint node = Philox::below(nodes.draw(0, i), N_NODES);
+    frontier.push_back(i % 10 == 0 ? node % 64 : node);
+  }
+
+  ReadPlanner planner;
+  checkLayer(setup, planner, frontier, Philox(9, 0, 0), true, false, 1, 256);
+  checkLayer(setup, planner, frontier, Philox(9, 0, 1), false, false, 1, 256);
+  checkLayer(setup, planner, frontier, Philox(9, 0, 2), true, true, 1, 256);
+  // wider gaps and shorter reads
+  ReadPlanner merging(4, 8);
+  checkLayer(setup, merging, frontier, Philox(9, 1, 0), true, false, 4, 8);
+  checkLayer(setup, merging, frontier, Philox(9, 1, 1), false, false, 4, 8);
+
+  // another device keeps cycling every sector through a small cache, so
+  // sectors found by the lookups are evicted before they are copied and
+  // have to be read after all
+  std::vector<char> file_data(setup.edges.size() * 4);
+  memcpy(file_data.data(), setup.edges.data(), file_data.size());
+  size_t n_file_sectors = file_data.size() / 512;
+  SectorCache cache(n_file_sectors / 4 * 512, 4);
+  std::atomic<bool> running(true);
+  std::thread other_device([&]() {
+    for (size_t s = 0; running; s = (s + 1) % n_file_sectors) {
+      cache.insert(s, file_data.data() + s * 512);
+    }
+  });
+  bool evicted = false;
+  for (uint32_t call = 0; call < 1000 && !evicted; call++) {
+    size_t n_hits = checkLayer(setup, planner, frontier,
+                               Philox(9, 2 + call, 0), true, false, 1, 256,
+                               &cache);
+    evicted = planner.getNumCachedSectors() < n_hits;
+  }
+  running = false;
+  other_device.join();
+  assert(evicted && "no cached sector was evicted during a plan");
+  // and a plan on the quiet cache copies what it found
+  size_t n_hits = checkLayer(setup, planner, frontier, Philox(9, 0, 3), false,
+                             false, 1, 256, &cache);
+  assert(n_hits > 0 && planner.getNumCachedSectors() == n_hits);
+
+  close(setup.edge_file);
+  close(setup.entry_file);
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
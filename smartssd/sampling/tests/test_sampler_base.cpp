@@ -26,5 +26,13 @@ int main() {
   testSamplerBase.setFanouts({20, 20, 20, 20});
   assert(testSamplerBase.getFanouts().size() == 4 &&
          "number of layers is not correct");
+
+  // the default sample goes through getSample
+  SampleWorkspace workspace;
+  testSamplerBase.sample(Span<const uint>(frontier.data(), frontier.size()),
+                         workspace);
+  assert(workspace.getNumLayers() == 3 && "number of layers is not correct");
+  assert(workspace.getLayer(1).size() == 3 && workspace.getLayer(1)[0] == 4 &&
+         "layer is not correct");
   return 0;
 }
@@ -0,0 +1,98 @@
+#include "SectorCache.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+
+int main() {
+  // 4 shards of 4 sectors
+  SectorCache cache(16 * 512, 4);
+  assert(cache.getCapacity() == 16 && "capacity is not correct");
+
+  std::vector<char> sector(512), copy(512);
+  for (uint64_t s = 0; s < 8; s++) {
+    memset(sector.data(), (int)s, 512);
+    cache.insert(s, sector.data());
+  }
+  assert(cache.size() == 8);
+  for (uint64_t s = 0; s < 8; s++) {
+    assert(cache.lookup(s) && "inserted sector is not cached");
+    assert(cache.copyTo(s, copy.data()));
+    assert(copy[0] == (char)s && copy[511] == (char)s);
+  }
+  assert(!cache.lookup(100));
+  assert(!cache.copyTo(100, copy.data()));
+  assert(cache.getNumLookups() == 9 && cache.getNumHits() == 8);
+
+  // the referenced sectors survive a flood of new ones better than the rest
+  for (uint64_t s = 1000; s < 1100; s++) {
+    cache.lookup(3);
+    cache.insert(s, sector.data());
+  }
+  assert(cache.size() == cache.getCapacity() && "cache is not full");
+  assert(cache.lookup(3) && "referenced sector was evicted");
+  cache.resetStats();
+  assert(cache.getHitRate() == 0);
+
+  // node 1 has 300 edges over 3 sectors, node 2 a single edge
+  const char *file_path = "test_sector_cache_edges.bin";
+  std::vector<uint> edges(1024);
+  for (size_t i = 0; i < edges.size(); i++) {
+    edges[i] = i;
+  }
+  FILE *file = fopen(file_path, "wb");
+  fwrite(edges.data(), sizeof(uint), edges.size(), file);
+  fclose(file);
+  const char *offsets_path = "test_sector_cache_offsets.bin";
+  std::vector<uint64_t> offsets_data = {0, 128, 428, 429, 1024};
+  assert(ArrayFile::write(offsets_path, offsets_data.data(), 8,
+                          offsets_data.size()) == 0);
+  ArrayFile offsets(offsets_path);
+  int fd = open(file_path, O_RDONLY);
+  assert(fd >= 0);
+
+  // room for node 3 (5 sectors) and node 1 (3 sectors), not node 0
+  SectorCache warm_cache(8 * 512, 1);
+  assert(warm_cache.prewarm(fd, offsets) == 2 && "prewarm took wrong nodes");
+  assert(warm_cache.lookup(1) && warm_cache.lookup(3) && warm_cache.lookup(7));
+  assert(!warm_cache.lookup(0));
+  assert(warm_cache.copyTo(2, copy.data()));
+  assert(reinterpret_cast<uint *>(copy.data())[5] == 256 + 5);
+  assert(warm_cache.getHitRate() == 0.75);
+
+  close(fd);
+  remove(file_path);
+  remove(offsets_path);
+
+  // 64 nodes of one sector each fill the budget of 8 shards, but not every
+  // shard gets 8 of them; only the nodes still cached are counted
+  std::vector<uint> hub_edges(64 * 128, 1);
+  file = fopen(file_path, "wb");
+  fwrite(hub_edges.data(), sizeof(uint), hub_edges.size(), file);
+  fclose(file);
+  std::vector<uint64_t> hub_offsets_data;
+  for (uint64_t v = 0; v <= 64; v++) {
+    hub_offsets_data.push_back(v * 128);
+  }
+  assert(ArrayFile::write(offsets_path, hub_offsets_data.data(), 8,
+                          hub_offsets_data.size()) == 0);
+  ArrayFile hub_offsets(offsets_path);
+  fd = open(file_path, O_RDONLY);
+  assert(fd >= 0);
+  SectorCache sharded_cache(64 * 512, 8);
+  size_t n_warm = sharded_cache.prewarm(fd, hub_offsets);
+  size_t n_present = 0;
+  for (uint64_t s = 0; s < 64; s++) {
+    n_present += sharded_cache.copyTo(s, copy.data());
+  }
+  assert(n_warm == n_present && n_warm < 64 &&
+         "prewarm counted nodes that a full shard evicted");
+
+  close(fd);
+  remove(file_path);
+  remove(offsets_path);
+  std::cout << "SectorCache test passed" << std::endl;
+}
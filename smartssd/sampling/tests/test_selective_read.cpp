@@ -0,0 +1,83 @@
+#include "StreamingSampler.hpp"
+#include "utils/artifact_writer.hpp"
+#include <cassert>
+#include <iostream>
+#include <sys/stat.h>
+#include <vector>
+
+const uint N_NODES = 20000;
+const uint DEGREE = 16;
+// 16 pages a chunk, so that a few targets take a few of them
+const size_t CHUNK_SIZE_BYTE = 64 * 1024;
+
+/**
+ * Sample a layer of every `step`-th node and the last one, with selective
+ * reads up to `density` of a chunk
+ */
+std::vector<uint> sample(StreamingSampler &sampler, uint step, double density,
+                         size_t &bytes_read) {
+  sampler.setSelectiveReadDensity(density);
+  std::vector<uint> frontier, result;
+  for (uint v = 0; v < N_NODES; v += step) {
+    frontier.push_back(v);
+  }
+  frontier.push_back(N_NODES - 1);
+  size_t before = sampler.getEdgeBytesRead();
+  sampler.sampleLayer(Span<const uint>(frontier.data(), frontier.size()), 4,
+                      result, Philox(7, step, 0));
+  bytes_read = sampler.getEdgeBytesRead() - before;
+  return result;
+}
+
+int main() {
+  // the edge file is opened with O_DIRECT, so it is written next to the test
+  // binary rather than to a tmpfs
+  std::string dir = "selective_read_graph";
+  mkdir(dir.c_str(), 0755);
+  std::vector<uint32_t> degrees(N_NODES, DEGREE), edges, train;
+  for (uint v = 0; v < N_NODES; v++) {
+    for (uint k = 0; k < DEGREE; k++) {
+      edges.push_back((v * 31 + k * 97) % N_NODES);
+    }
+    train.push_back(v);
+  }
+  ArtifactWriter writer(dir, CHUNK_SIZE_BYTE, 4);
+  writer.addNodes(0, degrees.data(), N_NODES, edges.data());
+  writer.finish();
+  writer.writeTrainNodes(train);
+
+  StreamingSampler sampler(
+      {0}, "parallel_streaming_sampler.xclbin", "parallel_streaming_sampler",
+      dir + "/streaming_edges.bin", dir + "/chunk_info.bin",
+      dir + "/train.bin", {4}, CHUNK_SIZE_BYTE / sizeof(int));
+  sampler.setDeviceMemory(64 << 20);
+  size_t n_chunks = sampler.getChunkOffsets().size();
+  size_t file_bytes = 0;
+  for (size_t c = 0; c < n_chunks; c++) {
+    file_bytes += sampler.getChunkStoredSize(c);
+  }
+  assert(n_chunks >= 10);
+
+  // a sparse frontier reads a few pages of every chunk, the last chunk up
+  // to its end, and samples what the whole chunks give. It goes first, so
+  // that no slot holds a whole chunk read before.
+  size_t full_bytes, selective_bytes;
+  std::vector<uint> selective = sample(sampler, 500, 0.25, selective_bytes);
+  std::vector<uint> full = sample(sampler, 500, 0, full_bytes);
+  assert(full_bytes == file_bytes);
+  assert(selective_bytes < full_bytes / 4 &&
+         "the sparse chunks were not read selectively");
+  assert(!full.empty() && selective == full &&
+         "selective reads change the samples");
+
+  // a dense frontier needs more than the density of every chunk, which is
+  // then read whole
+  std::vector<uint> dense_full = sample(sampler, 10, 0, full_bytes);
+  std::vector<uint> dense = sample(sampler, 10, 0.25, selective_bytes);
+  assert(selective_bytes == file_bytes &&
+         "the dense chunks were not read whole");
+  assert(dense == dense_full && "the whole chunk fallback changes the samples");
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
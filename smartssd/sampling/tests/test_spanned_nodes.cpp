@@ -0,0 +1,107 @@
+#include "StreamingSampler.hpp"
+#include "utils/artifact_writer.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <sys/stat.h>
+#include <vector>
+
+const uint N_NODES = 1000;
+const size_t CHUNK_SIZE_BYTE = 512;
+// edges of a piece of a node larger than a chunk, after the chunk header
+const uint PIECE = CHUNK_SIZE_BYTE / 4 - 4;
+// node 0 spans four full pieces and a smaller one, node 1 a full one and a
+// smaller one, the others fit in a chunk
+const uint HUB = 560;
+const uint SMALL_HUB = 200;
+
+std::vector<uint> sample(StreamingSampler &sampler, uint node, uint fanout,
+                         uint32_t call) {
+  std::vector<uint> frontier = {node}, result;
+  sampler.sampleLayer(Span<const uint>(frontier.data(), frontier.size()),
+                      fanout, result, Philox(11, call, 0));
+  return result;
+}
+
+int main() {
+  // the edge file is opened with O_DIRECT, so it is written next to the test
+  // binary rather than to a tmpfs
+  std::string dir = "spanned_nodes_graph";
+  mkdir(dir.c_str(), 0755);
+  // the hubs have distinct neighbors, neighbor k of node 0 is k + 1
+  std::vector<uint32_t> degrees(N_NODES, 4), edges, train;
+  degrees[0] = HUB;
+  degrees[1] = SMALL_HUB;
+  for (uint v = 0; v < N_NODES; v++) {
+    for (uint k = 0; k < degrees[v]; k++) {
+      edges.push_back(v < 2 ? v + k + 1 : (v * 31 + k * 97) % N_NODES);
+    }
+    train.push_back(v);
+  }
+  ArtifactWriter writer(dir, CHUNK_SIZE_BYTE, 4);
+  writer.addNodes(0, degrees.data(), N_NODES, edges.data());
+  writer.finish();
+  writer.writeTrainNodes(train);
+
+  StreamingSampler sampler(
+      {0}, "parallel_streaming_sampler.xclbin", "parallel_streaming_sampler",
+      dir + "/streaming_edges.bin", dir + "/chunk_info.bin",
+      dir + "/train.bin", {1}, CHUNK_SIZE_BYTE / sizeof(int));
+  sampler.setDeviceMemory(64 << 20);
+  assert(sampler.getNumSpannedNodes() == 2);
+
+  // every draw takes from a piece by its share of the neighbors
+  const uint n_calls = 5000;
+  const uint n_pieces = (HUB + PIECE - 1) / PIECE;
+  std::vector<uint> hits(n_pieces);
+  for (uint32_t call = 0; call < n_calls; call++) {
+    std::vector<uint> result = sample(sampler, 0, 1, call);
+    assert(result.size() == 1);
+    assert(result[0] >= 1 && result[0] <= HUB && "not a neighbor");
+    hits[(result[0] - 1) / PIECE]++;
+  }
+  for (uint i = 0; i < n_pieces; i++) {
+    double expected =
+        (double)n_calls * std::min(PIECE, HUB - i * PIECE) / HUB;
+    assert(std::abs(hits[i] - expected) < 0.02 * n_calls &&
+           "a piece is not hit by its share of the neighbors");
+  }
+
+  // the last piece is at most the fanout, the kernel returns all of its
+  // neighbors and they are drawn from on the host
+  sampler.setFanouts({PIECE});
+  std::set<uint> seen;
+  for (uint32_t call = 0; call < 20; call++) {
+    for (uint node : sample(sampler, 0, PIECE, n_calls + call)) {
+      assert(node >= 1 && node <= HUB && "not a neighbor");
+      seen.insert(node);
+    }
+  }
+  assert(*seen.rbegin() > (n_pieces - 1) * PIECE &&
+         "the last piece is never sampled");
+
+  // without replacement the samples of a node are distinct, and a fanout
+  // above the degree takes every neighbor
+  sampler.setFanouts({StreamingSampler::MAX_DISTINCT_FANOUT});
+  sampler.setReplace(false);
+  for (uint32_t call = 0; call < 20; call++) {
+    std::vector<uint> result = sample(
+        sampler, 0, StreamingSampler::MAX_DISTINCT_FANOUT, 2 * n_calls + call);
+    assert(result.size() == StreamingSampler::MAX_DISTINCT_FANOUT &&
+           "the samples are not distinct");
+    for (uint node : result) {
+      assert(node >= 1 && node <= HUB && "not a neighbor");
+    }
+  }
+  std::vector<uint> all =
+      sample(sampler, 1, StreamingSampler::MAX_DISTINCT_FANOUT, 3 * n_calls);
+  assert(all.size() == SMALL_HUB && "not every neighbor was taken");
+  for (uint node : all) {
+    assert(node >= 2 && node <= SMALL_HUB + 1 && "not a neighbor");
+  }
+
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "utils/uring_reader.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// the file ends in the middle of a sector
+const size_t FILE_SIZE_BYTE = 1024 * 512 + 100;
+const size_t N_REQUESTS = 300;
+const unsigned QUEUE_DEPTH = 16;
+
+/**
+ * Scattered one sector reads in the file, each to its own sector of the
+ * buffer in shuffled order
+ */
+std::vector<UringReader::ReadRequest> scatteredRequests() {
+  std::mt19937 rng(5);
+  std::vector<uint64_t> buffer_sectors(N_REQUESTS);
+  for (size_t i = 0; i < N_REQUESTS; i++) {
+    buffer_sectors[i] = i;
+  }
+  std::shuffle(buffer_sectors.begin(), buffer_sectors.end(), rng);
+  std::vector<UringReader::ReadRequest> requests;
+  for (size_t i = 0; i < N_REQUESTS; i++) {
+    uint64_t file_sector = rng() % (FILE_SIZE_BYTE / 512);
+    requests.push_back({file_sector * 512, buffer_sectors[i] * 512, 512});
+  }
+  return requests;
+}
+
+/**
+ * Read the requests with a fresh reader and compare every byte with pread
+ */
+void checkRead(int fd, unsigned queue_depth, bool iopoll,
+               const std::vector<UringReader::ReadRequest> &requests) {
+  size_t buffer_size = N_REQUESTS * 512;
+  char *buffer = static_cast<char *>(aligned_alloc(4096, buffer_size));
+  memset(buffer, 0, buffer_size);
+  UringReader reader(fd, queue_depth, iopoll);
+  reader.setBuffer(buffer, buffer_size);
+  assert(reader.read(requests) == 0 && "the reads failed");
+  std::vector<char> expected(512);
+  for (auto &request : requests) {
+    ssize_t re = pread(fd, expected.data(), request.length,
+                       request.file_offset);
+    assert(re == (ssize_t)request.length);
+    assert(memcmp(buffer + request.buffer_offset, expected.data(),
+                  request.length) == 0 &&
+           "a sector read differs from pread");
+  }
+  free(buffer);
+}
+
+int main() {
+  // written next to the test binary, O_DIRECT does not work on a tmpfs
+  std::string path = "uring_reader_file.bin";
+  std::vector<char> content(FILE_SIZE_BYTE);
+  std::mt19937 rng(3);
+  for (auto &c : content) {
+    c = static_cast<char>(rng());
+  }
+  int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  assert(out >= 0);
+  assert(write(out, content.data(), content.size()) ==
+         (ssize_t)content.size());
+  close(out);
+  int fd = open(path.c_str(), O_RDONLY);
+  int direct_fd = open(path.c_str(), O_RDONLY | O_DIRECT);
+  assert(fd >= 0);
+
+  std::vector<UringReader::ReadRequest> requests = scatteredRequests();
+  {
+    UringReader reader(fd, QUEUE_DEPTH);
+    assert(reader.isReady() && "io_uring is not available");
+  }
+  // more requests than entries in the queue, so it is refilled many times
+  checkRead(fd, QUEUE_DEPTH, false, requests);
+  if (direct_fd >= 0) {
+    checkRead(direct_fd, QUEUE_DEPTH, false, requests);
+  }
+  // a buffered file cannot be polled, the reads fail with EOPNOTSUPP and
+  // are done again on a ring without IOPOLL
+  checkRead(fd, QUEUE_DEPTH, true, requests);
+  // no ring with a queue of zero, the requests go through pread
+  {
+    UringReader reader(fd, 0);
+    assert(!reader.isReady());
+  }
+  checkRead(fd, 0, false, requests);
+
+  // a request over the end of the file comes back short, its retry reads
+  // nothing and the read fails with EIO after the bytes up to the end
+  for (unsigned queue_depth : {QUEUE_DEPTH, 0u}) {
+    char *buffer = static_cast<char *>(aligned_alloc(4096, 4096));
+    memset(buffer, 0, 4096);
+    UringReader reader(fd, queue_depth);
+    reader.setBuffer(buffer, 4096);
+    std::vector<UringReader::ReadRequest> past_end = {
+        {0, 0, 512}, {FILE_SIZE_BYTE - 100, 512, 512}};
+    assert(reader.read(past_end) == -EIO &&
+           "a read past the end of the file did not fail");
+    assert(memcmp(buffer, content.data(), 512) == 0);
+    assert(memcmp(buffer + 512, content.data() + FILE_SIZE_BYTE - 100,
+                  100) == 0 &&
+           "the bytes up to the end of the file were not read");
+    free(buffer);
+  }
+
+  close(fd);
+  if (direct_fd >= 0) {
+    close(direct_fd);
+  }
+  std::cout << "All tests passed!" << std::endl;
+  return 0;
+}